@@ -26,12 +26,20 @@ CEXPORT const char* bingoVersion();
 // options = "id: <property-name>"
 CEXPORT int bingoCreateDatabaseFile(const char* location, const char* type, const char* options);
 CEXPORT int bingoLoadDatabaseFile(const char* location, const char* options);
+// Opens the databases of the locations, separated by ';', with the same options as one read-only database.
+// Every search on it runs on all the databases at once, one thread per database. Top-N similarity searches
+// return the best hits of all the databases by decreasing similarity, the other searches return the hits
+// as the databases find them. Ids of the hits are the ids of the records in their databases.
+// bingoCloseDatabase closes all the databases
+CEXPORT int bingoLoadFederatedDatabase(const char* locations, const char* options);
 CEXPORT int bingoCloseDatabase(int db);
 
 //
 // Record insertion/deletion
 //
 CEXPORT int bingoInsertRecordObj(int db, int obj);
+// Inserts all the records of the iterator with bingonosql-insert-thread-count threads preparing them.
+// Records get ids in the iterator order regardless of the thread count. Returns the number of inserted records.
 CEXPORT int bingoInsertIteratorObj(int db, int iterator_obj_id);
 CEXPORT int bingoInsertRecordObjWithId(int db, int obj, int id);
 CEXPORT int bingoInsertRecordObjWithExtFP(int db, int obj, int fp);
@@ -41,17 +49,35 @@ CEXPORT int bingoGetRecordObj(int db, int id);
 
 CEXPORT int bingoOptimize(int db);
 
+// Reads the fingerprint storages of the database into memory. The mapping of the
+// database files is tuned by the load options mmf_populate, mmf_huge_pages and mmf_advise
+CEXPORT int bingoWarmup(int db);
+
 // Search methods that returns search object
 // Search object is an iterator
 CEXPORT int bingoSearchSub(int db, int query_obj, const char* options);
 CEXPORT int bingoSearchExact(int db, int query_obj, const char* options);
 CEXPORT int bingoSearchMolFormula(int db, const char* query, const char* options);
+
+// Exact search of all the records of the iterator at once, e.g. to find the records of an SDF or SMILES file
+// already present in the database. The records are hashed by bingonosql-insert-thread-count threads and joined
+// with the exact storage in its order, only the records sharing a hash with a stored one are matched.
+// Options are the ones of bingoSearchExact. Returns a search object over the matches ordered by the record index:
+// bingoGetCurrentId returns the id of the found record, bingoGetCurrentQueryIndex the index of the matched
+// record of the iterator starting from 0. Federated databases are not supported.
+CEXPORT int bingoSearchExactBatch(int db, int iterator_obj, const char* options);
 CEXPORT int bingoSearchSim(int db, int query_obj, float min, float max, const char* options);
 CEXPORT int bingoSearchSimWithExtFP(int db, int query_obj, float min, float max, int fp, const char* options);
 
 CEXPORT int bingoSearchSimTopN(int db, int query_obj, int limit, float min, const char* options);
 CEXPORT int bingoSearchSimTopNWithExtFP(int db, int query_obj, int limit, float min, int fp, const char* options);
 
+// Searches all the molecules, reactions or fingerprints of the queries array in one pass over the database.
+// search_objs receives a search object per query in the order of the array, it must have room for all of them.
+// If limit > 0 every search object returns only the best limit hits, otherwise all the hits with similarity >= min.
+// Hits are returned in order of decreasing similarity. Returns the number of search objects.
+CEXPORT int bingoSearchSimBatch(int db, int queries, int limit, float min, float max, const char* options, int* search_objs);
+
 CEXPORT int bingoEnumerateId(int db);
 
 //
@@ -60,6 +86,8 @@ CEXPORT int bingoEnumerateId(int db);
 CEXPORT int bingoNext(int search_obj);
 CEXPORT int bingoGetCurrentId(int search_obj);
 CEXPORT float bingoGetCurrentSimilarityValue(int search_obj);
+// Index of the iterator record matched by the current hit of bingoSearchExactBatch
+CEXPORT int bingoGetCurrentQueryIndex(int search_obj);
 
 // Estimation methods
 CEXPORT int bingoEstimateRemainingResultsCount(int search_obj);
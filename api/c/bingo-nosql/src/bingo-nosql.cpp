@@ -19,10 +19,16 @@
 #include "bingo-nosql.h"
 
 #include <cstdio>
+#include <functional>
 #include <string>
+#include <thread>
 
+#include "bingo_exact_join.h"
+#include "bingo_federated_matcher.h"
 #include "bingo_index.h"
+#include "bingo_insert_dispatcher.h"
 #include "bingo_internal.h"
+#include "indigo_array.h"
 #include "indigo_internal.h"
 #include "indigo_molecule.h"
 #include "indigo_reaction.h"
@@ -108,6 +114,14 @@ namespace
         static sf::safe_shared_hide_obj<SearchesData> searches_data;
         return searches_data;
     }
+
+    // Shard databases of the federated databases. The ids of the federated
+    // databases are taken from the pool of the indexes, so they never clash
+    static sf::safe_shared_hide_obj<std::unordered_map<long long, std::vector<int>>>& _federations()
+    {
+        static sf::safe_shared_hide_obj<std::unordered_map<long long, std::vector<int>>> federations;
+        return federations;
+    }
 }
 
 static int _bingoCreateOrLoadDatabaseFile(const char* location, const char* options, bool create, const char* type = nullptr)
@@ -197,7 +211,7 @@ static int _insertObjectToDatabase(int db, Indigo& self, IndigoObject& indigo_ob
             return (*bingo_index_ptr)->prepareIndexData(ind_mol);
         }();
         {
-            auto bingo_index_ptr = sf::xlock_safe_ptr(bingo_indexes->at(db));
+            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
             return (*bingo_index_ptr)->add(obj_id, obj_data);
         }
     }
@@ -219,7 +233,7 @@ static int _insertObjectToDatabase(int db, Indigo& self, IndigoObject& indigo_ob
             return (*bingo_index_ptr)->prepareIndexData(ind_rxn);
         }();
         {
-            auto bingo_index_ptr = sf::xlock_safe_ptr(bingo_indexes->at(db));
+            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
             return (*bingo_index_ptr)->add(obj_id, obj_data);
         }
     }
@@ -229,53 +243,22 @@ static int _insertObjectToDatabase(int db, Indigo& self, IndigoObject& indigo_ob
     }
 }
 
-static int _insertIteratorToDatabase(int db, Indigo& self, IndigoObject& iter, long obj_id)
+static int _insertIteratorToDatabase(int db, Indigo& self, IndigoObject& iter)
 {
-    profTimerStart(t, "_insertObjectToDatabase");
-    auto bingo_index_ptr = sf::xlock_safe_ptr(sf::slock_safe_ptr(_indexes())->at(db));
+    profTimerStart(t, "_insertIteratorToDatabase");
+    // Writers are serialized by the index, so searches keep running during the insert
+    const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+    const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
     const auto index_type = (*bingo_index_ptr)->getType();
 
-    if (index_type == IndexType::MOLECULE)
+    if (index_type != IndexType::MOLECULE && index_type != IndexType::REACTION)
     {
-        int counter = 0;
-        while (true)
-        {
-            try
-            {
-                IndigoObject* next_obj_ptr = iter.next();
-                if (next_obj_ptr == nullptr)
-                {
-                    break;
-                }
-                IndigoObject& next_obj = *next_obj_ptr;
-
-                profTimerStart(t1, "_preadd");
-
-                if (!IndigoMolecule::is(next_obj))
-                {
-                    throw BingoException("_insertIteratorToDatabase: Only molecule objects can be added to molecule index");
-                }
-                // FIXME: MK: for some reason we need to aromatize input molecule. If we first clone and aromatize cloned, it won't work
-                next_obj.getMolecule().aromatize(self.arom_options);
-                IndexMolecule ind_mol(next_obj.getMolecule(), self.arom_options);
-                profTimerStop(t1);
-                const auto obj_data = (*bingo_index_ptr)->prepareIndexData(ind_mol);
-                {
-                    (*bingo_index_ptr)->add(obj_id, obj_data);
-                }
-            }
-            catch (const Exception& e)
-            {
-                std::cerr << e.message() << std::endl;
-            }
-        }
-    }
-    else
-    {
-        throw BingoException("bingoInsertRecordObj: Incorrect database");
+        throw BingoException("bingoInsertIteratorObj: Incorrect database");
     }
 
-    return 1;
+    InsertDispatcher dispatcher(**bingo_index_ptr, iter, self.arom_options);
+    dispatcher.insert(self.bingonosql_insert_thread_count);
+    return dispatcher.inserted;
 }
 
 static int _insertObjectWithExtFPToDatabase(int db, Indigo& self, IndigoObject& indigo_obj, int obj_id, IndigoObject& fp)
@@ -305,7 +288,7 @@ static int _insertObjectWithExtFPToDatabase(int db, Indigo& self, IndigoObject&
             return (*bingo_index_ptr)->prepareIndexDataWithExtFP(ind_mol, fp);
         }();
         {
-            auto bingo_index_ptr = sf::xlock_safe_ptr(bingo_indexes->at(db));
+            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
             return (*bingo_index_ptr)->add(obj_id, obj_data);
         }
     }
@@ -325,7 +308,7 @@ static int _insertObjectWithExtFPToDatabase(int db, Indigo& self, IndigoObject&
             return (*bingo_index_ptr)->prepareIndexDataWithExtFP(ind_rxn, fp);
         }();
         {
-            auto bingo_index_ptr = sf::xlock_safe_ptr(bingo_indexes->at(db));
+            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
             return (*bingo_index_ptr)->add(obj_id, obj_data);
         }
     }
@@ -335,6 +318,65 @@ static int _insertObjectWithExtFPToDatabase(int db, Indigo& self, IndigoObject&
     }
 }
 
+// Shard databases of the federated database, nothing for an ordinary one
+static std::vector<int> _getShards(int db)
+{
+    const auto federations = sf::slock_safe_ptr(_federations());
+    auto it = federations->find(db);
+    if (it == federations->end())
+        return std::vector<int>();
+    return it->second;
+}
+
+static std::unique_ptr<Matcher> _createFederatedMatcher(std::vector<FederatedMatcher::Shard>&& shards, int limit)
+{
+    if (shards[0].index->getType() == IndexType::REACTION)
+        return std::make_unique<ReactionFederatedMatcher>(std::move(shards), limit);
+    return std::make_unique<MoleculeFederatedMatcher>(std::move(shards), limit);
+}
+
+// Creates the search object on the database or, if the database is federated, a search on
+// every shard merged into one. limit > 0 is the number of the hits of a top-N search
+static int _createSearch(int db, int limit, const std::function<std::unique_ptr<Matcher>(int db_id, BaseIndex& bingo_index)>& create_matcher)
+{
+    std::vector<int> shard_ids = _getShards(db);
+
+    std::unique_ptr<Matcher> matcher;
+    if (shard_ids.empty())
+    {
+        const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+        const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
+        matcher = create_matcher(db, **bingo_index_ptr);
+    }
+    else
+    {
+        std::vector<FederatedMatcher::Shard> shards;
+        for (int shard_id : shard_ids)
+        {
+            MMFAllocator::setDatabaseId(shard_id);
+            const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(shard_id));
+            shards.push_back(FederatedMatcher::Shard{shard_id, bingo_index_ptr->get(), create_matcher(shard_id, **bingo_index_ptr)});
+        }
+        matcher = _createFederatedMatcher(std::move(shards), limit);
+    }
+
+    auto searches_data = sf::xlock_safe_ptr(_searches_data());
+    auto search_id = searches_data->searches.insert(std::move(matcher));
+    searches_data->db[search_id] = shard_ids.empty() ? db : shard_ids[0];
+    return search_id;
+}
+
+static void _closeDatabases(const std::vector<int>& dbs)
+{
+    auto bingo_indexes = sf::xlock_safe_ptr(_indexes());
+    for (int db : dbs)
+    {
+        MMFAllocator::setDatabaseId(db);
+        bingo_indexes->remove(db);
+    }
+}
+
 #define getMatcherConst(id)                                                                                                                                    \
     const auto searches_data = sf::slock_safe_ptr(_searches_data());                                                                                           \
     if (!searches_data->searches.has(id))                                                                                                                      \
@@ -376,6 +418,47 @@ CEXPORT int bingoLoadDatabaseFile(const char* location, const char* options)
     INDIGO_END(-1);
 }
 
+CEXPORT int bingoLoadFederatedDatabase(const char* locations, const char* options)
+{
+    INDIGO_BEGIN
+    {
+        std::vector<int> shard_ids;
+        try
+        {
+            std::string all_locations(locations);
+            size_t begin = 0;
+            while (begin <= all_locations.size())
+            {
+                size_t end = all_locations.find(';', begin);
+                if (end == std::string::npos)
+                    end = all_locations.size();
+                if (end > begin)
+                    shard_ids.push_back(_bingoCreateOrLoadDatabaseFile(all_locations.substr(begin, end - begin).c_str(), options, false));
+                begin = end + 1;
+            }
+
+            if (shard_ids.empty())
+                throw BingoException("bingoLoadFederatedDatabase: no database locations");
+
+            const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+            IndexType type = (*sf::slock_safe_ptr(bingo_indexes->at(shard_ids[0])))->getType();
+            for (int shard_id : shard_ids)
+                if ((*sf::slock_safe_ptr(bingo_indexes->at(shard_id)))->getType() != type)
+                    throw BingoException("bingoLoadFederatedDatabase: databases have different types");
+        }
+        catch (...)
+        {
+            _closeDatabases(shard_ids);
+            throw;
+        }
+
+        const auto db_id = sf::xlock_safe_ptr(_indexes())->getNextId();
+        sf::xlock_safe_ptr(_federations())->emplace(db_id, shard_ids);
+        return (int)db_id;
+    }
+    INDIGO_END(-1);
+}
+
 CEXPORT int bingoCloseDatabase(int db)
 {
 #ifdef INDIGO_DEBUG
@@ -383,6 +466,18 @@ CEXPORT int bingoCloseDatabase(int db)
     ss << "~Bingo(" << db << ")";
     std::cout << ss.str() << std::endl;
 #endif
+    std::vector<int> shard_ids = _getShards(db);
+    if (!shard_ids.empty())
+    {
+        INDIGO_BEGIN_STATIC
+        {
+            sf::xlock_safe_ptr(_federations())->erase(db);
+            _closeDatabases(shard_ids);
+            return 1;
+        }
+        INDIGO_END(-1);
+    }
+
     BINGO_BEGIN_DB_STATIC(db)
     {
 
@@ -423,20 +518,7 @@ CEXPORT int bingoInsertIteratorObj(int db, int iterator_obj_id)
     BINGO_BEGIN_DB(db)
     {
         IndigoObject& iterator_obj = self.getObject(iterator_obj_id);
-        long obj_id = -1;
-        //        auto& properties = iterator_obj.getProperties();
-        //
-        //        const char* key_name = [db]() {
-        //            const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-        //            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-        //            return (*bingo_index_ptr)->getIdPropertyName();
-        //        }();
-
-        //        if (key_name != nullptr && properties.contains(key_name))
-        //        {
-        //            obj_id = strtol(properties.at(key_name), NULL, 10);
-        //        }
-        return _insertIteratorToDatabase(db, self, iterator_obj, obj_id);
+        return _insertIteratorToDatabase(db, self, iterator_obj);
     }
     BINGO_END(-1);
 }
@@ -493,7 +575,7 @@ CEXPORT int bingoDeleteRecord(int db, int id)
     BINGO_BEGIN_DB(db)
     {
         const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-        auto bingo_index_ptr = sf::xlock_safe_ptr(bingo_indexes->at(db));
+        const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
         (*bingo_index_ptr)->remove(id);
         return id;
     }
@@ -563,16 +645,28 @@ CEXPORT int bingoOptimize(int db)
     BINGO_BEGIN_DB(db)
     {
         const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-        auto bingo_index_ptr = sf::xlock_safe_ptr(bingo_indexes->at(db));
+        const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
         (*bingo_index_ptr)->optimize();
         return 0;
     }
     BINGO_END(-1);
 }
 
-CEXPORT int bingoSearchSub(int db, int query_obj, const char* options)
+CEXPORT int bingoWarmup(int db)
 {
     BINGO_BEGIN_DB(db)
+    {
+        const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+        auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
+        (*bingo_index_ptr)->warmup();
+        return 0;
+    }
+    BINGO_END(-1);
+}
+
+CEXPORT int bingoSearchSub(int db, int query_obj, const char* options)
+{
+    BINGO_BEGIN_SEARCH_DB(db)
     {
         auto obj_ptr = std::unique_ptr<IndigoObject>(self.getObject(query_obj).clone());
         IndigoObject& obj = *obj_ptr;
@@ -581,41 +675,21 @@ CEXPORT int bingoSearchSub(int db, int query_obj, const char* options)
         {
             obj.getBaseMolecule().aromatize(self.arom_options);
 
-            std::unique_ptr<MoleculeSubstructureQueryData> query_data = std::make_unique<MoleculeSubstructureQueryData>(obj.getQueryMolecule());
-            query_data->db_id = db;
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return (*bingo_index_ptr)->createMatcher("sub", query_data.release(), options);
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<MoleculeSubstructureQueryData> query_data = std::make_unique<MoleculeSubstructureQueryData>(obj.getQueryMolecule());
+                query_data->db_id = db_id;
+                return bingo_index.createMatcher("sub", query_data.release(), options);
+            });
         }
         else if (IndigoQueryReaction::is(obj))
         {
             obj.getBaseReaction().aromatize(self.arom_options);
 
-            std::unique_ptr<ReactionSubstructureQueryData> query_data = std::make_unique<ReactionSubstructureQueryData>(obj.getQueryReaction());
-            query_data->db_id = db;
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return (*bingo_index_ptr)->createMatcher("sub", query_data.release(), options);
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<ReactionSubstructureQueryData> query_data = std::make_unique<ReactionSubstructureQueryData>(obj.getQueryReaction());
+                query_data->db_id = db_id;
+                return bingo_index.createMatcher("sub", query_data.release(), options);
+            });
         }
         else
             throw BingoException("bingoSearchSub: only query molecule and query reaction can be set as query object");
@@ -625,7 +699,7 @@ CEXPORT int bingoSearchSub(int db, int query_obj, const char* options)
 
 CEXPORT int bingoSearchExact(int db, int query_obj, const char* options)
 {
-    BINGO_BEGIN_DB(db)
+    BINGO_BEGIN_SEARCH_DB(db)
     {
         auto obj_ptr = std::unique_ptr<IndigoObject>(self.getObject(query_obj).clone());
         IndigoObject& obj = *obj_ptr;
@@ -634,37 +708,19 @@ CEXPORT int bingoSearchExact(int db, int query_obj, const char* options)
         {
             obj.getBaseMolecule().aromatize(self.arom_options);
 
-            std::unique_ptr<MoleculeExactQueryData> query_data = std::make_unique<MoleculeExactQueryData>(obj.getMolecule());
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return (*bingo_index_ptr)->createMatcher("exact", query_data.release(), options);
-            }();
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<MoleculeExactQueryData> query_data = std::make_unique<MoleculeExactQueryData>(obj.getMolecule());
+                return bingo_index.createMatcher("exact", query_data.release(), options);
+            });
         }
         else if (IndigoReaction::is(obj))
         {
             obj.getBaseReaction().aromatize(self.arom_options);
 
-            std::unique_ptr<ReactionExactQueryData> query_data = std::make_unique<ReactionExactQueryData>(obj.getReaction());
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return (*bingo_index_ptr)->createMatcher("exact", query_data.release(), options);
-            }();
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<ReactionExactQueryData> query_data = std::make_unique<ReactionExactQueryData>(obj.getReaction());
+                return bingo_index.createMatcher("exact", query_data.release(), options);
+            });
         }
         else
             throw BingoException("bingoSearchExact: only non-query molecules and reactions can be set as query object");
@@ -672,33 +728,58 @@ CEXPORT int bingoSearchExact(int db, int query_obj, const char* options)
     BINGO_END(-1);
 }
 
-CEXPORT int bingoSearchMolFormula(int db, const char* query, const char* options)
+CEXPORT int bingoSearchExactBatch(int db, int iterator_obj, const char* options)
 {
-    BINGO_BEGIN_DB(db)
+    BINGO_BEGIN_SEARCH_DB(db)
     {
-        Array<char> gross_str;
-        gross_str.copy(query, (int)(strlen(query) + 1));
+        if (!_getShards(db).empty())
+            throw BingoException("bingoSearchExactBatch: federated databases are not supported");
 
-        std::unique_ptr<GrossQueryData> query_data = std::make_unique<GrossQueryData>(gross_str);
+        IndigoObject& iter = self.getObject(iterator_obj);
 
-        auto matcher = [&]() {
+        BaseIndex* bingo_index;
+        {
             const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
             const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-            return (*bingo_index_ptr)->createMatcher("formula", query_data.release(), options);
-        }();
-        {
-            auto searches_data = sf::xlock_safe_ptr(_searches_data());
-            auto search_id = searches_data->searches.insert(std::move(matcher));
-            searches_data->db[search_id] = db;
-            return search_id;
+            bingo_index = bingo_index_ptr->get();
         }
+
+        // The join locks the storages itself, so the index list stays free while it runs
+        ExactJoinDispatcher dispatcher(*bingo_index, db, iter, options, self.arom_options);
+        dispatcher.join(self.bingonosql_insert_thread_count);
+
+        std::unique_ptr<Matcher> matcher;
+        if (bingo_index->getType() == IndexType::REACTION)
+            matcher = std::make_unique<ReactionExactJoinMatcher>(*bingo_index, std::move(dispatcher.matches));
+        else
+            matcher = std::make_unique<MoleculeExactJoinMatcher>(*bingo_index, std::move(dispatcher.matches));
+
+        auto searches_data = sf::xlock_safe_ptr(_searches_data());
+        auto search_id = searches_data->searches.insert(std::move(matcher));
+        searches_data->db[search_id] = db;
+        return search_id;
+    }
+    BINGO_END(-1);
+}
+
+CEXPORT int bingoSearchMolFormula(int db, const char* query, const char* options)
+{
+    BINGO_BEGIN_SEARCH_DB(db)
+    {
+        Array<char> gross_str;
+        gross_str.copy(query, (int)(strlen(query) + 1));
+
+        return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+            std::unique_ptr<GrossQueryData> query_data = std::make_unique<GrossQueryData>(gross_str);
+            return bingo_index.createMatcher("formula", query_data.release(), options);
+        });
     }
     BINGO_END(-1);
 }
 
 CEXPORT int bingoSearchSim(int db, int query_obj, float min, float max, const char* options)
 {
-    BINGO_BEGIN_DB(db)
+    BINGO_BEGIN_SEARCH_DB(db)
     {
         auto obj_ptr = std::unique_ptr<IndigoObject>(self.getObject(query_obj).clone());
         IndigoObject& obj = *obj_ptr;
@@ -707,39 +788,19 @@ CEXPORT int bingoSearchSim(int db, int query_obj, float min, float max, const ch
         {
             obj.getBaseMolecule().aromatize(self.arom_options);
 
-            std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, max);
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return ((*bingo_index_ptr)->createMatcher("sim", query_data.release(), options));
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, max);
+                return bingo_index.createMatcher("sim", query_data.release(), options);
+            });
         }
         else if (IndigoReaction::is(obj))
         {
             obj.getBaseReaction().aromatize(self.arom_options);
 
-            std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, max);
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return ((*bingo_index_ptr)->createMatcher("sim", query_data.release(), options));
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, max);
+                return bingo_index.createMatcher("sim", query_data.release(), options);
+            });
         }
         else
             throw BingoException("bingoSearchSim: only query molecule and query reaction can be set as query object");
@@ -749,7 +810,7 @@ CEXPORT int bingoSearchSim(int db, int query_obj, float min, float max, const ch
 
 CEXPORT int bingoSearchSimWithExtFP(int db, int query_obj, float min, float max, int fp, const char* options)
 {
-    BINGO_BEGIN_DB(db)
+    BINGO_BEGIN_SEARCH_DB(db)
     {
         auto obj_ptr = std::unique_ptr<IndigoObject>(self.getObject(query_obj).clone());
         IndigoObject& obj = *obj_ptr;
@@ -759,39 +820,19 @@ CEXPORT int bingoSearchSimWithExtFP(int db, int query_obj, float min, float max,
         {
             obj.getBaseMolecule().aromatize(self.arom_options);
 
-            std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, max);
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return ((*bingo_index_ptr)->createMatcherWithExtFP("sim", query_data.release(), options, ext_fp));
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, max);
+                return bingo_index.createMatcherWithExtFP("sim", query_data.release(), options, ext_fp);
+            });
         }
         else if (IndigoReaction::is(obj))
         {
             obj.getBaseReaction().aromatize(self.arom_options);
 
-            std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, max);
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return ((*bingo_index_ptr)->createMatcherWithExtFP("sim", query_data.release(), options, ext_fp));
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, max);
+                return bingo_index.createMatcherWithExtFP("sim", query_data.release(), options, ext_fp);
+            });
         }
         else
             throw BingoException("bingoSearchSim: only query molecule and query reaction can be set as query object");
@@ -801,7 +842,7 @@ CEXPORT int bingoSearchSimWithExtFP(int db, int query_obj, float min, float max,
 
 CEXPORT int bingoSearchSimTopN(int db, int query_obj, int limit, float min, const char* options)
 {
-    BINGO_BEGIN_DB(db)
+    BINGO_BEGIN_SEARCH_DB(db)
     {
         auto obj_ptr = std::unique_ptr<IndigoObject>(self.getObject(query_obj).clone());
         IndigoObject& obj = *obj_ptr;
@@ -810,39 +851,19 @@ CEXPORT int bingoSearchSimTopN(int db, int query_obj, int limit, float min, cons
         {
             obj.getBaseMolecule().aromatize(self.arom_options);
 
-            std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, 1.0);
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return ((*bingo_index_ptr)->createMatcherTopN("sim", query_data.release(), options, limit));
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, limit, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, 1.0);
+                return bingo_index.createMatcherTopN("sim", query_data.release(), options, limit);
+            });
         }
         else if (IndigoReaction::is(obj))
         {
             obj.getBaseReaction().aromatize(self.arom_options);
 
-            std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, 1.0);
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return ((*bingo_index_ptr)->createMatcherTopN("sim", query_data.release(), options, limit));
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, limit, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, 1.0);
+                return bingo_index.createMatcherTopN("sim", query_data.release(), options, limit);
+            });
         }
         else
             throw BingoException("bingoSearchSimTopN: only query molecule and query reaction can be set as query object");
@@ -852,7 +873,7 @@ CEXPORT int bingoSearchSimTopN(int db, int query_obj, int limit, float min, cons
 
 CEXPORT int bingoSearchSimTopNWithExtFP(int db, int query_obj, int limit, float min, int fp, const char* options)
 {
-    BINGO_BEGIN_DB(db)
+    BINGO_BEGIN_SEARCH_DB(db)
     {
         auto obj_ptr = std::unique_ptr<IndigoObject>(self.getObject(query_obj).clone());
         IndigoObject& obj = *obj_ptr;
@@ -862,39 +883,19 @@ CEXPORT int bingoSearchSimTopNWithExtFP(int db, int query_obj, int limit, float
         {
             obj.getBaseMolecule().aromatize(self.arom_options);
 
-            std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, 1.0);
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return ((*bingo_index_ptr)->createMatcherTopNWithExtFP("sim", query_data.release(), options, limit, ext_fp));
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, limit, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, 1.0);
+                return bingo_index.createMatcherTopNWithExtFP("sim", query_data.release(), options, limit, ext_fp);
+            });
         }
         else if (IndigoReaction::is(obj))
         {
             obj.getBaseReaction().aromatize(self.arom_options);
 
-            std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, 1.0);
-
-            auto matcher = [&]() {
-                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-                const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-                return ((*bingo_index_ptr)->createMatcherTopNWithExtFP("sim", query_data.release(), options, limit, ext_fp));
-            }();
-
-            {
-                auto searches_data = sf::xlock_safe_ptr(_searches_data());
-                auto search_id = searches_data->searches.insert(std::move(matcher));
-                searches_data->db[search_id] = db;
-                return search_id;
-            }
+            return _createSearch(db, limit, [&](int db_id, BaseIndex& bingo_index) {
+                std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, 1.0);
+                return bingo_index.createMatcherTopNWithExtFP("sim", query_data.release(), options, limit, ext_fp);
+            });
         }
         else
             throw BingoException("bingoSearchSimTopN: only query molecule and query reaction can be set as query object");
@@ -902,22 +903,140 @@ CEXPORT int bingoSearchSimTopNWithExtFP(int db, int query_obj, int limit, float
     BINGO_END(-1);
 }
 
-CEXPORT int bingoEnumerateId(int db)
+static std::unique_ptr<Matcher> _createSimBatchMatcher(BaseIndex& bingo_index, IndigoObject& query, int limit, float min, float max, const char* options)
 {
-    BINGO_BEGIN_DB(db)
+    Indigo& self = indigoGetInstance();
+
+    if (query.type == IndigoObject::FINGERPRINT)
+    {
+        std::unique_ptr<SimilarityQueryData> query_data;
+        if (bingo_index.getType() == IndexType::REACTION)
+        {
+            Reaction empty;
+            query_data = std::make_unique<ReactionSimilarityQueryData>(empty, min, max);
+        }
+        else
+        {
+            Molecule empty;
+            query_data = std::make_unique<MoleculeSimilarityQueryData>(empty, min, max);
+        }
+        return bingo_index.createMatcherTopNWithExtFP("sim", query_data.release(), options, limit, query);
+    }
+
+    auto obj_ptr = std::unique_ptr<IndigoObject>(query.clone());
+    IndigoObject& obj = *obj_ptr;
+
+    if (IndigoMolecule::is(obj))
+    {
+        obj.getBaseMolecule().aromatize(self.arom_options);
+        std::unique_ptr<MoleculeSimilarityQueryData> query_data = std::make_unique<MoleculeSimilarityQueryData>(obj.getMolecule(), min, max);
+        return bingo_index.createMatcherTopN("sim", query_data.release(), options, limit);
+    }
+    else if (IndigoReaction::is(obj))
     {
-        auto matcher = [&]() {
+        obj.getBaseReaction().aromatize(self.arom_options);
+        std::unique_ptr<ReactionSimilarityQueryData> query_data = std::make_unique<ReactionSimilarityQueryData>(obj.getReaction(), min, max);
+        return bingo_index.createMatcherTopN("sim", query_data.release(), options, limit);
+    }
+    else
+        throw BingoException("bingoSearchSimBatch: only molecules, reactions and fingerprints can be set as queries");
+}
+
+CEXPORT int bingoSearchSimBatch(int db, int queries, int limit, float min, float max, const char* options, int* search_objs)
+{
+    BINGO_BEGIN_SEARCH_DB(db)
+    {
+        IndigoArray& query_array = IndigoArray::cast(self.getObject(queries));
+
+        std::vector<int> shard_ids = _getShards(db);
+        bool federated = !shard_ids.empty();
+        if (!federated)
+            shard_ids.push_back(db);
+
+        // Matchers of all the queries on every shard
+        std::vector<BaseIndex*> shard_indexes;
+        std::vector<std::vector<std::unique_ptr<Matcher>>> shard_matchers(shard_ids.size());
+        for (size_t k = 0; k < shard_ids.size(); k++)
+        {
+            MMFAllocator::setDatabaseId(shard_ids[k]);
             const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
-            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
-            return ((*bingo_index_ptr)->createMatcher("enum", nullptr, nullptr));
-        }();
+            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(shard_ids[k]));
+            shard_indexes.push_back(bingo_index_ptr->get());
+
+            for (int i = 0; i < query_array.objects.size(); i++)
+                shard_matchers[k].push_back(_createSimBatchMatcher(**bingo_index_ptr, query_array.objects[i], limit, min, max, options));
+        }
+
+        // Every shard is searched in one pass, the shards of a federated database at once
+        auto find_batch = [&](size_t k) {
+            MMFAllocator::setDatabaseId(shard_ids[k]);
+            std::vector<TopNSimMatcher*> topn_matchers;
+            for (auto& matcher : shard_matchers[k])
+                topn_matchers.push_back(dynamic_cast<TopNSimMatcher*>(matcher.get()));
+
+            const auto storage_lock = shard_indexes[k]->lockStorages();
+            TopNSimMatcher::findBatch(topn_matchers);
+        };
+
+        if (!federated)
+            find_batch(0);
+        else
+        {
+            std::vector<std::thread> workers;
+            std::vector<std::exception_ptr> errors(shard_ids.size());
+            for (size_t k = 0; k < shard_ids.size(); k++)
+                workers.emplace_back([&, k]() {
+                    try
+                    {
+                        find_batch(k);
+                    }
+                    catch (...)
+                    {
+                        errors[k] = std::current_exception();
+                    }
+                });
+            for (auto& worker : workers)
+                worker.join();
+            for (auto& error : errors)
+                if (error)
+                    std::rethrow_exception(error);
+        }
+
+        std::vector<std::unique_ptr<Matcher>> matchers;
+        for (int i = 0; i < query_array.objects.size(); i++)
+        {
+            if (!federated)
+            {
+                matchers.push_back(std::move(shard_matchers[0][i]));
+                continue;
+            }
+
+            std::vector<FederatedMatcher::Shard> shards;
+            for (size_t k = 0; k < shard_ids.size(); k++)
+                shards.push_back(FederatedMatcher::Shard{shard_ids[k], shard_indexes[k], std::move(shard_matchers[k][i])});
+            matchers.push_back(_createFederatedMatcher(std::move(shards), limit));
+        }
 
         {
             auto searches_data = sf::xlock_safe_ptr(_searches_data());
-            auto search_id = searches_data->searches.insert(std::move(matcher));
-            searches_data->db[search_id] = db;
-            return search_id;
+            for (int i = 0; i < (int)matchers.size(); i++)
+            {
+                auto search_id = searches_data->searches.insert(std::move(matchers[i]));
+                searches_data->db[search_id] = shard_ids[0];
+                search_objs[i] = (int)search_id;
+            }
         }
+
+        return (int)matchers.size();
+    }
+    BINGO_END(-1);
+}
+
+CEXPORT int bingoEnumerateId(int db)
+{
+    BINGO_BEGIN_SEARCH_DB(db)
+    {
+        return _createSearch(db, 0, [&](int db_id, BaseIndex& bingo_index) { return bingo_index.createMatcher("enum", nullptr, nullptr); });
     }
     BINGO_END(-1);
 }
@@ -943,6 +1062,7 @@ CEXPORT int bingoNext(int search_obj)
     BINGO_BEGIN_SEARCH(search_obj)
     {
         getMatcher(search_obj);
+        const auto storage_lock = matcher.lockStorages();
         return matcher.next();
     }
     BINGO_END(-1);
@@ -953,11 +1073,25 @@ CEXPORT int bingoGetCurrentId(int search_obj)
     BINGO_BEGIN_SEARCH(search_obj)
     {
         getMatcherConst(search_obj);
+        const auto storage_lock = matcher.lockStorages();
         return matcher.currentId();
     }
     BINGO_END(-1);
 }
 
+CEXPORT int bingoGetCurrentQueryIndex(int search_obj)
+{
+    BINGO_BEGIN_SEARCH(search_obj)
+    {
+        getMatcherConst(search_obj);
+        const ExactJoinMatcher* join_matcher = dynamic_cast<const ExactJoinMatcher*>(&matcher);
+        if (join_matcher == nullptr)
+            throw BingoException("bingoGetCurrentQueryIndex: Only batch exact search objects have query indices");
+        return join_matcher->currentQueryIndex();
+    }
+    BINGO_END(-1);
+}
+
 CEXPORT float bingoGetCurrentSimilarityValue(int search_obj)
 {
     BINGO_BEGIN_SEARCH(search_obj)
@@ -1058,7 +1192,7 @@ CEXPORT int bingoGetObject(int search_obj)
     BINGO_BEGIN_SEARCH(search_obj)
     {
         getMatcher(search_obj);
-        const auto& bingo_index = matcher.getIndex();
+        const auto storage_lock = matcher.lockStorages();
         return self.addObject(matcher.currentObject());
     }
     BINGO_END(-1);
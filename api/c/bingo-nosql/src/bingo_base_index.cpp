@@ -35,9 +35,16 @@ static const char* _max_mmf_size_prop = "max_mmf_size";
 static const char* _min_mmf_size_prop = "min_mmf_size";
 static const char* _mt_size_prop = "mt_size";
 static const char* _id_key_prop = "key";
+static const char* _mmf_populate_prop = "mmf_populate";
+static const char* _mmf_huge_pages_prop = "mmf_huge_pages";
+static const char* _mmf_advise_prop = "mmf_advise";
+static const char* _decoded_cache_size_prop = "decoded_cache_size";
+static const char* _sim_in_memory_prop = "sim_in_memory";
+static const char* _sub_increment_buffers_prop = "sub_increment_buffers";
 static const size_t _min_mmf_size = 33554432;  // 32Mb
 static const size_t _max_mmf_size = 536870912; // 512Mb
 static const int _small_base_size = 10000;
+static const size_t _max_prop_len = 1024;
 static const int _sim_mt_size = 50000;
 
 namespace
@@ -109,10 +116,12 @@ void BaseIndex::create(const char* location, const MoleculeFingerprintParameters
     size_t min_mmf_size = _getMinMMfSize(option_map);
     size_t max_mmf_size = _getMaxMMfSize(option_map);
 
+    MMFileOptions mmf_options = _getMMFileOptions(option_map);
+
     if (_type == IndexType::MOLECULE)
-        MMFAllocator::create(_mmf_path.c_str(), min_mmf_size, max_mmf_size, _molecule_type, index_id);
+        MMFAllocator::create(_mmf_path.c_str(), min_mmf_size, max_mmf_size, _molecule_type, index_id, mmf_options);
     else if (_type == IndexType::REACTION)
-        MMFAllocator::create(_mmf_path.c_str(), min_mmf_size, max_mmf_size, _reaction_type, index_id);
+        MMFAllocator::create(_mmf_path.c_str(), min_mmf_size, max_mmf_size, _reaction_type, index_id, mmf_options);
     else
         throw Exception("incorrect index type");
 
@@ -137,6 +146,13 @@ void BaseIndex::create(const char* location, const MoleculeFingerprintParameters
 
     _header->first_free_id = 0;
     _header->object_count = 0;
+
+    _createDecodedCache(option_map);
+
+    _sim_in_memory = _getBoolOption(option_map, _sim_in_memory_prop);
+    _buildSimMemoryTable();
+
+    _publishSnapshot();
 }
 
 void BaseIndex::load(const char* location, const char* options, int index_id)
@@ -166,7 +182,7 @@ void BaseIndex::load(const char* location, const char* options, int index_id)
 
     _read_only = _getAccessType(option_map);
 
-    MMFAllocator::load(_mmf_path.c_str(), index_id, _read_only);
+    MMFAllocator::load(_mmf_path.c_str(), index_id, _read_only, _getMMFileOptions(option_map));
 
     _header = MMFPtr<_Header>(MMFAddress(0, MMFAllocator::MAX_HEADER_LEN + MMFAllocator::getAllocatorDataSize()));
 
@@ -279,6 +295,46 @@ void BaseIndex::load(const char* location, const char* options, int index_id)
         GrossStorageShort::load(_gross_storage_short, _header.ptr()->gross_offset);
     else
         GrossStorage::load(_gross_storage, _header.ptr()->gross_offset);
+
+    if (_getBoolOption(option_map, _mmf_advise_prop))
+        _adviseStorages();
+
+    _createDecodedCache(option_map);
+
+    _sim_in_memory = _getBoolOption(option_map, _sim_in_memory_prop);
+    _buildSimMemoryTable();
+
+    if (!_read_only)
+        _loadIncrementBuffers();
+
+    _publishSnapshot();
+}
+
+void BaseIndex::warmup()
+{
+    profTimerStart(t, "bingo_warmup");
+    MMFRanges ranges;
+    _sub_fp_storage->collectRanges(ranges);
+    _sim_fp_storage->collectRanges(ranges);
+    ranges.prefetch();
+}
+
+void BaseIndex::_adviseStorages()
+{
+    // Fingerprints are scanned by every search, so they are read ahead.
+    // Records are fetched one by one for the candidates only, read ahead of
+    // them would just push the fingerprints out of the page cache
+    MMFRanges fp_ranges;
+    _sub_fp_storage->collectRanges(fp_ranges);
+    _sim_fp_storage->collectRanges(fp_ranges);
+    fp_ranges.advise(MMFAdvice::WILL_NEED);
+
+    MMFRanges cf_ranges;
+    if (_use_short)
+        _cf_storage_short->collectRanges(cf_ranges);
+    else
+        _cf_storage->collectRanges(cf_ranges);
+    cf_ranges.advise(MMFAdvice::RANDOM);
 }
 
 int BaseIndex::add(int obj_id, const ObjectIndexData& _obj_data)
@@ -286,6 +342,8 @@ int BaseIndex::add(int obj_id, const ObjectIndexData& _obj_data)
     if (_read_only)
         throw Exception("insert fail: Read only index can't be changed");
 
+    std::lock_guard<std::mutex> writer(_write_lock);
+
     MMFMapping& back_id_mapping = _back_id_mapping_ptr.ref();
 
     if (obj_id != -1 && back_id_mapping.get(obj_id) != (size_t)-1)
@@ -294,9 +352,130 @@ int BaseIndex::add(int obj_id, const ObjectIndexData& _obj_data)
     profTimerStart(t_after, "exclusive_write");
     {
         profTimerStart(t_in, "add_obj_data");
-        _insertIndexData(_obj_data);
+        _sub_fp_storage.ptr()->add(_obj_data.sub_fp.ptr(), &_sub_increment_pool);
+        _saveIncrementBuffers();
+
+        std::unique_lock<std::shared_mutex> storages(_storage_lock);
+        _sim_fp_storage.ptr()->add(_obj_data.sim_fp.ptr(), _header->object_count);
+        std::atomic_store(&_sim_memory_table, std::shared_ptr<const SimMemoryTable>());
+        _insertObjectData(_obj_data, _header->object_count);
+        obj_id = _assignId(obj_id);
     }
 
+    _publishSnapshot();
+    return obj_id;
+}
+
+void BaseIndex::addBatch(const std::vector<const ObjectIndexData*>& batch, Array<int>& ids)
+{
+    if (_read_only)
+        throw Exception("insert fail: Read only index can't be changed");
+
+    std::lock_guard<std::mutex> writer(_write_lock);
+
+    profTimerStart(t_after, "exclusive_write");
+    const int count = (int)batch.size();
+    const int first_base_id = _header->object_count;
+    {
+        profTimerStart(t_in, "add_obj_data");
+        Array<byte> sub_fps, sim_fps;
+        Array<int> base_ids;
+        for (int i = 0; i < count; i++)
+        {
+            sub_fps.concat(batch[i]->sub_fp);
+            sim_fps.concat(batch[i]->sim_fp);
+            base_ids.push(first_base_id + i);
+        }
+        _sub_fp_storage.ptr()->addBatch(sub_fps.ptr(), count, &_sub_increment_pool);
+        _saveIncrementBuffers();
+
+        std::unique_lock<std::shared_mutex> storages(_storage_lock);
+        _sim_fp_storage.ptr()->addBatch(sim_fps.ptr(), base_ids.ptr(), count);
+        std::atomic_store(&_sim_memory_table, std::shared_ptr<const SimMemoryTable>());
+
+        for (int i = 0; i < count; i++)
+            _insertObjectData(*batch[i], first_base_id + i);
+
+        ids.clear();
+        for (int i = 0; i < count; i++)
+            ids.push(_assignId(-1));
+    }
+
+    _publishSnapshot();
+}
+
+std::shared_ptr<const IndexSnapshot> BaseIndex::getSnapshot() const
+{
+    return std::atomic_load(&_snapshot);
+}
+
+std::shared_lock<std::shared_mutex> BaseIndex::lockStorages()
+{
+    return std::shared_lock<std::shared_mutex>(_storage_lock);
+}
+
+std::shared_lock<std::shared_mutex> BaseIndex::tryLockStorages()
+{
+    return std::shared_lock<std::shared_mutex>(_storage_lock, std::try_to_lock);
+}
+
+void BaseIndex::_publishSnapshot()
+{
+    TranspFpStorage& sub_storage = _sub_fp_storage.ref();
+
+    auto snapshot = std::make_shared<IndexSnapshot>();
+    snapshot->object_count = _header->object_count;
+    snapshot->pack_count = sub_storage.getPackCount();
+    snapshot->sub_increment = sub_storage.getIncrement();
+    snapshot->sub_increment_size = sub_storage.getIncrementSize();
+    snapshot->sub_increment_pin = _sub_increment_pool.pin(sub_storage.getIncrementAddress());
+
+    std::atomic_store(&_snapshot, std::shared_ptr<const IndexSnapshot>(std::move(snapshot)));
+}
+
+void BaseIndex::_saveIncrementBuffers()
+{
+    const std::vector<MMFAddress>& buffers = _sub_increment_pool.buffers();
+    if (buffers.size() == _saved_increment_buffers)
+        return;
+
+    // Buffers that do not fit into the property stay allocated and unused
+    std::string value;
+    for (const MMFAddress& buffer : buffers)
+    {
+        std::string item = std::to_string(buffer.file_id) + ":" + std::to_string(buffer.offset) + ";";
+        if (value.size() + item.size() >= _max_prop_len)
+            break;
+        value += item;
+    }
+    _properties->add(_sub_increment_buffers_prop, value.c_str());
+    _saved_increment_buffers = buffers.size();
+}
+
+void BaseIndex::_loadIncrementBuffers()
+{
+    const char* value = _properties->getNoThrow(_sub_increment_buffers_prop);
+    if (value == nullptr)
+        return;
+
+    std::vector<MMFAddress> buffers;
+    std::istringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ';'))
+    {
+        size_t sep = item.find(':');
+        if (sep == std::string::npos)
+            throw Exception("BaseIndex: incorrect increment buffers property");
+        buffers.emplace_back(std::stoi(item.substr(0, sep)), (ptrdiff_t)std::stoll(item.substr(sep + 1)));
+    }
+    _sub_increment_pool.restore(buffers, _sub_fp_storage->getIncrementAddress());
+    _saved_increment_buffers = buffers.size();
+}
+
+int BaseIndex::_assignId(int obj_id)
+{
+    MMFMapping& back_id_mapping = _back_id_mapping_ptr.ref();
+
     {
         profTimerStart(t_in, "mapping_changing_1");
         if (obj_id == -1)
@@ -326,7 +505,19 @@ void BaseIndex::optimize()
     if (_read_only)
         throw Exception("optimize fail: Read only index can't be changed");
 
+    std::lock_guard<std::mutex> writer(_write_lock);
+    std::unique_lock<std::shared_mutex> storages(_storage_lock);
     _sim_fp_storage.ptr()->optimize();
+    _buildSimMemoryTable();
+}
+
+void BaseIndex::_buildSimMemoryTable()
+{
+    if (!_sim_in_memory || _sim_fp_storage->isSmallBase())
+        return;
+
+    auto table = std::make_shared<SimMemoryTable>(_sim_fp_storage.ref(), _fp_params.fingerprintSizeSim());
+    std::atomic_store(&_sim_memory_table, std::shared_ptr<const SimMemoryTable>(std::move(table)));
 }
 
 void BaseIndex::remove(int obj_id)
@@ -334,6 +525,9 @@ void BaseIndex::remove(int obj_id)
     if (_read_only)
         throw Exception("remove fail: Read only index can't be changed");
 
+    std::lock_guard<std::mutex> writer(_write_lock);
+    std::unique_lock<std::shared_mutex> storages(_storage_lock);
+
     MMFMapping& back_id_mapping = _back_id_mapping_ptr.ref();
 
     if (obj_id < 0 || back_id_mapping.get(obj_id) == (size_t)-1)
@@ -343,6 +537,8 @@ void BaseIndex::remove(int obj_id)
         _cf_storage_short->remove(back_id_mapping.get(obj_id));
     else
         _cf_storage->remove(back_id_mapping.get(obj_id));
+    if (_decoded_cache)
+        _decoded_cache->remove((int)back_id_mapping.get(obj_id));
     _mappingRemove(obj_id);
 }
 
@@ -402,6 +598,12 @@ int BaseIndex::getObjectsCount() const
 }
 
 const byte* BaseIndex::getObjectCf(int id, int& len)
+{
+    std::shared_lock<std::shared_mutex> storages(_storage_lock);
+    return getObjectCfUnlocked(id, len);
+}
+
+const byte* BaseIndex::getObjectCfUnlocked(int id, int& len)
 {
     const byte* cf_buf =
         _use_short ? _cf_storage_short->get(_back_id_mapping_ptr.ref().get(id), len) : _cf_storage->get(_back_id_mapping_ptr.ref().get(id), len);
@@ -412,6 +614,16 @@ const byte* BaseIndex::getObjectCf(int id, int& len)
     return cf_buf;
 }
 
+DecodedCache* BaseIndex::getDecodedCache()
+{
+    return _decoded_cache.get();
+}
+
+std::shared_ptr<const SimMemoryTable> BaseIndex::getSimMemoryTable() const
+{
+    return std::atomic_load(&_sim_memory_table);
+}
+
 const char* BaseIndex::getIdPropertyName() const
 {
     return _properties.ref().getNoThrow(_id_key_prop);
@@ -463,14 +675,41 @@ void BaseIndex::_checkOptions(std::map<std::string, std::string>& option_map, bo
         if (is_create)
         {
             if ((it->first.compare(_read_only_prop) != 0) && (it->first.compare(_mt_size_prop) != 0) && (it->first.compare(_min_mmf_size_prop) != 0) &&
-                (it->first.compare(_max_mmf_size_prop) != 0) && (it->first.compare(_id_key_prop) != 0))
+                (it->first.compare(_max_mmf_size_prop) != 0) && (it->first.compare(_id_key_prop) != 0) && !_isMMFileOption(it->first) &&
+                (it->first.compare(_decoded_cache_size_prop) != 0) && (it->first.compare(_sim_in_memory_prop) != 0))
                 throw Exception("Creating index error: incorrect input options");
         }
-        else if ((it->first.compare(_read_only_prop)) != 0 && (it->first.compare(_id_key_prop) != 0))
+        else if ((it->first.compare(_read_only_prop)) != 0 && (it->first.compare(_id_key_prop) != 0) && !_isMMFileOption(it->first) &&
+                 (it->first.compare(_mmf_advise_prop) != 0) && (it->first.compare(_decoded_cache_size_prop) != 0) &&
+                 (it->first.compare(_sim_in_memory_prop) != 0))
             throw Exception("Loading index error: incorrect input options");
     }
 }
 
+bool BaseIndex::_isMMFileOption(const std::string& name)
+{
+    return (name.compare(_mmf_populate_prop) == 0) || (name.compare(_mmf_huge_pages_prop) == 0);
+}
+
+bool BaseIndex::_getBoolOption(std::map<std::string, std::string>& option_map, const char* name)
+{
+    if (option_map.find(name) != option_map.end())
+    {
+        if (option_map[name].compare("true") == 0)
+            return true;
+    }
+
+    return false;
+}
+
+MMFileOptions BaseIndex::_getMMFileOptions(std::map<std::string, std::string>& option_map)
+{
+    MMFileOptions options;
+    options.populate = _getBoolOption(option_map, _mmf_populate_prop);
+    options.huge_pages = _getBoolOption(option_map, _mmf_huge_pages_prop);
+    return options;
+}
+
 size_t BaseIndex::_getMinMMfSize(std::map<std::string, std::string>& option_map)
 {
     size_t mmf_size = _min_mmf_size;
@@ -511,6 +750,20 @@ size_t BaseIndex::_getMaxMMfSize(std::map<std::string, std::string>& option_map)
     return mmf_size;
 }
 
+void BaseIndex::_createDecodedCache(std::map<std::string, std::string>& option_map)
+{
+    // Only molecules are cached: reaction searches are rare enough not to need it
+    if (_type != IndexType::MOLECULE || option_map.find(_decoded_cache_size_prop) == option_map.end())
+        return;
+
+    unsigned long u_dec = 0;
+    std::istringstream isstr(option_map[_decoded_cache_size_prop]);
+    isstr >> u_dec;
+
+    if (u_dec != 0 && u_dec != ULONG_MAX)
+        _decoded_cache = std::make_unique<DecodedCache>((size_t)u_dec * 1048576);
+}
+
 bool BaseIndex::_getAccessType(std::map<std::string, std::string>& option_map)
 {
     if (option_map.find(_read_only_prop) != option_map.end())
@@ -598,19 +851,17 @@ ObjectIndexData BaseIndex::prepareIndexDataWithExtFP(IndexObject& obj, IndigoObj
     return obj_data;
 }
 
-void BaseIndex::_insertIndexData(const ObjectIndexData& obj_data)
+void BaseIndex::_insertObjectData(const ObjectIndexData& obj_data, int base_id)
 {
-    _sub_fp_storage.ptr()->add(obj_data.sub_fp.ptr());
-    _sim_fp_storage.ptr()->add(obj_data.sim_fp.ptr(), _header->object_count);
     if (_use_short)
-        _cf_storage_short.ptr()->add((byte*)obj_data.cf_str.ptr(), obj_data.cf_str.size(), _header->object_count);
+        _cf_storage_short.ptr()->add((byte*)obj_data.cf_str.ptr(), obj_data.cf_str.size(), base_id);
     else
-        _cf_storage.ptr()->add((byte*)obj_data.cf_str.ptr(), obj_data.cf_str.size(), _header->object_count);
-    _exact_storage.ptr()->add(obj_data.hash, _header->object_count);
+        _cf_storage.ptr()->add((byte*)obj_data.cf_str.ptr(), obj_data.cf_str.size(), base_id);
+    _exact_storage.ptr()->add(obj_data.hash, base_id);
     if (_use_short)
-        _gross_storage_short.ptr()->add(obj_data.gross_str, _header->object_count);
+        _gross_storage_short.ptr()->add(obj_data.gross_str, base_id);
     else
-        _gross_storage.ptr()->add(obj_data.gross_str, _header->object_count);
+        _gross_storage.ptr()->add(obj_data.gross_str, base_id);
 }
 
 void BaseIndex::_mappingLoad()
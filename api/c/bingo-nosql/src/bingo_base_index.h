@@ -1,11 +1,18 @@
 #ifndef __bingo_base_index__
 #define __bingo_base_index__
 
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
 #include "molecule/molecule_fingerprint.h"
 
 #include "indigo_internal.h"
 
 #include "bingo_cf_storage.h"
+#include "bingo_decoded_cache.h"
+#include "bingo_sim_memory_table.h"
 #include "bingo_exact_storage.h"
 #include "bingo_fp_storage.h"
 #include "bingo_gross_storage.h"
@@ -38,6 +45,20 @@ namespace bingo
         dword hash;
     };
 
+    // Bounds of the data written before the snapshot was taken. Storages only
+    // grow, so a search that reads within the bounds needs no lock while the
+    // writer appends records
+    struct IndexSnapshot
+    {
+        int object_count = 0;
+        int pack_count = 0;
+        const byte* sub_increment = nullptr;
+        int sub_increment_size = 0;
+
+        // Keeps the increment from being refilled after it is moved to a pack
+        std::shared_ptr<const void> sub_increment_pin;
+    };
+
     class BaseIndex
     {
     private:
@@ -70,8 +91,27 @@ namespace bingo
 
         int add(int obj_id, const ObjectIndexData&);
 
+        // Appends records with automatic ids, which are returned in ids.
+        // Fingerprints of the whole batch are written to the storages at once
+        void addBatch(const std::vector<const ObjectIndexData*>& batch, Array<int>& ids);
+
         void optimize();
 
+        std::shared_ptr<const IndexSnapshot> getSnapshot() const;
+
+        // Holds off inserts into the storages that an insert reorganizes:
+        // similarity, exact and formula storages and the id mapping.
+        // Substructure searches read a snapshot instead
+        std::shared_lock<std::shared_mutex> lockStorages();
+
+        // Same lock if it can be taken without waiting. Worker threads of a search use it:
+        // a writer may be queued behind the caller of the search, which waits for them
+        std::shared_lock<std::shared_mutex> tryLockStorages();
+
+        // Reads the fingerprint storages into memory, so the first searches
+        // after loading do not wait for the page faults
+        void warmup();
+
         void remove(int id);
 
         const MoleculeFingerprintParameters& getFingerprintParams() const;
@@ -98,6 +138,17 @@ namespace bingo
 
         const byte* getObjectCf(int id, int& len);
 
+        // getObjectCf() for the callers that already hold lockStorages()
+        const byte* getObjectCfUnlocked(int id, int& len);
+
+        // nullptr unless the index was opened with a decoded_cache_size option
+        DecodedCache* getDecodedCache();
+
+        // In-memory copy of the similarity fingerprint table if the index was opened
+        // with the sim_in_memory option. Inserts drop it and optimize() builds it again;
+        // a small base has no table and no copy. Must be taken under lockStorages()
+        std::shared_ptr<const SimMemoryTable> getSimMemoryTable() const;
+
         const char* getIdPropertyName() const;
 
         const char* getVersion();
@@ -146,6 +197,32 @@ namespace bingo
         bool _use_short = false;
         bool _is_old_db = false;
 
+        // There is a single writer at a time. It appends to the substructure
+        // storage without blocking readers and publishes a new snapshot after
+        // every write
+        std::mutex _write_lock;
+        std::shared_mutex _storage_lock;
+        IncrementBufferPool _sub_increment_pool;
+        size_t _saved_increment_buffers = 0;
+        std::shared_ptr<const IndexSnapshot> _snapshot;
+
+        std::unique_ptr<DecodedCache> _decoded_cache;
+
+        bool _sim_in_memory = false;
+        std::shared_ptr<const SimMemoryTable> _sim_memory_table;
+
+        void _publishSnapshot();
+
+        // The buffers of the increment pool are kept in the properties, so the
+        // ones retired before the database was closed are reused after loading
+        void _saveIncrementBuffers();
+
+        void _loadIncrementBuffers();
+
+        void _buildSimMemoryTable();
+
+        void _createDecodedCache(std::map<std::string, std::string>& option_map);
+
         static void _checkOptions(std::map<std::string, std::string>& option_map, bool is_create);
 
         static size_t _getMinMMfSize(std::map<std::string, std::string>& option_map);
@@ -154,10 +231,20 @@ namespace bingo
 
         static bool _getAccessType(std::map<std::string, std::string>& option_map);
 
+        static bool _isMMFileOption(const std::string& name);
+
+        static bool _getBoolOption(std::map<std::string, std::string>& option_map, const char* name);
+
+        static MMFileOptions _getMMFileOptions(std::map<std::string, std::string>& option_map);
+
+        void _adviseStorages();
+
         void _saveProperties(const MoleculeFingerprintParameters& fp_params, int sub_block_size, int sim_block_size, int cf_block_size,
                              std::map<std::string, std::string>& option_map);
 
-        void _insertIndexData(const ObjectIndexData& obj_data);
+        void _insertObjectData(const ObjectIndexData& obj_data, int base_id);
+
+        int _assignId(int obj_id);
 
         void _mappingCreate();
 
@@ -79,6 +79,12 @@ void ByteBufferStorage::remove(int idx)
     _addresses[idx].len = DELETED_RECORD;
 }
 
+void ByteBufferStorage::collectRanges(MMFRanges& ranges)
+{
+    for (int i = 0; i < _blocks.size(); i++)
+        ranges.add(_blocks[i].getAddress(), _block_size);
+}
+
 ByteBufferStorage::~ByteBufferStorage()
 {
 }
@@ -158,6 +164,12 @@ void ByteBufferStorageShort::remove(int idx)
     _addresses[idx].len = DELETED_RECORD;
 }
 
+void ByteBufferStorageShort::collectRanges(MMFRanges& ranges)
+{
+    for (int i = 0; i < _blocks.size(); i++)
+        ranges.add(_blocks[i].getAddress(), _block_size);
+}
+
 ByteBufferStorageShort::~ByteBufferStorageShort()
 {
 }
@@ -27,6 +27,7 @@ namespace bingo
         bool is_record_ok(int idx);
         void add(const byte* data, int len, int idx);
         void remove(int idx);
+        void collectRanges(MMFRanges& ranges);
         ~ByteBufferStorage();
 
     private:
@@ -58,6 +59,7 @@ namespace bingo
         bool is_record_ok(int idx);
         void add(const byte* data, int len, int idx);
         void remove(int idx);
+        void collectRanges(MMFRanges& ranges);
         ~ByteBufferStorageShort();
 
     private:
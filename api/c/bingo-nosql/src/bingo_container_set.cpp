@@ -21,6 +21,22 @@ void ContainerSet::setParams(int fp_size, int container_size, int min_ones_count
     _indices.allocate(_container_size);
 }
 
+void ContainerSet::collectRanges(MMFRanges& ranges)
+{
+    for (int i = 0; i < _set.size(); i++)
+        _set[i].collectRanges(ranges);
+    ranges.add(_increment.getAddress(), (size_t)_inc_count * _fp_size);
+    ranges.add(_indices.getAddress(), _inc_count * sizeof(int));
+}
+
+void ContainerSet::collectFingerprints(indigo::Array<byte>& fingerprints, indigo::Array<int>& ids)
+{
+    for (int i = 0; i < _set.size(); i++)
+        _set[i].collectFingerprints(fingerprints, ids);
+    fingerprints.concat(_increment.ptr(), _inc_count * _fp_size);
+    ids.concat(_indices.ptr(), _inc_count);
+}
+
 int ContainerSet::getContCount() const
 {
     return _set.size() + 1;
@@ -55,6 +71,11 @@ bool ContainerSet::add(const byte* fingerprint, int id, int fp_ones_count)
     return false;
 }
 
+bool ContainerSet::isIncrementFull() const
+{
+    return _inc_count == _container_size;
+}
+
 void ContainerSet::buildContainer()
 {
     profIncCounter("trees_count", 1);
@@ -177,6 +198,19 @@ int ContainerSet::getSimilar(const byte* query, SimCoef& sim_coef, double min_co
     return sim_fp_indices.size();
 }
 
+void ContainerSet::getSimilarBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef, int cont_idx)
+{
+    profTimerStart(cs_s, "getSimilarBatch");
+
+    if (cont_idx >= getContCount())
+        throw indigo::Exception("ContainerSet: Incorrect container index");
+
+    if (cont_idx == _set.size())
+        _findSimilarIncBatch(batch, active, sim_coef);
+    else
+        _set[cont_idx].findSimilarBatch(batch, active, sim_coef);
+}
+
 int ContainerSet::_findSimilarInc(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_indices)
 {
     byte* inc = _increment.ptr();
@@ -186,17 +220,60 @@ int ContainerSet::_findSimilarInc(const byte* query, SimCoef& sim_coef, double m
 
     int query_bit_number = bitGetOnesCount(query, _fp_size);
 
-    for (int i = 0; i < _inc_count; i++)
+    // The increment is contiguous, so the coefficients are computed by the batched popcount kernels.
+    // The query takes the target role of calcCoef here as in the multibit trees, so the asymmetric
+    // coefficients (Tversky, Euclid) weigh the query bits
+    int fp_bit_numbers[COEF_BATCH_SIZE];
+    double coefs[COEF_BATCH_SIZE];
+
+    for (int start = 0; start < _inc_count; start += COEF_BATCH_SIZE)
     {
-        byte* fp = inc + i * _fp_size;
-        int fp_bit_number = bitGetOnesCount(fp, _fp_size);
+        int n = std::min(_inc_count - start, COEF_BATCH_SIZE);
+        const byte* fps = inc + start * _fp_size;
+
+        bitGetOnesCountBatch(fps, _fp_size, n, fp_bit_numbers);
+        sim_coef.calcCoefBatch(query, fps, query_bit_number, fp_bit_numbers, n, coefs);
 
-        double coef = sim_coef.calcCoef(fp, query, query_bit_number, fp_bit_number);
-        if (coef < min_coef)
-            continue;
+        for (int i = 0; i < n; i++)
+        {
+            if (coefs[i] < min_coef)
+                continue;
 
-        sim_indices.push(SimResult(indices[i], (float)coef));
+            sim_indices.push(SimResult(indices[start + i], (float)coefs[i]));
+        }
     }
 
     return sim_indices.size();
 }
+
+void ContainerSet::_findSimilarIncBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef)
+{
+    byte* inc = _increment.ptr();
+    int* indices = _indices.ptr();
+
+    int fp_bit_numbers[COEF_BATCH_SIZE];
+    double coefs[COEF_BATCH_SIZE];
+
+    // A block of the increment stays in cache while all the active queries are scored against it
+    for (int start = 0; start < _inc_count; start += COEF_BATCH_SIZE)
+    {
+        int n = std::min(_inc_count - start, COEF_BATCH_SIZE);
+        const byte* fps = inc + start * _fp_size;
+
+        bitGetOnesCountBatch(fps, _fp_size, n, fp_bit_numbers);
+
+        for (int j = 0; j < active.size(); j++)
+        {
+            int q = active[j];
+            sim_coef.calcCoefBatch(batch.fingerprints + q * _fp_size, fps, batch.bit_counts[q], fp_bit_numbers, n, coefs);
+
+            for (int i = 0; i < n; i++)
+            {
+                if (coefs[i] < batch.min_coefs[q])
+                    continue;
+
+                batch.hits[q].push(SimResult(indices[start + i], (float)coefs[i]));
+            }
+        }
+    }
+}
@@ -30,6 +30,8 @@ namespace bingo
 
         bool add(const byte* fingerprint, int id, int fp_ones_count = -1);
 
+        bool isIncrementFull() const;
+
         void buildContainer();
 
         void splitSet(ContainerSet& new_set);
@@ -38,8 +40,15 @@ namespace bingo
 
         void optimize();
 
+        void collectRanges(MMFRanges& ranges);
+
+        // Appends the fingerprints of all the containers and their ids
+        void collectFingerprints(indigo::Array<byte>& fingerprints, indigo::Array<int>& ids);
+
         int getSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices, int cont_idx);
 
+        void getSimilarBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef, int cont_idx);
+
     private:
         MMFArray<MultibitTree> _set;
         int _fp_size;
@@ -53,6 +62,8 @@ namespace bingo
         int _max_ones_count;
 
         int _findSimilarInc(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_indices);
+
+        void _findSimilarIncBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef);
     };
 }; // namespace bingo
 
@@ -0,0 +1,100 @@
+#include "bingo_decoded_cache.h"
+
+#include "base_cpp/profiling.h"
+
+using namespace indigo;
+using namespace bingo;
+
+// Measured on typical drug-like molecules: the bulk of a decoded molecule is
+// the fixed set of its arrays plus about 200 bytes per atom and bond
+static const size_t MOLECULE_ITEM_SIZE = 256;
+
+DecodedCache::DecodedCache(size_t max_size) : _max_size(max_size), _size(0)
+{
+}
+
+bool DecodedCache::get(int id, Lease& lease)
+{
+    std::shared_ptr<_Entry> entry;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        auto it = _entries.find(id);
+        if (it == _entries.end())
+        {
+            profIncCounter("decoded_cache_miss", 1);
+            return false;
+        }
+        entry = it->second;
+        _lru.splice(_lru.begin(), _lru, entry->lru_pos);
+    }
+
+    std::unique_lock<std::mutex> entry_lock(entry->lock, std::try_to_lock);
+    if (!entry_lock.owns_lock())
+    {
+        profIncCounter("decoded_cache_busy", 1);
+        return false;
+    }
+
+    profIncCounter("decoded_cache_hit", 1);
+    lease._entry = std::move(entry);
+    lease._lock = std::move(entry_lock);
+    return true;
+}
+
+void DecodedCache::put(int id, std::unique_ptr<Molecule>&& mol, Lease& lease)
+{
+    auto entry = std::make_shared<_Entry>();
+    entry->size = estimateSize(*mol);
+    entry->mol = std::move(mol);
+    std::unique_lock<std::mutex> entry_lock(entry->lock);
+
+    if (entry->size <= _max_size)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_entries.find(id) == _entries.end())
+        {
+            _lru.push_front(id);
+            entry->lru_pos = _lru.begin();
+            _entries.emplace(id, entry);
+            _size += entry->size;
+            _evict();
+        }
+    }
+
+    lease._entry = std::move(entry);
+    lease._lock = std::move(entry_lock);
+}
+
+void DecodedCache::remove(int id)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    auto it = _entries.find(id);
+    if (it == _entries.end())
+        return;
+    _size -= it->second->size;
+    _lru.erase(it->second->lru_pos);
+    _entries.erase(it);
+}
+
+size_t DecodedCache::size() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _size;
+}
+
+size_t DecodedCache::estimateSize(const Molecule& mol)
+{
+    return sizeof(Molecule) + (mol.vertexCount() + mol.edgeCount()) * MOLECULE_ITEM_SIZE;
+}
+
+void DecodedCache::_evict()
+{
+    // Leased entries are only unlinked here, their molecules live until the lease ends
+    while (_size > _max_size && !_lru.empty())
+    {
+        auto it = _entries.find(_lru.back());
+        _size -= it->second->size;
+        _entries.erase(it);
+        _lru.pop_back();
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef __bingo_decoded_cache__
+#define __bingo_decoded_cache__
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "molecule/molecule.h"
+
+namespace bingo
+{
+    // Bounded LRU of decoded index records keyed by the base id. Searches
+    // that check the same records over and over skip the CMF decoding and
+    // reuse the rings and hydrogen counts the previous checks have computed.
+    // Records are never changed in place and base ids are never reused, so
+    // an entry stays valid until it is evicted; removed records are still
+    // filtered out by the storage before the cache is consulted.
+    //
+    // A cached molecule is used by one thread at a time: it is handed out
+    // with a lease that holds the lock of the entry
+    class DecodedCache
+    {
+    private:
+        struct _Entry
+        {
+            std::mutex lock;
+            std::unique_ptr<indigo::Molecule> mol;
+            size_t size = 0;
+            std::list<int>::iterator lru_pos;
+        };
+
+    public:
+        class Lease
+        {
+        public:
+            indigo::Molecule* molecule()
+            {
+                return _entry ? _entry->mol.get() : nullptr;
+            }
+
+        private:
+            friend class DecodedCache;
+
+            std::shared_ptr<_Entry> _entry;
+            std::unique_lock<std::mutex> _lock;
+        };
+
+        explicit DecodedCache(size_t max_size);
+
+        DecodedCache(const DecodedCache&) = delete;
+        DecodedCache& operator=(const DecodedCache&) = delete;
+
+        // Returns false if the record is not cached or another thread uses it
+        bool get(int id, Lease& lease);
+
+        // Takes the freshly decoded record and leases it. If the record was
+        // cached in the meantime, the lease holds a private copy instead
+        void put(int id, std::unique_ptr<indigo::Molecule>&& mol, Lease& lease);
+
+        void remove(int id);
+
+        size_t size() const;
+
+        // Approximate memory taken by a decoded molecule
+        static size_t estimateSize(const indigo::Molecule& mol);
+
+    private:
+        void _evict();
+
+        size_t _max_size;
+        size_t _size;
+
+        mutable std::mutex _lock;
+        std::unordered_map<int, std::shared_ptr<_Entry>> _entries;
+        std::list<int> _lru; // most recently used first
+    };
+}
+
+#endif // __bingo_decoded_cache__
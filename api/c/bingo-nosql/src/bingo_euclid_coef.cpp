@@ -16,6 +16,23 @@ double EuclidCoef::calcCoef(const byte* target, const byte* query, int target_bi
     return (double)common_bits / target_bit_count;
 }
 
+void EuclidCoef::calcCoefBatch(const byte* target, const byte* queries, int target_bit_count, const int* query_bit_counts, int count, double* coefs)
+{
+    int common_bits[COEF_BATCH_SIZE];
+
+    if (target_bit_count == -1)
+        target_bit_count = bitGetOnesCount(target, _fp_size);
+
+    for (int start = 0; start < count; start += COEF_BATCH_SIZE)
+    {
+        int n = std::min(count - start, COEF_BATCH_SIZE);
+        bitCommonOnesBatch(target, queries + (size_t)start * _fp_size, _fp_size, n, common_bits);
+
+        for (int i = 0; i < n; i++)
+            coefs[start + i] = (double)common_bits[i] / target_bit_count;
+    }
+}
+
 double EuclidCoef::calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count)
 {
     int min = (query_bit_count < max_target_bit_count ? query_bit_count : max_target_bit_count);
@@ -30,5 +47,6 @@ double EuclidCoef::calcUpperBound(int query_bit_count, int min_target_bit_count,
 
     int min = (b > max_a ? max_a : b);
 
-    return (double)min / min_target_bit_count;
+    // Same denominator as calcCoef gets with the query passed as the target
+    return (double)min / query_bit_count;
 }
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "bingo_exact_join.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "base_cpp/profiling.h"
+#include "bingo_internal.h"
+#include "indigo_molecule.h"
+#include "indigo_reaction.h"
+#include "mmf/mmf_allocator.h"
+
+using namespace indigo;
+using namespace bingo;
+
+// Records read from the iterator and joined with the storage at a time
+static const int EXACT_JOIN_PARTITION_SIZE = 16384;
+
+// Number of records or candidates processed by one worker at a time
+static const int EXACT_JOIN_COMMAND_SIZE = 64;
+
+void ExactJoinCommand::execute(OsCommandResult& result)
+{
+    if (dispatcher->_phase == ExactJoinDispatcher::_Phase::HASH)
+        dispatcher->_hashRecords(begin, end);
+    else
+        dispatcher->_verifyCandidates(begin, end, matcher);
+}
+
+ExactJoinDispatcher::ExactJoinDispatcher(BaseIndex& index, int db_id, IndigoObject& iterator, const char* options, const AromaticityOptions& arom_options)
+    : OsCommandDispatcher(HANDLING_ORDER_ANY, true), failed(0), _index(index), _db_id(db_id), _iterator(iterator), _options(options ? options : ""),
+      _arom_options(arom_options), _finished(false), _read_count(0), _phase(_Phase::HASH), _next(0), _count(0)
+{
+}
+
+void ExactJoinDispatcher::join(int thread_count)
+{
+    profTimerStart(t, "bingo_exact_join");
+    matches.clear();
+    failed = 0;
+    _finished = false;
+    _read_count = 0;
+
+    while (_readPartition())
+    {
+        _hashes.assign(_records.size(), 0);
+        _hashed.assign(_records.size(), 0);
+        _runPhase(_Phase::HASH, _records.size(), thread_count);
+
+        std::vector<std::pair<dword, int>> queries;
+        for (int i = 0; i < _records.size(); i++)
+            if (_hashed[i])
+                queries.emplace_back(_hashes[i], i);
+
+        _candidates.clear();
+        {
+            const auto storage_lock = _index.lockStorages();
+            _index.getExactStorage().joinCandidates(queries, _candidates);
+        }
+
+        // Candidates of a record go together, so a worker sets each query once
+        std::sort(_candidates.begin(), _candidates.end());
+        _confirmed.assign(_candidates.size(), 0);
+        _runPhase(_Phase::VERIFY, (int)_candidates.size(), thread_count);
+
+        for (size_t i = 0; i < _candidates.size(); i++)
+            if (_confirmed[i])
+                matches.emplace_back(_record_indices[_candidates[i].first], _candidates[i].second);
+
+        profIncCounter("bingo_exact_join.records", _records.size());
+        profIncCounter("bingo_exact_join.candidates", (int)_candidates.size());
+    }
+
+    _records.clear();
+    _record_indices.clear();
+    profIncCounter("bingo_exact_join.matches", (int)matches.size());
+}
+
+bool ExactJoinDispatcher::_readPartition()
+{
+    profTimerStart(t, "bingo_exact_join.read");
+    _records.clear();
+    _record_indices.clear();
+
+    while (!_finished && _records.size() < EXACT_JOIN_PARTITION_SIZE)
+    {
+        try
+        {
+            std::unique_ptr<IndigoObject> record(_iterator.next());
+            if (record == nullptr)
+            {
+                _finished = true;
+                break;
+            }
+            _records.add(std::move(record));
+            _record_indices.push_back(_read_count);
+        }
+        catch (const Exception& e)
+        {
+            std::cerr << e.message() << std::endl;
+            failed++;
+        }
+        _read_count++;
+    }
+    return _records.size() > 0;
+}
+
+void ExactJoinDispatcher::_runPhase(_Phase phase, int count, int thread_count)
+{
+    _phase = phase;
+    _next = 0;
+    _count = count;
+
+    if (thread_count == 1)
+        run(0);
+    else if (thread_count <= 0)
+        run(-1);
+    else
+        run(thread_count);
+}
+
+OsCommand* ExactJoinDispatcher::_allocateCommand()
+{
+    ExactJoinCommand* command = new ExactJoinCommand();
+    command->dispatcher = this;
+    return command;
+}
+
+bool ExactJoinDispatcher::_setupCommand(OsCommand& cmd)
+{
+    if (_next >= _count)
+        return false;
+
+    ExactJoinCommand& command = (ExactJoinCommand&)cmd;
+    command.begin = _next;
+    command.end = std::min(_next + EXACT_JOIN_COMMAND_SIZE, _count);
+    _next = command.end;
+    return true;
+}
+
+void ExactJoinDispatcher::_prepareThread()
+{
+    MMFAllocator::setDatabaseId(_db_id);
+}
+
+void ExactJoinDispatcher::_hashRecords(int begin, int end)
+{
+    profTimerStart(t, "bingo_exact_join.hash");
+
+    for (int i = begin; i < end; i++)
+    {
+        IndigoObject& record = _records[i];
+        try
+        {
+            if (_index.getType() == IndexType::MOLECULE)
+            {
+                if (!IndigoMolecule::is(record))
+                    throw BingoException("bingoSearchExactBatch: Only molecule objects can be searched in molecule index");
+
+                record.getMolecule().aromatize(_arom_options);
+                _hashes[i] = ExactStorage::calculateMolHash(record.getMolecule());
+            }
+            else
+            {
+                if (!IndigoReaction::is(record))
+                    throw BingoException("bingoSearchExactBatch: Only reaction objects can be searched in reaction index");
+
+                record.getReaction().aromatize(_arom_options);
+                _hashes[i] = ExactStorage::calculateRxnHash(record.getReaction());
+            }
+            _hashed[i] = 1;
+        }
+        catch (const Exception& e)
+        {
+            std::cerr << e.message() << std::endl;
+        }
+    }
+}
+
+void ExactJoinDispatcher::_verifyCandidates(int begin, int end, std::unique_ptr<Matcher>& matcher)
+{
+    profTimerStart(t, "bingo_exact_join.verify");
+
+    int query = -1;
+    for (int i = begin; i < end; i++)
+    {
+        if (_candidates[i].first != query)
+        {
+            query = _candidates[i].first;
+            IndigoObject& record = _records[query];
+
+            ExactQueryData* query_data;
+            if (_index.getType() == IndexType::MOLECULE)
+                query_data = new MoleculeExactQueryData(record.getMolecule());
+            else
+                query_data = new ReactionExactQueryData(record.getReaction());
+
+            if (matcher == nullptr)
+                matcher = _index.createMatcher("exact", query_data, _options.c_str());
+            else
+                ((BaseExactMatcher&)*matcher).setQueryData(query_data);
+        }
+
+        const auto storage_lock = matcher->lockStorages();
+        _confirmed[i] = ((BaseExactMatcher&)*matcher).tryCandidate(_candidates[i].second);
+    }
+}
+
+ExactJoinMatcher::ExactJoinMatcher(BaseIndex& index, std::vector<std::pair<int, int>>&& matches, IndigoObject*& current_obj)
+    : BaseMatcher(index, current_obj), _matches(std::move(matches)), _current_match(-1)
+{
+}
+
+bool ExactJoinMatcher::next()
+{
+    if (_current_match + 1 >= (int)_matches.size())
+        return false;
+
+    _current_match++;
+    _current_id = _matches[_current_match].second;
+
+    // The object handed out by currentObject() follows the search, the
+    // others are loaded only when they are asked for
+    if (_current_obj_used && _current_obj)
+        _loadCurrentObject(_index, _current_id, _current_obj);
+
+    return true;
+}
+
+IndigoObject* ExactJoinMatcher::currentObject()
+{
+    if (!_current_obj_used && _current_match >= 0)
+        _loadCurrentObject(_index, _current_id, _current_obj);
+
+    return BaseMatcher::currentObject();
+}
+
+int ExactJoinMatcher::currentQueryIndex() const
+{
+    if (_current_match < 0 || _current_match >= (int)_matches.size())
+        throw Exception("ExactJoinMatcher: There is no current match");
+
+    return _matches[_current_match].first;
+}
+
+void ExactJoinMatcher::_setParameters(const char* params)
+{
+}
+
+void ExactJoinMatcher::_initPartition()
+{
+}
+
+MoleculeExactJoinMatcher::MoleculeExactJoinMatcher(BaseIndex& index, std::vector<std::pair<int, int>>&& matches)
+    : ExactJoinMatcher(index, std::move(matches), (IndigoObject*&)_current_mol), _current_mol(new IndexCurrentMolecule(_current_mol))
+{
+}
+
+ReactionExactJoinMatcher::ReactionExactJoinMatcher(BaseIndex& index, std::vector<std::pair<int, int>>&& matches)
+    : ExactJoinMatcher(index, std::move(matches), (IndigoObject*&)_current_rxn), _current_rxn(new IndexCurrentReaction(_current_rxn))
+{
+}
@@ -0,0 +1,135 @@
+#ifndef __bingo_exact_join__
+#define __bingo_exact_join__
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base_cpp/os_thread_wrapper.h"
+#include "molecule/molecule_arom.h"
+
+#include "bingo_matcher.h"
+
+namespace bingo
+{
+    class ExactJoinDispatcher;
+
+    // Range of the records or of the candidates of a partition handled by one worker
+    class ExactJoinCommand : public indigo::OsCommand
+    {
+    public:
+        void execute(indigo::OsCommandResult& result) override;
+
+        ExactJoinDispatcher* dispatcher;
+        int begin;
+        int end;
+
+        // Exact matcher the verified records are set to as queries. The dispatcher pools
+        // the commands, so the matcher is created once per pooled command and reused
+        std::unique_ptr<Matcher> matcher;
+    };
+
+    // Exact search of all the records of an iterator at once. The records are read
+    // by partitions. Worker threads parse and hash the records of a partition, then
+    // the hashes are joined with the exact storage in the order of its hash table,
+    // and the workers verify only the records which share a hash with a stored one.
+    // Worker threads share the session of the caller to see its options
+    class ExactJoinDispatcher : public indigo::OsCommandDispatcher
+    {
+    public:
+        ExactJoinDispatcher(BaseIndex& index, int db_id, IndigoObject& iterator, const char* options, const indigo::AromaticityOptions& arom_options);
+
+        // Thread count semantics follow bingonosql-insert-thread-count
+        void join(int thread_count);
+
+        // (record index, base id) pairs of the matches ordered by the record index.
+        // Records are indexed in the iterator order starting from 0
+        std::vector<std::pair<int, int>> matches;
+
+        int failed;
+
+    private:
+        friend class ExactJoinCommand;
+
+        enum class _Phase
+        {
+            HASH,
+            VERIFY
+        };
+
+        indigo::OsCommand* _allocateCommand() override;
+        bool _setupCommand(indigo::OsCommand& command) override;
+        void _prepareThread() override;
+
+        bool _readPartition();
+        void _runPhase(_Phase phase, int count, int thread_count);
+
+        void _hashRecords(int begin, int end);
+        void _verifyCandidates(int begin, int end, std::unique_ptr<Matcher>& matcher);
+
+        BaseIndex& _index;
+        int _db_id;
+        IndigoObject& _iterator;
+        std::string _options;
+        indigo::AromaticityOptions _arom_options;
+        bool _finished;
+        int _read_count;
+
+        // Records of the current partition with their indices in the iterator
+        indigo::PtrArray<IndigoObject> _records;
+        std::vector<int> _record_indices;
+        std::vector<dword> _hashes;
+        std::vector<char> _hashed;
+
+        // (record, base id) pairs of equal hashes and the verdicts on them
+        std::vector<std::pair<int, int>> _candidates;
+        std::vector<char> _confirmed;
+
+        _Phase _phase;
+        int _next;
+        int _count;
+    };
+
+    // Search object over the matches of an exact join. currentId() is the id of
+    // the found record, currentQueryIndex() is the index of the matched input record
+    class ExactJoinMatcher : public BaseMatcher
+    {
+    public:
+        ExactJoinMatcher(BaseIndex& index, std::vector<std::pair<int, int>>&& matches, IndigoObject*& current_obj);
+
+        bool next() override;
+
+        IndigoObject* currentObject() override;
+
+        int currentQueryIndex() const;
+
+    protected:
+        void _setParameters(const char* params) override;
+        void _initPartition() override;
+
+    private:
+        std::vector<std::pair<int, int>> _matches;
+        int _current_match;
+    };
+
+    class MoleculeExactJoinMatcher : public ExactJoinMatcher
+    {
+    public:
+        MoleculeExactJoinMatcher(BaseIndex& index, std::vector<std::pair<int, int>>&& matches);
+
+    private:
+        IndexCurrentMolecule* _current_mol;
+    };
+
+    class ReactionExactJoinMatcher : public ExactJoinMatcher
+    {
+    public:
+        ReactionExactJoinMatcher(BaseIndex& index, std::vector<std::pair<int, int>>&& matches);
+
+    private:
+        IndexCurrentReaction* _current_rxn;
+    };
+}
+
+#endif // __bingo_exact_join__
@@ -1,5 +1,7 @@
 #include "bingo_exact_storage.h"
 
+#include <algorithm>
+
 #include "base_cpp/profiling.h"
 #include "graph/subgraph_hash.h"
 #include "molecule/elements.h"
@@ -55,6 +57,46 @@ void ExactStorage::findCandidates(dword query_hash, Array<int>& candidates, int
         candidates.push(indices[i]);
 }
 
+void ExactStorage::joinCandidates(std::vector<std::pair<dword, int>>& queries, std::vector<std::pair<int, int>>& candidates)
+{
+    profTimerStart(t, "exact_join");
+
+    std::sort(queries.begin(), queries.end(), [this](const std::pair<dword, int>& q1, const std::pair<dword, int>& q2) {
+        size_t bucket1 = _molecule_hashes.getBucket(q1.first);
+        size_t bucket2 = _molecule_hashes.getBucket(q2.first);
+        if (bucket1 != bucket2)
+            return bucket1 < bucket2;
+        return q1 < q2;
+    });
+
+    std::vector<std::pair<size_t, size_t>> pairs;
+
+    size_t begin = 0;
+    while (begin < queries.size())
+    {
+        size_t bucket = _molecule_hashes.getBucket(queries[begin].first);
+        size_t end = begin + 1;
+        while (end < queries.size() && _molecule_hashes.getBucket(queries[end].first) == bucket)
+            end++;
+
+        pairs.clear();
+        _molecule_hashes.getBucketPairs(bucket, pairs);
+        profIncCounter("exact_join_buckets", 1);
+
+        // Queries of the bucket are sorted by hash, so every stored pair
+        // finds the queries with its hash by a binary search
+        for (const auto& pair : pairs)
+        {
+            auto it = std::lower_bound(queries.begin() + begin, queries.begin() + end, pair.first,
+                                       [](const std::pair<dword, int>& query, size_t hash) { return query.first < hash; });
+            for (; it != queries.begin() + end && it->first == pair.first; it++)
+                candidates.emplace_back(it->second, (int)pair.second);
+        }
+
+        begin = end;
+    }
+}
+
 dword ExactStorage::calculateMolHash(Molecule& mol)
 {
     return MoleculeHash::calculate(mol);
@@ -1,6 +1,8 @@
 #ifndef __bingo_exact_storage__
 #define __bingo_exact_storage__
 
+#include <vector>
+
 #include "molecule/molecule.h"
 #include "reaction/reaction.h"
 
@@ -24,6 +26,11 @@ namespace bingo
 
         void findCandidates(dword query_hash, indigo::Array<int>& candidates, int part_id = -1, int part_count = -1);
 
+        // Candidates of many queries given as (hash, query index) pairs. The queries are
+        // sorted into the order of the hash table, so every bucket is read once for all the
+        // queries falling into it. Appends (query index, candidate id) pairs of equal hashes
+        void joinCandidates(std::vector<std::pair<dword, int>>& queries, std::vector<std::pair<int, int>>& candidates);
+
         static dword calculateMolHash(indigo::Molecule& mol);
 
         static dword calculateRxnHash(indigo::Reaction& rxn);
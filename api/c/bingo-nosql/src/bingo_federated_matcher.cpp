@@ -0,0 +1,282 @@
+#include "bingo_federated_matcher.h"
+
+#include "indigo_internal.h"
+
+#include "mmf/mmf_allocator.h"
+
+using namespace indigo;
+using namespace bingo;
+
+FederatedMatcher::FederatedMatcher(std::vector<Shard>&& shards, int limit, IndigoObject*& current_obj)
+    : BaseMatcher(*shards[0].index, current_obj), _limit(limit), _current_hit{-1, 0}
+{
+    _similarity = dynamic_cast<BaseSimilarityMatcher*>(shards[0].matcher.get()) != nullptr;
+    _ordered = dynamic_cast<TopNSimMatcher*>(shards[0].matcher.get()) != nullptr;
+
+    _shards.resize(shards.size());
+    for (size_t i = 0; i < shards.size(); i++)
+        _shards[i].shard = std::move(shards[i]);
+}
+
+FederatedMatcher::~FederatedMatcher()
+{
+    _stopWorkers();
+}
+
+bool FederatedMatcher::next()
+{
+    if (_workers.empty())
+        _startWorkers();
+
+    int shard_idx = -1;
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        while (_limit <= 0 || _hits_count < _limit)
+        {
+            if (_worker_error)
+                std::rethrow_exception(_worker_error);
+
+            bool wait = false;
+            shard_idx = _pickShard(wait);
+            if (!wait)
+                break;
+            _cv_hits.wait(lock);
+        }
+
+        if (shard_idx >= 0)
+        {
+            _current_hit = _shards[shard_idx].hits.front();
+            _shards[shard_idx].hits.pop_front();
+            _hits_count++;
+            _next_shard = (shard_idx + 1) % _shards.size();
+            _cv_space.notify_all();
+        }
+    }
+
+    if (shard_idx < 0)
+    {
+        _stopWorkers();
+        _current_shard = -1;
+        return false;
+    }
+
+    _current_shard = shard_idx;
+
+    // The object handed out by currentObject() follows the search, the
+    // others are loaded only when they are asked for
+    if (_current_obj_used && _current_obj)
+        _loadShardObject();
+
+    return true;
+}
+
+int FederatedMatcher::currentId() const
+{
+    return _current_hit.id;
+}
+
+IndigoObject* FederatedMatcher::currentObject()
+{
+    if (!_current_obj_used && _current_shard >= 0)
+        _loadShardObject();
+
+    return BaseMatcher::currentObject();
+}
+
+float FederatedMatcher::currentSimValue() const
+{
+    if (!_similarity)
+        throw Exception("FederatedMatcher: Matcher does not support this method");
+
+    return _current_hit.sim_value;
+}
+
+void FederatedMatcher::setOptions(const char* options)
+{
+    throw Exception("FederatedMatcher: Matcher does not support this method");
+}
+
+int FederatedMatcher::esimateRemainingResultsCount(int& delta)
+{
+    throw Exception("FederatedMatcher: Matcher does not support this method");
+}
+
+float FederatedMatcher::esimateRemainingTime(float& delta)
+{
+    throw Exception("FederatedMatcher: Matcher does not support this method");
+}
+
+std::shared_lock<std::shared_mutex> FederatedMatcher::lockStorages() const
+{
+    return std::shared_lock<std::shared_mutex>();
+}
+
+void FederatedMatcher::_setParameters(const char* params)
+{
+}
+
+void FederatedMatcher::_initPartition()
+{
+}
+
+void FederatedMatcher::_startWorkers()
+{
+    Indigo& indigo = indigoGetInstance();
+    _arom_options = indigo.arom_options;
+    _tautomer_rules = &indigo.tautomer_rules;
+
+    for (int i = 0; i < (int)_shards.size(); i++)
+        _workers.emplace_back(&FederatedMatcher::_workerLoop, this, i);
+}
+
+void FederatedMatcher::_stopWorkers()
+{
+    if (_workers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop_request = true;
+        _cv_space.notify_all();
+    }
+    for (auto& worker : _workers)
+        if (worker.joinable())
+            worker.join();
+}
+
+void FederatedMatcher::_workerLoop(int shard_idx)
+{
+    qword session = indigoAllocSessionId();
+    _ShardState& state = _shards[shard_idx];
+
+    // A failure of the setup is reported like a failure of the search, an exception
+    // leaving the thread function would terminate the process
+    try
+    {
+        // Every worker runs in its own session that inherits the options affecting matching
+        Indigo& indigo = indigoGetInstance();
+        indigo.arom_options = _arom_options;
+        for (int i = 0; i < _tautomer_rules->size(); i++)
+        {
+            auto t_rule = _tautomer_rules->getPtr(i);
+            if (t_rule == nullptr)
+                continue;
+            auto rule = std::make_unique<TautomerRule>();
+            rule->list1.copy(t_rule->list1);
+            rule->list2.copy(t_rule->list2);
+            rule->aromaticity1 = t_rule->aromaticity1;
+            rule->aromaticity2 = t_rule->aromaticity2;
+            indigo.tautomer_rules.expand(i + 1);
+            indigo.tautomer_rules.reset(i, std::move(rule));
+        }
+
+        Matcher& matcher = *state.shard.matcher;
+        MMFAllocator::setDatabaseId(state.shard.db_id);
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _cv_space.wait(lock, [&]() { return _stop_request || state.hits.size() < FEDERATED_QUEUE_SIZE; });
+                if (_stop_request)
+                    break;
+            }
+
+            _Hit hit{-1, 0};
+            bool found;
+            {
+                const auto storage_lock = matcher.lockStorages();
+                found = matcher.next();
+                if (found)
+                {
+                    hit.id = matcher.currentId();
+                    if (_similarity)
+                        hit.sim_value = matcher.currentSimValue();
+                }
+            }
+
+            if (!found)
+                break;
+
+            std::lock_guard<std::mutex> lock(_mtx);
+            state.hits.push_back(hit);
+            _cv_hits.notify_one();
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if (!_worker_error)
+            _worker_error = std::current_exception();
+        _stop_request = true;
+        _cv_space.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        state.done = true;
+        _cv_hits.notify_one();
+    }
+
+    indigoReleaseSessionId(session);
+}
+
+int FederatedMatcher::_pickShard(bool& wait) const
+{
+    int count = (int)_shards.size();
+    int best = -1;
+    wait = false;
+
+    for (int k = 0; k < count; k++)
+    {
+        // Unordered hits are taken from the shards in turn
+        int i = (_next_shard + k) % count;
+        const _ShardState& state = _shards[i];
+
+        if (state.hits.empty())
+        {
+            // An ordered merge needs the next hit of every shard
+            if (!state.done && _ordered)
+            {
+                wait = true;
+                return -1;
+            }
+            if (!state.done)
+                wait = true;
+            continue;
+        }
+
+        if (!_ordered)
+        {
+            wait = false;
+            return i;
+        }
+
+        if (best < 0 || state.hits.front().sim_value > _shards[best].hits.front().sim_value)
+            best = i;
+    }
+
+    return best;
+}
+
+void FederatedMatcher::_loadShardObject()
+{
+    const Shard& shard = _shards[_current_shard].shard;
+    MMFAllocator::setDatabaseId(shard.db_id);
+
+    // The record is decoded while the shard storages are locked, it may be moved after
+    const auto storage_lock = shard.index->lockStorages();
+    int cf_len;
+    const byte* cf_buf = shard.index->getObjectCfUnlocked(_current_hit.id, cf_len);
+    _loadObject((const char*)cf_buf, cf_len, _current_obj, shard.index->isOldDB());
+}
+
+MoleculeFederatedMatcher::MoleculeFederatedMatcher(std::vector<Shard>&& shards, int limit)
+    : FederatedMatcher(std::move(shards), limit, (IndigoObject*&)_current_mol), _current_mol(new IndexCurrentMolecule(_current_mol))
+{
+}
+
+ReactionFederatedMatcher::ReactionFederatedMatcher(std::vector<Shard>&& shards, int limit)
+    : FederatedMatcher(std::move(shards), limit, (IndigoObject*&)_current_rxn), _current_rxn(new IndexCurrentReaction(_current_rxn))
+{
+}
@@ -0,0 +1,118 @@
+#ifndef __bingo_federated_matcher__
+#define __bingo_federated_matcher__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bingo_matcher.h"
+
+namespace bingo
+{
+    // Hits a shard worker may find ahead of the consumer
+    constexpr int FEDERATED_QUEUE_SIZE = 1024;
+
+    // Search over the shards of a federated database. Every shard has its own
+    // matcher driven by a worker thread, so the shards are searched at once.
+    // Hits of top-N similarity searches are merged by decreasing similarity,
+    // hits of the other searches are taken as the shards find them.
+    // Ids are the ids the records have in their shards
+    class FederatedMatcher : public BaseMatcher
+    {
+    public:
+        struct Shard
+        {
+            int db_id;
+            BaseIndex* index;
+            std::unique_ptr<Matcher> matcher;
+        };
+
+        // limit > 0 is the number of the hits of the whole search
+        FederatedMatcher(std::vector<Shard>&& shards, int limit, IndigoObject*& current_obj);
+        ~FederatedMatcher() override;
+
+        bool next() override;
+
+        int currentId() const override;
+        IndigoObject* currentObject() override;
+        float currentSimValue() const override;
+
+        void setOptions(const char* options) override;
+        int esimateRemainingResultsCount(int& delta) override;
+        float esimateRemainingTime(float& delta) override;
+
+        // The workers lock the storages of their shards themselves
+        std::shared_lock<std::shared_mutex> lockStorages() const override;
+
+    protected:
+        void _setParameters(const char* params) override;
+        void _initPartition() override;
+
+    private:
+        struct _Hit
+        {
+            int id;
+            float sim_value;
+        };
+
+        struct _ShardState
+        {
+            Shard shard;
+            std::deque<_Hit> hits;
+            bool done = false;
+        };
+
+        std::vector<_ShardState> _shards;
+        int _limit;
+        bool _similarity;
+        bool _ordered;
+
+        int _hits_count = 0;
+        int _next_shard = 0;
+        int _current_shard = -1;
+        _Hit _current_hit;
+
+        std::vector<std::thread> _workers;
+        std::mutex _mtx;
+        std::condition_variable _cv_hits;
+        std::condition_variable _cv_space;
+        std::atomic_bool _stop_request = false;
+        std::exception_ptr _worker_error;
+
+        AromaticityOptions _arom_options;
+        PtrArray<TautomerRule>* _tautomer_rules = nullptr;
+
+        void _startWorkers();
+        void _stopWorkers();
+        void _workerLoop(int shard_idx);
+
+        // Shard of the next hit, -1 if the search is over.
+        // Sets wait if a shard has to be waited for
+        int _pickShard(bool& wait) const;
+
+        void _loadShardObject();
+    };
+
+    class MoleculeFederatedMatcher : public FederatedMatcher
+    {
+    public:
+        MoleculeFederatedMatcher(std::vector<Shard>&& shards, int limit);
+
+    private:
+        IndexCurrentMolecule* _current_mol;
+    };
+
+    class ReactionFederatedMatcher : public FederatedMatcher
+    {
+    public:
+        ReactionFederatedMatcher(std::vector<Shard>&& shards, int limit);
+
+    private:
+        IndexCurrentReaction* _current_rxn;
+    };
+}
+
+#endif // __bingo_federated_matcher__
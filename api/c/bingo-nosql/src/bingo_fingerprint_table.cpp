@@ -45,26 +45,65 @@ void FingerprintTable::add(const byte* fingerprint, int id)
     {
         if ((fp_bit_count >= _table[i].getMinBorder()) && (fp_bit_count <= _table[i].getMaxBorder()))
         {
-            if (_table[i].add(fingerprint, id))
-            {
-                if (_table[i].getMinBorder() == _table[i].getMaxBorder() || _table[i].getContCount() > 1 || _table.size() >= _max_cell_count)
-                    _table[i].buildContainer();
-                else
-                {
-                    _table.resize(_table.size() + 1);
-                    for (int j = _table.size() - 2; j >= i + 1; j--)
-                        _table[j + 1] = _table[j];
-
-                    _table[i + 1].setParams(_fp_size, _mt_size, -1, -1);
-                    _table[i].splitSet(_table[i + 1]);
-                }
-            }
-
+            _addToCell(i, fingerprint, id, fp_bit_count);
             break;
         }
     }
 }
 
+void FingerprintTable::addBatch(const byte* fingerprints, const int* ids, int count)
+{
+    profTimerStart(t, "fp_table_add_batch");
+
+    std::vector<int> ones(count);
+    bitGetOnesCountBatch(fingerprints, _fp_size, count, ones.data());
+
+    // Counting sort by the number of ones, so all the fingerprints are
+    // distributed over the cells in one forward pass
+    std::vector<int> starts(_fp_size * 8 + 2, 0);
+    for (int i = 0; i < count; i++)
+        starts[ones[i] + 1]++;
+    for (int i = 1; i < (int)starts.size(); i++)
+        starts[i] += starts[i - 1];
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++)
+        order[starts[ones[i]]++] = i;
+
+    // Splitting a cell only narrows it and inserts the rest after it, so the
+    // cell of the next fingerprint never precedes the current one
+    int cell = 0;
+    for (int k = 0; k < count; k++)
+    {
+        int i = order[k];
+        while (cell < _table.size() - 1 && ones[i] > _table[cell].getMaxBorder())
+            cell++;
+        _addToCell(cell, fingerprints + (size_t)i * _fp_size, ids[i], ones[i]);
+    }
+}
+
+void FingerprintTable::_addToCell(int i, const byte* fingerprint, int id, int fp_bit_count)
+{
+    if (_table[i].add(fingerprint, id, fp_bit_count))
+    {
+        if (_table[i].getMinBorder() == _table[i].getMaxBorder() || _table[i].getContCount() > 1 || _table.size() >= _max_cell_count)
+            _table[i].buildContainer();
+        else
+        {
+            _table.resize(_table.size() + 1);
+            for (int j = _table.size() - 2; j >= i + 1; j--)
+                _table[j + 1] = _table[j];
+
+            _table[i + 1].setParams(_fp_size, _mt_size, -1, -1);
+            _table[i].splitSet(_table[i + 1]);
+
+            // If all the fingerprints have the same number of ones, they stay in
+            // the old cell, which is still full and gets a container instead
+            if (_table[i].isIncrementFull())
+                _table[i].buildContainer();
+        }
+    }
+}
+
 void FingerprintTable::findSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices)
 {
     sim_fp_indices.clear();
@@ -90,6 +129,20 @@ void FingerprintTable::optimize()
         _table[i].optimize();
 }
 
+void FingerprintTable::collectRanges(MMFRanges& ranges)
+{
+    for (int i = 0; i < _table.size(); i++)
+        _table[i].collectRanges(ranges);
+}
+
+void FingerprintTable::collectCellFingerprints(int cell_idx, indigo::Array<byte>& fingerprints, indigo::Array<int>& ids)
+{
+    if (cell_idx >= _table.size())
+        throw indigo::Exception("FingerprintTable: Incorrect cell index");
+
+    _table[cell_idx].collectFingerprints(fingerprints, ids);
+}
+
 int FingerprintTable::getCellCount() const
 {
     return _table.size();
@@ -119,6 +172,14 @@ void FingerprintTable::getCellsInterval(const byte* query, SimCoef& sim_coef, do
     }
 }
 
+double FingerprintTable::getCellUpperBound(int query_bit_count, SimCoef& sim_coef, int cell_idx)
+{
+    if (cell_idx >= _table.size())
+        throw indigo::Exception("FingerprintTable: Incorrect cell index");
+
+    return sim_coef.calcUpperBound(query_bit_count, _table[cell_idx].getMinBorder(), _table[cell_idx].getMaxBorder());
+}
+
 int FingerprintTable::firstFitCell(int query_bit_count, int min_cell, int max_cell) const
 {
     int first_cell = -1;
@@ -169,6 +230,27 @@ int FingerprintTable::getSimilar(const byte* query, SimCoef& sim_coef, double mi
     return sim_fp_indices.size();
 }
 
+void FingerprintTable::getSimilarBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef, int cell_idx, int cont_idx)
+{
+    if (cell_idx >= _table.size())
+        throw indigo::Exception("FingerprintTable: Incorrect cell index");
+
+    QS_DEF(indigo::Array<int>, fit);
+    fit.clear();
+
+    for (int i = 0; i < active.size(); i++)
+    {
+        int q = active[i];
+        if (sim_coef.calcUpperBound(batch.bit_counts[q], _table[cell_idx].getMinBorder(), _table[cell_idx].getMaxBorder()) >= batch.min_coefs[q])
+            fit.push(q);
+    }
+
+    if (fit.size() == 0)
+        return;
+
+    _table[cell_idx].getSimilarBatch(batch, fit, sim_coef, cont_idx);
+}
+
 FingerprintTable::~FingerprintTable()
 {
 }
@@ -28,22 +28,34 @@ namespace bingo
 
         void add(const byte* fingerprint, int id);
 
+        void addBatch(const byte* fingerprints, const int* ids, int count);
+
         void findSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices);
 
         void optimize();
 
+        void collectRanges(MMFRanges& ranges);
+
+        // Appends the fingerprints of the cell and their ids
+        void collectCellFingerprints(int cell_idx, indigo::Array<byte>& fingerprints, indigo::Array<int>& ids);
+
         int getCellCount() const;
 
         int getCellSize(int cell_idx) const;
 
         void getCellsInterval(const byte* query, SimCoef& sim_coef, double min_coef, int& min_cell, int& max_cell);
 
+        // Highest coefficient a fingerprint of the cell may have with the query
+        double getCellUpperBound(int query_bit_count, SimCoef& sim_coef, int cell_idx);
+
         int firstFitCell(int query_bit_count, int min_cell, int max_cell) const;
 
         int nextFitCell(int query_bit_count, int first_fit_cell, int min_cell, int max_cell, int idx) const;
 
         int getSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices, int cell_idx, int cont_idx);
 
+        void getSimilarBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef, int cell_idx, int cont_idx);
+
         ~FingerprintTable();
 
     private:
@@ -56,6 +68,8 @@ namespace bingo
         MMFPtr<size_t> _inc_id_buffer;
         int _inc_size;
         int _inc_fp_count;
+
+        void _addToCell(int cell_idx, const byte* fingerprint, int id, int fp_bit_count);
     };
 }; // namespace bingo
 
@@ -4,6 +4,8 @@
 #include "base_cpp/profiling.h"
 #include "base_cpp/tlscont.h"
 
+#include <algorithm>
+
 using namespace bingo;
 
 TranspFpStorage::TranspFpStorage(int fp_size, int block_size, int small_base_size) : _fp_size(fp_size), _block_size(block_size)
@@ -32,7 +34,54 @@ void TranspFpStorage::load(MMFPtr<TranspFpStorage>& ptr, MMFAddress offset)
     ptr = MMFPtr<TranspFpStorage>(offset);
 }
 
-void TranspFpStorage::add(const byte* fp)
+std::shared_ptr<const void> IncrementBufferPool::pin(MMFAddress buffer)
+{
+    if (_current.pin == nullptr || _current.ptr.getAddress() != buffer)
+        _current = {MMFPtr<byte>(buffer), std::make_shared<int>(0)};
+    return _current.pin;
+}
+
+MMFPtr<byte> IncrementBufferPool::exchange(MMFPtr<byte> moved, size_t size)
+{
+    if (_current.pin == nullptr || _current.ptr.getAddress() != moved.getAddress())
+        _current = {moved, std::make_shared<int>(0)};
+    if (std::find(_buffers.begin(), _buffers.end(), moved.getAddress()) == _buffers.end())
+        _buffers.push_back(moved.getAddress());
+
+    // A buffer is free when the pool holds the only reference to its pin
+    for (size_t i = 0; i < _retired.size(); i++)
+    {
+        if (_retired[i].pin.use_count() == 1)
+        {
+            std::swap(_current, _retired[i]);
+            return _current.ptr;
+        }
+    }
+
+    _retired.push_back(std::move(_current));
+    _current.ptr.allocate(size);
+    _current.pin = std::make_shared<int>(0);
+    _buffers.push_back(_current.ptr.getAddress());
+    return _current.ptr;
+}
+
+const std::vector<MMFAddress>& IncrementBufferPool::buffers() const
+{
+    return _buffers;
+}
+
+void IncrementBufferPool::restore(const std::vector<MMFAddress>& buffers, MMFAddress current)
+{
+    _buffers = buffers;
+    _retired.clear();
+    for (const MMFAddress& buffer : _buffers)
+    {
+        if (buffer != current)
+            _retired.push_back({MMFPtr<byte>(buffer), std::make_shared<int>(0)});
+    }
+}
+
+void TranspFpStorage::add(const byte* fp, IncrementBufferPool* pool)
 {
     memcpy(_inc_buffer.ptr() + (_inc_fp_count * _fp_size), fp, _fp_size);
 
@@ -50,6 +99,8 @@ void TranspFpStorage::add(const byte* fp)
     {
         _addIncToStorage();
         _inc_fp_count = 0;
+        if (pool != nullptr)
+            _inc_buffer = pool->exchange(_inc_buffer, (size_t)_inc_size * _fp_size);
     }
 }
 
@@ -73,6 +124,11 @@ const byte* TranspFpStorage::getIncrement() const
     return _inc_buffer.ptr();
 }
 
+MMFAddress TranspFpStorage::getIncrementAddress() const
+{
+    return _inc_buffer.getAddress();
+}
+
 int TranspFpStorage::getIncrementSize() const
 {
     return _inc_fp_count;
@@ -83,37 +139,100 @@ int TranspFpStorage::getIncrementCapacity() const
     return _inc_size;
 }
 
+void TranspFpStorage::collectRanges(MMFRanges& ranges)
+{
+    for (int i = 0; i < _block_count; i++)
+        ranges.add(_storage[i].getAddress(), _block_size);
+    ranges.add(_inc_buffer.getAddress(), (size_t)_inc_fp_count * _fp_size);
+}
+
 TranspFpStorage::~TranspFpStorage()
 {
 }
 
+void TranspFpStorage::addBatch(const byte* fps, int count, IncrementBufferPool* pool)
+{
+    while (count > 0)
+    {
+        if (_inc_fp_count == 0 && count >= _inc_size)
+        {
+            _addPackToStorage(fps, _inc_size);
+            fps += _inc_size * _fp_size;
+            count -= _inc_size;
+            continue;
+        }
+        add(fps, pool);
+        fps += _fp_size;
+        count--;
+    }
+}
+
 void TranspFpStorage::_addIncToStorage()
+{
+    _addPackToStorage(_inc_buffer.ptr(), _inc_fp_count);
+}
+
+// Transposes 8x8 bit matrix: bit j of byte i goes to bit i of byte j
+static inline qword _transpose8x8(qword x)
+{
+    qword t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+void TranspFpStorage::_addPackToStorage(const byte* fps, int fp_count)
 {
     profTimerStart(t0, "fp_inc_to_transp");
 
-    std::vector<byte> block_buf;
-    block_buf.resize(_block_size);
+    const int bit_count = 8 * _fp_size;
+    const int first_block = _pack_count * bit_count;
 
-    // byte inc_mask = 0x80;
-    for (int bit_idx = 0; bit_idx < 8 * _fp_size; bit_idx++)
+    std::vector<byte*> blocks(bit_count);
+    _storage.resize(first_block + bit_count);
+    for (int bit_idx = 0; bit_idx < bit_count; bit_idx++)
     {
-        memset(&block_buf[0], 0, _block_size);
-        for (int fp_idx = 0; fp_idx < _inc_fp_count; fp_idx++)
-            bitSetBit(&block_buf[0], fp_idx, bitGetBit(_inc_buffer.ptr() + fp_idx * _fp_size, bit_idx));
+        _storage[first_block + bit_idx].allocate(_block_size);
+        blocks[bit_idx] = _storage[first_block + bit_idx].ptr();
+        memset(blocks[bit_idx], 0, _block_size);
+    }
 
-        if (_pack_count == 0)
+    // Every 8 fingerprints by 8 bits tile is transposed at once. Fingerprint bytes
+    // are walked in strips, so the blocks being written stay in cache
+    const int STRIP_BYTES = 8;
+    for (int strip = 0; strip < _fp_size; strip += STRIP_BYTES)
+    {
+        int strip_end = std::min(strip + STRIP_BYTES, _fp_size);
+        for (int group = 0; group * 8 < fp_count; group++)
         {
-            // Update bit usage count
-            _fp_bit_usage_counts[bit_idx] = bitGetOnesCount(&block_buf[0], _block_size);
+            const byte* rows = fps + (size_t)group * 8 * _fp_size;
+            int rows_count = std::min(8, fp_count - group * 8);
+            for (int byte_idx = strip; byte_idx < strip_end; byte_idx++)
+            {
+                qword tile = 0;
+                for (int row = 0; row < rows_count; row++)
+                    tile |= (qword)rows[row * _fp_size + byte_idx] << (8 * row);
+                if (tile == 0)
+                    continue;
+                tile = _transpose8x8(tile);
+                for (int bit = 0; bit < 8; bit++)
+                    blocks[byte_idx * 8 + bit][group] = (byte)(tile >> (8 * bit));
+            }
         }
+    }
 
-        int block_idx = (_pack_count * _fp_size * 8) + bit_idx;
-        _storage.resize(block_idx + 1);
-        _storage[block_idx].allocate(_block_size);
-        memcpy(_storage[block_idx].ptr(), &block_buf[0], _block_size);
-        _block_count++;
+    if (_pack_count == 0)
+    {
+        // Update bit usage count
+        for (int bit_idx = 0; bit_idx < bit_count; bit_idx++)
+            _fp_bit_usage_counts[bit_idx] = bitGetOnesCount(blocks[bit_idx], _block_size);
     }
 
+    _block_count += bit_count;
     _pack_count++;
 }
 
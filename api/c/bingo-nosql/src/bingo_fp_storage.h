@@ -2,6 +2,7 @@
 #define __bingo_fp_storage__
 
 #include <fstream>
+#include <memory>
 #include <vector>
 
 #include "mmf/mmf_array.h"
@@ -9,6 +10,40 @@
 
 namespace bingo
 {
+    // Buffers the increment of TranspFpStorage continues in after it has been
+    // moved to a pack. Searches of an index snapshot may still scan the moved
+    // increment, so it is reused only when no snapshot pins it anymore.
+    // Lives in the process memory and is used by the writer only. The buffers
+    // are allocated in the database, so the index keeps their addresses to
+    // give the retired ones back to the pool when it is loaded again
+    class IncrementBufferPool
+    {
+    public:
+        // Returns the pin of the buffer that a snapshot holds while it reads the buffer
+        std::shared_ptr<const void> pin(MMFAddress buffer);
+
+        // Retires the moved buffer and returns the buffer for the new increment
+        MMFPtr<byte> exchange(MMFPtr<byte> moved, size_t size);
+
+        // Addresses of all buffers that have been exchanged, the current one included
+        const std::vector<MMFAddress>& buffers() const;
+
+        // Takes back the buffers of a loaded database. No snapshot outlives the
+        // database, so every buffer but the current increment is free
+        void restore(const std::vector<MMFAddress>& buffers, MMFAddress current);
+
+    private:
+        struct _Buffer
+        {
+            MMFPtr<byte> ptr;
+            std::shared_ptr<const void> pin;
+        };
+
+        _Buffer _current;
+        std::vector<_Buffer> _retired;
+        std::vector<MMFAddress> _buffers;
+    };
+
     class TranspFpStorage
     {
     public:
@@ -18,7 +53,13 @@ namespace bingo
 
         static void load(MMFPtr<TranspFpStorage>& ptr, MMFAddress offset);
 
-        void add(const byte* fp);
+        // The increment is refilled in place after it is moved to a pack,
+        // or in a buffer from the pool if there are readers of the old one
+        void add(const byte* fp, IncrementBufferPool* pool = nullptr);
+
+        // Adds count fingerprints stored one after another. Whole packs are
+        // transposed straight from the input without passing the increment
+        void addBatch(const byte* fps, int count, IncrementBufferPool* pool = nullptr);
 
         int getBlockSize(void) const;
 
@@ -28,6 +69,8 @@ namespace bingo
 
         const byte* getIncrement() const;
 
+        MMFAddress getIncrementAddress() const;
+
         int getIncrementSize(void) const;
 
         int getIncrementCapacity(void) const;
@@ -38,6 +81,9 @@ namespace bingo
 
         MMFArray<int>& getFpBitUsageCounts();
 
+        // Adds the mapped memory of the transposed blocks and of the increment
+        void collectRanges(MMFRanges& ranges);
+
     protected:
         int _fp_size;
         int _block_count;
@@ -56,6 +102,8 @@ namespace bingo
         void _createFpStorage(int fp_size, int inc_fp_capacity, const char* inc_filename);
 
         void _addIncToStorage();
+
+        void _addPackToStorage(const byte* fps, int fp_count);
     };
 }; // namespace bingo
 
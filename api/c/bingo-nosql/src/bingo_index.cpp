@@ -14,6 +14,7 @@ std::unique_ptr<Matcher> MoleculeIndex::createMatcher(const char* type, MatcherQ
     if (strcmp(type, "sub") == 0)
     {
         std::unique_ptr<MoleculeSubMatcher> matcher = std::make_unique<MoleculeSubMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<SubstructureQueryData*>(query_data));
         return matcher;
@@ -21,6 +22,7 @@ std::unique_ptr<Matcher> MoleculeIndex::createMatcher(const char* type, MatcherQ
     else if (strcmp(type, "sim") == 0)
     {
         std::unique_ptr<MoleculeSimMatcher> matcher = std::make_unique<MoleculeSimMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<SimilarityQueryData*>(query_data));
         return matcher;
@@ -28,6 +30,7 @@ std::unique_ptr<Matcher> MoleculeIndex::createMatcher(const char* type, MatcherQ
     else if (strcmp(type, "exact") == 0)
     {
         std::unique_ptr<MolExactMatcher> matcher = std::make_unique<MolExactMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<ExactQueryData*>(query_data));
         return matcher;
@@ -35,6 +38,7 @@ std::unique_ptr<Matcher> MoleculeIndex::createMatcher(const char* type, MatcherQ
     else if (strcmp(type, "formula") == 0)
     {
         std::unique_ptr<MolGrossMatcher> matcher = std::make_unique<MolGrossMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<GrossQueryData*>(query_data));
         return matcher;
@@ -54,6 +58,7 @@ std::unique_ptr<Matcher> MoleculeIndex::createMatcherWithExtFP(const char* type,
     if (strcmp(type, "sim") == 0)
     {
         std::unique_ptr<MoleculeSimMatcher> matcher = std::make_unique<MoleculeSimMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryDataWithExtFP(dynamic_cast<SimilarityQueryData*>(query_data), fp);
         return matcher;
@@ -69,6 +74,7 @@ std::unique_ptr<Matcher> MoleculeIndex::createMatcherTopN(const char* type, Matc
     if (strcmp(type, "sim") == 0)
     {
         std::unique_ptr<MoleculeTopNSimMatcher> matcher = std::make_unique<MoleculeTopNSimMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<SimilarityQueryData*>(query_data));
         matcher->setLimit(limit);
@@ -86,6 +92,7 @@ std::unique_ptr<Matcher> MoleculeIndex::createMatcherTopNWithExtFP(const char* t
     if (strcmp(type, "sim") == 0)
     {
         std::unique_ptr<MoleculeTopNSimMatcher> matcher = std::make_unique<MoleculeTopNSimMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryDataWithExtFP(dynamic_cast<SimilarityQueryData*>(query_data), fp);
         matcher->setLimit(limit);
@@ -106,6 +113,7 @@ std::unique_ptr<Matcher> ReactionIndex::createMatcher(const char* type, MatcherQ
     if (strcmp(type, "sub") == 0)
     {
         std::unique_ptr<ReactionSubMatcher> matcher = std::make_unique<ReactionSubMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<SubstructureQueryData*>(query_data));
         return matcher;
@@ -113,6 +121,7 @@ std::unique_ptr<Matcher> ReactionIndex::createMatcher(const char* type, MatcherQ
     else if (strcmp(type, "sim") == 0)
     {
         std::unique_ptr<ReactionSimMatcher> matcher = std::make_unique<ReactionSimMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<SimilarityQueryData*>(query_data));
         return matcher;
@@ -120,6 +129,7 @@ std::unique_ptr<Matcher> ReactionIndex::createMatcher(const char* type, MatcherQ
     else if (strcmp(type, "exact") == 0)
     {
         std::unique_ptr<RxnExactMatcher> matcher = std::make_unique<RxnExactMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<ExactQueryData*>(query_data));
         return matcher;
@@ -139,6 +149,7 @@ std::unique_ptr<Matcher> ReactionIndex::createMatcherWithExtFP(const char* type,
     if (strcmp(type, "sim") == 0)
     {
         std::unique_ptr<ReactionSimMatcher> matcher = std::make_unique<ReactionSimMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryDataWithExtFP(dynamic_cast<SimilarityQueryData*>(query_data), fp);
         return matcher;
@@ -154,6 +165,7 @@ std::unique_ptr<Matcher> ReactionIndex::createMatcherTopN(const char* type, Matc
     if (strcmp(type, "sim") == 0)
     {
         std::unique_ptr<ReactionTopNSimMatcher> matcher = std::make_unique<ReactionTopNSimMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<SimilarityQueryData*>(query_data));
         matcher->setLimit(limit);
@@ -171,6 +183,7 @@ std::unique_ptr<Matcher> ReactionIndex::createMatcherTopNWithExtFP(const char* t
     if (strcmp(type, "sim") == 0)
     {
         std::unique_ptr<ReactionTopNSimMatcher> matcher = std::make_unique<ReactionTopNSimMatcher>(*this);
+        const auto storage_lock = matcher->lockStorages();
         matcher->setOptions(options);
         matcher->setQueryDataWithExtFP(dynamic_cast<SimilarityQueryData*>(query_data), fp);
         matcher->setLimit(limit);
@@ -0,0 +1,178 @@
+#include "bingo_insert_dispatcher.h"
+
+#include <iostream>
+
+#include "base_cpp/profiling.h"
+#include "base_cpp/scratch_arena.h"
+#include "bingo_internal.h"
+#include "indigo_molecule.h"
+#include "indigo_reaction.h"
+
+using namespace indigo;
+using namespace bingo;
+
+// Number of records processed by one worker at a time
+static const int RECORDS_PER_COMMAND = 64;
+
+void InsertCommand::clear()
+{
+    records.clear();
+}
+
+void InsertCommand::execute(OsCommandResult& result_)
+{
+    InsertCommandResult& result = (InsertCommandResult&)result_;
+
+    for (int i = 0; i < records.size(); i++)
+    {
+        IndigoObject& record = records[i];
+        try
+        {
+            profTimerStart(t, "bingo_insert.prepare");
+            ScratchScope scratch;
+            std::unique_ptr<ObjectIndexData> data;
+            if (index->getType() == IndexType::MOLECULE)
+            {
+                if (!IndigoMolecule::is(record))
+                    throw BingoException("bingoInsertIteratorObj: Only molecule objects can be added to molecule index");
+
+                // FIXME: MK: for some reason we need to aromatize input molecule. If we first clone and aromatize cloned, it won't work
+                record.getMolecule().aromatize(arom_options);
+                IndexMolecule ind_mol(record.getMolecule(), arom_options);
+                data = std::make_unique<ObjectIndexData>(index->prepareIndexData(ind_mol));
+            }
+            else
+            {
+                if (!IndigoReaction::is(record))
+                    throw BingoException("bingoInsertIteratorObj: Only reaction objects can be added to reaction index");
+
+                record.getReaction().aromatize(arom_options);
+                IndexReaction ind_rxn(record.getReaction(), arom_options);
+                data = std::make_unique<ObjectIndexData>(index->prepareIndexData(ind_rxn));
+            }
+            result.data.push_back(std::move(data));
+            result.errors.emplace_back();
+        }
+        catch (const Exception& e)
+        {
+            result.data.emplace_back();
+            result.errors.emplace_back(e.message());
+        }
+    }
+}
+
+void InsertCommandResult::clear()
+{
+    data.clear();
+    errors.clear();
+}
+
+InsertDispatcher::InsertDispatcher(BaseIndex& index, IndigoObject& iterator, const AromaticityOptions& arom_options)
+    : OsCommandDispatcher(HANDLING_ORDER_SERIAL, true), inserted(0), failed(0), _index(index), _iterator(iterator), _arom_options(arom_options),
+      _finished(false)
+{
+}
+
+void InsertDispatcher::insert(int thread_count)
+{
+    profTimerStart(t, "bingo_insert");
+    inserted = 0;
+    failed = 0;
+    _finished = false;
+
+    _pending.clear();
+
+    if (thread_count == 1)
+        run(0);
+    else if (thread_count <= 0)
+        run(-1);
+    else
+        run(thread_count);
+    _flush();
+
+    // Build the containers of the similarity cells right away after a bulk load
+    if (inserted >= _index.getSubStorage().getIncrementCapacity())
+        _index.optimize();
+
+    profIncCounter("bingo_insert.records", inserted);
+    profIncCounter("bingo_insert.failed", failed);
+}
+
+OsCommand* InsertDispatcher::_allocateCommand()
+{
+    return new InsertCommand();
+}
+
+OsCommandResult* InsertDispatcher::_allocateResult()
+{
+    return new InsertCommandResult();
+}
+
+bool InsertDispatcher::_setupCommand(OsCommand& cmd)
+{
+    if (_finished)
+        return false;
+
+    profTimerStart(t, "bingo_insert.read");
+    InsertCommand& command = (InsertCommand&)cmd;
+    command.index = &_index;
+    command.arom_options = _arom_options;
+
+    while (command.records.size() < RECORDS_PER_COMMAND)
+    {
+        try
+        {
+            std::unique_ptr<IndigoObject> record(_iterator.next());
+            if (record == nullptr)
+            {
+                _finished = true;
+                break;
+            }
+            command.records.add(std::move(record));
+        }
+        catch (const Exception& e)
+        {
+            std::cerr << e.message() << std::endl;
+            failed++;
+        }
+    }
+    return command.records.size() > 0;
+}
+
+void InsertDispatcher::_handleResult(OsCommandResult& res)
+{
+    profTimerStart(t, "bingo_insert.write");
+    InsertCommandResult& result = (InsertCommandResult&)res;
+
+    for (size_t i = 0; i < result.data.size(); i++)
+    {
+        if (result.data[i] == nullptr)
+        {
+            std::cerr << result.errors[i] << std::endl;
+            failed++;
+            continue;
+        }
+        _pending.push_back(std::move(result.data[i]));
+    }
+
+    // Records are written by whole fingerprint packs, so the substructure
+    // storage transposes them without copying to its increment
+    if ((int)_pending.size() >= _index.getSubStorage().getIncrementCapacity())
+        _flush();
+}
+
+void InsertDispatcher::_flush()
+{
+    if (_pending.empty())
+        return;
+
+    std::vector<const ObjectIndexData*> batch;
+    batch.reserve(_pending.size());
+    for (auto& data : _pending)
+        batch.push_back(data.get());
+
+    Array<int> ids;
+    _index.addBatch(batch, ids);
+    inserted += ids.size();
+    _pending.clear();
+}
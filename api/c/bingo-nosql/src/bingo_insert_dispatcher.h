@@ -0,0 +1,75 @@
+#ifndef __bingo_insert_dispatcher__
+#define __bingo_insert_dispatcher__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base_cpp/os_thread_wrapper.h"
+#include "molecule/molecule_arom.h"
+
+#include "bingo_base_index.h"
+
+namespace bingo
+{
+    // Pack of records taken from the iterator. Records are parsed lazily,
+    // so loading, fingerprinting and CMF encoding all happen in execute()
+    class InsertCommand : public indigo::OsCommand
+    {
+    public:
+        void execute(indigo::OsCommandResult& result) override;
+        void clear() override;
+
+        indigo::PtrArray<IndigoObject> records;
+
+        const BaseIndex* index;
+        indigo::AromaticityOptions arom_options;
+    };
+
+    class InsertCommandResult : public indigo::OsCommandResult
+    {
+    public:
+        void clear() override;
+
+        // Index data of every record of the command; nullptr if the record failed
+        std::vector<std::unique_ptr<ObjectIndexData>> data;
+        std::vector<std::string> errors;
+    };
+
+    // Pipelined bulk insert: worker threads prepare index data for packs of
+    // records while the calling thread appends them to the index in the
+    // iterator order, so record ids do not depend on the thread count.
+    // Records are written in batches of a whole fingerprint pack.
+    // Worker threads share the session of the caller to see its options.
+    class InsertDispatcher : public indigo::OsCommandDispatcher
+    {
+    public:
+        InsertDispatcher(BaseIndex& index, IndigoObject& iterator, const indigo::AromaticityOptions& arom_options);
+
+        // Thread count semantics follow bingonosql-sub-search-thread-count:
+        // 1 inserts on the calling thread, 0 or negative picks the count automatically
+        void insert(int thread_count);
+
+        int inserted;
+        int failed;
+
+    private:
+        indigo::OsCommand* _allocateCommand() override;
+        indigo::OsCommandResult* _allocateResult() override;
+
+        bool _setupCommand(indigo::OsCommand& command) override;
+        void _handleResult(indigo::OsCommandResult& result) override;
+
+        void _flush();
+
+        BaseIndex& _index;
+        IndigoObject& _iterator;
+        indigo::AromaticityOptions _arom_options;
+        bool _finished;
+
+        // Prepared records waiting to be written in one batch
+        std::vector<std::unique_ptr<ObjectIndexData>> _pending;
+    };
+}
+
+#endif // __bingo_insert_dispatcher__
@@ -38,6 +38,20 @@ namespace indigo
         }                                                                                                                                                      \
         bingo::MMFAllocator::setDatabaseId(db_id);
 
+// Used by the searches, which also run on the federated databases.
+// The federated matcher selects the allocators of the shards itself
+#define BINGO_BEGIN_SEARCH_DB(db_id)                                                                                                                           \
+    INDIGO_BEGIN                                                                                                                                               \
+    {                                                                                                                                                          \
+        {                                                                                                                                                      \
+            auto indexes = sf::slock_safe_ptr(_indexes());                                                                                                     \
+            auto federations = sf::slock_safe_ptr(_federations());                                                                                             \
+            if (indexes->has(db_id))                                                                                                                           \
+                bingo::MMFAllocator::setDatabaseId(db_id);                                                                                                     \
+            else if (federations->count(db_id) == 0)                                                                                                           \
+                throw BingoException("Incorrect database instance");                                                                                           \
+        }
+
 // Used when we don't need Indigo session, just handle errors
 #define BINGO_BEGIN_DB_STATIC(db_id)                                                                                                                           \
     INDIGO_BEGIN_STATIC                                                                                                                                        \
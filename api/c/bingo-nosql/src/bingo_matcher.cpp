@@ -27,6 +27,10 @@ using namespace bingo;
 static const char* _matcher_params_prop = "";
 static const char* _matcher_part_prop = "part";
 
+// Initial estimations of the substructure screening costs, refined during the search
+static const float _default_try_time = 5e-5f;
+static const float _default_screen_byte_time = 1e-9f;
+
 GrossQueryData::GrossQueryData(Array<char>& gross_str) : _obj(gross_str)
 {
 }
@@ -184,6 +188,11 @@ IndigoObject* BaseMatcher::currentObject()
     return _current_obj;
 }
 
+std::shared_lock<std::shared_mutex> BaseMatcher::lockStorages() const
+{
+    return _index.lockStorages();
+}
+
 const BaseIndex& BaseMatcher::getIndex()
 {
     return _index;
@@ -259,12 +268,17 @@ void BaseMatcher::setOptions(const char* options)
 }
 
 bool BaseMatcher::_isCurrentObjectExist()
+{
+    return _isObjectExist(_index, _current_id);
+}
+
+bool BaseMatcher::_isObjectExist(BaseIndex& index, int id)
 {
     int cf_len;
-    if (_index.useShortBuffer())
-        _index.getCfStorageShort().get(_current_id, cf_len);
+    if (index.useShortBuffer())
+        index.getCfStorageShort().get(id, cf_len);
     else
-        _index.getCfStorage().get(_current_id, cf_len);
+        index.getCfStorage().get(id, cf_len);
 
     if (cf_len == -1)
         return false;
@@ -274,24 +288,11 @@ bool BaseMatcher::_isCurrentObjectExist()
 
 void BaseMatcher::_loadObject(const char* cf_str, int cf_len, IndigoObject*& current_obj, bool is_old_db)
 {
-    BufferScanner buf_scn(cf_str, cf_len);
-
     if (IndigoMolecule::is(*current_obj))
-    {
-        Molecule& mol = current_obj->getMolecule();
-        if (is_old_db)
-        {
-            CmfLoader cmf_loader(buf_scn);
-            cmf_loader.loadMolecule(mol);
-        }
-        else
-        {
-            IcmLoader icm_loader(buf_scn);
-            icm_loader.loadMolecule(mol);
-        }
-    }
+        _loadMolecule(cf_str, cf_len, current_obj->getMolecule(), is_old_db);
     else if (IndigoReaction::is(*current_obj))
     {
+        BufferScanner buf_scn(cf_str, cf_len);
         Reaction& rxn = current_obj->getReaction();
 
         if (is_old_db)
@@ -309,6 +310,22 @@ void BaseMatcher::_loadObject(const char* cf_str, int cf_len, IndigoObject*& cur
         throw Exception("BaseMatcher::unknown current object type");
 }
 
+void BaseMatcher::_loadMolecule(const char* cf_str, int cf_len, Molecule& mol, bool is_old_db)
+{
+    BufferScanner buf_scn(cf_str, cf_len);
+
+    if (is_old_db)
+    {
+        CmfLoader cmf_loader(buf_scn);
+        cmf_loader.loadMolecule(mol);
+    }
+    else
+    {
+        IcmLoader icm_loader(buf_scn);
+        icm_loader.loadMolecule(mol);
+    }
+}
+
 bool BaseMatcher::_loadCurrentObject(BaseIndex& index, int current_id, IndigoObject*& current_obj)
 {
     try
@@ -335,6 +352,34 @@ bool BaseMatcher::_loadCurrentObject(BaseIndex& index, int current_id, IndigoObj
     }
 }
 
+Molecule* BaseMatcher::_leaseCurrentMolecule(BaseIndex& index, int current_id, DecodedCache::Lease& lease)
+{
+    try
+    {
+        int cf_len;
+        const char* cf_str =
+            index.useShortBuffer() ? (const char*)index.getCfStorageShort().get(current_id, cf_len) : (const char*)index.getCfStorage().get(current_id, cf_len);
+
+        if (cf_len == -1)
+            return nullptr;
+
+        DecodedCache& cache = *index.getDecodedCache();
+        if (!cache.get(current_id, lease))
+        {
+            auto mol = std::make_unique<Molecule>();
+            _loadMolecule(cf_str, cf_len, *mol, index.isOldDB());
+            cache.put(current_id, std::move(mol), lease);
+        }
+        return lease.molecule();
+    }
+    catch (Exception& ex)
+    {
+        const int db_id = index.getIdMapping()[current_id];
+        ex.appendMessage(" on id=%d", db_id);
+        throw;
+    }
+}
+
 int BaseMatcher::esimateRemainingResultsCount(int& delta)
 {
     _match_probability_esimate.setCount(_current_id + 1);
@@ -369,186 +414,24 @@ void errorHandler(const char* message, void*)
     throw Exception(message);
 }
 
-void threadFunc(BaseSubstructureMatcher* matcher)
-{
-#ifndef USE_SAFE_PTR
-    std::mutex& input_mtx = matcher->_input_mtx;
-    std::condition_variable& cv_input = matcher->_cv_input;
-    std::mutex& results_mtx = matcher->_results_mtx;
-    std::condition_variable& cv_results = matcher->_cv_results;
-#endif
-    auto& input_data = matcher->_input_data;
-    std::atomic_bool& all_data_in_queue = matcher->_all_data_in_queue;
-
-    auto& results = matcher->_results;
-    std::atomic_bool& finished_processing = matcher->_finished_processing;
-    std::atomic_bool& stop_request = matcher->_stop_request;
-
-    int matched = 0;
-    int db_object_idx = -1;
-    bool match = false;
-    std::unique_ptr<IndigoObject> molecule_obj;
-    MMFAllocator::setDatabaseId(matcher->getDbId());
-    std::vector<int> input_chunk;
-    std::vector<int> results_chunk;
-
-    input_chunk.reserve(THREAD_INPUT_CHUNK_SIZE);
-    results_chunk.reserve(THREAD_INPUT_CHUNK_SIZE / 8);
-
-    if (!indigoSelf().hasLocalCopy())
-    {
-        qword _session = indigoAllocSessionId();
-        Indigo& indigo = indigoSelf().createOrGetLocalCopy(_session);
-        indigo.arom_options = matcher->_arom_options;
-        for (int i = 0; i < matcher->_tautomer_rules->size(); i++)
-        {
-            auto t_rule = matcher->_tautomer_rules->getPtr(i);
-            if (t_rule == nullptr)
-                continue;
-            auto rule = std::make_unique<TautomerRule>();
-            rule->list1.copy(t_rule->list1);
-            rule->list2.copy(t_rule->list2);
-            rule->aromaticity1 = t_rule->aromaticity1;
-            rule->aromaticity2 = t_rule->aromaticity2;
-            indigo.tautomer_rules.expand(i + 1);
-            indigo.tautomer_rules.reset(i, rule.release());
-        }
-    }
-
-    while (!stop_request)
-    {
-        { // read idx
-#ifdef USE_SAFE_PTR
-            while (input_data->empty() && !all_data_in_queue)
-                std::this_thread::sleep_for(std::chrono::microseconds(1));
-            if (input_data->empty())
-                break;
-            std::lock_guard<decltype(input_data)> lock(input_data);
-            for (int i = 0; i < THREAD_INPUT_CHUNK_SIZE && input_data->size() > 0; i++)
-            {
-                input_chunk.push_back(input_data->front());
-                input_data->pop_front();
-            }
-#else
-            std::unique_lock<std::mutex> lock(input_mtx);
-            cv_input.wait(lock, [&input_data, &all_data_in_queue]() { return !input_data.empty() || all_data_in_queue; });
-            if (input_data.empty())
-                // std::this_thread::yield();
-                std::this_thread::sleep_for(std::chrono::microseconds(1));
-            if (input_data.empty())
-                break;
-            for (int i = 0; i < THREAD_INPUT_CHUNK_SIZE && input_data.size() > 0; i++)
-            {
-                input_chunk.push_back(input_data.front());
-                input_data.pop_front();
-            }
-#endif
-        }
-        molecule_obj.reset(matcher->allocateObject());
-        for (int i = 0; i < input_chunk.size(); i++)
-        {
-            if (stop_request)
-                return;
-            db_object_idx = input_chunk[i];
-            match = matcher->tryCurrent(db_object_idx, molecule_obj.get());
-            if (match)
-            {
-                results_chunk.emplace_back(db_object_idx);
-            }
-        }
-        input_chunk.clear();
-        { // write result
-#ifdef USE_SAFE_PTR
-            if (results_chunk.size() > 0)
-            {
-                std::lock_guard<decltype(results)> lock(results);
-                for (int i = 0; i < results_chunk.size(); i++)
-                {
-                    results->push_back(results_chunk[i]);
-                }
-                results_chunk.clear();
-            }
-            else // no data - add empty result
-            {
-                results->push_back(-1);
-            }
-#else
-            std::lock_guard<std::mutex> locker(results_mtx);
-            if (results_chunk.size() > 0)
-            {
-                for (int i = 0; i < results_chunk.size(); i++)
-                {
-                    results.push_back(results_chunk[i]);
-                }
-                results_chunk.clear();
-            }
-            else // no data - add empty result
-            {
-                results.push_back(-1);
-            }
-            cv_results.notify_one();
-#endif
-        }
-    }
-}
-
-void run_threads(BaseSubstructureMatcher* matcher, int count)
-{
-    std::deque<std::thread> threads;
-    if (count < 0)
-        count = 3 * std::thread::hardware_concurrency() / 2 + 1;
-    for (int i = 0; i < count; i++)
-        threads.emplace_back(threadFunc, matcher);
-    while (threads.size() > 0)
-    {
-        threads.front().join();
-        threads.pop_front();
-    }
-#ifdef USE_SAFE_PTR
-    matcher->_finished_processing = true;
-#else
-    std::lock_guard<std::mutex> locker(matcher->_results_mtx);
-    matcher->_finished_processing = true;
-    matcher->_cv_results.notify_one();
-#endif
-}
-
 BaseSubstructureMatcher::BaseSubstructureMatcher(/*const */ BaseIndex& index, IndigoObject*& current_obj)
-    : BaseMatcher(index, current_obj), _fp_storage(_index.getSubStorage()), _tautomer(false), _input_data(MAX_INPUT_QUEUE_SIZE),
-      _results(MAX_INPUT_QUEUE_SIZE * 3)
+    : BaseMatcher(index, current_obj), _fp_storage(_index.getSubStorage()), _tautomer(false)
 {
     _fp_size = _index.getFingerprintParams().fingerprintSize();
 
     _current_id = -1;
     _current_cand_id = -1;
     _current_pack = -1;
-    _final_pack = _fp_storage.getPackCount() + 1;
+    _snapshot = _index.getSnapshot();
+    _final_pack = _snapshot->pack_count + 1;
 
     _cand_count = 0;
+    _try_time_estimate = _default_try_time;
 }
 
 BaseSubstructureMatcher::~BaseSubstructureMatcher()
 {
-    if (_t.has_value())
-    {
-        _stop_request = true;
-        {
-#ifdef USE_SAFE_PTR
-            _input_data->empty();
-            _all_data_in_queue = true;
-#else
-            std::lock_guard<std::mutex> lock(_input_mtx);
-            _input_data.empty();
-            _all_data_in_queue = true;
-            _cv_input.notify_all();
-#endif
-        }
-        while (!_finished_processing)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-        _t->join();
-    }
+    _stopWorkers();
 }
 
 bool BaseSubstructureMatcher::_find_candidates()
@@ -557,7 +440,7 @@ bool BaseSubstructureMatcher::_find_candidates()
     _current_pack++;
     if (_current_pack < _final_pack)
     {
-        _findPackCandidates(_current_pack);
+        _findPackCandidates(_current_pack, _candidates);
         _cand_count += _candidates.size();
     }
     else // no more candidates
@@ -572,195 +455,334 @@ bool BaseSubstructureMatcher::_find_candidates()
 
 bool BaseSubstructureMatcher::next()
 {
-    // int fp_size_in_bits = _fp_size * 8;
-    // static int sub_cnt = 0;
+    if (_multithread)
+        return _nextParallel();
 
-    if (!_multithread || !_t.has_value())
-        _current_cand_id++;
+    _current_cand_id++;
 
-    if (_multithread)
+    while (!((_current_pack == _final_pack) && (_current_cand_id == _candidates.size())))
     {
-        if (!_t.has_value()) // first call
+        profTimerStart(tsingle, "sub_single");
+
+        if (_current_cand_id == _candidates.size())
         {
-            Indigo& indigo = indigoGetInstance();
-            _arom_options = indigo.arom_options;
-            _tautomer_rules = &indigo.tautomer_rules;
-            _t.emplace(run_threads, this, _thread_count);
-// #def CHECK_CF_SIZE
-#ifdef CHECK_CF_SIZE
-            {
-                int cf_len;
-                const char* cf_str;
-                int total_len = 0;
-                int max_len = 0;
-                int count = 0;
-                auto start = std::chrono::high_resolution_clock::now();
-
-                std::vector<char> buffer(8192);                 // 8kb initial buffer
-                std::vector<std::pair<size_t, size_t>> offsets; // vector of pair<buffer_offset, cf_size>
-                size_t buffer_offset = 0;
-
-                for (int id = 0; id < _index.getIdMapping().size(); id++)
-                {
-                    cf_str =
-                        _index.useShortBuffer() ? (const char*)_index.getCfStorageShort().get(id, cf_len) : (const char*)_index.getCfStorage().get(id, cf_len);
-                    total_len += cf_len;
-                    max_len = std::max(max_len, cf_len);
-                    count++;
+            if (_find_candidates())
+                break;
+        }
 
-                    // Ensure buffer has enough space
-                    if (buffer_offset + cf_len > buffer.size())
-                    {
-                        buffer.resize(buffer.size() * 2);
-                    }
+        if (_candidates.size() == 0)
+        {
+            continue;
+        }
 
-                    // Copy cf_len bytes from cf_str to end of buffer
-                    std::memcpy(buffer.data() + buffer_offset, cf_str, cf_len);
+        _current_id = _candidates[_current_cand_id];
 
-                    // Store offset and size in vector
-                    offsets.emplace_back(buffer_offset, cf_len);
+        profTimerStart(tt, "sub_try");
+        auto start = std::chrono::steady_clock::now();
+        bool status = false;
+        status = tryCurrent(_current_id, _current_obj);
+        _updateTryTimeEstimate(std::chrono::steady_clock::now() - start, 1);
+        profTimerStop(tt);
 
-                    buffer_offset += cf_len;
-                }
-                auto end = std::chrono::high_resolution_clock::now();
-                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-                printf("\n---\ncount=%d total_len=%d max_len=%d in %zdms\n", count, total_len, max_len, duration.count());
-            }
-#endif
+        if (status)
+            profIncCounter("sub_found", 1);
+
+        _match_probability_esimate.addValue((float)status);
+        _match_time_esimate.addValue(profTimerGetTimeSec(tsingle));
+
+        if (status)
+        {
+            sub_cnt++;
+            return true;
         }
+        _current_cand_id++;
+    }
+
+    profIncCounter("sub_count_cand", _cand_count);
+    return false;
+}
+
+bool BaseSubstructureMatcher::_nextParallel()
+{
+    if (!_workers_started)
+        _startWorkers();
+
+    if (_current_obj == nullptr)
+        throw Exception("BaseMatcher: Matcher's current object was destroyed");
 
-        profTimerStart(tsingle_m, "sub_single");
-        while (true)
+    profTimerStart(tsingle, "sub_single");
+
+    int result = -1;
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        while (result < 0)
         {
-            if ((_current_cand_id == _candidates.size()) && !_all_data_in_queue)
+            if (_worker_error)
+                std::rethrow_exception(_worker_error);
+
+            if (_ordered)
             {
-                if (_find_candidates())
+                if (_emit_pos < _emit_buf.size())
                 {
-                    _all_data_in_queue = true;
-#ifndef USE_SAFE_PTR
-                    _cv_input.notify_all();
-#endif
+                    result = _emit_buf[_emit_pos++];
+                    continue;
                 }
-            }
-            int rsize = 0;
-            {
-#ifdef USE_SAFE_PTR
-                rsize = _results->size();
-#else
-                std::lock_guard<std::mutex> rlock(_results_mtx);
-                rsize = _results.size();
-#endif
-            }
-            if (!_all_data_in_queue && rsize < MAX_INPUT_QUEUE_SIZE)
-            {
-                // input queue not full - add candidates
-#ifdef USE_SAFE_PTR
-                std::lock_guard<decltype(_input_data)> lock(_input_data);
-                while (_input_data->size() < MAX_INPUT_QUEUE_SIZE && _current_cand_id < _candidates.size())
+                if (_emit_pack >= _final_pack)
+                    break;
+
+                auto pack_it = _pack_chunks_count.find(_emit_pack);
+                if (pack_it != _pack_chunks_count.end() && pack_it->second == _emit_chunk)
                 {
-                    _input_data->push_back(_candidates[_current_cand_id++]);
+                    // The whole pack has been returned, let workers screen the next one
+                    _pack_chunks_count.erase(pack_it);
+                    _emit_pack++;
+                    _emit_chunk = 0;
+                    _cv_work.notify_all();
+                    continue;
                 }
-#else
-                std::lock_guard<std::mutex> lock(_input_mtx);
-                while (_input_data.size() < MAX_INPUT_QUEUE_SIZE && _current_cand_id < _candidates.size())
+
+                auto chunk_it = _done_chunks.find(std::make_pair(_emit_pack, _emit_chunk));
+                if (chunk_it != _done_chunks.end())
                 {
-                    _input_data.push_back(_candidates[_current_cand_id++]);
-                    _cv_input.notify_one();
-                }
-#endif
-                if (_current_cand_id >= _candidates.size()) // need more candidates
+                    _emit_buf.swap(chunk_it->second);
+                    _emit_pos = 0;
+                    _emit_chunk++;
+                    _done_chunks.erase(chunk_it);
                     continue;
+                }
             }
-
-            // wait for results
-            bool status = false;
-#ifdef USE_SAFE_PTR
-            while (_results->empty() && !_finished_processing)
-                // std::this_thread::yield();
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            if (!_results->empty())
-#else
-            std::unique_lock<std::mutex> lock(_results_mtx);
-            _cv_results.wait(lock, [this]() { return !_results.empty() || _finished_processing; });
-            if (!_results.empty())
-#endif
+            else
             {
+                if (!_results.empty())
                 {
-                    if (_current_obj == nullptr)
-                        throw Exception("BaseMatcher: Matcher's current object was destroyed");
-#ifdef USE_SAFE_PTR
-                    std::lock_guard<decltype(_results)> lock(_results);
-                    auto result = _results->front();
-                    _results->pop_front();
-#else
-                    auto result = _results.front();
+                    result = _results.front();
                     _results.pop_front();
-#endif
-                    if (result < 0)
-                        continue;
-                    _current_id = result;
+                    _cv_work.notify_one();
+                    continue;
                 }
-                _loadCurrentObject(_index, _current_id, _current_obj);
-                status = true;
+                if (_active_workers == 0)
+                    break;
             }
-            else if (_finished_processing)
-                break;
-            if (status)
-                profIncCounter("sub_found", 1);
 
-            _match_probability_esimate.addValue((float)status);
-            _match_time_esimate.addValue(profTimerGetTimeSec(tsingle_m));
-
-            if (status)
+            // The caller holds the storage lock, so it verifies a chunk rather than
+            // waiting for the workers, which may be held off by a queued writer
+            if (!_work_chunks.empty())
             {
-                sub_cnt++;
-                return true;
+                SubSearchChunk chunk = std::move(_work_chunks.front());
+                _work_chunks.pop_front();
+                lock.unlock();
+                _verifyChunk(chunk, _current_obj);
+                lock.lock();
+
+                _addVerifiedChunk(chunk);
+                continue;
             }
+
+            _cv_results.wait(lock);
         }
-        _t->join();
-        _t.reset();
     }
+
+    if (result < 0)
+    {
+        _stopWorkers();
+        profIncCounter("sub_count_cand", _cand_count);
+        return false;
+    }
+
+    _current_id = result;
+    _loadCurrentObject(_index, _current_id, _current_obj);
+
+    profIncCounter("sub_found", 1);
+    _match_probability_esimate.addValue(1.f);
+    _match_time_esimate.addValue(profTimerGetTimeSec(tsingle));
+    sub_cnt++;
+    return true;
+}
+
+void BaseSubstructureMatcher::_startWorkers()
+{
+    Indigo& indigo = indigoGetInstance();
+    _arom_options = indigo.arom_options;
+    _tautomer_rules = &indigo.tautomer_rules;
+
+    _workers_started = true;
+    _next_pack = _current_pack + 1;
+    _emit_pack = _next_pack;
+    if (_next_pack >= _final_pack)
+        return;
+
+    int count = _thread_count;
+    if (count <= 0)
+        count = 3 * std::thread::hardware_concurrency() / 2 + 1;
+    // There is no point in having more workers than packs to screen and chunks to verify
+    int pack_count = _final_pack - _next_pack;
+    count = std::max(1, std::min(count, pack_count * (_fp_storage.getBlockSize() * 8 / THREAD_INPUT_CHUNK_SIZE)));
+
+    _workers_count = count;
+    _active_workers = count;
+    for (int i = 0; i < count; i++)
+        _workers.emplace_back(&BaseSubstructureMatcher::_workerLoop, this);
+}
+
+void BaseSubstructureMatcher::_stopWorkers()
+{
+    if (_workers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop_request = true;
+        _cv_work.notify_all();
+    }
+    for (auto& worker : _workers)
+        worker.join();
+    _workers.clear();
+}
+
+bool BaseSubstructureMatcher::_canScreenNextPack() const
+{
+    if (_next_pack >= _final_pack)
+        return false;
+    // Limit the amount of work done ahead of the consumer in case the search is abandoned
+    if (_ordered)
+        return _next_pack - _emit_pack < 2 * _workers_count;
+    return (int)_work_chunks.size() < _workers_count && _results.size() < (size_t)MAX_INPUT_QUEUE_SIZE;
+}
+
+void BaseSubstructureMatcher::_verifyChunk(SubSearchChunk& chunk, IndigoObject* obj)
+{
+    profTimerStart(tt, "sub_try");
+    auto start = std::chrono::steady_clock::now();
+    size_t tried = 0, matched = 0;
+    for (; tried < chunk.ids.size(); tried++)
+    {
+        if (_stop_request)
+            break;
+        if (tryCurrent(chunk.ids[tried], obj))
+            chunk.ids[matched++] = chunk.ids[tried];
+    }
+    _updateTryTimeEstimate(std::chrono::steady_clock::now() - start, tried);
+    chunk.ids.resize(matched);
+}
+
+void BaseSubstructureMatcher::_addVerifiedChunk(SubSearchChunk& chunk)
+{
+    if (_ordered)
+        _done_chunks.emplace(std::make_pair(chunk.pack, chunk.seq), std::move(chunk.ids));
     else
+        _results.insert(_results.end(), chunk.ids.begin(), chunk.ids.end());
+    _cv_results.notify_one();
+}
+
+void BaseSubstructureMatcher::_updateTryTimeEstimate(std::chrono::duration<float> elapsed, size_t tried)
+{
+    if (tried == 0)
+        return;
+    // Exponential moving average; concurrent updates may be lost, it is only an estimate
+    float estimate = _try_time_estimate;
+    _try_time_estimate = 0.9f * estimate + 0.1f * elapsed.count() / tried;
+}
+
+void BaseSubstructureMatcher::_workerLoop()
+{
+    // Every worker runs in its own session that inherits the options affecting matching
+    qword session = indigoAllocSessionId();
+    Indigo& indigo = indigoGetInstance();
+    indigo.arom_options = _arom_options;
+    for (int i = 0; i < _tautomer_rules->size(); i++)
     {
-        while (!((_current_pack == _final_pack) && (_current_cand_id == _candidates.size())))
-        {
-            profTimerStart(tsingle, "sub_single");
+        auto t_rule = _tautomer_rules->getPtr(i);
+        if (t_rule == nullptr)
+            continue;
+        auto rule = std::make_unique<TautomerRule>();
+        rule->list1.copy(t_rule->list1);
+        rule->list2.copy(t_rule->list2);
+        rule->aromaticity1 = t_rule->aromaticity1;
+        rule->aromaticity2 = t_rule->aromaticity2;
+        indigo.tautomer_rules.expand(i + 1);
+        indigo.tautomer_rules.reset(i, std::move(rule));
+    }
+    MMFAllocator::setDatabaseId(getDbId());
 
-            if (_current_cand_id == _candidates.size())
+    std::unique_ptr<IndigoObject> obj(allocateObject());
+    Array<int> candidates;
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    try
+    {
+        while (!_stop_request)
+        {
+            if (!_work_chunks.empty())
             {
-                if (_find_candidates())
-                    break;
+                // Records are read under the storage lock. If a writer holds it or waits for it,
+                // the caller of next() verifies the chunks itself, so the worker only backs off
+                auto storage_lock = _index.tryLockStorages();
+                if (!storage_lock.owns_lock())
+                {
+                    _cv_work.wait_for(lock, std::chrono::milliseconds(1));
+                    continue;
+                }
+
+                SubSearchChunk chunk = std::move(_work_chunks.front());
+                _work_chunks.pop_front();
+                lock.unlock();
+                _verifyChunk(chunk, obj.get());
+                storage_lock.unlock();
+                lock.lock();
+
+                _addVerifiedChunk(chunk);
+                continue;
             }
 
-            if (_candidates.size() == 0)
+            if (_canScreenNextPack())
             {
+                int pack = _next_pack++;
+                _screening_count++;
+                lock.unlock();
+                _findPackCandidates(pack, candidates);
+                lock.lock();
+                _screening_count--;
+                _cand_count += candidates.size();
+
+                int seq = 0;
+                for (int i = 0; i < candidates.size(); i += THREAD_INPUT_CHUNK_SIZE, seq++)
+                {
+                    int end = std::min(candidates.size(), i + THREAD_INPUT_CHUNK_SIZE);
+                    _work_chunks.push_back(SubSearchChunk{pack, seq, std::vector<int>(candidates.ptr() + i, candidates.ptr() + end)});
+                }
+                _pack_chunks_count[pack] = seq;
+                _cv_work.notify_all();
+                _cv_results.notify_one();
                 continue;
             }
 
-            _current_id = _candidates[_current_cand_id];
-
-            profTimerStart(tt, "sub_try");
-            bool status = false;
-            status = tryCurrent(_current_id, _current_obj);
-            profTimerStop(tt);
-
-            if (status)
-                profIncCounter("sub_found", 1);
-
-            _match_probability_esimate.addValue((float)status);
-            _match_time_esimate.addValue(profTimerGetTimeSec(tsingle));
+            if (_next_pack >= _final_pack && _screening_count == 0)
+                break;
 
-            if (status)
-            {
-                sub_cnt++;
-                return true;
-            }
-            _current_cand_id++;
+            _cv_work.wait(lock);
         }
     }
+    catch (...)
+    {
+        if (!lock.owns_lock())
+            lock.lock();
+        if (!_worker_error)
+            _worker_error = std::current_exception();
+        _stop_request = true;
+        _cv_work.notify_all();
+    }
 
-    profIncCounter("sub_count_cand", _cand_count);
-    return false;
+    _active_workers--;
+    _cv_results.notify_one();
+    lock.unlock();
+
+    obj.reset();
+    indigoReleaseSessionId(session);
+}
+
+std::shared_lock<std::shared_mutex> BaseSubstructureMatcher::lockStorages() const
+{
+    return _index.lockStorages();
 }
 
 int BaseSubstructureMatcher::getDbId() const
@@ -772,15 +794,9 @@ void BaseSubstructureMatcher::setQueryData(SubstructureQueryData* query_data)
 {
     auto& indigo = indigoGetInstance();
 
-    if (indigo.bingonosql_tau_sub_search_thread_count == 1)
-    {
-        _multithread = false;
-    }
-    else
-    {
-        _multithread = true;
-        _thread_count = indigo.bingonosql_tau_sub_search_thread_count;
-    }
+    _multithread = indigo.bingonosql_sub_search_thread_count != 1;
+    _thread_count = indigo.bingonosql_sub_search_thread_count;
+    _ordered = indigo.bingonosql_sub_search_ordered;
     _query_data.reset(query_data);
 
     const MoleculeFingerprintParameters& fp_params = _index.getFingerprintParams();
@@ -805,25 +821,25 @@ void BaseSubstructureMatcher::setQueryData(SubstructureQueryData* query_data)
               [&](int i1, int i2) { return fp_bit_usage[i1] < fp_bit_usage[i2]; });
 }
 
-void BaseSubstructureMatcher::_findPackCandidates(int pack_idx)
+void BaseSubstructureMatcher::_findPackCandidates(int pack_idx, Array<int>& candidates)
 {
-    if (pack_idx == _fp_storage.getPackCount())
+    if (pack_idx == _snapshot->pack_count)
     {
-        _findIncCandidates();
+        _findIncCandidates(candidates);
         return;
     }
 
     profTimerStart(t, "sub_find_cand_pack");
 
-    _candidates.clear();
+    candidates.clear();
 
     TranspFpStorage& fp_storage = _index.getSubStorage();
-
-    // const byte *query_fp = _query_fp.ptr();
+    MMFArray<int>& fp_bit_usage = fp_storage.getFpBitUsageCounts();
 
     const byte* block;
 
     int fp_size_in_bits = _fp_size * 8;
+    int pack_capacity = fp_storage.getBlockSize() * 8;
 
     Array<byte> fit_bits;
     fit_bits.clear_resize(fp_storage.getBlockSize());
@@ -832,52 +848,84 @@ void BaseSubstructureMatcher::_findPackCandidates(int pack_idx)
     profTimerStart(tgs, "sub_find_cand_pack_get_search");
     int left = 0, right = fp_storage.getBlockSize() - 1;
 
-    // Filter only based on the first 10 bits
-    // TODO: collect time infromation about the reading and matching measurements and
-    // and balance between reading new block or check filtered items without reading new block
-    for (int i = 0; i < _query_fp_bits_used.size() && i < 15; i++)
+    // Columns are read starting from the rarest bits. Reading the next one is worth it
+    // while the verification time it is expected to save exceeds the time to read it.
+    // The next column is expected to pass not less than the previous one has passed
+    // because the bits are correlated and sorted by the usage.
+    float try_time = _try_time_estimate;
+    float byte_time = _default_screen_byte_time;
+    int survivors = pack_capacity;
+    float pass_rate = 0;
+    int columns_read = 0;
+
+    for (int i = 0; i < _query_fp_bits_used.size(); i++)
     {
         int j = _query_fp_bits_used[i];
 
+        float expected_pass_rate = std::max(pass_rate, std::min(1.f, (float)fp_bit_usage[j] / pack_capacity));
+        float saved_time = survivors * (1 - expected_pass_rate) * try_time;
+        if (saved_time <= (right - left + 1) * byte_time)
+            break;
+
+        auto start = std::chrono::steady_clock::now();
+
         profTimerStart(tgb, "sub_find_cand_pack_get_block");
         block = fp_storage.getBlock(pack_idx * fp_size_in_bits + j);
         profTimerStop(tgb);
 
         profTimerStart(tgu, "sub_find_cand_pack_fit_update");
         bitAnd(fit_bits.ptr() + left, &block[0] + left, right - left + 1);
+        int new_survivors = bitGetOnesCount(fit_bits.ptr() + left, right - left + 1);
+        profTimerStop(tgu);
 
-        while (left <= right && fit_bits[left] == 0)
-            left++;
-        while (left <= right && fit_bits[right] == 0)
-            right--;
+        std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+        byte_time = elapsed.count() / (right - left + 1);
+        pass_rate = (float)new_survivors / survivors;
+        survivors = new_survivors;
+        columns_read++;
 
-        if (left > right)
+        if (survivors == 0)
             // Not more results
             break;
 
-        profTimerStop(tgu);
+        while (fit_bits[left] == 0)
+            left++;
+        while (fit_bits[right] == 0)
+            right--;
     }
     profTimerStop(tgs);
+    profIncCounter("sub_find_cand_pack_columns", columns_read);
 
-    for (int k = 0; k < 8 * fp_storage.getBlockSize(); k++)
-        if (bitGetBit(fit_bits.ptr(), k))
-            _candidates.push(k + pack_idx * fp_storage.getBlockSize() * 8);
+    if (survivors == 0)
+        return;
+
+    candidates.reserve(survivors);
+    int pack_offset = pack_idx * pack_capacity;
+    for (int k = left; k <= right; k++)
+    {
+        byte word = fit_bits[k];
+        while (word != 0)
+        {
+            candidates.push(pack_offset + k * 8 + bitGetOneLOIndex(word));
+            word &= word - 1;
+        }
+    }
 }
 
-void BaseSubstructureMatcher::_findIncCandidates()
+void BaseSubstructureMatcher::_findIncCandidates(Array<int>& candidates)
 {
     // profTimerStart(t, "sub_find_cand_inc");
-    _candidates.clear();
+    candidates.clear();
 
     const TranspFpStorage& fp_storage = _index.getSubStorage();
 
-    int inc_block_id_offset = fp_storage.getPackCount() * fp_storage.getBlockSize() * 8;
-    const byte* inc = fp_storage.getIncrement();
-    for (int i = 0; i < fp_storage.getIncrementSize(); i++)
+    int inc_block_id_offset = _snapshot->pack_count * fp_storage.getBlockSize() * 8;
+    const byte* inc = _snapshot->sub_increment;
+    for (int i = 0; i < _snapshot->sub_increment_size; i++)
     {
         const byte* fp = inc + i * _fp_size;
         if (bitTestOnes(_query_fp.ptr(), fp, _fp_size))
-            _candidates.push(i + inc_block_id_offset);
+            candidates.push(i + inc_block_id_offset);
     }
 }
 
@@ -891,7 +939,7 @@ void BaseSubstructureMatcher::_setParameters(const char* parameters)
 
 void BaseSubstructureMatcher::_initPartition()
 {
-    int pack_count_with_inc = _fp_storage.getPackCount() + 1;
+    int pack_count_with_inc = _snapshot->pack_count + 1;
 
     if (_part_count > pack_count_with_inc)
     {
@@ -919,6 +967,11 @@ MoleculeSubMatcher::MoleculeSubMatcher(/*const */ BaseIndex& index)
     _mapping.clear();
 }
 
+MoleculeSubMatcher::~MoleculeSubMatcher()
+{
+    _stopWorkers();
+}
+
 IndigoObject* MoleculeSubMatcher::allocateObject()
 {
     return new IndigoMolecule();
@@ -929,22 +982,51 @@ const Array<int>& MoleculeSubMatcher::currentMapping()
     return _mapping;
 }
 
-bool MoleculeSubMatcher::tryCurrent(int current_id, IndigoObject* current_obj) // const
-{
-    if (!_loadCurrentObject(_index, current_id, current_obj))
+void MoleculeSubMatcher::setQueryData(SubstructureQueryData* query_data)
+{
+    BaseSubstructureMatcher::setQueryData(query_data);
+
+    SubstructureMoleculeQuery& query = (SubstructureMoleculeQuery&)(_query_data->getQueryObject());
+    _compiled_query.compileReordered((QueryMolecule&)(query.getMolecule()));
+    _unfold_target_h = MoleculeSubstructureMatcher::shouldUnfoldTargetHydrogens((QueryMolecule&)(query.getMolecule()), false);
+}
+
+bool MoleculeSubMatcher::tryCurrent(int current_id, IndigoObject* current_obj) // const
+{
+    // Tautomer search and unfolded hydrogens change the target, the cached one must stay intact
+    if (_index.getDecodedCache() == nullptr || _tautomer || _unfold_target_h)
+    {
+        if (!_loadCurrentObject(_index, current_id, current_obj))
+            return false;
+        return tryObject(current_obj);
+    }
+
+    if (current_obj == 0)
+        throw Exception("MoleculeSubMatcher: Matcher's current object was destroyed");
+
+    DecodedCache::Lease lease;
+    Molecule* target_mol = _leaseCurrentMolecule(_index, current_id, lease);
+    if (target_mol == nullptr || !_tryMolecule(*target_mol, current_obj == _current_obj))
         return false;
-    return tryObject(current_obj);
+
+    // The object of the cursor is filled for the hits only
+    if (current_obj == _current_obj)
+        _loadCurrentObject(_index, current_id, current_obj);
+    return true;
 }
 
 bool MoleculeSubMatcher::tryObject(IndigoObject* current_obj)
 {
-    SubstructureMoleculeQuery& query = (SubstructureMoleculeQuery&)(_query_data->getQueryObject());
-    QueryMolecule& query_mol = (QueryMolecule&)(query.getMolecule());
-
     if (current_obj == 0)
         throw Exception("MoleculeSubMatcher: Matcher's current object was destroyed");
 
-    Molecule& target_mol = current_obj->getMolecule();
+    return _tryMolecule(current_obj->getMolecule(), current_obj == _current_obj);
+}
+
+bool MoleculeSubMatcher::_tryMolecule(Molecule& target_mol, bool save_mapping)
+{
+    SubstructureMoleculeQuery& query = (SubstructureMoleculeQuery&)(_query_data->getQueryObject());
+    QueryMolecule& query_mol = (QueryMolecule&)(query.getMolecule());
 
     if (_tautomer)
     {
@@ -966,7 +1048,7 @@ bool MoleculeSubMatcher::tryObject(IndigoObject* current_obj)
         // profTimerStart(tr_m, "sub_try_matching");
         MoleculeSubstructureMatcher msm(target_mol);
 
-        msm.setQuery(query_mol);
+        msm.setQuery(_compiled_query);
 
         bool find_res = msm.find();
 
@@ -974,7 +1056,16 @@ bool MoleculeSubMatcher::tryObject(IndigoObject* current_obj)
 
         if (find_res)
         {
-            _mapping.copy(msm.getTargetMapping(), target_mol.vertexCount());
+            // Worker threads verify their own objects; the mapping is kept for the cursor object only
+            if (save_mapping)
+            {
+                _mapping.copy(msm.getTargetMapping(), target_mol.vertexCount());
+                for (int i = 0; i < _mapping.size(); i++)
+                {
+                    if (_mapping[i] >= 0)
+                        _mapping[i] = _compiled_query.sourceAtom(_mapping[i]);
+                }
+            }
             return true;
         }
     }
@@ -989,6 +1080,11 @@ ReactionSubMatcher::ReactionSubMatcher(/*const */ BaseIndex& index)
     _mapping.clear();
 }
 
+ReactionSubMatcher::~ReactionSubMatcher()
+{
+    _stopWorkers();
+}
+
 IndigoObject* ReactionSubMatcher::allocateObject()
 {
     return new IndigoReaction();
@@ -1011,10 +1107,10 @@ bool ReactionSubMatcher::tryObject(IndigoObject* current_obj)
     SubstructureReactionQuery& query = (SubstructureReactionQuery&)_query_data->getQueryObject();
     QueryReaction& query_rxn = (QueryReaction&)(query.getReaction());
 
-    if (_current_obj == 0)
+    if (current_obj == 0)
         throw Exception("ReactionSubMatcher: Matcher's current object was destroyed");
 
-    Reaction& target_rxn = _current_obj->getReaction();
+    Reaction& target_rxn = current_obj->getReaction();
 
     ReactionSubstructureMatcher rsm(target_rxn);
 
@@ -1022,6 +1118,9 @@ bool ReactionSubMatcher::tryObject(IndigoObject* current_obj)
 
     if (rsm.find())
     {
+        if (current_obj != _current_obj)
+            return true;
+
         _mapping.resize(target_rxn.end());
         for (int i = target_rxn.begin(); i != target_rxn.end(); i = target_rxn.next(i))
             _mapping[i].clear();
@@ -1076,7 +1175,7 @@ bool BaseSimilarityMatcher::next()
 
             if (!sim_storage.isSmallBase())
             {
-                if (_current_container == sim_storage.getCellSize(_current_cell))
+                if (_current_container == _getCellSize(_current_cell))
                 {
                     _current_cell = sim_storage.nextFitCell(query_bit_count, _first_cell, _min_cell, _max_cell, _current_cell);
 
@@ -1091,7 +1190,7 @@ bool BaseSimilarityMatcher::next()
                 }
 
                 _current_portion.clear();
-                sim_storage.getSimilar(_query_fp.ptr(), *_sim_coef, _query_data->getMin(), _current_portion, _current_cell, _current_container);
+                _getSimilar(_query_data->getMin(), _current_cell, _current_container, _current_portion);
             }
             else
             {
@@ -1135,6 +1234,7 @@ void BaseSimilarityMatcher::setQueryData(SimilarityQueryData* query_data)
     _query_data->getQueryObject().buildFingerprint(fp_params, nullptr, &_query_fp);
 
     SimStorage& sim_storage = _index.getSimStorage();
+    _sim_memory_table = _index.getSimMemoryTable();
 
     int query_bit_count = bitGetOnesCount(_query_fp.ptr(), _fp_size);
 
@@ -1153,7 +1253,7 @@ void BaseSimilarityMatcher::setQueryData(SimilarityQueryData* query_data)
     }
     _containers_count = 0;
     for (int i = _min_cell; i <= _max_cell; i++)
-        _containers_count += sim_storage.getCellSize(i);
+        _containers_count += _getCellSize(i);
 }
 
 void BaseSimilarityMatcher::setQueryDataWithExtFP(SimilarityQueryData* query_data, IndigoObject& fp)
@@ -1168,6 +1268,7 @@ void BaseSimilarityMatcher::setQueryDataWithExtFP(SimilarityQueryData* query_dat
         throw Exception("BaseSimilarityMatcher: external fingerprint is incompatible with current database");
 
     SimStorage& sim_storage = _index.getSimStorage();
+    _sim_memory_table = _index.getSimMemoryTable();
 
     int query_bit_count = bitGetOnesCount(_query_fp.ptr(), _fp_size);
 
@@ -1186,7 +1287,7 @@ void BaseSimilarityMatcher::setQueryDataWithExtFP(SimilarityQueryData* query_dat
     }
     _containers_count = 0;
     for (int i = _min_cell; i <= _max_cell; i++)
-        _containers_count += sim_storage.getCellSize(i);
+        _containers_count += _getCellSize(i);
 }
 
 void BaseSimilarityMatcher::resetThresholdLimit(float min)
@@ -1207,6 +1308,7 @@ void BaseSimilarityMatcher::resetThresholdLimit(float min)
     _current_portion_id = 0;
     _current_portion.clear();
     _current_sim_value = -1;
+    _sim_memory_table = _index.getSimMemoryTable();
 
     if (sim_storage.isSmallBase())
         return;
@@ -1223,7 +1325,209 @@ void BaseSimilarityMatcher::resetThresholdLimit(float min)
     }
     _containers_count = 0;
     for (int i = _min_cell; i <= _max_cell; i++)
-        _containers_count += sim_storage.getCellSize(i);
+        _containers_count += _getCellSize(i);
+}
+
+void BaseSimilarityMatcher::_findSimilarBatch(const std::vector<BaseSimilarityMatcher*>& matchers, int limit, PtrArray<Array<SimResult>>& hits)
+{
+    profTimerStart(tbatch, "sim_batch");
+
+    hits.clear();
+    if (matchers.empty())
+        return;
+
+    const BaseSimilarityMatcher& first = *matchers[0];
+    BaseIndex& index = first._index;
+    SimStorage& sim_storage = index.getSimStorage();
+    std::shared_ptr<const SimMemoryTable> memory_table = index.getSimMemoryTable();
+    SimCoef& sim_coef = *first._sim_coef;
+    int fp_size = first._fp_size;
+    int count = (int)matchers.size();
+
+    Array<byte> fingerprints;
+    Array<int> bit_counts;
+    Array<double> min_coefs;
+    Array<int> min_cells, max_cells;
+
+    fingerprints.clear_resize(count * fp_size);
+    bit_counts.clear_resize(count);
+    min_coefs.clear_resize(count);
+    min_cells.clear_resize(count);
+    max_cells.clear_resize(count);
+
+    for (int q = 0; q < count; q++)
+    {
+        const BaseSimilarityMatcher& matcher = *matchers[q];
+        if (&matcher._index != &index || matcher._fp_size != fp_size)
+            throw Exception("BaseSimilarityMatcher: batched queries must belong to the same database");
+
+        memcpy(fingerprints.ptr() + q * fp_size, matcher._query_fp.ptr(), fp_size);
+        bit_counts[q] = bitGetOnesCount(matcher._query_fp.ptr(), fp_size);
+        min_coefs[q] = matcher._query_data->getMin();
+        min_cells[q] = matcher._min_cell;
+        max_cells[q] = matcher._max_cell;
+        hits.push();
+    }
+
+    SimBatch batch = {count, fingerprints.ptr(), bit_counts.ptr(), min_coefs.ptr(), hits};
+
+    QS_DEF(Array<int>, active);
+    active.clear();
+
+    // Hits of the deleted records are dropped before the top-N selection
+    auto drop_deleted = [&](Array<SimResult>& query_hits) {
+        int n_existing = 0;
+        for (int i = 0; i < query_hits.size(); i++)
+            if (_isObjectExist(index, query_hits[i].id))
+                query_hits[n_existing++] = query_hits[i];
+        query_hits.resize(n_existing);
+    };
+
+    // Top-N threshold of a query is raised as soon as it has twice as many hits as needed,
+    // so the rest of the storage is pruned more aggressively for it
+    auto trim = [&](int q) {
+        Array<SimResult>& query_hits = hits[q];
+        drop_deleted(query_hits);
+        if (query_hits.size() <= limit)
+            return;
+
+        std::nth_element(query_hits.ptr(), query_hits.ptr() + limit - 1, query_hits.ptr() + query_hits.size(),
+                         [](const SimResult& res1, const SimResult& res2) { return res1.sim_value > res2.sim_value; });
+        query_hits.resize(limit);
+        min_coefs[q] = std::max(min_coefs[q], (double)query_hits[limit - 1].sim_value);
+    };
+
+    if (sim_storage.isSmallBase())
+    {
+        for (int q = 0; q < count; q++)
+            active.push(q);
+        sim_storage.getIncSimilarBatch(batch, active, sim_coef);
+    }
+    else
+    {
+        for (int cell = 0; cell < sim_storage.getCellCount(); cell++)
+        {
+            if (first._part_count != -1 && first._part_id != -1 && (cell % first._part_count) != first._part_id - 1)
+                continue;
+
+            active.clear();
+            for (int q = 0; q < count; q++)
+                if (min_cells[q] != -1 && min_cells[q] <= cell && cell <= max_cells[q])
+                    active.push(q);
+
+            if (active.size() == 0)
+                continue;
+
+            int cell_size = (memory_table ? 1 : sim_storage.getCellSize(cell));
+            for (int cont = 0; cont < cell_size; cont++)
+            {
+                if (memory_table)
+                    memory_table->getSimilarBatch(batch, active, sim_coef, cell);
+                else
+                    sim_storage.getSimilarBatch(batch, active, sim_coef, cell, cont);
+
+                if (limit > 0)
+                    for (int j = 0; j < active.size(); j++)
+                        if (hits[active[j]].size() >= 2 * limit)
+                            trim(active[j]);
+            }
+        }
+    }
+
+    for (int q = 0; q < count; q++)
+    {
+        if (limit > 0)
+            trim(q);
+        else
+            drop_deleted(hits[q]);
+    }
+
+    profIncCounter("sim_batch_queries", count);
+}
+
+void BaseSimilarityMatcher::_findTopSimilar(int limit, Array<SimResult>& hits)
+{
+    profTimerStart(ttop, "sim_top_n");
+
+    SimStorage& sim_storage = _index.getSimStorage();
+    int query_bit_count = bitGetOnesCount(_query_fp.ptr(), _fp_size);
+    double min_coef = _query_data->getMin();
+
+    // The cells are taken from the storage as it is now
+    _sim_memory_table = _index.getSimMemoryTable();
+
+    // Min-heap of the best hits found so far; once it is full, its top is the
+    // coefficient a fingerprint has to beat
+    auto worse = [](const SimResult& res1, const SimResult& res2) { return res1.sim_value > res2.sim_value; };
+    hits.clear();
+
+    QS_DEF(Array<SimResult>, portion);
+    auto add_portion = [&]() {
+        for (int i = 0; i < portion.size(); i++)
+        {
+            if (!_isObjectExist(_index, portion[i].id))
+                continue;
+
+            if (limit <= 0 || hits.size() < limit)
+            {
+                hits.push(portion[i]);
+                std::push_heap(hits.ptr(), hits.ptr() + hits.size(), worse);
+            }
+            else if (portion[i].sim_value > hits[0].sim_value)
+            {
+                std::pop_heap(hits.ptr(), hits.ptr() + hits.size(), worse);
+                hits.top() = portion[i];
+                std::push_heap(hits.ptr(), hits.ptr() + hits.size(), worse);
+            }
+            else
+                continue;
+
+            if (limit > 0 && hits.size() == limit)
+                min_coef = std::max(min_coef, (double)hits[0].sim_value);
+        }
+    };
+
+    if (sim_storage.isSmallBase())
+    {
+        portion.clear();
+        sim_storage.getIncSimilar(_query_fp.ptr(), *_sim_coef, min_coef, portion);
+        add_portion();
+        return;
+    }
+
+    // Cells are visited from the most promising one, and the search stops at the
+    // first cell that cannot hold a fingerprint better than the current top-N
+    QS_DEF(Array<int>, cells);
+    QS_DEF(Array<double>, bounds);
+    cells.clear();
+    bounds.clear_resize(sim_storage.getCellCount());
+    for (int cell = 0; cell < sim_storage.getCellCount(); cell++)
+    {
+        if (_part_count != -1 && _part_id != -1 && (cell % _part_count) != _part_id - 1)
+            continue;
+
+        bounds[cell] = sim_storage.getCellUpperBound(query_bit_count, *_sim_coef, cell);
+        if (bounds[cell] >= min_coef)
+            cells.push(cell);
+    }
+    std::stable_sort(cells.ptr(), cells.ptr() + cells.size(), [&](int cell1, int cell2) { return bounds[cell1] > bounds[cell2]; });
+
+    for (int i = 0; i < cells.size(); i++)
+    {
+        int cell = cells[i];
+        if (bounds[cell] < min_coef || (limit > 0 && hits.size() == limit && bounds[cell] <= min_coef))
+            break;
+
+        int cell_size = _getCellSize(cell);
+        for (int cont = 0; cont < cell_size; cont++)
+        {
+            portion.clear();
+            _getSimilar(min_coef, cell, cont, portion);
+            add_portion();
+        }
+    }
+
+    profIncCounter("sim_top_n_cells", cells.size());
 }
 
 void BaseSimilarityMatcher::_setParameters(const char* parameters)
@@ -1289,6 +1593,23 @@ void BaseSimilarityMatcher::_initPartition()
 {
 }
 
+int BaseSimilarityMatcher::_getCellSize(int cell_idx) const
+{
+    // The in-memory table keeps a whole cell in a single container
+    if (_sim_memory_table)
+        return 1;
+
+    return _index.getSimStorage().getCellSize(cell_idx);
+}
+
+void BaseSimilarityMatcher::_getSimilar(double min_coef, int cell_idx, int cont_idx, Array<SimResult>& portion)
+{
+    if (_sim_memory_table)
+        _sim_memory_table->getSimilar(_query_fp.ptr(), *_sim_coef, min_coef, portion, cell_idx);
+    else
+        _index.getSimStorage().getSimilar(_query_fp.ptr(), *_sim_coef, min_coef, portion, cell_idx, cont_idx);
+}
+
 int BaseSimilarityMatcher::esimateRemainingResultsCount(int& delta)
 {
     int left_cont_count = _containers_count - _match_probability_esimate.getCount();
@@ -1369,10 +1690,7 @@ bool TopNSimMatcher::next()
     if (_idx < 0)
     {
         _findTopN();
-        if (_result_ids.size() > 0)
-        {
-            _idx = 0;
-        }
+        _idx = 0;
     }
 
     if (_idx >= 0 && _idx < _result_ids.size())
@@ -1398,274 +1716,9 @@ bool TopNSimMatcher::next()
 
 void TopNSimMatcher::_findTopN()
 {
-    QS_DEF(Array<float>, thrs);
-    QS_DEF(Array<int>, nhits_per_block);
-    QS_DEF(Array<int>, blocks);
-    QS_DEF(Array<int>, cells);
-
-    thrs.clear();
-    nhits_per_block.clear();
-    blocks.clear();
-    cells.clear();
-
-    SimStorage& sim_storage = _index.getSimStorage();
-
-    float thr_low_limit = _query_data->getMin();
-    int hits_limit = _limit;
-
-    _initModelDistribution(thrs, nhits_per_block);
-
-    blocks.clear_resize(thrs.size());
-    cells.clear_resize(thrs.size());
-    _current_results.clear();
-
-    bool already_found = false;
-    bool too_many = false;
-    float thr_proc = 0.0f;
-    float cur_thr = 0.0f;
-    float thr_too_many = 0.0f;
-    int nhits = 0;
-    int start_iter = thrs.size();
-
-    int cont_count = 0;
-    int cells_count = 0;
-    int min_cell = 0;
-    int max_cell = 0;
-    int cur_cell = 0;
-
-    int i;
-    int cnt = 0;
-
-    for (i = 0; i < thrs.size(); i++)
-    {
-        if (too_many)
-        {
-            if (thr_proc == 0.0f)
-                cur_thr = thr_too_many + (1.0f - thr_too_many) / 2;
-            else
-                cur_thr = thr_too_many + (thr_proc - thr_too_many) / 2;
-        }
-        else
-            cur_thr = thrs[i];
-
-        resetThresholdLimit(cur_thr);
-
-        cont_count = containersCount();
-        blocks[i] = cont_count;
-        cells_count = cellsCount();
-        cells[i] = cells_count;
-        min_cell = minCell();
-        max_cell = maxCell();
-
-        if ((cont_count > 0) && (nhits == 0))
-        {
-            cnt = 0;
-            _current_results.clear();
-
-            SimResult* res = 0;
-
-            while (BaseSimilarityMatcher::next())
-            {
-                cnt++;
-                res = &_current_results.push();
-                res->id = _current_id;
-                res->sim_value = _current_sim_value;
-                cur_cell = currentCell();
-                if ((cnt > hits_limit * 2) && ((max_cell - cur_cell) > cells_count / 2))
-                {
-                    thr_too_many = cur_thr;
-                    too_many = true;
-                    break;
-                }
-                else
-                    too_many = false;
-            }
-
-            if (too_many)
-                continue;
-
-            if ((cnt >= hits_limit) || (cur_thr <= thr_low_limit))
-            {
-                already_found = true;
-                break;
-            }
-
-            nhits = (cnt / cont_count);
-
-            if ((nhits == 0) && (cnt > 0))
-                nhits = 1;
-
-            thr_proc = cur_thr;
-            nhits_per_block[i] = nhits;
-            if (i < thrs.size() - 2)
-                start_iter = i + 1;
-            else
-            {
-                already_found = true;
-                break;
-            }
-
-            if (thr_too_many > 0.0)
-            {
-                thrs[i] = thr_proc;
-                thrs[start_iter] = thr_proc - (thr_proc - thr_too_many) / 2;
-                if (start_iter < thrs.size() - 2)
-                    thrs[start_iter + 1] = thr_too_many;
-            }
-        }
-        else if ((cont_count == 0) && sim_storage.isSmallBase())
-        {
-            cnt = 0;
-            _current_results.clear();
-
-            SimResult* res = 0;
-
-            while (BaseSimilarityMatcher::next())
-            {
-                cnt++;
-                res = &_current_results.push();
-                res->id = _current_id;
-                res->sim_value = _current_sim_value;
-
-                if (cnt > hits_limit * 2)
-                {
-                    thr_too_many = cur_thr;
-                    too_many = true;
-                    break;
-                }
-                else
-                    too_many = false;
-            }
-
-            if (too_many)
-                continue;
-
-            if ((cnt >= hits_limit) || (cur_thr <= thr_low_limit))
-            {
-                already_found = true;
-                break;
-            }
-        }
-        else if (cont_count == 0)
-            continue;
-        else
-        {
-            nhits_per_block[i] = nhits_per_block[i - 1] * 2;
-        }
-    }
-
-    if (!already_found)
-    {
-        bool adjusted = false;
-        float next_thr = 0.0f;
-        float prev_thr = 0.0f;
-
-        i = start_iter;
-
-        while (i < thrs.size())
-        {
-            if ((blocks[i] * nhits_per_block[i] < hits_limit) && (i < (thrs.size() - 1)) && (!adjusted))
-            {
-                i++;
-                continue;
-            }
-
-            cur_thr = thrs[i];
-
-            if ((blocks[i] * nhits_per_block[i] > 2 * hits_limit) && (!adjusted))
-            {
-                next_thr = cur_thr + (thrs[i - 1] - cur_thr) / 2;
-                prev_thr = cur_thr;
-                cur_thr = next_thr;
-                adjusted = true;
-            }
-
-            too_many = false;
-
-            resetThresholdLimit(cur_thr);
-
-            cont_count = containersCount();
-            cells_count = cellsCount();
-            cells[i] = cells_count;
-            min_cell = minCell();
-            max_cell = maxCell();
-
-            if (cont_count > 0)
-            {
-                cnt = 0;
-                _current_results.clear();
-
-                SimResult* res = 0;
-
-                while (BaseSimilarityMatcher::next())
-                {
-                    cnt++;
-                    res = &_current_results.push();
-                    res->id = _current_id;
-                    res->sim_value = _current_sim_value;
-                    cur_cell = currentCell();
-                    if ((cnt > hits_limit * 2) && (max_cell - cur_cell) > cells_count / 2)
-                    {
-                        next_thr = cur_thr + (thr_proc - cur_thr) / 2;
-                        thr_too_many = cur_thr;
-                        thrs[i] = next_thr;
-                        too_many = true;
-                        adjusted = true;
-                        break;
-                    }
-                }
-
-                if (((cnt >= hits_limit) || (cur_thr <= thr_low_limit)) && (!too_many))
-                    break;
-            }
-            else
-                i++;
-
-            if (!too_many)
-            {
-                thr_proc = cur_thr;
-                nhits_per_block[i] = cnt / cont_count;
-                if (i < (thrs.size() - 2))
-                    nhits_per_block[i + 1] = nhits_per_block[i] * 2;
-
-                if (thr_too_many > 0.0)
-                {
-                    next_thr = cur_thr - (cur_thr - thr_too_many) / 2;
-                    thrs[i] = next_thr;
-                }
-                else if (i < (thrs.size() - 2))
-                {
-                    if ((hits_limit - cnt) < (nhits_per_block[i + 1] * (blocks[i + 1] - cont_count)))
-                    {
-                        next_thr = cur_thr - (cur_thr - thrs[i + 1]) / 2;
-                        thrs[i] = next_thr;
-                        adjusted = true;
-                    }
-                    else
-                    {
-                        i++;
-                        next_thr = thrs[i];
-                    }
-                }
-            }
-
-            cur_thr = next_thr;
-        }
-    }
-
-    if (_current_results.size() > 0)
-    {
-        _current_results.qsort(_cmp_sim_res, nullptr);
-
-        for (i = 0; i < _current_results.size(); i++)
-        {
-            _result_ids.push(_current_results[i].id);
-            _result_sims.push(_current_results[i].sim_value);
-
-            if (i == (hits_limit - 1))
-                break;
-        }
-    }
+    QS_DEF(Array<SimResult>, hits);
+    _findTopSimilar(_limit, hits);
+    _setResults(hits);
 }
 
 int TopNSimMatcher::_cmp_sim_res(SimResult& res1, SimResult& res2, void* context)
@@ -1678,18 +1731,46 @@ int TopNSimMatcher::_cmp_sim_res(SimResult& res1, SimResult& res2, void* context
     return 0;
 }
 
-void TopNSimMatcher::_initModelDistribution(Array<float>& model_thrs, Array<int>& model_nhits_per_block)
+void TopNSimMatcher::setLimit(int limit)
+{
+    _limit = limit;
+}
+
+void TopNSimMatcher::_setResults(Array<SimResult>& results)
 {
-    for (int i = 0; i < 9; i++)
+    results.qsort(_cmp_sim_res, nullptr);
+
+    _result_ids.clear();
+    _result_sims.clear();
+    for (int i = 0; i < results.size(); i++)
     {
-        model_thrs.push(_2FLOAT(1.0 - 0.1 * (i + 1)));
-        model_nhits_per_block.push(5 * 2 ^ (i));
+        _result_ids.push(results[i].id);
+        _result_sims.push(results[i].sim_value);
     }
+    _idx = 0;
 }
 
-void TopNSimMatcher::setLimit(int limit)
+void TopNSimMatcher::findBatch(const std::vector<TopNSimMatcher*>& matchers)
 {
-    _limit = limit;
+    // Matchers with different limits are searched separately, usually all of them have the same one
+    std::map<int, std::vector<BaseSimilarityMatcher*>> groups;
+    std::map<int, std::vector<TopNSimMatcher*>> group_matchers;
+    for (TopNSimMatcher* matcher : matchers)
+    {
+        int limit = std::max(matcher->_limit, 0);
+        groups[limit].push_back(matcher);
+        group_matchers[limit].push_back(matcher);
+    }
+
+    PtrArray<Array<SimResult>> hits;
+    for (auto& group : groups)
+    {
+        _findSimilarBatch(group.second, group.first, hits);
+
+        std::vector<TopNSimMatcher*>& group_topn = group_matchers[group.first];
+        for (int i = 0; i < (int)group_topn.size(); i++)
+            group_topn[i]->_setResults(hits[i]);
+    }
 }
 
 TopNSimMatcher::~TopNSimMatcher()
@@ -1748,6 +1829,12 @@ void BaseExactMatcher::setQueryData(ExactQueryData* query_data)
     _query_hash = _calcHash();
 }
 
+bool BaseExactMatcher::tryCandidate(int id)
+{
+    _current_id = id;
+    return _tryCurrent();
+}
+
 void BaseExactMatcher::_initPartition()
 {
 }
@@ -1785,16 +1872,31 @@ dword MolExactMatcher::_calcHash()
 
 bool MolExactMatcher::_tryCurrent() /* const */
 {
-    SimilarityMoleculeQuery& query = (SimilarityMoleculeQuery&)(_query_data->getQueryObject());
-    Molecule& query_mol = (Molecule&)(query.getMolecule());
+    if (_current_obj == 0)
+        throw Exception("MoleculeExactMatcher: Matcher's current object was destroyed");
 
-    if (!_loadCurrentObject(_index, _current_id, _current_obj))
+    // Tautomer search changes the target, the cached one must stay intact
+    if (_index.getDecodedCache() == nullptr || _tautomer)
+    {
+        if (!_loadCurrentObject(_index, _current_id, _current_obj))
+            return false;
+        return _tryMolecule(_current_obj->getMolecule());
+    }
+
+    DecodedCache::Lease lease;
+    Molecule* target_mol = _leaseCurrentMolecule(_index, _current_id, lease);
+    if (target_mol == nullptr || !_tryMolecule(*target_mol))
         return false;
 
-    if (_current_obj == 0)
-        throw Exception("MoleculeExactMatcher: Matcher's current object was destroyed");
+    // The object of the cursor is filled for the hits only
+    _loadCurrentObject(_index, _current_id, _current_obj);
+    return true;
+}
 
-    Molecule& target_mol = _current_obj->getMolecule();
+bool MolExactMatcher::_tryMolecule(Molecule& target_mol)
+{
+    SimilarityMoleculeQuery& query = (SimilarityMoleculeQuery&)(_query_data->getQueryObject());
+    Molecule& query_mol = (Molecule&)(query.getMolecule());
 
     if (_tautomer)
     {
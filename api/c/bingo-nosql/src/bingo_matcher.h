@@ -2,11 +2,13 @@
 #define __bingo_matcher__
 
 #include <atomic>
-
-// #define USE_SAFE_PTR
-#ifdef USE_SAFE_PTR
-#include "safe_ptr.h"
-#endif
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "bingo_base_index.h"
 #include "bingo_object.h"
@@ -16,7 +18,6 @@
 #include "indigo_molecule.h"
 #include "indigo_reaction.h"
 
-#include "base_cpp/fixed_deque.h"
 #include "base_cpp/os_thread_wrapper.h"
 #include "base_cpp/ptr_array.h"
 #include "math/statistics.h"
@@ -192,6 +193,9 @@ namespace bingo
         virtual int minCell() const = 0;
         virtual int maxCell() const = 0;
 
+        // Keeps concurrent inserts from reorganizing the storages the search reads
+        virtual std::shared_lock<std::shared_mutex> lockStorages() const = 0;
+
         virtual ~Matcher(){};
     };
 
@@ -219,6 +223,8 @@ namespace bingo
         int minCell() const override;
         int maxCell() const override;
 
+        std::shared_lock<std::shared_mutex> lockStorages() const override;
+
     protected:
         BaseIndex& _index;
         IndigoObject*& _current_obj;
@@ -231,10 +237,17 @@ namespace bingo
         MeanEstimator _match_probability_esimate, _match_time_esimate;
 
         bool _isCurrentObjectExist();
+        static bool _isObjectExist(BaseIndex& index, int id);
 
         static void _loadObject(const char* cf_str, int cf_len, IndigoObject*& current_obj, bool is_old_db);
+        static void _loadMolecule(const char* cf_str, int cf_len, Molecule& mol, bool is_old_db);
         static bool _loadCurrentObject(BaseIndex& index, int current_id, IndigoObject*& current_obj);
 
+        // Decoded molecule of the record taken from the decoded cache of the index.
+        // It may only be read: the next searches will see it again.
+        // Returns nullptr if the record was removed
+        static Molecule* _leaseCurrentMolecule(BaseIndex& index, int current_id, DecodedCache::Lease& lease);
+
         virtual void _setParameters(const char* params) = 0;
         virtual void _initPartition() = 0;
 
@@ -244,7 +257,13 @@ namespace bingo
     constexpr int MAX_INPUT_QUEUE_SIZE = 10240;
     constexpr int THREAD_INPUT_CHUNK_SIZE = 512;
 
-    // using results_queue = std::deque<std::pair<int, std::unique_ptr<IndigoObject>>>;
+    // Portion of screened candidates of one pack verified by a single worker
+    struct SubSearchChunk
+    {
+        int pack;
+        int seq;
+        std::vector<int> ids;
+    };
 
     class BaseSubstructureMatcher : public BaseMatcher
     {
@@ -263,6 +282,10 @@ namespace bingo
 
         int getDbId() const;
 
+        // Fingerprints are screened in the snapshot taken when the search was created,
+        // the lock covers reading the records and their ids
+        std::shared_lock<std::shared_mutex> lockStorages() const override;
+
         AromaticityOptions _arom_options;
         PtrArray<TautomerRule>* _tautomer_rules;
 
@@ -273,9 +296,9 @@ namespace bingo
         Array<byte> _query_fp;
         Array<int> _query_fp_bits_used;
 
-        void _findPackCandidates(int pack_idx);
+        void _findPackCandidates(int pack_idx, Array<int>& candidates);
 
-        void _findIncCandidates();
+        void _findIncCandidates(Array<int>& candidates);
 
         bool _find_candidates();
 
@@ -287,43 +310,69 @@ namespace bingo
         IndigoTautomerParams _tautomer_params;
 
         bool _multithread = false;
+        bool _ordered = false;
         int _thread_count = -1;
 
+        // Must be called from the destructors of the derived classes: workers call their tryCurrent
+        void _stopWorkers();
+
     private:
         Array<int> _candidates;
         int _current_cand_id;
         int _current_pack;
         int _final_pack;
         const TranspFpStorage& _fp_storage;
+        std::shared_ptr<const IndexSnapshot> _snapshot;
         int sub_cnt;
-        std::optional<std::thread> _t;
 
-    public:
-#ifdef USE_SAFE_PTR
-        sf::contfree_safe_ptr<FixedDeque<int>> _input_data;
-        sf::contfree_safe_ptr<FixedDeque<int>> _results;
-#else
-        FixedDeque<int> _input_data;
-        FixedDeque<int> _results;
-        // results_queue _results;
-        std::mutex _input_mtx;
-        std::condition_variable _cv_input;
-        std::mutex _results_mtx;
+        // Parallel search state. Workers claim packs in increasing order, screen them and
+        // split survivors into chunks; any worker verifies any chunk. Results are handed
+        // to next() either as they come or strictly in the index order.
+        std::vector<std::thread> _workers;
+        std::mutex _mtx;
+        std::condition_variable _cv_work;
         std::condition_variable _cv_results;
-#endif
-        std::atomic_bool _all_data_in_queue = false;
-        std::atomic_bool _finished_processing = false;
+        std::deque<SubSearchChunk> _work_chunks;
+        std::map<std::pair<int, int>, std::vector<int>> _done_chunks;
+        std::map<int, int> _pack_chunks_count;
+        std::deque<int> _results;
+        std::vector<int> _emit_buf;
+        size_t _emit_pos = 0;
+        int _emit_pack = 0;
+        int _emit_chunk = 0;
+        int _next_pack = 0;
+        int _screening_count = 0;
+        int _workers_count = 0;
+        bool _workers_started = false;
+        int _active_workers = 0;
         std::atomic_bool _stop_request = false;
-        int _results_empty = 0;
+        std::exception_ptr _worker_error;
+
+        bool _nextParallel();
+        void _startWorkers();
+        void _workerLoop();
+        bool _canScreenNextPack() const;
+        void _verifyChunk(SubSearchChunk& chunk, IndigoObject* obj);
+        // Must be called under _mtx
+        void _addVerifiedChunk(SubSearchChunk& chunk);
+
+        // Mean time of a single candidate verification used by the screening to decide
+        // how many fingerprint columns are worth reading
+        std::atomic<float> _try_time_estimate;
+        void _updateTryTimeEstimate(std::chrono::duration<float> elapsed, size_t tried);
     };
 
     class MoleculeSubMatcher : public BaseSubstructureMatcher
     {
     public:
         MoleculeSubMatcher(/*const */ BaseIndex& index);
+        ~MoleculeSubMatcher() override;
 
         const Array<int>& currentMapping();
 
+        // Compiles the query once for all the candidates of the search
+        void setQueryData(SubstructureQueryData* query_data);
+
         virtual bool tryCurrent(int current_id, IndigoObject* current_obj) /*const*/ override;
         virtual bool tryObject(IndigoObject* current_obj) override;
 
@@ -331,6 +380,10 @@ namespace bingo
 
     private:
         Array<int> _mapping;
+        CompiledSubstructureQuery _compiled_query;
+        bool _unfold_target_h = false;
+
+        bool _tryMolecule(Molecule& target_mol, bool save_mapping);
 
         IndexCurrentMolecule* _current_mol;
     };
@@ -339,6 +392,7 @@ namespace bingo
     {
     public:
         ReactionSubMatcher(/*const */ BaseIndex& index);
+        ~ReactionSubMatcher() override;
 
         const PtrArray<Array<int>>& currentMapping();
 
@@ -382,6 +436,16 @@ namespace bingo
         float _current_sim_value;
         std::unique_ptr<SimilarityQueryData> _query_data;
 
+        // Runs the queries of all the matchers in one pass over the similarity storage.
+        // The matchers must belong to the same index and have the same metric.
+        // If limit > 0 only the best limit hits of every query are kept in hits, otherwise all of them
+        static void _findSimilarBatch(const std::vector<BaseSimilarityMatcher*>& matchers, int limit, PtrArray<Array<SimResult>>& hits);
+
+        // Finds the best limit hits of the query in a single pass over the storage,
+        // visiting the cells in the decreasing order of their upper bounds.
+        // If limit <= 0 all the hits above the threshold are found. Hits are not sorted
+        void _findTopSimilar(int limit, Array<SimResult>& hits);
+
     private:
         int _fp_size;
 
@@ -399,6 +463,9 @@ namespace bingo
 
         std::unique_ptr<SimCoef> _sim_coef;
 
+        // In-memory copy of the storage taken with the query, if the index has one
+        std::shared_ptr<const SimMemoryTable> _sim_memory_table;
+
         Array<byte> _current_block;
         const byte* _cur_loc;
         Array<byte> _query_fp;
@@ -406,6 +473,10 @@ namespace bingo
         void _setParameters(const char* params) override;
 
         void _initPartition() override;
+
+        int _getCellSize(int cell_idx) const;
+
+        void _getSimilar(double min_coef, int cell_idx, int cont_idx, Array<SimResult>& portion);
     };
 
     class MoleculeSimMatcher : public BaseSimilarityMatcher
@@ -434,17 +505,20 @@ namespace bingo
         bool next() override;
         void setLimit(int limit);
 
+        // Fills the results of all the matchers by a single batched search.
+        // A matcher with limit <= 0 gets all the hits above its threshold
+        static void findBatch(const std::vector<TopNSimMatcher*>& matchers);
+
         ~TopNSimMatcher() override;
 
     protected:
         void _findTopN();
-        void _initModelDistribution(Array<float>& thrs, Array<int>& nhits_per_block);
+        void _setResults(Array<SimResult>& results);
         static int _cmp_sim_res(SimResult& res1, SimResult& res2, void* context);
 
     private:
         int _idx;
         int _limit;
-        Array<SimResult> _current_results;
         Array<int> _result_ids;
         Array<float> _result_sims;
     };
@@ -476,6 +550,9 @@ namespace bingo
 
         void setQueryData(ExactQueryData* query_data);
 
+        // Checks a candidate found apart from the matcher, e.g. by ExactStorage::joinCandidates
+        bool tryCandidate(int id);
+
         ~BaseExactMatcher() override;
 
     protected:
@@ -504,6 +581,7 @@ namespace bingo
         dword _calcHash() override;
 
         bool _tryCurrent() /* const */ override;
+        bool _tryMolecule(Molecule& target_mol);
 
         void _setParameters(const char* params) override;
 
@@ -212,6 +212,87 @@ void MultibitTree::_findSimilarInNode(MMFPtr<_MultibitNode> node_ptr, const byte
         sim_indices.push(right_indices[i]);
 }
 
+void MultibitTree::_findLinearBatch(_MultibitNode* node, const SimBatch& batch, const Array<int>& active, SimCoef& sim_coef)
+{
+    profTimerStart(tmsl, "multibit_tree_search_linear_batch");
+    byte* fingerprints = _fingerprints_ptr.ptr();
+    int* indices = _indices_ptr.ptr();
+
+    int* fp_indices = node->fp_indices_array.ptr();
+
+    // Every fingerprint of the leaf is loaded once and scored against all the active queries
+    for (int i = 0; i < node->fp_indices_count; i++)
+    {
+        const byte* fp = fingerprints + fp_indices[i] * _fp_size;
+        int f_bit_number = (_min_fp_bit_number == _max_fp_bit_number ? _min_fp_bit_number : bitGetOnesCount(fp, _fp_size));
+
+        for (int j = 0; j < active.size(); j++)
+        {
+            int q = active[j];
+            double coef = sim_coef.calcCoef(batch.fingerprints + q * _fp_size, fp, batch.bit_counts[q], f_bit_number);
+            if (coef < batch.min_coefs[q])
+                continue;
+
+            batch.hits[q].push(SimResult(indices[fp_indices[i]], (float)coef));
+        }
+    }
+}
+
+void MultibitTree::_findSimilarInNodeBatch(MMFPtr<_MultibitNode> node_ptr, const SimBatch& batch, const Array<int>& active, const Array<int>& m01,
+                                           const Array<int>& m10, SimCoef& sim_coef)
+{
+    if (node_ptr.isNull() || active.size() == 0)
+        return;
+
+    _MultibitNode* node = node_ptr.ptr();
+
+    if (node->fp_indices_count != 0)
+    {
+        _findLinearBatch(node, batch, active, sim_coef);
+        return;
+    }
+
+    _MatchBit* match_bits = node->match_bits_array.ptr();
+
+    QS_DEF(Array<int>, right_active);
+    QS_DEF(Array<int>, right_m01);
+    QS_DEF(Array<int>, right_m10);
+    right_active.clear();
+    right_m01.clear();
+    right_m10.clear();
+
+    // Same pruning as _findSimilarInNode, but the right subtree is entered only by the queries it can match
+    for (int j = 0; j < active.size(); j++)
+    {
+        int q = active[j];
+        const byte* query = batch.fingerprints + q * _fp_size;
+        int q_m01 = m01[j], q_m10 = m10[j];
+
+        for (int i = 0; i < node->match_bits_count; i++)
+            if (match_bits[i].val == 0)
+            {
+                if (bitGetBit(query, match_bits[i].idx))
+                    q_m01++;
+            }
+            else if (!bitGetBit(query, match_bits[i].idx))
+                q_m10++;
+
+        double right_upper_bound = sim_coef.calcUpperBound(batch.bit_counts[q], _min_fp_bit_number, _max_fp_bit_number, q_m10, q_m01);
+        if (right_upper_bound + EPSILON > batch.min_coefs[q])
+        {
+            right_active.push(q);
+            right_m01.push(q_m01);
+            right_m10.push(q_m10);
+        }
+    }
+
+    if (!node->left.isNull())
+    {
+        _findSimilarInNodeBatch(node->left, batch, active, m01, m10, sim_coef);
+        _findSimilarInNodeBatch(node->right, batch, right_active, right_m01, right_m10, sim_coef);
+    }
+}
+
 MultibitTree::MultibitTree(int fp_size) : _fp_size(fp_size)
 {
     _tree_ptr.allocate();
@@ -220,6 +301,32 @@ MultibitTree::MultibitTree(int fp_size) : _fp_size(fp_size)
     _max_level = 6;
 }
 
+void MultibitTree::collectRanges(MMFRanges& ranges) const
+{
+    ranges.add(_fingerprints_ptr.getAddress(), (size_t)_fp_count * _fp_size);
+    ranges.add(_indices_ptr.getAddress(), _fp_count * sizeof(int));
+    _collectNodeRanges(_tree_ptr, ranges);
+}
+
+void MultibitTree::collectFingerprints(Array<byte>& fingerprints, Array<int>& ids) const
+{
+    fingerprints.concat(_fingerprints_ptr.ptr(), _fp_count * _fp_size);
+    ids.concat(_indices_ptr.ptr(), _fp_count);
+}
+
+void MultibitTree::_collectNodeRanges(MMFPtr<_MultibitNode> node_ptr, MMFRanges& ranges)
+{
+    if (node_ptr.isNull())
+        return;
+
+    const _MultibitNode* node = node_ptr.ptr();
+    ranges.add(node_ptr.getAddress(), sizeof(_MultibitNode));
+    ranges.add(node->match_bits_array.getAddress(), node->match_bits_count * sizeof(_MatchBit));
+    ranges.add(node->fp_indices_array.getAddress(), node->fp_indices_count * sizeof(int));
+    _collectNodeRanges(node->left, ranges);
+    _collectNodeRanges(node->right, ranges);
+}
+
 void MultibitTree::build(MMFPtr<byte> fingerprints, MMFPtr<int> indices, int fp_count, int min_fp_bit_number, int max_fp_bit_number)
 {
     _fingerprints_ptr = fingerprints;
@@ -243,3 +350,14 @@ int MultibitTree::findSimilar(const byte* query, SimCoef& sim_coef, double min_c
 
     return sim_fp_indices.size();
 }
+
+void MultibitTree::findSimilarBatch(const SimBatch& batch, const Array<int>& active, SimCoef& sim_coef)
+{
+    profTimerStart(tms, "multibit_tree_search_batch");
+
+    QS_DEF(Array<int>, zeros);
+    zeros.clear_resize(active.size());
+    zeros.zerofill();
+
+    _findSimilarInNodeBatch(_tree_ptr, batch, active, zeros, zeros, sim_coef);
+}
@@ -22,6 +22,15 @@ namespace bingo
 
         int findSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices);
 
+        // Searches the queries listed in active (indices in batch) in one tree traversal
+        void findSimilarBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef);
+
+        // Adds the mapped memory of the fingerprints and of every tree node
+        void collectRanges(MMFRanges& ranges) const;
+
+        // Appends the fingerprints of the tree and their ids
+        void collectFingerprints(indigo::Array<byte>& fingerprints, indigo::Array<int>& ids) const;
+
     private:
         struct _MatchBit
         {
@@ -75,6 +84,8 @@ namespace bingo
 
         static int _compareBitWeights(_DistrWeight& bw1, _DistrWeight& bw2, void* context);
 
+        static void _collectNodeRanges(MMFPtr<_MultibitNode> node_ptr, MMFRanges& ranges);
+
         MMFPtr<_MultibitNode> _buildNode(indigo::Array<int>& fit_fp_indices, const indigo::Array<bool>& is_parrent_mb, int level);
 
         void _build();
@@ -84,6 +95,11 @@ namespace bingo
 
         void _findSimilarInNode(MMFPtr<_MultibitNode> node_ptr, const byte* query, int query_bit_number, SimCoef& sim_coef, double min_coef,
                                 indigo::Array<SimResult>& sim_indices, int m01, int m10);
+
+        void _findLinearBatch(_MultibitNode* node, const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef);
+
+        void _findSimilarInNodeBatch(MMFPtr<_MultibitNode> node_ptr, const SimBatch& batch, const indigo::Array<int>& active, const indigo::Array<int>& m01,
+                                     const indigo::Array<int>& m10, SimCoef& sim_coef);
     };
 }; // namespace bingo
 
@@ -1,10 +1,17 @@
 #ifndef __sim_coef__
 #define __sim_coef__
 
+#include <algorithm>
+
 #include "base_c/defs.h"
+#include "base_cpp/array.h"
+#include "base_cpp/ptr_array.h"
 
 namespace bingo
 {
+    // Number of fingerprints whose common bits are counted at once by calcCoefBatch
+    static const int COEF_BATCH_SIZE = 256;
+
     struct SimResult
     {
         int id;
@@ -15,6 +22,17 @@ namespace bingo
         }
     };
 
+    // Queries of a batched similarity search. The storage is walked once and every fingerprint
+    // is scored against all the queries which can still reach the threshold
+    struct SimBatch
+    {
+        int count;
+        const byte* fingerprints;                         // query fingerprints stored one after another
+        const int* bit_counts;                            // number of ones in every query fingerprint
+        const double* min_coefs;                          // per-query thresholds, may be raised between the calls
+        indigo::PtrArray<indigo::Array<SimResult>>& hits; // hits of the i-th query are appended to hits[i]
+    };
+
     class SimCoef
     {
     public:
@@ -26,6 +44,9 @@ namespace bingo
 
         virtual double calcCoef(const byte* target, const byte* query, int target_bit_count, int query_bit_count) = 0;
 
+        // coefs[i] = calcCoef(target, queries + i * fp_size, target_bit_count, query_bit_counts[i]) for count contiguous fingerprints
+        virtual void calcCoefBatch(const byte* target, const byte* queries, int target_bit_count, const int* query_bit_counts, int count, double* coefs) = 0;
+
         virtual double calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count) = 0;
 
         virtual double calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count, int m10, int m01) = 0;
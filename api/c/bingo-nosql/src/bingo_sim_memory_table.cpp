@@ -0,0 +1,154 @@
+#include "bingo_sim_memory_table.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "base_c/bitarray.h"
+#include "base_cpp/profiling.h"
+
+using namespace indigo;
+using namespace bingo;
+
+SimMemoryTable::SimMemoryTable(SimStorage& storage, int fp_size) : _fp_size(fp_size)
+{
+    profTimerStart(t, "sim_memory_table_build");
+
+    int cell_count = storage.getCellCount();
+
+    Array<byte> fingerprints;
+    Array<int> ids;
+    std::vector<int> ones, order;
+
+    for (int cell = 0; cell < cell_count; cell++)
+    {
+        fingerprints.clear();
+        ids.clear();
+        storage.collectCellFingerprints(cell, fingerprints, ids);
+
+        int count = ids.size();
+        ones.resize(count);
+        if (count > 0)
+            bitGetOnesCountBatch(fingerprints.ptr(), _fp_size, count, ones.data());
+
+        order.resize(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int i1, int i2) { return ones[i1] < ones[i2]; });
+
+        _Cell new_cell;
+        new_cell.begin = (int)_ids.size();
+        new_cell.end = new_cell.begin + count;
+        _cells.push_back(new_cell);
+
+        _fingerprints.resize(((size_t)new_cell.end * _fp_size + sizeof(_Line) - 1) / sizeof(_Line));
+        for (int i = 0; i < count; i++)
+        {
+            int idx = new_cell.begin + i;
+            const byte* fp = fingerprints.ptr() + (size_t)order[i] * _fp_size;
+
+            memcpy((byte*)_getFingerprint(idx), fp, _fp_size);
+            _ones.push_back(ones[order[i]]);
+            _ids.push_back(ids[order[i]]);
+        }
+    }
+
+    profIncCounter("sim_memory_table_fingerprints", (int)_ids.size());
+}
+
+int SimMemoryTable::getCellCount() const
+{
+    return (int)_cells.size();
+}
+
+int SimMemoryTable::getSimilar(const byte* query, SimCoef& sim_coef, double min_coef, Array<SimResult>& sim_fp_indices, int cell_idx) const
+{
+    if (cell_idx >= (int)_cells.size())
+        throw Exception("SimMemoryTable: Incorrect cell index");
+
+    const _Cell& cell = _cells[cell_idx];
+    int query_bit_count = bitGetOnesCount(query, _fp_size);
+
+    int idx = cell.begin;
+    while (idx < cell.end)
+    {
+        // Fingerprints with the same number of ones are skipped together
+        int fp_bit_count = _ones[idx];
+        int group_end = _groupEnd(idx, cell.end);
+
+        if (sim_coef.calcUpperBound(query_bit_count, fp_bit_count, fp_bit_count) + EPSILON > min_coef)
+        {
+            for (int start = idx; start < group_end; start += COEF_BATCH_SIZE)
+                _findInBlock(query, query_bit_count, start, std::min(group_end - start, COEF_BATCH_SIZE), sim_coef, min_coef, sim_fp_indices);
+        }
+
+        idx = group_end;
+    }
+
+    return sim_fp_indices.size();
+}
+
+void SimMemoryTable::getSimilarBatch(const SimBatch& batch, const Array<int>& active, SimCoef& sim_coef, int cell_idx) const
+{
+    if (cell_idx >= (int)_cells.size())
+        throw Exception("SimMemoryTable: Incorrect cell index");
+
+    const _Cell& cell = _cells[cell_idx];
+
+    QS_DEF(Array<int>, fit);
+
+    int idx = cell.begin;
+    while (idx < cell.end)
+    {
+        int fp_bit_count = _ones[idx];
+        int group_end = _groupEnd(idx, cell.end);
+
+        // Queries which can reach their thresholds with this number of ones
+        fit.clear();
+        for (int j = 0; j < active.size(); j++)
+        {
+            int q = active[j];
+            if (sim_coef.calcUpperBound(batch.bit_counts[q], fp_bit_count, fp_bit_count) + EPSILON > batch.min_coefs[q])
+                fit.push(q);
+        }
+
+        // A block stays in cache while all the fitting queries are scored against it
+        for (int start = idx; fit.size() > 0 && start < group_end; start += COEF_BATCH_SIZE)
+        {
+            int count = std::min(group_end - start, COEF_BATCH_SIZE);
+            for (int k = 0; k < fit.size(); k++)
+            {
+                int q = fit[k];
+                _findInBlock(batch.fingerprints + q * _fp_size, batch.bit_counts[q], start, count, sim_coef, batch.min_coefs[q], batch.hits[q]);
+            }
+        }
+
+        idx = group_end;
+    }
+}
+
+void SimMemoryTable::_findInBlock(const byte* query, int query_bit_count, int start, int count, SimCoef& sim_coef, double min_coef,
+                                  Array<SimResult>& hits) const
+{
+    int bit_counts[COEF_BATCH_SIZE];
+    double coefs[COEF_BATCH_SIZE];
+
+    std::fill(bit_counts, bit_counts + count, _ones[start]);
+    sim_coef.calcCoefBatch(query, _getFingerprint(start), query_bit_count, bit_counts, count, coefs);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (coefs[i] < min_coef)
+            continue;
+
+        hits.push(SimResult(_ids[start + i], (float)coefs[i]));
+    }
+}
+
+const byte* SimMemoryTable::_getFingerprint(int idx) const
+{
+    return (const byte*)_fingerprints.data() + (size_t)idx * _fp_size;
+}
+
+int SimMemoryTable::_groupEnd(int idx, int end) const
+{
+    return (int)(std::upper_bound(_ones.begin() + idx, _ones.begin() + end, _ones[idx]) - _ones.begin());
+}
@@ -0,0 +1,66 @@
+#ifndef __bingo_sim_memory_table__
+#define __bingo_sim_memory_table__
+
+#include <vector>
+
+#include "base_cpp/array.h"
+
+#include "bingo_sim_coef.h"
+#include "bingo_sim_storage.h"
+
+namespace bingo
+{
+    // Copy of the fingerprint table of the similarity storage in plain memory,
+    // built for the databases opened with the sim_in_memory option. It has the
+    // cells of the fingerprint table, but every cell is one contiguous run of
+    // fingerprints sorted by the number of ones, so a search is a linear scan
+    // by the batched coefficient kernels without the address translation of
+    // the mapped storage. Fingerprints are stored one after another from a
+    // 64-byte boundary, so a fingerprint of the default size is a cache line.
+    //
+    // The copy is never changed, a new one is built instead
+    class SimMemoryTable
+    {
+    public:
+        SimMemoryTable(SimStorage& storage, int fp_size);
+
+        SimMemoryTable(const SimMemoryTable&) = delete;
+        SimMemoryTable& operator=(const SimMemoryTable&) = delete;
+
+        int getCellCount() const;
+
+        int getSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices, int cell_idx) const;
+
+        void getSimilarBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef, int cell_idx) const;
+
+    private:
+        struct alignas(64) _Line
+        {
+            byte data[64];
+        };
+
+        // Fingerprints [begin, end) of the cell
+        struct _Cell
+        {
+            int begin;
+            int end;
+        };
+
+        int _fp_size;
+
+        std::vector<_Cell> _cells;
+        std::vector<_Line> _fingerprints;
+        std::vector<int> _ones;
+        std::vector<int> _ids;
+
+        // Scores count fingerprints from start, all with the same number of ones
+        void _findInBlock(const byte* query, int query_bit_count, int start, int count, SimCoef& sim_coef, double min_coef,
+                          indigo::Array<SimResult>& hits) const;
+
+        const byte* _getFingerprint(int idx) const;
+
+        int _groupEnd(int idx, int end) const;
+    };
+}
+
+#endif // __bingo_sim_memory_table__
@@ -46,6 +46,17 @@ void SimStorage::add(const byte* fingerprint, int id)
     }
 }
 
+void SimStorage::addBatch(const byte* fingerprints, const int* ids, int count)
+{
+    // Fill the initial increment one by one until the fingerprint table is built
+    int i = 0;
+    for (; i < count && _fingerprint_table.getAddress() == MMFAddress::null; i++)
+        add(fingerprints + (size_t)i * _fp_size, ids[i]);
+
+    if (i < count)
+        _fingerprint_table->addBatch(fingerprints + (size_t)i * _fp_size, ids + i, count - i);
+}
+
 void SimStorage::optimize()
 {
     if (_fingerprint_table.getAddress() == MMFAddress::null)
@@ -54,6 +65,25 @@ void SimStorage::optimize()
     _fingerprint_table->optimize();
 }
 
+void SimStorage::collectRanges(MMFRanges& ranges)
+{
+    if (_fingerprint_table.getAddress() == MMFAddress::null)
+    {
+        ranges.add(_inc_buffer.getAddress(), (size_t)_inc_fp_count * _fp_size);
+        return;
+    }
+
+    _fingerprint_table->collectRanges(ranges);
+}
+
+void SimStorage::collectCellFingerprints(int cell_idx, Array<byte>& fingerprints, Array<int>& ids)
+{
+    if (_fingerprint_table.getAddress() == MMFAddress::null)
+        throw Exception("SimStorage: fingerprint table wasn't built");
+
+    _fingerprint_table->collectCellFingerprints(cell_idx, fingerprints, ids);
+}
+
 int SimStorage::getCellCount() const
 {
     if (_fingerprint_table.getAddress() == MMFAddress::null)
@@ -78,6 +108,14 @@ void SimStorage::getCellsInterval(const byte* query, SimCoef& sim_coef, double m
     _fingerprint_table->getCellsInterval(query, sim_coef, min_coef, min_cell, max_cell);
 }
 
+double SimStorage::getCellUpperBound(int query_bit_count, SimCoef& sim_coef, int cell_idx)
+{
+    if (_fingerprint_table.getAddress() == MMFAddress::null)
+        throw Exception("SimStorage: fingerprint table wasn't built");
+
+    return _fingerprint_table->getCellUpperBound(query_bit_count, sim_coef, cell_idx);
+}
+
 int SimStorage::firstFitCell(int query_bit_count, int min_cell, int max_cell) const
 {
     if (_fingerprint_table.getAddress() == MMFAddress::null)
@@ -124,6 +162,34 @@ int SimStorage::getIncSimilar(const byte* query, SimCoef& sim_coef, double min_c
     return sim_fp_indices.size();
 }
 
+void SimStorage::getSimilarBatch(const SimBatch& batch, const Array<int>& active, SimCoef& sim_coef, int cell_idx, int cont_idx)
+{
+    if (_fingerprint_table.getAddress() == MMFAddress::null)
+        throw Exception("SimStorage: fingerprint table wasn't built");
+
+    _fingerprint_table->getSimilarBatch(batch, active, sim_coef, cell_idx, cont_idx);
+}
+
+void SimStorage::getIncSimilarBatch(const SimBatch& batch, const Array<int>& active, SimCoef& sim_coef)
+{
+    for (int i = 0; i < _inc_fp_count; i++)
+    {
+        const byte* fp = _inc_buffer.ptr() + (i * _fp_size);
+        int fp_bit_count = bitGetOnesCount(fp, _fp_size);
+        size_t id = _inc_id_buffer[i];
+
+        for (int j = 0; j < active.size(); j++)
+        {
+            int q = active[j];
+            double coef = sim_coef.calcCoef(fp, batch.fingerprints + q * _fp_size, fp_bit_count, batch.bit_counts[q]);
+            if (coef < batch.min_coefs[q])
+                continue;
+
+            batch.hits[q].push(SimResult(id, _2FLOAT(coef)));
+        }
+    }
+}
+
 SimStorage::~SimStorage()
 {
 }
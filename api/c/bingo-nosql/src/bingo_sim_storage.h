@@ -25,14 +25,24 @@ namespace bingo
 
         void add(const byte* fingerprint, int id);
 
+        void addBatch(const byte* fingerprints, const int* ids, int count);
+
         void optimize();
 
+        // Adds the mapped memory of the fingerprints searched by similarity
+        void collectRanges(MMFRanges& ranges);
+
+        // Appends the fingerprints of the cell and their ids
+        void collectCellFingerprints(int cell_idx, indigo::Array<byte>& fingerprints, indigo::Array<int>& ids);
+
         int getCellCount() const;
 
         int getCellSize(int cell_idx) const;
 
         void getCellsInterval(const byte* query, SimCoef& sim_coef, double min_coef, int& min_cell, int& max_cell);
 
+        double getCellUpperBound(int query_bit_count, SimCoef& sim_coef, int cell_idx);
+
         int firstFitCell(int query_bit_count, int min_cell, int max_cell) const;
 
         int nextFitCell(int query_bit_count, int first_fit_cell, int min_cell, int max_cell, int idx) const;
@@ -43,6 +53,10 @@ namespace bingo
 
         int getIncSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices);
 
+        void getSimilarBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef, int cell_idx, int cont_idx);
+
+        void getIncSimilarBatch(const SimBatch& batch, const indigo::Array<int>& active, SimCoef& sim_coef);
+
         ~SimStorage();
 
     private:
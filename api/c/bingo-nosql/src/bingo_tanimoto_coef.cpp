@@ -14,6 +14,24 @@ double TanimotoCoef::calcCoef(const byte* target, const byte* query, int target_
     return (double)common_bits / (common_bits + unique_bits);
 }
 
+void TanimotoCoef::calcCoefBatch(const byte* target, const byte* queries, int target_bit_count, const int* query_bit_counts, int count, double* coefs)
+{
+    int common_bits[COEF_BATCH_SIZE];
+
+    if (target_bit_count == -1)
+        target_bit_count = bitGetOnesCount(target, _fp_size);
+
+    for (int start = 0; start < count; start += COEF_BATCH_SIZE)
+    {
+        int n = std::min(count - start, COEF_BATCH_SIZE);
+        bitCommonOnesBatch(target, queries + (size_t)start * _fp_size, _fp_size, n, common_bits);
+
+        // |A ^ B| + |A & B| = |A| + |B| - |A & B|
+        for (int i = 0; i < n; i++)
+            coefs[start + i] = (double)common_bits[i] / (target_bit_count + query_bit_counts[start + i] - common_bits[i]);
+    }
+}
+
 double TanimotoCoef::calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count)
 {
     int min = (query_bit_count < max_target_bit_count ? query_bit_count : max_target_bit_count);
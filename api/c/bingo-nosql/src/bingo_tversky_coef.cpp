@@ -26,13 +26,32 @@ double TverskyCoef::calcCoef(const byte* target, const byte* query, int target_b
     return (double)common_bits / ((target_bit_count - common_bits) * _alpha + (query_bit_count - common_bits) * _beta + common_bits);
 }
 
+void TverskyCoef::calcCoefBatch(const byte* target, const byte* queries, int target_bit_count, const int* query_bit_counts, int count, double* coefs)
+{
+    int common_bits[COEF_BATCH_SIZE];
+
+    if (target_bit_count == -1)
+        target_bit_count = bitGetOnesCount(target, _fp_size);
+
+    for (int start = 0; start < count; start += COEF_BATCH_SIZE)
+    {
+        int n = std::min(count - start, COEF_BATCH_SIZE);
+        bitCommonOnesBatch(target, queries + (size_t)start * _fp_size, _fp_size, n, common_bits);
+
+        for (int i = 0; i < n; i++)
+            coefs[start + i] =
+                (double)common_bits[i] / ((target_bit_count - common_bits[i]) * _alpha + (query_bit_counts[start + i] - common_bits[i]) * _beta + common_bits[i]);
+    }
+}
+
 double TverskyCoef::calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count)
 {
     if (fabs(_alpha + _beta - 1) > 1e-7)
         return 1;
 
+    // The storages pass the query as the target of calcCoef, so alpha weighs the query bits
     int min = (query_bit_count < max_target_bit_count ? query_bit_count : max_target_bit_count);
-    return min / (_alpha * min_target_bit_count + _beta * query_bit_count);
+    return min / (_alpha * query_bit_count + _beta * min_target_bit_count);
 }
 
 double TverskyCoef::calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count, int m10, int m01)
@@ -45,5 +64,5 @@ double TverskyCoef::calcUpperBound(int query_bit_count, int min_target_bit_count
 
     int min = (b > max_a ? max_a : b);
 
-    return (double)min / (_alpha * min_target_bit_count + _beta * query_bit_count);
+    return (double)min / (_alpha * query_bit_count + _beta * min_target_bit_count);
 }
\ No newline at end of file
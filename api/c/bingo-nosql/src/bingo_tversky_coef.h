@@ -16,6 +16,8 @@ namespace bingo
 
         double calcCoef(const byte* target, const byte* query, int target_bit_count, int query_bit_count);
 
+        void calcCoefBatch(const byte* target, const byte* queries, int target_bit_count, const int* query_bit_counts, int count, double* coefs);
+
         double calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count);
 
         double calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count, int m10, int m01);
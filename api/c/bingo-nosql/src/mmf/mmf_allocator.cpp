@@ -19,11 +19,14 @@ int MMFAllocator::getAllocatorDataSize()
     return sizeof(MMFAllocatorData);
 }
 
-void MMFAllocator::create(const char* filename, size_t min_size, size_t max_size, const char* index_type, int index_id)
+void MMFAllocator::create(const char* filename, size_t min_size, size_t max_size, const char* index_type, int index_id, const MMFileOptions& options)
 {
     auto inst = std::make_unique<MMFAllocator>();
+    inst->_options = options;
 
-    inst->_mm_files.emplace_back(std::make_unique<MMFile>(_genFilename(0, filename), min_size, true, false));
+    inst->_max_files_count = 1 + MAX_FILES_COUNT;
+    inst->_mm_files.reserve(inst->_max_files_count);
+    inst->_mm_files.emplace_back(std::make_unique<MMFile>(_genFilename(0, filename), min_size, true, false, options));
     MMFile& file = *inst->_mm_files.at(0);
     const auto* mmf_ptr = file.ptr();
     if ((mmf_ptr == nullptr) || (min_size == 0) || (min_size < sizeof(MMFAllocator)))
@@ -36,6 +39,7 @@ void MMFAllocator::create(const char* filename, size_t min_size, size_t max_size
     allocator_data->_max_file_size = max_size;
     allocator_data->_cur_file_id = 0;
     inst->_filename.assign(filename);
+    inst->_files_count.store(1, std::memory_order_release);
     inst->_addHeader(index_type);
     {
         auto allocators = sf::xlock_safe_ptr(_allocators());
@@ -45,7 +49,7 @@ void MMFAllocator::create(const char* filename, size_t min_size, size_t max_size
     setDatabaseId(index_id);
 }
 
-void MMFAllocator::load(const char* filename, int index_id, bool read_only)
+void MMFAllocator::load(const char* filename, int index_id, bool read_only, const MMFileOptions& options)
 {
     auto name = _genFilename(0, filename);
     std::ifstream fstream(name.c_str(), std::ios::binary | std::ios::ate);
@@ -53,8 +57,9 @@ void MMFAllocator::load(const char* filename, int index_id, bool read_only)
     size_t size = fstream.tellg();
 
     auto inst = std::make_unique<MMFAllocator>();
+    inst->_options = options;
 
-    inst->_mm_files.emplace_back(std::make_unique<MMFile>(name, size, false, read_only));
+    inst->_mm_files.emplace_back(std::make_unique<MMFile>(name, size, false, read_only, options));
     MMFile& file = *inst->_mm_files.at(0);
     const auto* mmf_ptr = file.ptr();
     if ((mmf_ptr == nullptr) || (size == 0) || (size < sizeof(MMFAllocator)))
@@ -64,11 +69,15 @@ void MMFAllocator::load(const char* filename, int index_id, bool read_only)
 
     auto* allocator_data = static_cast<MMFAllocatorData*>(file.ptr(MAX_HEADER_LEN));
     inst->_filename.assign(filename);
+    // The table is sized for the existing files, so databases of any size load
+    inst->_max_files_count = allocator_data->_cur_file_id + 1 + MAX_FILES_COUNT;
+    inst->_mm_files.reserve(inst->_max_files_count);
     for (auto i = 1; i < allocator_data->_cur_file_id + 1; i++)
     {
         size_t file_size = _getFileSize(i, allocator_data->_min_file_size, allocator_data->_max_file_size, allocator_data->_existing_files);
-        inst->_mm_files.emplace_back(std::make_unique<MMFile>(_genFilename(i, inst->_filename.c_str()), file_size, false, read_only));
+        inst->_mm_files.emplace_back(std::make_unique<MMFile>(_genFilename(i, inst->_filename.c_str()), file_size, false, read_only, options));
     }
+    inst->_files_count.store(static_cast<int>(inst->_mm_files.size()), std::memory_order_release);
 
     {
         auto allocators = sf::xlock_safe_ptr(_allocators());
@@ -79,12 +88,65 @@ void MMFAllocator::load(const char* filename, int index_id, bool read_only)
 
 const void* MMFAllocator::get(int file_id, ptrdiff_t offset) const
 {
-    return _mm_files.at(static_cast<int>(file_id))->ptr(offset);
+    return _getFile(file_id).ptr(offset);
 }
 
 void* MMFAllocator::get(int file_id, ptrdiff_t offset)
 {
-    return _mm_files.at(static_cast<int>(file_id))->ptr(offset);
+    return _getFile(file_id).ptr(offset);
+}
+
+MMFile& MMFAllocator::_getFile(int file_id) const
+{
+    // Readers may resolve addresses while the writer adds a file. The file table
+    // is reserved up front, so only the published count needs synchronization
+    if (file_id < 0 || file_id >= _files_count.load(std::memory_order_acquire))
+        throw Exception("MMFAllocator: incorrect file id %d", file_id);
+    return *_mm_files.data()[file_id];
+}
+
+void MMFAllocator::advise(MMFAddress address, size_t len, MMFAdvice advice)
+{
+    _getFile(address.file_id).advise(address.offset, len, advice);
+}
+
+void MMFAllocator::prefetch(MMFAddress address, size_t len)
+{
+    MMFile& file = _getFile(address.file_id);
+    // Let the system read the range ahead before it is touched page by page
+    file.advise(address.offset, len, MMFAdvice::WILL_NEED);
+    file.prefetch(address.offset, len);
+}
+
+void MMFRanges::add(MMFAddress address, size_t len)
+{
+    if (len == 0 || address == MMFAddress::null)
+        return;
+
+    if (!_ranges.empty())
+    {
+        _Range& last = _ranges.back();
+        if (last.address.file_id == address.file_id && last.address.offset + static_cast<ptrdiff_t>(last.len) == address.offset)
+        {
+            last.len += len;
+            return;
+        }
+    }
+    _ranges.push_back({address, len});
+}
+
+void MMFRanges::advise(MMFAdvice advice) const
+{
+    MMFAllocator& allocator = MMFAllocator::getAllocator();
+    for (const _Range& range : _ranges)
+        allocator.advise(range.address, range.len, advice);
+}
+
+void MMFRanges::prefetch() const
+{
+    MMFAllocator& allocator = MMFAllocator::getAllocator();
+    for (const _Range& range : _ranges)
+        allocator.prefetch(range.address, range.len);
 }
 
 size_t MMFAllocator::_getFileSize(size_t idx, size_t min_size, size_t max_size, dword existing_files)
@@ -133,7 +195,11 @@ void MMFAllocator::_addFile(size_t alloc_size)
     if (alloc_size > file_size)
         throw Exception("MMFAllocator: Too big allocation size");
 
-    _mm_files.emplace_back(std::make_unique<MMFile>(_genFilename(_mm_files.size(), _filename.c_str()), file_size, true, false));
+    if (_mm_files.size() >= _max_files_count)
+        throw Exception("MMFAllocator: file count limit is exceeded");
+
+    _mm_files.emplace_back(std::make_unique<MMFile>(_genFilename(_mm_files.size(), _filename.c_str()), file_size, true, false, _options));
+    _files_count.store(static_cast<int>(_mm_files.size()), std::memory_order_release);
 
     allocator_data->_cur_file_id++;
     allocator_data->_free_off = 0;
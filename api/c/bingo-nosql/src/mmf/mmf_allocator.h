@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -20,8 +21,9 @@ namespace bingo
 
         static int getAllocatorDataSize();
 
-        static void create(const char* filename, size_t min_size, size_t max_size, const char* index_type, int index_id);
-        static void load(const char* filename, int index_id, bool read_only);
+        static void create(const char* filename, size_t min_size, size_t max_size, const char* index_type, int index_id,
+                           const MMFileOptions& options = MMFileOptions());
+        static void load(const char* filename, int index_id, bool read_only, const MMFileOptions& options = MMFileOptions());
         void close();
 
         static MMFAllocator& getAllocator();
@@ -29,6 +31,9 @@ namespace bingo
         const void* get(int file_id, ptrdiff_t offset) const;
         void* get(int file_id, ptrdiff_t offset);
 
+        void advise(MMFAddress address, size_t len, MMFAdvice advice);
+        void prefetch(MMFAddress address, size_t len);
+
         template <typename T>
         MMFAddress allocate(int count = 1)
         {
@@ -62,6 +67,8 @@ namespace bingo
         static void setDatabaseId(int db_id);
 
         static constexpr const int MAX_HEADER_LEN = 128;
+        // Number of files that can be added after the database is created or loaded
+        static constexpr const size_t MAX_FILES_COUNT = 4096;
 
     private:
         struct MMFAllocatorData
@@ -81,6 +88,8 @@ namespace bingo
 
         void _addFile(size_t alloc_size);
 
+        MMFile& _getFile(int file_id) const;
+
         static size_t _getFileSize(size_t idx, size_t min_size, size_t max_size, dword sizes);
 
         static std::string _genFilename(int idx, const char* filename);
@@ -89,10 +98,35 @@ namespace bingo
 
         std::string _filename;
         std::vector<std::unique_ptr<MMFile>> _mm_files;
+        std::atomic<int> _files_count{0};
+        size_t _max_files_count = 0;
+        MMFileOptions _options;
 
         static sf::safe_shared_hide_obj<std::unordered_map<int, std::unique_ptr<MMFAllocator>>>& _allocators();
 
         static thread_local MMFAllocator* _current_allocator;
         static thread_local int _current_db_id;
     };
+
+    // Set of mapped ranges of the current database that are advised or
+    // prefetched together. Adjacent ranges of the same file are merged,
+    // so storages built from many small allocations need few system calls
+    class MMFRanges
+    {
+    public:
+        void add(MMFAddress address, size_t len);
+
+        void advise(MMFAdvice advice) const;
+
+        void prefetch() const;
+
+    private:
+        struct _Range
+        {
+            MMFAddress address;
+            size_t len;
+        };
+
+        std::vector<_Range> _ranges;
+    };
 }
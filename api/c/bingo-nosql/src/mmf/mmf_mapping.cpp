@@ -81,6 +81,25 @@ void MMFMapping::remove(size_t id)
     it->buf[idx_in_block].second = -1;
 }
 
+size_t MMFMapping::getBucket(size_t id1)
+{
+    return _hashFunc(id1);
+}
+
+void MMFMapping::getBucketPairs(size_t bucket, std::vector<std::pair<size_t, size_t>>& pairs)
+{
+    if (_mapping_table[bucket].getAddress() == MMFAddress::null)
+        return;
+
+    _MapList& cur_list = _mapping_table[bucket].ref();
+
+    for (_MapList::Iterator it = cur_list.begin(); it != cur_list.end(); it++)
+    {
+        const _KeyPair* buf = it->buf.ptr();
+        pairs.insert(pairs.end(), buf, buf + it->count);
+    }
+}
+
 size_t MMFMapping::_hashFunc(size_t id)
 {
     return (id % _prime);
@@ -23,6 +23,13 @@ namespace bingo
 
         void remove(size_t id);
 
+        // Bucket of the table holding the key. Keys looked up in the order
+        // of their buckets read the table sequentially
+        size_t getBucket(size_t id1);
+
+        // Appends all the pairs of the bucket
+        void getBucketPairs(size_t bucket, std::vector<std::pair<size_t, size_t>>& pairs);
+
     private:
         typedef std::pair<size_t, size_t> _KeyPair;
 
@@ -1,5 +1,6 @@
 #include "mmfile.h"
 
+#include <algorithm>
 #include <utility>
 
 #include "base_cpp/exception.h"
@@ -19,6 +20,19 @@
 using namespace bingo;
 using namespace indigo;
 
+static size_t _pageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return static_cast<size_t>(info.dwPageSize);
+#elif (defined __GNUC__ || defined __APPLE__)
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 4096;
+#endif
+}
+
 void* MMFile::ptr(const ptrdiff_t offset)
 {
     return static_cast<void*>(static_cast<byte*>(_ptr) + offset);
@@ -53,7 +67,8 @@ size_t MMFile::size() const
     return _len;
 }
 
-MMFile::MMFile(std::string filename, size_t buf_size, bool create_flag, bool read_only) : _len(buf_size), _filename(std::move(filename))
+MMFile::MMFile(std::string filename, size_t buf_size, bool create_flag, bool read_only, const MMFileOptions& options)
+    : _len(buf_size), _filename(std::move(filename))
 {
     if (create_flag)
     {
@@ -96,6 +111,8 @@ MMFile::MMFile(std::string filename, size_t buf_size, bool create_flag, bool rea
     if (_ptr == nullptr)
         throw Exception("MMF: Could not map view of file. Error message: %s", _getSystemErrorMsg());
 
+    if (options.populate)
+        prefetch(0, _len);
 #elif (defined __GNUC__ || defined __APPLE__)
     int flags;
     mode_t permissions = 0;
@@ -122,14 +139,65 @@ MMFile::MMFile(std::string filename, size_t buf_size, bool create_flag, bool rea
     if (read_only)
         prot_flags = PROT_READ;
 
-    _ptr = mmap(static_cast<caddr_t>(nullptr), _len, prot_flags, MAP_SHARED, _fd, 0);
+    int map_flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (options.populate)
+        map_flags |= MAP_POPULATE;
+#endif
+
+    _ptr = mmap(static_cast<caddr_t>(nullptr), _len, prot_flags, map_flags, _fd, 0);
 
     if (_ptr == MAP_FAILED)
     {
         _ptr = nullptr;
         throw Exception("MMF: Could not map view of file. Error message: %s", _getSystemErrorMsg());
     }
+
+#ifdef MADV_HUGEPAGE
+    // Only a hint: file backed huge pages depend on the kernel and the file system
+    if (options.huge_pages)
+        madvise(_ptr, _len, MADV_HUGEPAGE);
 #endif
+#ifndef MAP_POPULATE
+    if (options.populate)
+        prefetch(0, _len);
+#endif
+#endif
+}
+
+void MMFile::advise(ptrdiff_t offset, size_t len, MMFAdvice advice)
+{
+#if !defined _WIN32 && (defined __GNUC__ || defined __APPLE__)
+    static const size_t page_size = _pageSize();
+
+    // madvise needs a page aligned start
+    size_t begin = static_cast<size_t>(offset) / page_size * page_size;
+    size_t end = std::min(static_cast<size_t>(offset) + len, _len);
+    if (begin >= end)
+        return;
+
+    int flag = MADV_NORMAL;
+    if (advice == MMFAdvice::RANDOM)
+        flag = MADV_RANDOM;
+    else if (advice == MMFAdvice::SEQUENTIAL)
+        flag = MADV_SEQUENTIAL;
+    else if (advice == MMFAdvice::WILL_NEED)
+        flag = MADV_WILLNEED;
+    madvise(static_cast<byte*>(_ptr) + begin, end - begin, flag);
+#endif
+}
+
+void MMFile::prefetch(ptrdiff_t offset, size_t len) const
+{
+    static const size_t page_size = _pageSize();
+    size_t end = std::min(static_cast<size_t>(offset) + len, _len);
+    const volatile byte* data = static_cast<const volatile byte*>(_ptr);
+    byte sum = 0;
+    for (size_t pos = static_cast<size_t>(offset); pos < end; pos += page_size)
+        sum += data[pos];
+    if (end > static_cast<size_t>(offset))
+        sum += data[end - 1];
+    (void)sum;
 }
 
 MMFile::~MMFile()
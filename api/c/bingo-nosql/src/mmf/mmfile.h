@@ -9,10 +9,26 @@
 
 namespace bingo
 {
+    struct MMFileOptions
+    {
+        // Fault in the whole file when it is mapped
+        bool populate = false;
+        // Ask for transparent huge pages where the system supports them
+        bool huge_pages = false;
+    };
+
+    enum class MMFAdvice
+    {
+        NORMAL,
+        RANDOM,
+        SEQUENTIAL,
+        WILL_NEED
+    };
+
     class MMFile
     {
     public:
-        MMFile(std::string filename, size_t buf_size, bool create_flag, bool read_only);
+        MMFile(std::string filename, size_t buf_size, bool create_flag, bool read_only, const MMFileOptions& options = MMFileOptions());
         ~MMFile();
 
         MMFile& operator=(const MMFile&) = delete;
@@ -28,6 +44,12 @@ namespace bingo
 
         size_t size() const;
 
+        // Hints the expected access pattern of the range, does nothing where not supported
+        void advise(ptrdiff_t offset, size_t len, MMFAdvice advice);
+
+        // Reads the range page by page so that it is resident
+        void prefetch(ptrdiff_t offset, size_t len) const;
+
     private:
 #ifdef _WIN32
         void* _h_map_file;
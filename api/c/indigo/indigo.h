@@ -79,6 +79,11 @@ CEXPORT const char* indigoGetLastError(void);
 typedef void (*INDIGO_ERROR_HANDLER)(const char* message, void* context);
 CEXPORT void indigoSetErrorHandler(INDIGO_ERROR_HANDLER handler, void* context);
 
+// Objects are referred to by positive handles. A handle is not a sequence
+// number and is never given out again in the session once the object is freed.
+// A session holds up to 2^22 - 1 objects at a time and creates about 2^31
+// objects over its lifetime
+
 // Free an object
 CEXPORT int indigoFree(int handle);
 // Clone an object
@@ -985,6 +990,10 @@ CEXPORT int indigoIterateSmiles(int reader);
 CEXPORT int indigoIterateCML(int reader);
 CEXPORT int indigoIterateCDX(int reader);
 
+// With the "iterate-file-thread-count" option set to N > 0, SDF and SMILES files
+// are memory-mapped or read by large blocks, and with N > 1 the records are
+// parsed ahead by N threads and returned in the file order. indigoAt() is not
+// supported by such iterators
 CEXPORT int indigoIterateSDFile(const char* filename);
 CEXPORT int indigoIterateRDFile(const char* filename);
 CEXPORT int indigoIterateSmilesFile(const char* filename);
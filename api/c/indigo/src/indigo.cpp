@@ -183,16 +183,14 @@ Indigo::Indigo()
 
 void Indigo::removeAllObjects()
 {
-    auto objects_holder = sf::xlock_safe_ptr(_objects_holder);
 #ifdef INDIGO_OBJECT_DEBUG
-    for (const auto& item : objects_holder->objects)
-    {
+    _objects.forEach([](int handle) {
         std::stringstream ss;
-        ss << "~IndigoObject(" << TL_GET_SESSION_ID() << ", " << item.first << ")";
+        ss << "~IndigoObject(" << TL_GET_SESSION_ID() << ", " << handle << ")";
         std::cout << ss.str() << std::endl;
-    }
+    });
 #endif
-    objects_holder->objects.clear();
+    _objects.removeAll();
 }
 
 void Indigo::updateCancellationHandler()
@@ -435,63 +433,41 @@ CEXPORT void indigoSetErrorMessage(const char* message)
 
 int Indigo::addObject(IndigoObject* obj)
 {
-    auto objects_holder = sf::xlock_safe_ptr(_objects_holder);
-    int id = objects_holder->next_id++;
-#ifdef INDIGO_OBJECT_DEBUG
-    std::stringstream ss;
-    ss << "IndigoObject(" << TL_GET_SESSION_ID() << ", " << id << ")";
-    std::cout << ss.str() << std::endl;
-#endif
-    objects_holder->objects.emplace(id, std::unique_ptr<IndigoObject>(obj));
-    return id;
+    return addObject(std::unique_ptr<IndigoObject>(obj));
 }
 
 int Indigo::addObject(std::unique_ptr<IndigoObject>&& obj)
 {
-    auto objects_holder = sf::xlock_safe_ptr(_objects_holder);
-    int id = objects_holder->next_id++;
+    int id = _objects.add(std::move(obj));
 #ifdef INDIGO_OBJECT_DEBUG
     std::stringstream ss;
     ss << "IndigoObject(" << TL_GET_SESSION_ID() << ", " << id << ")";
     std::cout << ss.str() << std::endl;
 #endif
-    objects_holder->objects.emplace(id, std::move(obj));
     return id;
 }
 
 void Indigo::removeObject(int id)
 {
-    auto objects_holder = sf::xlock_safe_ptr(_objects_holder);
 #ifdef INDIGO_OBJECT_DEBUG
     std::stringstream ss;
     ss << "~IndigoObject(" << TL_GET_SESSION_ID() << ", " << id << ")";
     std::cout << ss.str() << std::endl;
 #endif
-    if (objects_holder->objects.count(id) == 0)
-    {
-        return;
-    }
-    objects_holder->objects.erase(id);
+    _objects.remove(id);
 }
 
 IndigoObject& Indigo::getObject(int handle)
 {
-    auto objects_holder = sf::slock_safe_ptr(_objects_holder);
-
-    try
-    {
-        return *objects_holder->objects.at(handle);
-    }
-    catch (const std::out_of_range& e)
-    {
-        throw IndigoError("can not access object #%d: %s", handle, e.what());
-    }
+    IndigoObject* obj = _objects.get(handle);
+    if (obj == nullptr)
+        throw IndigoError("can not access object #%d: no such object", handle);
+    return *obj;
 }
 
 int Indigo::countObjects() const
 {
-    auto objects_holder = sf::slock_safe_ptr(_objects_holder);
-    return objects_holder->objects.size();
+    return _objects.count();
 }
 
 void Indigo::TmpData::clear()
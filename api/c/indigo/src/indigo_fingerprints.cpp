@@ -38,6 +38,13 @@ IndigoFingerprint::~IndigoFingerprint()
 {
 }
 
+IndigoObject* IndigoFingerprint::clone()
+{
+    auto res = std::make_unique<IndigoFingerprint>();
+    res->bytes.copy(bytes);
+    return res.release();
+}
+
 IndigoFingerprint& IndigoFingerprint::cast(IndigoObject& obj)
 {
     if (obj.type == IndigoObject::FINGERPRINT)
@@ -34,6 +34,7 @@ public:
 
     void toString(Array<char>& str) override;
     void toBuffer(Array<char>& buf) override;
+    IndigoObject* clone() override;
 
     static IndigoFingerprint& cast(IndigoObject& obj);
 
@@ -29,6 +29,7 @@
 
 #include "indigo.h"
 #include "indigo_abbreviations.h"
+#include "indigo_object_table.h"
 
 #include "base_cpp/cancellation_handler.h"
 #include "base_cpp/exception.h"
@@ -181,6 +182,7 @@ public:
         JSON_REACTION,
         MONOMER_LIBRARY,
         KET_DOCUMENT,
+        RECORD_FILE_LOADER,
         INDIGO_OBJECT_LAST_TYPE // must be the last element in the enum
     };
 
@@ -360,7 +362,10 @@ public:
     bool embedding_edges_uniqueness, find_unique_embeddings;
     int max_embeddings;
 
-    int bingonosql_tau_sub_search_thread_count = 1; // default is 1 -- no multithread
+    int bingonosql_sub_search_thread_count = 1; // default is 1 -- no multithread
+    bool bingonosql_sub_search_ordered = false; // multithreaded search returns results as soon as they are found
+    int bingonosql_insert_thread_count = 1;     // threads preparing records in bingoInsertIteratorObj, 1 -- no multithread
+    int iterate_file_thread_count = 0;          // threads reading records in indigoIterateSDFile and indigoIterateSmilesFile, 0 -- classic loaders
 
     int layout_max_iterations = 0; // default is zero -- no limit
     bool smart_layout = false;
@@ -408,12 +413,7 @@ private:
     static INDIGO_ERROR_HANDLER& error_handler();
     static void*& error_handler_context();
 
-    struct ObjectsHolder
-    {
-        std::unordered_map<int, std::unique_ptr<IndigoObject>> objects;
-        int next_id = 1;
-    };
-    sf::safe_shared_hide_obj<ObjectsHolder> _objects_holder;
+    IndigoObjectTable _objects;
     int _indigo_id;
     std::unique_ptr<abbreviations::IndigoAbbreviations> _abbreviations = nullptr;
 };
@@ -500,6 +500,187 @@ IndigoObject* IndigoMultilineSmilesLoader::at(int index)
     return next();
 }
 
+// Records parsed ahead of the ones handed out, per reading thread
+static const int RECORD_FILE_LOADER_WINDOW = 1024;
+
+// Small ranges keep the reading threads close to the records handed out
+static const size_t RECORD_FILE_LOADER_RANGE_SIZE = 16 * 1024;
+
+namespace
+{
+    // Thrown from the record handler to stop the reading threads
+    struct RecordFileLoaderStop
+    {
+    };
+}
+
+IndigoRecordFileLoader::IndigoRecordFileLoader(const char* filename, RecordFileReader::Format format, int thread_count)
+    : IndigoObject(RECORD_FILE_LOADER), _reader(indigoGetInstance().filename_encoding, filename, format), _format(format), _thread_count(thread_count),
+      _offset(0LL), _has_pending(false), _next_index(0LL), _started(false), _done(false), _stop_request(false)
+{
+}
+
+IndigoRecordFileLoader::~IndigoRecordFileLoader()
+{
+    _stopReading();
+}
+
+IndigoObject* IndigoRecordFileLoader::next()
+{
+    if (!_fetch())
+        return 0;
+
+    _has_pending = false;
+    _offset = _pending.next_offset;
+    return _pending.object.release();
+}
+
+bool IndigoRecordFileLoader::hasNext()
+{
+    return _fetch();
+}
+
+long long IndigoRecordFileLoader::tell()
+{
+    return _offset;
+}
+
+int IndigoRecordFileLoader::count()
+{
+    return (int)_reader.count();
+}
+
+bool IndigoRecordFileLoader::_fetch()
+{
+    if (_has_pending)
+        return true;
+
+    if (_thread_count <= 1)
+    {
+        RecordFileReader::Record record;
+        if (!_reader.next(record))
+            return false;
+
+        _pending = _createItem(record);
+        _has_pending = true;
+        return true;
+    }
+
+    if (!_started)
+        _startReading();
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    while (true)
+    {
+        auto it = _ready.find(_next_index);
+        if (it != _ready.end())
+        {
+            _pending = std::move(it->second);
+            _ready.erase(it);
+            _next_index++;
+            _has_pending = true;
+            _cv_space.notify_all();
+            return true;
+        }
+
+        if (_error)
+            std::rethrow_exception(_error);
+        if (_done)
+            return false;
+
+        _cv_ready.wait(lock);
+    }
+}
+
+IndigoRecordFileLoader::_Item IndigoRecordFileLoader::_createItem(const RecordFileReader::Record& record)
+{
+    Array<char> data;
+    data.copy(record.data, (int)record.size);
+
+    _Item item;
+    item.next_offset = record.next_offset;
+
+    if (_format == RecordFileReader::Format::SDF)
+    {
+        PropertiesMap properties;
+        RecordFileReader::readSdfProperties(record, properties);
+        item.object = std::make_unique<IndigoRdfMolecule>(data, properties, (int)record.index, record.offset);
+    }
+    else if (data.find('>') == -1)
+        item.object = std::make_unique<IndigoSmilesMolecule>(data, (int)record.index, record.offset);
+    else
+        item.object = std::make_unique<IndigoSmilesReaction>(data, (int)record.index, record.offset);
+
+    return item;
+}
+
+void IndigoRecordFileLoader::_startReading()
+{
+    _started = true;
+    _producer = std::thread(&IndigoRecordFileLoader::_readRecords, this, TL_GET_SESSION_ID());
+}
+
+void IndigoRecordFileLoader::_stopReading()
+{
+    if (!_producer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop_request = true;
+        _cv_space.notify_all();
+    }
+    _producer.join();
+}
+
+void IndigoRecordFileLoader::_readRecords(qword session_id)
+{
+    // The reading threads work in the session of the loader to use its loading options
+    TL_SET_SESSION_ID(session_id);
+
+    try
+    {
+        _reader.forEach(
+            _thread_count,
+            [this](const RecordFileReader::Record& record) {
+                _Item item = _createItem(record);
+                try
+                {
+                    if (item.object->type == SMILES_REACTION)
+                        item.object->getReaction();
+                    else
+                        item.object->getMolecule();
+                }
+                catch (Exception&)
+                {
+                    // Broken records fail again when they are asked for
+                }
+
+                std::unique_lock<std::mutex> lock(_mtx);
+                _cv_space.wait(lock, [&]() { return _stop_request || record.index < _next_index + _thread_count * RECORD_FILE_LOADER_WINDOW; });
+                if (_stop_request)
+                    throw RecordFileLoaderStop();
+
+                _ready.emplace(record.index, std::move(item));
+                if (record.index == _next_index)
+                    _cv_ready.notify_one();
+            },
+            RECORD_FILE_LOADER_RANGE_SIZE);
+    }
+    catch (RecordFileLoaderStop&)
+    {
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    _done = true;
+    _cv_ready.notify_one();
+}
+
 CEXPORT int indigoIterateSDF(int reader)
 {
     INDIGO_BEGIN
@@ -548,6 +729,8 @@ CEXPORT int indigoTell(int handle)
             size = ((IndigoRdfLoader&)obj).tell();
         else if (obj.type == IndigoObject::MULTILINE_SMILES_LOADER)
             size = ((IndigoMultilineSmilesLoader&)obj).tell();
+        else if (obj.type == IndigoObject::RECORD_FILE_LOADER)
+            size = ((IndigoRecordFileLoader&)obj).tell();
         else if (obj.type == IndigoObject::RDF_MOLECULE || obj.type == IndigoObject::RDF_REACTION || obj.type == IndigoObject::SMILES_MOLECULE ||
                  obj.type == IndigoObject::SMILES_REACTION)
             size = ((IndigoRdfData&)obj).tell();
@@ -586,6 +769,8 @@ CEXPORT long long indigoTell64(int handle)
             return ((IndigoRdfLoader&)obj).tell();
         if (obj.type == IndigoObject::MULTILINE_SMILES_LOADER)
             return ((IndigoMultilineSmilesLoader&)obj).tell();
+        if (obj.type == IndigoObject::RECORD_FILE_LOADER)
+            return ((IndigoRecordFileLoader&)obj).tell();
         if (obj.type == IndigoObject::RDF_MOLECULE || obj.type == IndigoObject::RDF_REACTION || obj.type == IndigoObject::SMILES_MOLECULE ||
             obj.type == IndigoObject::SMILES_REACTION)
             return ((IndigoRdfData&)obj).tell();
@@ -611,6 +796,9 @@ CEXPORT int indigoIterateSDFile(const char* filename)
 {
     INDIGO_BEGIN
     {
+        if (self.iterate_file_thread_count > 0)
+            return self.addObject(new IndigoRecordFileLoader(filename, RecordFileReader::Format::SDF, self.iterate_file_thread_count));
+
         return self.addObject(new IndigoSdfLoader(filename));
     }
     INDIGO_END(-1);
@@ -629,6 +817,9 @@ CEXPORT int indigoIterateSmilesFile(const char* filename)
 {
     INDIGO_BEGIN
     {
+        if (self.iterate_file_thread_count > 0)
+            return self.addObject(new IndigoRecordFileLoader(filename, RecordFileReader::Format::LINES, self.iterate_file_thread_count));
+
         return self.addObject(new IndigoMultilineSmilesLoader(filename));
     }
     INDIGO_END(-1);
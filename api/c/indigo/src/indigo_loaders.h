@@ -21,12 +21,19 @@
 
 #include "indigo_internal.h"
 
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+
 #include <rapidjson/document.h>
 
 #include "base_cpp/properties_map.h"
 #include "molecule/molecule.h"
 #include "molecule/molecule_json_loader.h"
 #include "molecule/query_molecule.h"
+#include "molecule/record_file_reader.h"
 #include "reaction/reaction.h"
 
 class IndigoRdfData : public IndigoObject
@@ -211,6 +218,58 @@ protected:
     long long _max_offset;
 };
 
+// Loader of SDF and SMILES files used by indigoIterateSDFile() and indigoIterateSmilesFile()
+// when the "iterate-file-thread-count" option is set. Records are read by RecordFileReader.
+// With several threads the records are parsed ahead by the reader threads and handed out
+// in the file order
+class IndigoRecordFileLoader : public IndigoObject
+{
+public:
+    IndigoRecordFileLoader(const char* filename, RecordFileReader::Format format, int thread_count);
+    ~IndigoRecordFileLoader() override;
+
+    IndigoObject* next() override;
+    bool hasNext() override;
+
+    long long tell();
+    int count();
+
+protected:
+    struct _Item
+    {
+        std::unique_ptr<IndigoObject> object;
+        long long next_offset;
+    };
+
+    bool _fetch();
+    _Item _createItem(const RecordFileReader::Record& record);
+
+    void _startReading();
+    void _stopReading();
+    void _readRecords(qword session_id);
+
+    RecordFileReader _reader;
+    RecordFileReader::Format _format;
+    int _thread_count;
+    long long _offset;
+
+    // The record to be handed out next
+    _Item _pending;
+    bool _has_pending;
+
+    // Records parsed ahead by the reader threads, by their indices
+    std::thread _producer;
+    std::mutex _mtx;
+    std::condition_variable _cv_ready;
+    std::condition_variable _cv_space;
+    std::map<long long, _Item> _ready;
+    long long _next_index;
+    bool _started;
+    bool _done;
+    bool _stop_request;
+    std::exception_ptr _error;
+};
+
 namespace indigo
 {
     class MultipleCmlLoader;
@@ -320,8 +320,11 @@ IndigoMoleculeSubstructureMatchIter::IndigoMoleculeSubstructureMatchIter(Molecul
                                                                          bool disable_folding_query_h)
     : IndigoObject(MOLECULE_SUBSTRUCTURE_MATCH_ITER), matcher(target_), target(target_), original_target(original_target_), query(query_)
 {
+    compiled_query.disable_folding_query_h = disable_folding_query_h;
+    compiled_query.compile(query);
+
     matcher.disable_folding_query_h = disable_folding_query_h;
-    matcher.setQuery(query);
+    matcher.setQuery(compiled_query);
     matcher.fmcache = &fmcache;
 
     matcher.use_pi_systems_matcher = resonance;
@@ -65,6 +65,7 @@ public:
 
     const char* debugInfo() const override;
 
+    CompiledSubstructureQuery compiled_query;
     MoleculeSubstructureMatcher matcher;
     MoleculeSubstructureMatcher::FragmentMatchCache fmcache;
 
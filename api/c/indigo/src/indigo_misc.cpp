@@ -854,6 +854,9 @@ CEXPORT int indigoCount(int item)
         if (obj.type == IndigoObject::MULTILINE_SMILES_LOADER)
             return ((IndigoMultilineSmilesLoader&)obj).count();
 
+        if (obj.type == IndigoObject::RECORD_FILE_LOADER)
+            return ((IndigoRecordFileLoader&)obj).count();
+
         throw IndigoError("indigoCount(): can not handle %s", obj.debugInfo());
     }
     INDIGO_END(-1);
@@ -129,6 +129,7 @@ IndigoObjectTypes::IndigoObjectTypes()
     emplace(IndigoObject::JSON_REACTION, "<JsonReaction>");
     emplace(IndigoObject::MONOMER_LIBRARY, "<MonomerLibrary>");
     emplace(IndigoObject::KET_DOCUMENT, "<KetDocument>");
+    emplace(IndigoObject::RECORD_FILE_LOADER, "<RecordFileLoader>");
 
     if (size() != IndigoObject::INDIGO_OBJECT_LAST_TYPE - 1)
     {
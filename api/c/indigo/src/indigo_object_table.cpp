@@ -0,0 +1,193 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include "indigo_object_table.h"
+
+#include <functional>
+#include <thread>
+
+#include "indigo_internal.h"
+
+IndigoObjectTable::IndigoObjectTable()
+{
+    for (auto& chunk : _chunks)
+        chunk.store(nullptr, std::memory_order_relaxed);
+}
+
+IndigoObjectTable::~IndigoObjectTable()
+{
+    removeAll();
+    for (auto& chunk : _chunks)
+        delete[] chunk.load(std::memory_order_relaxed);
+}
+
+int IndigoObjectTable::_chunkIndex(int pos, int& offset)
+{
+    unsigned int value = (unsigned int)pos + (1U << FIRST_CHUNK_BITS);
+    int top = 0;
+    while ((value >> (top + 1)) != 0)
+        top++;
+    offset = (int)(value - (1U << top));
+    return top - FIRST_CHUNK_BITS;
+}
+
+int IndigoObjectTable::_position(int handle)
+{
+    return (handle & ((1 << POSITION_BITS) - 1)) - 1;
+}
+
+IndigoObjectTable::Slot* IndigoObjectTable::_slot(int pos) const
+{
+    int offset;
+    Slot* chunk = _chunks[_chunkIndex(pos, offset)].load(std::memory_order_acquire);
+    if (chunk == nullptr)
+        return nullptr;
+    return chunk + offset;
+}
+
+IndigoObjectTable::FreeList& IndigoObjectTable::_localFreeList()
+{
+    static thread_local const size_t shard = std::hash<std::thread::id>()(std::this_thread::get_id()) % FREE_LIST_SHARDS;
+    return _free_lists[shard];
+}
+
+IndigoObjectTable::Slot& IndigoObjectTable::_acquireSlot(int& pos)
+{
+    FreeList& local = _localFreeList();
+    {
+        std::lock_guard<std::mutex> guard(local.lock);
+        if (!local.positions.empty())
+        {
+            pos = local.positions.back();
+            local.positions.pop_back();
+            return *_slot(pos);
+        }
+    }
+
+    // Take a slot that another thread has released before growing the table,
+    // otherwise a producer/consumer pair of threads would never reuse slots
+    for (auto& other : _free_lists)
+    {
+        if (&other == &local)
+            continue;
+        std::unique_lock<std::mutex> guard(other.lock, std::try_to_lock);
+        if (guard.owns_lock() && !other.positions.empty())
+        {
+            pos = other.positions.back();
+            other.positions.pop_back();
+            return *_slot(pos);
+        }
+    }
+
+    pos = _end.fetch_add(1, std::memory_order_relaxed);
+    if (pos >= (1 << POSITION_BITS) - 1)
+    {
+        _end.fetch_sub(1, std::memory_order_relaxed);
+        throw IndigoError("object handles are exhausted, %d objects are alive", count());
+    }
+
+    int offset;
+    int chunk_index = _chunkIndex(pos, offset);
+    Slot* chunk = _chunks[chunk_index].load(std::memory_order_acquire);
+    if (chunk == nullptr)
+    {
+        std::lock_guard<std::mutex> guard(_chunks_lock);
+        chunk = _chunks[chunk_index].load(std::memory_order_relaxed);
+        if (chunk == nullptr)
+        {
+            chunk = new Slot[1 << (chunk_index + FIRST_CHUNK_BITS)];
+            _chunks[chunk_index].store(chunk, std::memory_order_release);
+        }
+    }
+    return chunk[offset];
+}
+
+void IndigoObjectTable::_releaseSlot(int pos)
+{
+    // A reused slot would give out a handle that was already freed once
+    if (_slot(pos)->generation == GENERATION_MASK)
+        return;
+
+    FreeList& local = _localFreeList();
+    std::lock_guard<std::mutex> guard(local.lock);
+    local.positions.push_back(pos);
+}
+
+int IndigoObjectTable::add(std::unique_ptr<IndigoObject>&& obj)
+{
+    int pos;
+    Slot& slot = _acquireSlot(pos);
+
+    slot.generation++;
+    int handle = (slot.generation << POSITION_BITS) | (pos + 1);
+
+    slot.object.store(obj.release(), std::memory_order_relaxed);
+    slot.handle.store(handle, std::memory_order_release);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    return handle;
+}
+
+IndigoObject* IndigoObjectTable::get(int handle) const
+{
+    if (handle <= 0)
+        return nullptr;
+    int pos = _position(handle);
+    if (pos < 0 || pos >= _end.load(std::memory_order_acquire))
+        return nullptr;
+    const Slot* slot = _slot(pos);
+    if (slot == nullptr || slot->handle.load(std::memory_order_acquire) != handle)
+        return nullptr;
+    return slot->object.load(std::memory_order_relaxed);
+}
+
+bool IndigoObjectTable::remove(int handle)
+{
+    if (handle <= 0)
+        return false;
+    int pos = _position(handle);
+    if (pos < 0 || pos >= _end.load(std::memory_order_acquire))
+        return false;
+    Slot* slot = _slot(pos);
+    if (slot == nullptr)
+        return false;
+
+    // Only one of the threads releasing the same handle wins the slot
+    int expected = handle;
+    if (!slot->handle.compare_exchange_strong(expected, 0, std::memory_order_acq_rel))
+        return false;
+
+    std::unique_ptr<IndigoObject> obj(slot->object.exchange(nullptr, std::memory_order_relaxed));
+    _count.fetch_sub(1, std::memory_order_relaxed);
+    _releaseSlot(pos);
+    return true;
+}
+
+int IndigoObjectTable::removeAll()
+{
+    int removed = 0;
+    forEach([&](int handle) {
+        if (remove(handle))
+            removed++;
+    });
+    return removed;
+}
+
+int IndigoObjectTable::count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
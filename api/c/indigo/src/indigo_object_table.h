@@ -0,0 +1,117 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __indigo_object_table__
+#define __indigo_object_table__
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base_c/defs.h"
+
+class IndigoObject;
+
+// Handle table of an Indigo session.
+//
+// Slots live in chunks of geometrically growing size that are never moved or
+// released before the table itself, so a handle is resolved with two atomic
+// loads and no lock. A handle is (generation << 22) | (position + 1): the
+// generation counter makes a freed handle invalid even after its slot is reused.
+// A slot whose 511 generations are used up is retired rather than reused, so a
+// handle is never handed out twice. A table holds up to 2^22 - 1 live objects
+// and hands out about 2^31 handles over its lifetime, the same as the former
+// int id counter; after that add() throws.
+// Freed slots go to free lists sharded by thread, so threads creating and
+// releasing objects do not contend with each other.
+class DLLEXPORT IndigoObjectTable
+{
+public:
+    IndigoObjectTable();
+    ~IndigoObjectTable();
+
+    IndigoObjectTable(const IndigoObjectTable&) = delete;
+    IndigoObjectTable& operator=(const IndigoObjectTable&) = delete;
+
+    int add(std::unique_ptr<IndigoObject>&& obj);
+
+    // Returns nullptr if the handle does not refer to a live object
+    IndigoObject* get(int handle) const;
+
+    // Returns false if the handle does not refer to a live object
+    bool remove(int handle);
+
+    // Releases every object of the table, returns the number of them
+    int removeAll();
+
+    int count() const;
+
+    template <typename Callback> void forEach(Callback&& callback) const
+    {
+        int end = _end.load(std::memory_order_acquire);
+        for (int pos = 0; pos < end; pos++)
+        {
+            const Slot* slot = _slot(pos);
+            if (slot == nullptr)
+                continue;
+            int handle = slot->handle.load(std::memory_order_acquire);
+            if (handle != 0)
+                callback(handle);
+        }
+    }
+
+private:
+    enum
+    {
+        POSITION_BITS = 22,
+        GENERATION_MASK = (1 << (31 - POSITION_BITS)) - 1,
+        FIRST_CHUNK_BITS = 10,
+        CHUNKS_COUNT = POSITION_BITS - FIRST_CHUNK_BITS + 1,
+        FREE_LIST_SHARDS = 16
+    };
+
+    struct Slot
+    {
+        std::atomic<int> handle{0};
+        std::atomic<IndigoObject*> object{nullptr};
+        int generation = 0; // owned by whoever holds the slot while it is free
+    };
+
+    struct alignas(64) FreeList
+    {
+        std::mutex lock;
+        std::vector<int> positions;
+    };
+
+    static int _chunkIndex(int pos, int& offset);
+    static int _position(int handle);
+
+    Slot* _slot(int pos) const;
+    Slot& _acquireSlot(int& pos);
+    void _releaseSlot(int pos);
+    FreeList& _localFreeList();
+
+    std::atomic<Slot*> _chunks[CHUNKS_COUNT];
+    std::mutex _chunks_lock;
+    std::atomic<int> _end{0};
+    std::atomic<int> _count{0};
+    FreeList _free_lists[FREE_LIST_SHARDS];
+};
+
+#endif
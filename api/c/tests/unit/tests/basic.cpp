@@ -16,6 +16,10 @@
  * limitations under the License.
  ***************************************************************************/
 
+#include <map>
+#include <set>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <molecule/molecule_auto_loader.h>
@@ -712,3 +716,92 @@ TEST_F(IndigoApiBasicTest, canonical_smiles_invalid_molecule_descriptive_error)
     EXPECT_NE(std::string::npos, errStr.find("Si")) << "Error should mention Si, got: " << errStr;
     EXPECT_NE(std::string::npos, errStr.find("5 drawn bonds")) << "Error should mention 5 drawn bonds, got: " << errStr;
 }
+
+TEST_F(IndigoApiBasicTest, object_handles_from_threads)
+{
+    const int threads_count = 8;
+    const int objects_count = 500;
+
+    int kept = indigoLoadMoleculeFromString("CCO");
+    std::vector<std::vector<int>> handles(threads_count);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; t++)
+    {
+        threads.emplace_back([this, t, &handles]() {
+            indigoSetSessionId(session);
+            for (int i = 0; i < objects_count; i++)
+            {
+                int m = indigoLoadMoleculeFromString("c1ccccc1");
+                if (i % 2 == 0)
+                    indigoFree(m);
+                else
+                    handles[t].push_back(m);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    ASSERT_EQ(1 + threads_count * objects_count / 2, indigoCountReferences());
+    std::set<int> unique_handles;
+    for (auto& thread_handles : handles)
+    {
+        for (int m : thread_handles)
+        {
+            unique_handles.insert(m);
+            ASSERT_EQ(6, indigoCountAtoms(m));
+        }
+    }
+    ASSERT_EQ(threads_count * objects_count / 2, (int)unique_handles.size());
+    ASSERT_EQ(3, indigoCountAtoms(kept));
+
+    // A freed handle stays invalid after its slot is reused
+    int freed = handles[0][0];
+    indigoFree(freed);
+    int reused = indigoLoadMoleculeFromString("C");
+    ASSERT_NE(freed, reused);
+    ASSERT_ANY_THROW(indigoCountAtoms(freed));
+    ASSERT_EQ(1, indigoCountAtoms(reused));
+
+    // ... and after every later reuse of the slot
+    indigoFree(reused);
+    for (int i = 0; i < 2000; i++)
+    {
+        int m = indigoLoadMoleculeFromString("N");
+        ASSERT_NE(freed, m);
+        ASSERT_NE(reused, m);
+        indigoFree(m);
+    }
+    ASSERT_ANY_THROW(indigoCountAtoms(freed));
+    ASSERT_ANY_THROW(indigoCountAtoms(reused));
+
+    indigoFreeAllObjects();
+    ASSERT_EQ(0, indigoCountReferences());
+    ASSERT_ANY_THROW(indigoCountAtoms(kept));
+}
+
+TEST_F(IndigoApiBasicTest, object_handles_generation_exhausted)
+{
+    // A handle keeps the slot position in its low 22 bits and the slot
+    // generation above them. A slot is retired after 511 generations
+    const int position_mask = (1 << 22) - 1;
+    const int generations_count = 511;
+
+    int first = indigoLoadMoleculeFromString("C");
+    indigoFree(first);
+    std::set<int> handles = {first};
+    std::map<int, int> slot_uses;
+    slot_uses[first & position_mask]++;
+    for (int i = 0; i < 4 * generations_count; i++)
+    {
+        int m = indigoLoadMoleculeFromString("C");
+        ASSERT_TRUE(handles.insert(m).second);
+        ASSERT_LE(++slot_uses[m & position_mask], generations_count);
+        indigoFree(m);
+    }
+
+    // Objects moved on to other slots once the generations of a slot were used up
+    ASSERT_LE(4u, slot_uses.size());
+    ASSERT_ANY_THROW(indigoCountAtoms(first));
+    ASSERT_EQ(0, indigoCountReferences());
+}
@@ -24,11 +24,18 @@
 #include <indigo.h>
 
 #include <base_cpp/exception.h>
+#include <molecule/molecule_fingerprint.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <deque>
+#include <filesystem>
 #include <iostream>
 #include <list>
+#include <map>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "common.h"
@@ -75,6 +82,744 @@ TEST_F(BingoNosqlTest, test_subsearch_tau)
     bingoCloseDatabase(db);
 }
 
+TEST_F(BingoNosqlTest, test_subsearch_multithread)
+{
+    constexpr int MAX_ITEMS = 5000;
+    int db = bingoCreateDatabaseFile(::testing::UnitTest::GetInstance()->current_test_info()->name(), "molecule", "");
+    int item, count = 0, iter = indigoIterateSmilesFile(dataPath("molecules/basic/sample_100000.smi").c_str());
+    while ((item = indigoNext(iter)))
+    {
+        bingoInsertRecordObj(db, item);
+        indigoFree(item);
+        if (++count >= MAX_ITEMS)
+            break;
+    }
+    indigoFree(iter);
+
+    auto search = [db](const char* query_smarts) {
+        std::vector<int> ids;
+        int query = indigoLoadSmartsFromString(query_smarts);
+        int sub_matcher = bingoSearchSub(db, query, "");
+        while (bingoNext(sub_matcher))
+            ids.push_back(bingoGetCurrentId(sub_matcher));
+        bingoEndSearch(sub_matcher);
+        indigoFree(query);
+        return ids;
+    };
+
+    for (const char* query : {"c1ccccc1", "C(=O)N", "[#7;R]"})
+    {
+        indigoSetOptionInt("bingonosql-sub-search-thread-count", 1);
+        std::vector<int> expected = search(query);
+        EXPECT_FALSE(expected.empty());
+
+        indigoSetOptionInt("bingonosql-sub-search-thread-count", 4);
+        indigoSetOptionBool("bingonosql-sub-search-ordered", true);
+        EXPECT_EQ(expected, search(query));
+
+        indigoSetOptionBool("bingonosql-sub-search-ordered", false);
+        std::vector<int> unordered = search(query);
+        std::sort(unordered.begin(), unordered.end());
+        std::sort(expected.begin(), expected.end());
+        EXPECT_EQ(expected, unordered);
+    }
+
+    // Abandoned search must stop its workers
+    int query = indigoLoadSmartsFromString("C");
+    int sub_matcher = bingoSearchSub(db, query, "");
+    EXPECT_TRUE(bingoNext(sub_matcher));
+    bingoEndSearch(sub_matcher);
+    indigoFree(query);
+
+    indigoSetOptionInt("bingonosql-sub-search-thread-count", 1);
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_search_while_inserting)
+{
+    constexpr int INITIAL_ITEMS = 8000;
+    constexpr int MAX_ITEMS = 11000;
+    int db = bingoCreateDatabaseFile(::testing::UnitTest::GetInstance()->current_test_info()->name(), "molecule", "");
+    std::vector<int> items;
+    int item, iter = indigoIterateSmilesFile(dataPath("molecules/basic/sample_100000.smi").c_str());
+    while ((int)items.size() < MAX_ITEMS && (item = indigoNext(iter)))
+        items.push_back(item);
+    indigoFree(iter);
+    for (int i = 0; i < INITIAL_ITEMS; i++)
+        bingoInsertRecordObj(db, items[i]);
+
+    int query = indigoLoadSmartsFromString("c1ccccc1");
+    auto count_hits = [=]() {
+        int hits = 0;
+        int sub_matcher = bingoSearchSub(db, query, "");
+        while (bingoNext(sub_matcher))
+        {
+            EXPECT_LT(bingoGetCurrentId(sub_matcher), MAX_ITEMS);
+            hits++;
+        }
+        bingoEndSearch(sub_matcher);
+        return hits;
+    };
+
+    // The writer crosses the growth of the substructure increment and the build of
+    // the similarity table while the searches run
+    std::atomic_bool finished = false;
+    std::thread writer([this, db, &items, &finished]() {
+        indigoSetSessionId(session);
+        for (int i = INITIAL_ITEMS; i < MAX_ITEMS; i++)
+            bingoInsertRecordObj(db, items[i]);
+        finished = true;
+    });
+
+    int searches = 0;
+    int hits = count_hits();
+    while (!finished)
+    {
+        // Every search sees a consistent prefix of the inserted records. Parallel
+        // searches verify the records while the writer waits for the storages
+        indigoSetOptionInt("bingonosql-sub-search-thread-count", searches % 2 == 0 ? 1 : 4);
+        int new_hits = count_hits();
+        EXPECT_GE(new_hits, hits);
+        hits = new_hits;
+
+        int sim_matcher = bingoSearchSim(db, items[searches % INITIAL_ITEMS], 0.9f, 1.0f, "");
+        EXPECT_TRUE(bingoNext(sim_matcher));
+        bingoEndSearch(sim_matcher);
+        searches++;
+    }
+    writer.join();
+    indigoSetOptionInt("bingonosql-sub-search-thread-count", 1);
+
+    EXPECT_GT(searches, 0);
+    EXPECT_GE(count_hits(), hits);
+    int enumerated = 0, enumerator = bingoEnumerateId(db);
+    while (bingoNext(enumerator))
+        enumerated++;
+    bingoEndSearch(enumerator);
+    EXPECT_EQ(MAX_ITEMS, enumerated);
+
+    indigoFree(query);
+    for (int obj : items)
+        indigoFree(obj);
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_insert_iterator_multithread)
+{
+    auto build = [this](const char* name, int thread_count) {
+        indigoSetOptionInt("bingonosql-insert-thread-count", thread_count);
+        int db = bingoCreateDatabaseFile(name, "molecule", "");
+        int iter = indigoIterateSDFile(dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz").c_str());
+        int inserted = bingoInsertIteratorObj(db, iter);
+        indigoFree(iter);
+        return std::make_pair(db, inserted);
+    };
+
+    auto serial = build("test_insert_iterator_serial", 1);
+    auto parallel = build("test_insert_iterator_parallel", 4);
+    indigoSetOptionInt("bingonosql-insert-thread-count", 1);
+
+    EXPECT_GT(serial.second, 200);
+    ASSERT_EQ(serial.second, parallel.second);
+
+    // Records get the same ids whatever the thread count is
+    for (int id = 0; id < serial.second; id++)
+    {
+        int expected = bingoGetRecordObj(serial.first, id);
+        int actual = bingoGetRecordObj(parallel.first, id);
+        EXPECT_STREQ(std::string(indigoCanonicalSmiles(expected)).c_str(), indigoCanonicalSmiles(actual));
+        indigoFree(expected);
+        indigoFree(actual);
+    }
+
+    int query = indigoLoadSmartsFromString("c1ccccc1");
+    std::vector<int> ids[2];
+    for (int i = 0; i < 2; i++)
+    {
+        int sub_matcher = bingoSearchSub(i == 0 ? serial.first : parallel.first, query, "");
+        while (bingoNext(sub_matcher))
+            ids[i].push_back(bingoGetCurrentId(sub_matcher));
+        bingoEndSearch(sub_matcher);
+    }
+    EXPECT_FALSE(ids[0].empty());
+    EXPECT_EQ(ids[0], ids[1]);
+    indigoFree(query);
+
+    bingoCloseDatabase(serial.first);
+    bingoCloseDatabase(parallel.first);
+}
+
+TEST_F(BingoNosqlTest, test_mapping_options_and_warmup)
+{
+    const char* name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    int db = bingoCreateDatabaseFile(name, "molecule", "mmf_populate:true;mmf_huge_pages:true");
+    int iter = indigoIterateSDFile(dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz").c_str());
+    int inserted = bingoInsertIteratorObj(db, iter);
+    indigoFree(iter);
+    EXPECT_EQ(0, bingoWarmup(db));
+
+    int query = indigoLoadSmartsFromString("c1ccccc1");
+    auto count_hits = [query](int db) {
+        int hits = 0;
+        int sub_matcher = bingoSearchSub(db, query, "");
+        while (bingoNext(sub_matcher))
+            hits++;
+        bingoEndSearch(sub_matcher);
+        return hits;
+    };
+    int expected = count_hits(db);
+    bingoCloseDatabase(db);
+
+    // Mapping options only change how the files are paged in, not what is read
+    db = bingoLoadDatabaseFile(name, "mmf_populate:true;mmf_advise:true");
+    ASSERT_GE(db, 0);
+    EXPECT_EQ(0, bingoWarmup(db));
+    EXPECT_GT(inserted, 200);
+    EXPECT_GT(expected, 0);
+    EXPECT_EQ(expected, count_hits(db));
+    indigoFree(query);
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_increment_buffers_after_reload)
+{
+    // The substructure increment is moved to a pack every 65536 records
+    constexpr int PACK_SIZE = 65536;
+    constexpr int FIRST_SESSION = PACK_SIZE + 100;
+    constexpr int SECOND_SESSION = PACK_SIZE;
+    const char* smiles[] = {"c1ccccc1O", "CCCCO", "c1ccncc1", "CC(=O)N"};
+    std::vector<int> mols;
+    for (const char* item : smiles)
+        mols.push_back(indigoLoadMoleculeFromString(item));
+
+    auto insert = [&mols](int db, int first, int count) {
+        for (int i = first; i < first + count; i++)
+            bingoInsertRecordObj(db, mols[i % mols.size()]);
+    };
+    auto storage_size = [](const std::string& name) {
+        uintmax_t size = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(name))
+            if (entry.path().filename().string().rfind("mmf_storage", 0) == 0)
+                size += entry.file_size();
+        return size;
+    };
+
+    const std::string single_name = "test_increment_buffers_single";
+    const std::string reload_name = "test_increment_buffers_reload";
+    // Files of the same size keep the storage size independent of when they were added
+    const char* options = "min_mmf_size:64;max_mmf_size:64";
+    int single = bingoCreateDatabaseFile(single_name.c_str(), "molecule", options);
+    insert(single, 0, FIRST_SESSION + SECOND_SESSION);
+    bingoCloseDatabase(single);
+
+    int db = bingoCreateDatabaseFile(reload_name.c_str(), "molecule", options);
+    insert(db, 0, FIRST_SESSION);
+    bingoCloseDatabase(db);
+
+    // The buffer retired before closing is reused for the next increment
+    // instead of a new one
+    db = bingoLoadDatabaseFile(reload_name.c_str(), "");
+    ASSERT_GE(db, 0);
+    insert(db, FIRST_SESSION, SECOND_SESSION);
+    EXPECT_EQ(storage_size(single_name), storage_size(reload_name));
+
+    int query = indigoLoadSmartsFromString("c1ccccc1");
+    int hits = 0, sub_matcher = bingoSearchSub(db, query, "");
+    while (bingoNext(sub_matcher))
+        hits++;
+    bingoEndSearch(sub_matcher);
+    EXPECT_EQ((FIRST_SESSION + SECOND_SESSION + 3) / 4, hits);
+    indigoFree(query);
+
+    for (int mol : mols)
+        indigoFree(mol);
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_decoded_cache)
+{
+    const char* name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    int db = bingoCreateDatabaseFile(name, "molecule", "");
+    int iter = indigoIterateSDFile(dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz").c_str());
+    bingoInsertIteratorObj(db, iter);
+    indigoFree(iter);
+
+    int exact_query = bingoGetRecordObj(db, 10);
+    auto search = [exact_query](int db, const char* query_smarts) {
+        std::vector<std::string> hits;
+        int query = query_smarts != nullptr ? indigoLoadSmartsFromString(query_smarts) : exact_query;
+        int matcher = query_smarts != nullptr ? bingoSearchSub(db, query, "") : bingoSearchExact(db, query, "");
+        // The object of the cursor holds the record even if it was checked in the cache
+        int current = bingoGetObject(matcher);
+        while (bingoNext(matcher))
+            hits.push_back(std::to_string(bingoGetCurrentId(matcher)) + " " + indigoCanonicalSmiles(current));
+        indigoFree(current);
+        bingoEndSearch(matcher);
+        if (query != exact_query)
+            indigoFree(query);
+        return hits;
+    };
+
+    const std::vector<const char*> queries = {"c1ccccc1", "C(=O)N", "[#7;R]", "[#8;H1]", "[H]OC=O", nullptr};
+    std::vector<std::vector<std::string>> expected;
+    for (const char* query : queries)
+    {
+        expected.push_back(search(db, query));
+        EXPECT_FALSE(expected.back().empty());
+    }
+    bingoCloseDatabase(db);
+
+    // The cache of one megabyte holds about a half of the records, so the
+    // repeated searches take some of them from the cache and evict others
+    db = bingoLoadDatabaseFile(name, "decoded_cache_size:1");
+    ASSERT_GE(db, 0);
+    for (int thread_count : {1, 4})
+    {
+        indigoSetOptionInt("bingonosql-sub-search-thread-count", thread_count);
+        indigoSetOptionBool("bingonosql-sub-search-ordered", true);
+        for (int pass = 0; pass < 2; pass++)
+            for (size_t i = 0; i < queries.size(); i++)
+                EXPECT_EQ(expected[i], search(db, queries[i]));
+    }
+
+    // Removed records must not be found in the cache
+    bingoDeleteRecord(db, 10);
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        std::vector<std::string> hits = search(db, queries[i]);
+        for (const auto& hit : hits)
+            EXPECT_NE(0u, hit.rfind("10 ", 0));
+    }
+
+    indigoSetOptionInt("bingonosql-sub-search-thread-count", 1);
+    indigoSetOptionBool("bingonosql-sub-search-ordered", false);
+    indigoFree(exact_query);
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_simsearch_batch)
+{
+    constexpr int MAX_ITEMS = 20000;
+    constexpr int QUERIES_COUNT = 20;
+    constexpr int LIMIT = 10;
+    constexpr float MIN_SIM = 0.6f;
+
+    // External fingerprints hold only the similarity part of the full fingerprint,
+    // which starts where MoleculeFingerprintBuilder::getSim() points
+    int ext_enabled;
+    MoleculeFingerprintParameters fp_params{};
+    indigoGetOptionBool("fp-ext-enabled", &ext_enabled);
+    indigoGetOptionInt("fp-ord-qwords", &fp_params.ord_qwords);
+    indigoGetOptionInt("fp-sim-qwords", &fp_params.sim_qwords);
+    fp_params.ext = ext_enabled != 0;
+    const int sim_offset = fp_params.fingerprintSizeExt() + fp_params.fingerprintSizeOrd();
+
+    int db = bingoCreateDatabaseFile(::testing::UnitTest::GetInstance()->current_test_info()->name(), "molecule", "");
+    int queries = indigoCreateArray();
+    int fp_queries = indigoCreateArray();
+    int item, count = 0, iter = indigoIterateSmilesFile(dataPath("molecules/basic/sample_100000.smi").c_str());
+    while ((item = indigoNext(iter)))
+    {
+        if (count < MAX_ITEMS)
+            bingoInsertRecordObj(db, item);
+        else
+        {
+            indigoArrayAdd(queries, item);
+            indigoAromatize(item);
+            int fp = indigoFingerprint(item, "sim");
+            char* buf;
+            int size;
+            indigoToBuffer(fp, &buf, &size);
+            int sim_fp = indigoLoadFingerprintFromBuffer(reinterpret_cast<const byte*>(buf) + sim_offset, fp_params.fingerprintSizeSim());
+            indigoArrayAdd(fp_queries, sim_fp);
+            indigoFree(sim_fp);
+            indigoFree(fp);
+        }
+        indigoFree(item);
+        if (++count >= MAX_ITEMS + QUERIES_COUNT)
+            break;
+    }
+    indigoFree(iter);
+    bingoDeleteRecord(db, 7);
+
+    using Hits = std::vector<std::pair<int, float>>;
+    auto collect = [](int search_obj) {
+        Hits hits;
+        while (bingoNext(search_obj))
+            hits.emplace_back(bingoGetCurrentId(search_obj), bingoGetCurrentSimilarityValue(search_obj));
+        bingoEndSearch(search_obj);
+        return hits;
+    };
+    auto by_sim = [](const std::pair<int, float>& a, const std::pair<int, float>& b) { return a.second > b.second || (a.second == b.second && a.first < b.first); };
+
+    std::vector<int> search_objs(QUERIES_COUNT);
+    std::vector<int> fp_search_objs(QUERIES_COUNT);
+
+    // Threshold mode returns exactly the hits of the separate searches
+    ASSERT_EQ(QUERIES_COUNT, bingoSearchSimBatch(db, queries, 0, MIN_SIM, 1.0f, "", search_objs.data()));
+    for (int i = 0; i < QUERIES_COUNT; i++)
+    {
+        int query = indigoAt(queries, i);
+        Hits expected = collect(bingoSearchSim(db, query, MIN_SIM, 1.0f, ""));
+        Hits actual = collect(search_objs[i]);
+        indigoFree(query);
+
+        std::sort(expected.begin(), expected.end(), by_sim);
+        std::sort(actual.begin(), actual.end(), by_sim);
+        EXPECT_EQ(expected, actual);
+    }
+
+    // Top-N mode returns the best hits, fingerprints can be used instead of the molecules
+    ASSERT_EQ(QUERIES_COUNT, bingoSearchSimBatch(db, queries, LIMIT, 0.3f, 1.0f, "", search_objs.data()));
+    ASSERT_EQ(QUERIES_COUNT, bingoSearchSimBatch(db, fp_queries, LIMIT, 0.3f, 1.0f, "", fp_search_objs.data()));
+    for (int i = 0; i < QUERIES_COUNT; i++)
+    {
+        int query = indigoAt(queries, i);
+        Hits all = collect(bingoSearchSim(db, query, 0.3f, 1.0f, ""));
+        Hits actual = collect(search_objs[i]);
+        Hits actual_fp = collect(fp_search_objs[i]);
+
+        std::sort(all.begin(), all.end(), by_sim);
+        ASSERT_EQ(std::min<size_t>(all.size(), LIMIT), actual.size());
+        for (size_t j = 0; j < actual.size(); j++)
+            EXPECT_EQ(all[j].second, actual[j].second);
+        EXPECT_EQ(actual, actual_fp);
+        for (const auto& hit : actual)
+            EXPECT_NE(7, hit.first);
+
+        // Single top-N searches find the same best hits in one pass over the cells
+        for (int limit : {LIMIT, 10 * LIMIT})
+        {
+            Hits single = collect(bingoSearchSimTopN(db, query, limit, 0.3f, ""));
+            ASSERT_EQ(std::min<size_t>(all.size(), limit), single.size());
+            for (size_t j = 0; j < single.size(); j++)
+                EXPECT_EQ(all[j].second, single[j].second);
+            for (const auto& hit : single)
+                EXPECT_NE(7, hit.first);
+        }
+        indigoFree(query);
+    }
+
+    indigoFree(fp_queries);
+    indigoFree(queries);
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_sim_in_memory)
+{
+    constexpr int QUERIES_COUNT = 10;
+    constexpr int LIMIT = 20;
+
+    const std::string name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    int db = bingoCreateDatabaseFile((name + "_mmf").c_str(), "molecule", "");
+    int mem_db = bingoCreateDatabaseFile((name + "_mem").c_str(), "molecule", "sim_in_memory:true");
+    int queries = indigoCreateArray();
+    int iter = indigoIterateSmilesFile(dataPath("molecules/basic/sample_100000.smi").c_str());
+    auto insert = [&](int count) {
+        int item;
+        for (int i = 0; i < count && (item = indigoNext(iter)); i++)
+        {
+            bingoInsertRecordObj(db, item);
+            bingoInsertRecordObj(mem_db, item);
+            if (i % 1000 == 0 && indigoCount(queries) < QUERIES_COUNT)
+                indigoArrayAdd(queries, item);
+            indigoFree(item);
+        }
+    };
+
+    using Hits = std::vector<std::pair<int, float>>;
+    auto collect = [](int search_obj) {
+        Hits hits;
+        while (bingoNext(search_obj))
+            hits.emplace_back(bingoGetCurrentId(search_obj), bingoGetCurrentSimilarityValue(search_obj));
+        bingoEndSearch(search_obj);
+        std::sort(hits.begin(), hits.end(), [](const std::pair<int, float>& a, const std::pair<int, float>& b) {
+            return a.second > b.second || (a.second == b.second && a.first < b.first);
+        });
+        return hits;
+    };
+    auto sims = [](const Hits& hits) {
+        std::vector<float> values;
+        for (const auto& hit : hits)
+            values.push_back(hit.second);
+        return values;
+    };
+
+    // The copy in memory finds exactly what the mapped storage does
+    auto compare = [&]() {
+        int count = indigoCount(queries);
+        std::vector<int> search_objs(count), mem_search_objs(count);
+        ASSERT_EQ(count, bingoSearchSimBatch(db, queries, LIMIT, 0.4f, 1.0f, "", search_objs.data()));
+        ASSERT_EQ(count, bingoSearchSimBatch(mem_db, queries, LIMIT, 0.4f, 1.0f, "", mem_search_objs.data()));
+
+        for (int i = 0; i < count; i++)
+        {
+            int query = indigoAt(queries, i);
+            for (const char* metric : {"", "euclid-sub", "tversky 0.3 0.7"})
+                EXPECT_EQ(collect(bingoSearchSim(db, query, 0.5f, 1.0f, metric)), collect(bingoSearchSim(mem_db, query, 0.5f, 1.0f, metric)));
+            EXPECT_EQ(sims(collect(bingoSearchSimTopN(db, query, LIMIT, 0.3f, ""))), sims(collect(bingoSearchSimTopN(mem_db, query, LIMIT, 0.3f, ""))));
+            EXPECT_EQ(sims(collect(search_objs[i])), sims(collect(mem_search_objs[i])));
+            indigoFree(query);
+        }
+    };
+
+    // A small base has no fingerprint table to copy, so the records go past it
+    insert(15000);
+    bingoDeleteRecord(db, 7);
+    bingoDeleteRecord(mem_db, 7);
+    bingoOptimize(mem_db);
+    compare();
+
+    // Inserts drop the copy until the next optimize()
+    insert(500);
+    compare();
+    bingoOptimize(mem_db);
+    compare();
+    bingoCloseDatabase(mem_db);
+
+    mem_db = bingoLoadDatabaseFile((name + "_mem").c_str(), "sim_in_memory:true");
+    ASSERT_GE(mem_db, 0);
+    compare();
+
+    indigoFree(iter);
+    indigoFree(queries);
+    bingoCloseDatabase(mem_db);
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_sim_tversky_asymmetric)
+{
+    constexpr int MAX_ITEMS = 12000;
+    constexpr float MIN_SIM = 0.6f;
+    const char* metric = "tversky 0.9 0.1";
+
+    // Past the small base the records go to the fingerprint table, both to the container increments and to the built containers
+    int db = bingoCreateDatabaseFile(::testing::UnitTest::GetInstance()->current_test_info()->name(), "molecule", "");
+    std::vector<int> fps;
+    int queries = indigoCreateArray();
+    int item, iter = indigoIterateSmilesFile(dataPath("molecules/basic/sample_100000.smi").c_str());
+    while (static_cast<int>(fps.size()) < MAX_ITEMS && (item = indigoNext(iter)))
+    {
+        ASSERT_EQ(static_cast<int>(fps.size()), bingoInsertRecordObj(db, item));
+        if (fps.size() % 2000 == 0)
+            indigoArrayAdd(queries, item);
+        indigoAromatize(item);
+        fps.push_back(indigoFingerprint(item, "sim"));
+        indigoFree(item);
+    }
+    indigoFree(iter);
+
+    // The storages weigh the query bits with alpha, as indigoSimilarity(query, target) does
+    for (int i = 0; i < indigoCount(queries); i++)
+    {
+        int query = indigoAt(queries, i);
+        indigoAromatize(query);
+        int query_fp = indigoFingerprint(query, "sim");
+
+        std::map<int, float> found;
+        int search_obj = bingoSearchSim(db, query, MIN_SIM, 1.0f, metric);
+        while (bingoNext(search_obj))
+            found.emplace(bingoGetCurrentId(search_obj), bingoGetCurrentSimilarityValue(search_obj));
+        bingoEndSearch(search_obj);
+        ASSERT_FALSE(found.empty());
+
+        // Values right at the threshold may fall either way, bingo compares them in double
+        for (int id = 0; id < static_cast<int>(fps.size()); id++)
+        {
+            float sim = indigoSimilarity(query_fp, fps[id], metric);
+            if (found.count(id))
+                EXPECT_NEAR(sim, found[id], 1e-5);
+            else
+                EXPECT_LT(sim, MIN_SIM + 1e-5);
+        }
+
+        indigoFree(query_fp);
+        indigoFree(query);
+    }
+
+    for (int fp : fps)
+        indigoFree(fp);
+    indigoFree(queries);
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_federated_database)
+{
+    constexpr int MAX_ITEMS = 3000;
+    constexpr int SHARDS_COUNT = 3;
+    constexpr int LIMIT = 20;
+
+    // The records are spread over the shards by their ids, the whole database has all of them
+    const std::string name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    int db = bingoCreateDatabaseFile(name.c_str(), "molecule", "");
+    std::vector<int> shards;
+    std::string locations;
+    for (int k = 0; k < SHARDS_COUNT; k++)
+    {
+        std::string location = name + "_" + std::to_string(k);
+        shards.push_back(bingoCreateDatabaseFile(location.c_str(), "molecule", ""));
+        locations += (k > 0 ? ";" : "") + location;
+    }
+
+    int queries = indigoCreateArray();
+    int item, count = 0, iter = indigoIterateSmilesFile(dataPath("molecules/basic/sample_100000.smi").c_str());
+    while (count < MAX_ITEMS && (item = indigoNext(iter)))
+    {
+        bingoInsertRecordObjWithId(db, item, count);
+        bingoInsertRecordObjWithId(shards[count % SHARDS_COUNT], item, count);
+        if (count % 500 == 0)
+            indigoArrayAdd(queries, item);
+        indigoFree(item);
+        count++;
+    }
+    indigoFree(iter);
+    for (int shard : shards)
+        bingoCloseDatabase(shard);
+
+    int fed_db = bingoLoadFederatedDatabase(locations.c_str(), "read_only:true");
+    ASSERT_GE(fed_db, 0);
+
+    using Hits = std::vector<std::pair<int, float>>;
+    auto collect = [](int search_obj, bool sim) {
+        Hits hits;
+        while (bingoNext(search_obj) > 0)
+            hits.emplace_back(bingoGetCurrentId(search_obj), sim ? bingoGetCurrentSimilarityValue(search_obj) : 0.f);
+        bingoEndSearch(search_obj);
+        return hits;
+    };
+    auto sorted = [](Hits hits) {
+        std::sort(hits.begin(), hits.end(), [](const std::pair<int, float>& a, const std::pair<int, float>& b) {
+            return a.second > b.second || (a.second == b.second && a.first < b.first);
+        });
+        return hits;
+    };
+    auto sims = [](const Hits& hits) {
+        std::vector<float> values;
+        for (const auto& hit : hits)
+            values.push_back(hit.second);
+        return values;
+    };
+
+    // Unordered searches find the same records as on the whole database
+    int sub_query = indigoLoadQueryMoleculeFromString("c1ccncc1");
+    EXPECT_EQ(sorted(collect(bingoSearchSub(db, sub_query, ""), false)), sorted(collect(bingoSearchSub(fed_db, sub_query, ""), false)));
+    EXPECT_EQ(sorted(collect(bingoSearchMolFormula(db, "C6 H6", ""), false)), sorted(collect(bingoSearchMolFormula(fed_db, "C6 H6", ""), false)));
+    Hits all = sorted(collect(bingoEnumerateId(fed_db), false));
+    ASSERT_EQ((size_t)MAX_ITEMS, all.size());
+    EXPECT_EQ(MAX_ITEMS - 1, all.back().first);
+
+    // The object of the cursor follows the hits of all the shards
+    int search_obj = bingoSearchSub(fed_db, sub_query, "");
+    int current = bingoGetObject(search_obj);
+    int checked = 0;
+    while (bingoNext(search_obj) > 0 && checked++ < 50)
+    {
+        int record = bingoGetRecordObj(db, bingoGetCurrentId(search_obj));
+        EXPECT_STREQ(indigoCanonicalSmiles(record), indigoCanonicalSmiles(current));
+        indigoFree(record);
+    }
+    EXPECT_GT(checked, 0);
+    indigoFree(current);
+    bingoEndSearch(search_obj);
+    indigoFree(sub_query);
+
+    std::vector<int> search_objs(indigoCount(queries)), fed_search_objs(indigoCount(queries));
+    ASSERT_EQ(indigoCount(queries), bingoSearchSimBatch(db, queries, LIMIT, 0.3f, 1.0f, "", search_objs.data()));
+    ASSERT_EQ(indigoCount(queries), bingoSearchSimBatch(fed_db, queries, LIMIT, 0.3f, 1.0f, "", fed_search_objs.data()));
+    for (int i = 0; i < indigoCount(queries); i++)
+    {
+        int query = indigoAt(queries, i);
+        EXPECT_EQ(sorted(collect(bingoSearchExact(db, query, ""), false)), sorted(collect(bingoSearchExact(fed_db, query, ""), false)));
+        EXPECT_EQ(sorted(collect(bingoSearchSim(db, query, 0.6f, 1.0f, ""), true)), sorted(collect(bingoSearchSim(fed_db, query, 0.6f, 1.0f, ""), true)));
+
+        // Top-N hits of the shards are merged by decreasing similarity up to the limit
+        Hits top = collect(bingoSearchSimTopN(fed_db, query, LIMIT, 0.3f, ""), true);
+        EXPECT_EQ(sims(sorted(top)), sims(top));
+        EXPECT_EQ(sims(collect(bingoSearchSimTopN(db, query, LIMIT, 0.3f, ""), true)), sims(top));
+        EXPECT_EQ(sims(collect(search_objs[i], true)), sims(collect(fed_search_objs[i], true)));
+        indigoFree(query);
+    }
+
+    // Federated databases are read-only
+    int mol = indigoLoadMoleculeFromString("CCO");
+    EXPECT_THROW(bingoInsertRecordObj(fed_db, mol), Exception);
+    indigoFree(mol);
+
+    indigoFree(queries);
+    EXPECT_EQ(1, bingoCloseDatabase(fed_db));
+    bingoCloseDatabase(db);
+}
+
+TEST_F(BingoNosqlTest, test_search_exact_batch)
+{
+    const char* name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    const std::string sdf = dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz");
+    int db = bingoCreateDatabaseFile(name, "molecule", "");
+    int iter = indigoIterateSDFile(sdf.c_str());
+    bingoInsertIteratorObj(db, iter);
+    indigoFree(iter);
+
+    // Every record searched one by one
+    using Matches = std::vector<std::pair<int, int>>;
+    Matches expected;
+    iter = indigoIterateSDFile(sdf.c_str());
+    int item, index = 0;
+    while ((item = indigoNext(iter)))
+    {
+        try
+        {
+            int search_obj = bingoSearchExact(db, item, "");
+            while (bingoNext(search_obj) > 0)
+                expected.emplace_back(index, bingoGetCurrentId(search_obj));
+            bingoEndSearch(search_obj);
+        }
+        catch (const Exception&)
+        {
+        }
+        indigoFree(item);
+        index++;
+    }
+    indigoFree(iter);
+    ASSERT_GT(expected.size(), 200u);
+
+    for (int thread_count : {1, 4})
+    {
+        indigoSetOptionInt("bingonosql-insert-thread-count", thread_count);
+        iter = indigoIterateSDFile(sdf.c_str());
+        int search_obj = bingoSearchExactBatch(db, iter, "");
+        indigoFree(iter);
+
+        // The object of the cursor follows the matches
+        int current = bingoGetObject(search_obj);
+        Matches matches;
+        while (bingoNext(search_obj) > 0)
+        {
+            matches.emplace_back(bingoGetCurrentQueryIndex(search_obj), bingoGetCurrentId(search_obj));
+            if (matches.size() % 50 == 0)
+            {
+                int record = bingoGetRecordObj(db, matches.back().second);
+                EXPECT_STREQ(std::string(indigoCanonicalSmiles(record)).c_str(), indigoCanonicalSmiles(current));
+                indigoFree(record);
+            }
+        }
+        indigoFree(current);
+        bingoEndSearch(search_obj);
+
+        std::sort(expected.begin(), expected.end());
+        EXPECT_EQ(expected, matches);
+    }
+    indigoSetOptionInt("bingonosql-insert-thread-count", 1);
+
+    // Only batch exact searches know the records of the queries
+    int query = indigoLoadMoleculeFromString("c1ccccc1");
+    int search_obj = bingoSearchExact(db, query, "");
+    EXPECT_THROW(bingoGetCurrentQueryIndex(search_obj), Exception);
+    bingoEndSearch(search_obj);
+    indigoFree(query);
+
+    bingoCloseDatabase(db);
+}
+
 TEST_F(BingoNosqlTest, test_enumerate_id)
 {
     int db = bingoCreateDatabaseFile(::testing::UnitTest::GetInstance()->current_test_info()->name(), "molecule", "");
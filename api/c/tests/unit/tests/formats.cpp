@@ -27,6 +27,8 @@
 
 #include <algorithm>
 #include <fstream>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace indigo;
@@ -277,6 +279,52 @@ TEST_F(IndigoApiFormatsTest, fromGzFile)
     }
 }
 
+TEST_F(IndigoApiFormatsTest, iterate_file_thread_count)
+{
+    auto read_all = [](int reader) {
+        std::vector<std::string> items;
+        while (indigoHasNext(reader))
+        {
+            int item = indigoNext(reader);
+            std::string text = std::to_string(indigoIndex(item)) + " " + std::to_string(indigoTell64(item)) + " " + indigoCanonicalSmiles(item);
+            if (indigoHasProperty(item, "PUBCHEM_COMPOUND_CID"))
+                text += std::string(" ") + indigoGetProperty(item, "PUBCHEM_COMPOUND_CID");
+            items.push_back(text);
+            indigoFree(item);
+        }
+        return items;
+    };
+
+    for (const char* name : {"molecules/basic/Compound_0000001_0000250.sdf.gz", "molecules/basic/pubchem_slice_50.smi"})
+    {
+        const std::string path = dataPath(name);
+        const bool sdf = strstr(name, ".sdf") != nullptr;
+        auto iterate = [&]() { return sdf ? indigoIterateSDFile(path.c_str()) : indigoIterateSmilesFile(path.c_str()); };
+
+        indigoSetOptionInt("iterate-file-thread-count", 0);
+        int reader = iterate();
+        std::vector<std::string> expected = read_all(reader);
+        long long size = indigoTell64(reader);
+        indigoFree(reader);
+        ASSERT_FALSE(expected.empty());
+
+        for (int thread_count : {1, 4})
+        {
+            indigoSetOptionInt("iterate-file-thread-count", thread_count);
+            reader = iterate();
+            EXPECT_EQ((int)expected.size(), indigoCount(reader));
+            EXPECT_EQ(expected, read_all(reader));
+            EXPECT_EQ(size, indigoTell64(reader));
+            indigoFree(reader);
+
+            // A loader freed in the middle of the file stops its threads
+            reader = iterate();
+            indigoFree(indigoNext(reader));
+            indigoFree(reader);
+        }
+    }
+}
+
 TEST_F(IndigoApiFormatsTest, noFile)
 {
     ASSERT_THROW(
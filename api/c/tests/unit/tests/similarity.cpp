@@ -16,6 +16,8 @@
  * limitations under the License.
  ***************************************************************************/
 
+#include <string>
+
 #include <gtest/gtest.h>
 
 #include <indigo_internal.h>
@@ -95,6 +97,30 @@ TEST_F(IndigoSimilarityTest, similarity_sim)
     EXPECT_EQ(1.00, indigoSimilarity(f2, f3, "tanimoto"));
 }
 
+TEST_F(IndigoSimilarityTest, clone_fingerprint)
+{
+    for (const auto& type : {"sim", "sub", "full"})
+    {
+        int fp = indigoFingerprint(m2, type);
+        const std::string expected = indigoToString(fp);
+        int copy = indigoClone(fp);
+        ASSERT_NE(-1, copy);
+        ASSERT_NE(fp, copy);
+        EXPECT_EQ(1.00, indigoSimilarity(fp, copy, "tanimoto"));
+
+        // The copy owns its bits, so it outlives the original
+        indigoFree(fp);
+        EXPECT_EQ(expected, indigoToString(copy));
+
+        // Arrays hold clones of the added objects
+        int array = indigoCreateArray();
+        ASSERT_NE(-1, indigoArrayAdd(array, copy));
+        EXPECT_EQ(1, indigoCount(array));
+        indigoFree(array);
+        indigoFree(copy);
+    }
+}
+
 TEST_F(IndigoSimilarityTest, similarity_sub)
 {
     const char* type = "sub";
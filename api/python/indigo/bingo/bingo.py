@@ -15,7 +15,7 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
-from ctypes import CDLL
+from ctypes import CDLL, c_int
 
 from ..indigo.indigo import Indigo
 from ..indigo.indigo_lib import IndigoLib
@@ -77,6 +77,20 @@ class Bingo:
             libraryHandle,
         )
 
+    @staticmethod
+    def loadFederatedDatabase(indigo, paths, options=""):
+        libraryHandle = BingoLib()
+        return Bingo(
+            IndigoLib.checkResult(
+                libraryHandle.lib.bingoLoadFederatedDatabase(
+                    ";".join(paths).encode(), options.encode()
+                ),
+                BingoException,
+            ),
+            indigo,
+            libraryHandle,
+        )
+
     def version(self):
         return IndigoLib.checkResultString(
             self._lib().bingoVersion(), BingoException
@@ -139,6 +153,17 @@ class Bingo:
             self,
         )
 
+    def searchExactBatch(self, iterator, options=""):
+        return BingoObject(
+            IndigoLib.checkResult(
+                self._lib().bingoSearchExactBatch(
+                    self._id, iterator.id, options.encode()
+                ),
+                BingoException,
+            ),
+            self,
+        )
+
     def searchSim(self, query, minSim, maxSim, metric="tanimoto"):
         return BingoObject(
             IndigoLib.checkResult(
@@ -197,6 +222,24 @@ class Bingo:
             self,
         )
 
+    def searchSimBatch(
+        self, queries, limit, minSim, maxSim=1.0, metric="tanimoto"
+    ):
+        search_objs = (c_int * queries.count())()
+        count = IndigoLib.checkResult(
+            self._lib().bingoSearchSimBatch(
+                self._id,
+                queries.id,
+                limit,
+                minSim,
+                maxSim,
+                metric.encode(),
+                search_objs,
+            ),
+            BingoException,
+        )
+        return [BingoObject(search_objs[i], self) for i in range(count)]
+
     def enumerateId(self):
         return BingoObject(
             IndigoLib.checkResult(
@@ -221,6 +264,11 @@ class Bingo:
             self._lib().bingoOptimize(self._id), BingoException
         )
 
+    def warmup(self):
+        IndigoLib.checkResult(
+            self._lib().bingoWarmup(self._id), BingoException
+        )
+
     def getRecordById(self, id):
         return IndigoObject(
             self.session,
@@ -37,6 +37,8 @@ class BingoLib:
         ]
         BingoLib.lib.bingoLoadDatabaseFile.restype = c_int
         BingoLib.lib.bingoLoadDatabaseFile.argtypes = [c_char_p, c_char_p]
+        BingoLib.lib.bingoLoadFederatedDatabase.restype = c_int
+        BingoLib.lib.bingoLoadFederatedDatabase.argtypes = [c_char_p, c_char_p]
         BingoLib.lib.bingoCloseDatabase.restype = c_int
         BingoLib.lib.bingoCloseDatabase.argtypes = [c_int]
         BingoLib.lib.bingoInsertRecordObj.restype = c_int
@@ -68,6 +70,8 @@ class BingoLib:
         BingoLib.lib.bingoSearchSub.argtypes = [c_int, c_int, c_char_p]
         BingoLib.lib.bingoSearchExact.restype = c_int
         BingoLib.lib.bingoSearchExact.argtypes = [c_int, c_int, c_char_p]
+        BingoLib.lib.bingoSearchExactBatch.restype = c_int
+        BingoLib.lib.bingoSearchExactBatch.argtypes = [c_int, c_int, c_char_p]
         BingoLib.lib.bingoSearchMolFormula.restype = c_int
         BingoLib.lib.bingoSearchMolFormula.argtypes = [
             c_int,
@@ -108,6 +112,16 @@ class BingoLib:
             c_int,
             c_char_p,
         ]
+        BingoLib.lib.bingoSearchSimBatch.restype = c_int
+        BingoLib.lib.bingoSearchSimBatch.argtypes = [
+            c_int,
+            c_int,
+            c_int,
+            c_float,
+            c_float,
+            c_char_p,
+            POINTER(c_int),
+        ]
         BingoLib.lib.bingoEnumerateId.restype = c_int
         BingoLib.lib.bingoEnumerateId.argtypes = [c_int]
         BingoLib.lib.bingoNext.restype = c_int
@@ -120,8 +134,12 @@ class BingoLib:
         BingoLib.lib.bingoEndSearch.argtypes = [c_int]
         BingoLib.lib.bingoGetCurrentSimilarityValue.restype = c_float
         BingoLib.lib.bingoGetCurrentSimilarityValue.argtypes = [c_int]
+        BingoLib.lib.bingoGetCurrentQueryIndex.restype = c_int
+        BingoLib.lib.bingoGetCurrentQueryIndex.argtypes = [c_int]
         BingoLib.lib.bingoOptimize.restype = c_int
         BingoLib.lib.bingoOptimize.argtypes = [c_int]
+        BingoLib.lib.bingoWarmup.restype = c_int
+        BingoLib.lib.bingoWarmup.argtypes = [c_int]
         BingoLib.lib.bingoEstimateRemainingResultsCount.restype = c_int
         BingoLib.lib.bingoEstimateRemainingResultsCount.argtypes = [c_int]
         BingoLib.lib.bingoEstimateRemainingResultsCountError.restype = c_int
@@ -85,6 +85,11 @@ class BingoObject:
             BingoException,
         )
 
+    def getCurrentQueryIndex(self):
+        return IndigoLib.checkResult(
+            self._lib().bingoGetCurrentQueryIndex(self._id), BingoException
+        )
+
     def estimateRemainingResultsCount(self):
         return IndigoLib.checkResult(
             self._lib().bingoEstimateRemainingResultsCount(self._id),
@@ -90,6 +90,7 @@ namespace indigo
         bool _use_pi_systems_matcher;
         MoleculeAtomNeighbourhoodCounters _nei_target_counters;
         MoleculeAtomNeighbourhoodCounters _nei_query_counters;
+        CompiledSubstructureQuery _compiled_query;
 
         PtrArray<RedBlackStringMap<int>> _fmcache;
 
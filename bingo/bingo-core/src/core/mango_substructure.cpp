@@ -136,6 +136,7 @@ void MangoSubstructure::_validateQueryExtraData()
 
     _query_has_stereocenters = _query.stereocenters.size() > 0;
     _query_has_stereocare_bonds = _query.cis_trans.count() > 0;
+    _compiled_query.compile(_query);
     _query_extra_valid = true;
 }
 
@@ -164,6 +165,8 @@ void MangoSubstructure::loadTarget(Scanner& scanner)
 
 bool MangoSubstructure::matchLoadedTarget()
 {
+    _validateQueryExtraData();
+
     MoleculeSubstructureMatcher matcher(_target);
 
     matcher.match_3d = match_3d;
@@ -175,7 +178,7 @@ bool MangoSubstructure::matchLoadedTarget()
 
     _fmcache.clear();
 
-    matcher.setQuery(_query);
+    matcher.setQuery(_compiled_query);
 
     profTimerStart(temb, "match.embedding");
     bool res = matcher.find();
@@ -9,6 +9,7 @@ extern "C"
 #include "access/htup.h"
 #include "catalog/index.h"
 #include "catalog/pg_type.h"
+#include "nodes/tidbitmap.h"
 #include "storage/bufmgr.h"
 #include "utils/rel.h"
 
@@ -74,6 +75,17 @@ extern "C"
     CEXPORT void bingo_rescan(IndexScanDesc, ScanKey, int, ScanKey, int);
     CEXPORT void bingo_endscan(IndexScanDesc);
     CEXPORT bool bingo_gettuple(IndexScanDesc, ScanDirection);
+    CEXPORT int64 bingo_getbitmap(IndexScanDesc, TIDBitmap*);
+
+#if PG_VERSION_NUM / 100 >= 1700
+    CEXPORT Size bingo_estimateparallelscan(int, int);
+#elif PG_VERSION_NUM / 100 >= 1000
+    CEXPORT Size bingo_estimateparallelscan(void);
+#endif
+#if PG_VERSION_NUM / 100 >= 1000
+    CEXPORT void bingo_initparallelscan(void*);
+    CEXPORT void bingo_parallelrescan(IndexScanDesc);
+#endif
 
 #else
     BINGO_FUNCTION_EXPORT(bingo_build);
@@ -113,10 +125,14 @@ Datum bingo_handler(PG_FUNCTION_ARGS)
     amroutine->amcanreturn = NULL;
 
 #if PG_VERSION_NUM / 100 >= 1000
+    /*
+     * Parallel workers could search the index sections they claim one by one, but the shared
+     * section hand-off has not been run in workers yet, so parallel index scans stay off
+     */
     amroutine->amcanparallel = false;
-    amroutine->amestimateparallelscan = NULL;
-    amroutine->aminitparallelscan = NULL;
-    amroutine->amparallelrescan = NULL;
+    amroutine->amestimateparallelscan = bingo_estimateparallelscan;
+    amroutine->aminitparallelscan = bingo_initparallelscan;
+    amroutine->amparallelrescan = bingo_parallelrescan;
 #endif
 
 #if PG_VERSION_NUM / 100 >= 1200
@@ -134,7 +150,7 @@ Datum bingo_handler(PG_FUNCTION_ARGS)
     amroutine->amrescan = bingo_rescan;
     amroutine->amgettuple = bingo_gettuple;
     amroutine->amendscan = bingo_endscan;
-    amroutine->amgetbitmap = NULL;
+    amroutine->amgetbitmap = bingo_getbitmap;
     amroutine->ammarkpos = NULL;
     amroutine->amrestrpos = NULL;
 
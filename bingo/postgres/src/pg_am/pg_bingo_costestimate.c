@@ -6,12 +6,173 @@
 #include <math.h>
 
 #include <nodes/relation.h>
+#include <optimizer/clauses.h>
 #include <optimizer/predtest.h>
 #endif
 
+#include <access/htup_details.h>
+#include <catalog/pg_type.h>
+#include <funcapi.h>
+#include <nodes/makefuncs.h>
 #include <optimizer/cost.h>
+#include <utils/lsyscache.h>
 #include <utils/selfuncs.h>
 #include <utils/spccache.h>
+#include <utils/typcache.h>
+
+/*
+ * Implemented by the search engine, see pg_bingo_search.cpp
+ */
+extern double bingo_estimatescreening(Oid index_oid, int strategy, Datum query, double* query_bits, double* sections);
+
+/*
+ * Section pages read on screening besides the query fingerprint bits: section info and existing structures
+ */
+#define BINGO_SECTION_SCREENING_PAGES 2.0
+/*
+ * Part of a page read to load a candidate structure for matching
+ */
+#define BINGO_CANDIDATE_PAGES 0.05
+
+/*
+ * Query types are composite, so a query written as ('CC', '')::bingo.sub stays a row constructor
+ * after constant folding. Forms the composite value if all its fields are constants, otherwise returns NULL
+ */
+static Const* bingo_fold_row_query(RowExpr* row)
+{
+    TupleDesc tupdesc;
+    Datum* values;
+    bool* nulls;
+    ListCell* lc;
+    Const* result = NULL;
+    int natts;
+    int i = 0;
+
+    if (row->row_typeid == RECORDOID)
+        return NULL;
+
+    tupdesc = lookup_rowtype_tupdesc(row->row_typeid, -1);
+    natts = tupdesc->natts;
+
+    if (list_length(row->args) == natts)
+    {
+        values = (Datum*)palloc(natts * sizeof(Datum));
+        nulls = (bool*)palloc(natts * sizeof(bool));
+
+        foreach (lc, row->args)
+        {
+            Const* field = (Const*)lfirst(lc);
+#if PG_VERSION_NUM / 100 >= 1100
+            Oid field_type = tupdesc->attrs[i].atttypid;
+#else
+            Oid field_type = tupdesc->attrs[i]->atttypid;
+#endif
+            if (!IsA(field, Const) || field->consttype != field_type)
+                break;
+
+            values[i] = field->constvalue;
+            nulls[i] = field->constisnull;
+            i++;
+        }
+
+        if (i == natts)
+            result = makeConst(row->row_typeid, -1, InvalidOid, -1, HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)), false, false);
+
+        pfree(values);
+        pfree(nulls);
+    }
+
+    ReleaseTupleDesc(tupdesc);
+    return result;
+}
+
+/*
+ * Screening estimate of the index quals. Returns false if the qual is not screened
+ * by fingerprints or its query is not known at planning time
+ */
+static bool bingo_screening_estimate(PlannerInfo* root, IndexOptInfo* index, List* indexQuals, double* fraction, double* query_bits, double* sections)
+{
+    RestrictInfo* rinfo;
+    OpExpr* clause;
+    Node* query;
+    int strategy;
+
+    /*
+     * The search engine screens by a single query
+     */
+    if (list_length(indexQuals) != 1)
+        return false;
+
+    rinfo = (RestrictInfo*)linitial(indexQuals);
+    if (!IsA(rinfo, RestrictInfo) || !IsA(rinfo->clause, OpExpr))
+        return false;
+
+    clause = (OpExpr*)rinfo->clause;
+    if (list_length(clause->args) != 2)
+        return false;
+
+    query = estimate_expression_value(root, (Node*)lsecond(clause->args));
+    if (IsA(query, RowExpr))
+        query = (Node*)bingo_fold_row_query((RowExpr*)query);
+    if (query == NULL || !IsA(query, Const) || ((Const*)query)->constisnull)
+        return false;
+
+    strategy = get_op_opfamily_strategy(clause->opno, index->opfamily[0]);
+    if (strategy == 0)
+        return false;
+
+    *fraction = bingo_estimatescreening(index->indexoid, strategy, ((Const*)query)->constvalue, query_bits, sections);
+    return *fraction >= 0;
+}
+
+/*
+ * Every section is screened by reading its pages of the query fingerprint bits, then the candidates
+ * passed the screening are loaded and matched one by one. Matching a candidate costs the same as
+ * the operator on a sequential scan, so the index wins only when the screening is selective
+ */
+static void bingo_screening_cost(PlannerInfo* root, IndexOptInfo* index, List* indexQuals, double loop_count, double fraction, double query_bits,
+                                 double sections, Cost* indexStartupCost, Cost* indexTotalCost, Selectivity* indexSelectivity, double* indexCorrelation)
+{
+    double candidates;
+    double screening_pages;
+    double index_pages;
+    double spc_random_page_cost;
+    QualCost index_qual_cost;
+
+    candidates = fraction * index->tuples;
+    screening_pages = sections * (query_bits + BINGO_SECTION_SCREENING_PAGES);
+    index_pages = screening_pages + candidates * BINGO_CANDIDATE_PAGES;
+
+    get_tablespace_page_costs(index->reltablespace, &spc_random_page_cost, NULL);
+
+    /*
+     * Repeated scans find the pages in cache, see genericcostestimate
+     */
+    if (loop_count > 1)
+        index_pages = index_pages_fetched(index_pages * loop_count, index->pages, (double)index->pages, root) / loop_count;
+
+    /*
+     * The query is prepared once, and its fingerprint is read before the first section is screened
+     */
+    cost_qual_eval(&index_qual_cost, indexQuals, root);
+
+    *indexStartupCost = index_qual_cost.startup;
+    if (sections > 0)
+        *indexStartupCost += screening_pages / sections * spc_random_page_cost;
+
+    *indexTotalCost = index_qual_cost.startup + index_pages * spc_random_page_cost + candidates * (cpu_index_tuple_cost + index_qual_cost.per_tuple);
+
+    /*
+     * Matches are at most the candidates passed the screening
+     */
+    *indexSelectivity = fraction;
+    /*
+     * Sections keep the structures in the order they were indexed, and the index build reads the heap
+     * in physical order, so the candidates come back mostly in heap order. cost_index uses the square
+     * of the correlation, and -1.0 is also what the generic estimate of this access method reports
+     */
+    *indexCorrelation = -1.0;
+}
 
 /*
 #include "access/sysattr.h"
@@ -311,8 +472,24 @@
 void bingo_costestimate120(struct PlannerInfo* root, struct IndexPath* path, double loop_count, Cost* indexStartupCost, Cost* indexTotalCost,
                            Selectivity* indexSelectivity, double* indexCorrelation, double* indexPages)
 {
+    IndexOptInfo* index = path->indexinfo;
+    List* indexQuals = get_quals_from_indexclauses(path->indexclauses);
+    double fraction, query_bits, sections;
 
     GenericCosts costs;
+
+    /*
+     * The whole index is read by sections, the number of parallel workers depends on its size
+     */
+    *indexPages = index->pages;
+
+    if (bingo_screening_estimate(root, index, indexQuals, &fraction, &query_bits, &sections))
+    {
+        bingo_screening_cost(root, index, indexQuals, loop_count, fraction, query_bits, sections, indexStartupCost, indexTotalCost, indexSelectivity,
+                             indexCorrelation);
+        return;
+    }
+
     MemSet(&costs, 0, sizeof(costs));
     costs.numIndexTuples = 1;
     costs.numIndexPages = 1;
@@ -326,7 +503,6 @@ void bingo_costestimate120(struct PlannerInfo* root, struct IndexPath* path, dou
     *indexTotalCost = costs.indexTotalCost;
     *indexSelectivity = costs.indexSelectivity;
     *indexCorrelation = costs.indexCorrelation;
-    *indexPages = costs.numIndexPages;
 }
 
 #else
@@ -567,16 +743,33 @@ static void genericcostestimate92(PlannerInfo* root, IndexPath* path, double loo
 void bingo_costestimate96(struct PlannerInfo* root, struct IndexPath* path, double loop_count, Cost* indexStartupCost, Cost* indexTotalCost,
                           Selectivity* indexSelectivity, double* indexCorrelation)
 {
+    double fraction, query_bits, sections;
+
+    if (bingo_screening_estimate(root, path->indexinfo, path->indexquals, &fraction, &query_bits, &sections))
+    {
+        bingo_screening_cost(root, path->indexinfo, path->indexquals, loop_count, fraction, query_bits, sections, indexStartupCost, indexTotalCost,
+                             indexSelectivity, indexCorrelation);
+        return;
+    }
+
     genericcostestimate92(root, path, loop_count, 1.0, indexStartupCost, indexTotalCost, indexSelectivity, indexCorrelation);
 }
 
 void bingo_costestimate101(struct PlannerInfo* root, struct IndexPath* path, double loop_count, Cost* indexStartupCost, Cost* indexTotalCost,
                            Selectivity* indexSelectivity, double* indexCorrelation, double* indexPages)
 {
+    double fraction, query_bits, sections;
 
-    genericcostestimate92(root, path, loop_count, 1.0, indexStartupCost, indexTotalCost, indexSelectivity, indexCorrelation);
+    *indexPages = path->indexinfo->pages;
 
-    *indexPages = 1;
+    if (bingo_screening_estimate(root, path->indexinfo, path->indexquals, &fraction, &query_bits, &sections))
+    {
+        bingo_screening_cost(root, path->indexinfo, path->indexquals, loop_count, fraction, query_bits, sections, indexStartupCost, indexTotalCost,
+                             indexSelectivity, indexCorrelation);
+        return;
+    }
+
+    genericcostestimate92(root, path, loop_count, 1.0, indexStartupCost, indexTotalCost, indexSelectivity, indexCorrelation);
 }
 #endif
 
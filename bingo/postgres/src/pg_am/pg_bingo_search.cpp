@@ -4,25 +4,30 @@ extern "C"
 {
 #include "postgres.h"
 
+#include "access/genam.h"
 #include "access/relscan.h"
 #include "access/skey.h"
 #include "fmgr.h"
 #include "miscadmin.h"
+#include "storage/bufmgr.h"
 #include "utils/rel.h"
 #include "utils/relcache.h"
-#if PG_VERSION_NUM / 100 >= 1200
-#include "access/genam.h"
-#endif
+#include "nodes/tidbitmap.h"
 }
 
 #include "bingo_pg_fix_post.h"
 
+#include <string>
+#include <vector>
+
 #include "base_cpp/tlscont.h"
 #include "bingo_pg_common.h"
 #include "bingo_pg_search.h"
 #include "bingo_pg_search_engine.h"
 #include "pg_bingo_context.h"
 
+using namespace indigo;
+
 #if PG_VERSION_NUM / 100 < 906
 
 extern "C"
@@ -30,10 +35,6 @@ extern "C"
     BINGO_FUNCTION_EXPORT(bingo_beginscan);
 
     BINGO_FUNCTION_EXPORT(bingo_gettuple);
-    /*
-     * Turn off bitmap scan
-     */
-    // BINGO_FUNCTION_EXPORT(bingo_getbitmap);
 
     BINGO_FUNCTION_EXPORT(bingo_rescan);
 
@@ -174,42 +175,180 @@ Datum bingo_endscan(PG_FUNCTION_ARGS)
     PG_RETURN_VOID();
 #endif
 }
+#if PG_VERSION_NUM / 100 >= 1000
+/*
+ * Parallel scan shared state: the next section to search
+ */
+#if PG_VERSION_NUM / 100 >= 1700
+CEXPORT Size bingo_estimateparallelscan(int nkeys, int norderbys)
+#else
+CEXPORT Size bingo_estimateparallelscan(void)
+#endif
+{
+    return BingoPgSearchEngine::parallelScanSize();
+}
+
+CEXPORT void bingo_initparallelscan(void* target)
+{
+    BingoPgSearchEngine::initParallelScan(target);
+}
+
+CEXPORT void bingo_parallelrescan(IndexScanDesc scan)
+{
+    ParallelIndexScanDesc parallel_scan = scan->parallel_scan;
+    BingoPgSearchEngine::resetParallelScan(OffsetToPointer((void*)parallel_scan, parallel_scan->ps_offset));
+}
+#endif
+
+#if PG_VERSION_NUM / 100 >= 906
 /*
  * Get all tuples at once
  */
-// Datum
-// bingo_getbitmap(PG_FUNCTION_ARGS) {
-//   IndexScanDesc scan = (IndexScanDesc) PG_GETARG_POINTER(0);
-//   TIDBitmap *tbm = (TIDBitmap *) PG_GETARG_POINTER(1);
-//
-//   qword item_size = 0;
-//   BingoPgSearch* search_engine = (BingoPgSearch*) scan->opaque;
-//   PG_BINGO_BEGIN
-//   {
-//      /*
-//       * Create search engine
-//       */
-//      /*
-//       * Fetch to the next item and add result to the bitmap
-//       */
-//      indigo::Array<ItemPointerData> found_items;
-//      ItemPointer item_ptr;
-//      do {
-//         item_ptr = &found_items.push();
-//      } while (search_engine->next(scan, item_ptr));
-//      /*
-//       * Pop the last element
-//       */
-//      found_items.pop();
-//      item_size = found_items.size();
-//      BINGO_PG_TRY {
-//         tbm_add_tuples(tbm, found_items.ptr(), found_items.size(), false);
-//      } BINGO_PG_HANDLE(throw BingoPgError("internal error: can not add bitmap solution: %s", message));
-//   }
-//   PG_BINGO_HANDLE(delete search_engine);
-//
-//   PG_RETURN_INT64(item_size);
-//}
+CEXPORT int64 bingo_getbitmap(IndexScanDesc scan, TIDBitmap* tbm)
+{
+    int64 result = 0;
+
+    BingoPgSearch* search_engine = (BingoPgSearch*)scan->opaque;
+    if (search_engine == NULL)
+        elog(ERROR, "bingo: search error: search context was deleted");
+
+    PG_BINGO_BEGIN
+    {
+        /*
+         * Matches are verified by the search engine, so they are added without recheck.
+         * Every section is screened and verified as a whole, and its tids are read by map blocks.
+         * Single matches of the cursor searches are gathered up to a map block
+         */
+        Array<ItemPointerData> found_items;
+
+        auto add_found_items = [&]() {
+            BINGO_PG_TRY
+            {
+                tbm_add_tuples(tbm, found_items.ptr(), found_items.size(), false);
+            }
+            BINGO_PG_HANDLE(throw BingoPgError("internal error: can not add bitmap solution: %s", message));
+            result += found_items.size();
+            found_items.clear();
+        };
+
+        while (search_engine->nextSection(scan, found_items))
+        {
+            if (found_items.size() >= BINGO_MOLS_PER_MAPBLOCK)
+                add_found_items();
+        }
+        if (found_items.size() > 0)
+            add_found_items();
+    }
+    PG_BINGO_HANDLE(delete search_engine; scan->opaque = NULL);
+
+    return result;
+}
+#endif
+/*
+ * Fingerprint screening estimate for the planner. Returns the fraction of the indexed structures
+ * passed the screening of the query, or a negative value if the query is not screened by fingerprints
+ */
+static const int BINGO_ESTIMATE_SECTIONS = 2;
+/*
+ * The planner asks for the same query again on every plan of a statement and on every execution of
+ * a prepared one, so the last estimates are kept until the index grows or is rebuilt
+ */
+static const int BINGO_ESTIMATE_CACHE_SIZE = 16;
+
+struct BingoScreeningEstimate
+{
+    Oid index_oid;
+    Oid index_filenode;
+    BlockNumber index_blocks;
+    int strategy;
+    std::string query;
+    double fraction;
+    double query_bits;
+    double sections;
+};
+
+static std::vector<BingoScreeningEstimate> bingo_screening_estimates;
+static int bingo_screening_estimates_next = 0;
+
+CEXPORT double bingo_estimatescreening(Oid index_oid, int strategy, Datum query, double* query_bits, double* sections)
+{
+    double result = -1;
+
+    /*
+     * Other searches are made through a cursor over the shadow tables
+     */
+    if (strategy != BingoPgCommon::MOL_SUB && strategy != BingoPgCommon::MOL_SMARTS)
+        return result;
+
+    Relation rel = index_open(index_oid, AccessShareLock);
+    BlockNumber index_blocks = RelationGetNumberOfBlocks(rel);
+    Oid index_filenode = rel->rd_rel->relfilenode;
+
+    struct varlena* query_value = pg_detoast_datum_packed((struct varlena*)DatumGetPointer(query));
+    std::string query_key(VARDATA_ANY(query_value), VARSIZE_ANY_EXHDR(query_value));
+
+    for (const BingoScreeningEstimate& estimate : bingo_screening_estimates)
+    {
+        if (estimate.index_oid == index_oid && estimate.index_filenode == index_filenode && estimate.index_blocks == index_blocks &&
+            estimate.strategy == strategy && estimate.query == query_key)
+        {
+            index_close(rel, AccessShareLock);
+            *query_bits = estimate.query_bits;
+            *sections = estimate.sections;
+            return estimate.fraction;
+        }
+    }
+
+    IndexScanDesc scan = RelationGetIndexScan(rel, 1, 0);
+
+    ScanKey key = &scan->keyData[0];
+    memset(key, 0, sizeof(ScanKeyData));
+    key->sk_attno = 1;
+    key->sk_strategy = strategy;
+    key->sk_argument = query;
+
+    /*
+     * Planning falls back to the generic estimate if the query can not be prepared. Errors of
+     * PostgreSQL are caught as well, the search engine is released after the handler
+     */
+    std::unique_ptr<BingoPgSearch> search_engine;
+    BINGO_PG_TRY
+    {
+        try
+        {
+            search_engine = std::make_unique<BingoPgSearch>(rel);
+            result = search_engine->estimateScreening(scan, BINGO_ESTIMATE_SECTIONS, *query_bits, *sections);
+        }
+        catch (Exception& e)
+        {
+            elog(DEBUG1, "bingo: estimate: can not screen the query: %s", e.message());
+            result = -1;
+        }
+        catch (...)
+        {
+            elog(DEBUG1, "bingo: estimate: can not screen the query: unknown error");
+            result = -1;
+        }
+    }
+    BINGO_PG_HANDLE(elog(DEBUG1, "bingo: estimate: can not screen the query: %s", message); result = -1);
+    search_engine.reset();
+
+    IndexScanEnd(scan);
+    index_close(rel, AccessShareLock);
+
+    if (result >= 0)
+    {
+        BingoScreeningEstimate estimate = {index_oid, index_filenode, index_blocks, strategy, query_key, result, *query_bits, *sections};
+        if ((int)bingo_screening_estimates.size() < BINGO_ESTIMATE_CACHE_SIZE)
+            bingo_screening_estimates.push_back(std::move(estimate));
+        else
+            bingo_screening_estimates[bingo_screening_estimates_next] = std::move(estimate);
+        bingo_screening_estimates_next = (bingo_screening_estimates_next + 1) % BINGO_ESTIMATE_CACHE_SIZE;
+    }
+
+    return result;
+}
+
 /*
  * Get a tuples by a chain
  */
@@ -133,6 +133,30 @@ void BingoPgBufferCacheMap::getTidItem(int map_idx, ItemPointerData& tid_item)
     }
 }
 
+void BingoPgBufferCacheMap::getTidItems(const indigo::Array<int>& map_idxs, indigo::Array<ItemPointerData>& tid_items)
+{
+    for (int i = 0; i < map_idxs.size(); ++i)
+        _checkMapIdx(map_idxs[i]);
+
+    if (_write)
+    {
+        for (int i = 0; i < map_idxs.size(); ++i)
+            tid_items.push(_cache[map_idxs[i]].tid_map);
+    }
+    else
+    {
+        /*
+         * Read data for a buffer
+         */
+        _buffer.readBuffer(_index, _blockId, BINGO_PG_READ);
+        int data_len;
+        BingoMapData* map_data = (BingoMapData*)_buffer.getIndexData(data_len);
+        for (int i = 0; i < map_idxs.size(); ++i)
+            tid_items.push(map_data[map_idxs[i]].tid_map);
+        _buffer.changeAccess(BINGO_PG_NOLOCK);
+    }
+}
+
 void BingoPgBufferCacheMap::getCmfItem(int map_idx, ItemPointerData& cmf_item)
 {
     _checkMapIdx(map_idx);
@@ -74,6 +74,10 @@ public:
      * Getters
      */
     void getTidItem(int map_idx, ItemPointerData& tid_item);
+    /*
+     * Appends the tids of the given map indices, the buffer is locked once
+     */
+    void getTidItems(const indigo::Array<int>& map_idxs, indigo::Array<ItemPointerData>& tid_items);
     void getCmfItem(int map_idx, ItemPointerData& cmf_item);
     void getXyzItem(int map_idx, ItemPointerData& xyz_item);
 
@@ -475,6 +475,26 @@ void BingoPgIndex::readTidItem(int section_idx, int mol_idx, PG_OBJECT result_pt
     map_cache.getTidItem(map_mol_idx, result_item);
 }
 
+void BingoPgIndex::readTidItems(int section_idx, const BingoPgExternalBitset& structures, indigo::Array<ItemPointerData>& result)
+{
+    indigo::Array<int> map_idxs;
+    BingoPgSection& current_section = _jumpToSection(section_idx);
+
+    int mol_idx = structures.begin();
+    while (mol_idx != structures.end())
+    {
+        /*
+         * Collect the structures of the map block and read their tids at once
+         */
+        int map_block_idx = mol_idx / BINGO_MOLS_PER_MAPBLOCK;
+        map_idxs.clear();
+        for (; mol_idx != structures.end() && mol_idx / BINGO_MOLS_PER_MAPBLOCK == map_block_idx; mol_idx = structures.next(mol_idx))
+            map_idxs.push(mol_idx % BINGO_MOLS_PER_MAPBLOCK);
+
+        current_section.getMapBufferCache(map_block_idx).getTidItems(map_idxs, result);
+    }
+}
+
 void BingoPgIndex::andWithBitset(int section_idx, int fp_idx, BingoPgExternalBitset& ext_bitset)
 {
     // profTimerStart(t0, "bingo_pg.read_fp_and_with");
@@ -117,6 +117,10 @@ public:
      */
     void readTidItem(ItemPointerData&, PG_OBJECT result_ptr);
     void readTidItem(int section_idx, int mol_idx, PG_OBJECT result_ptr);
+    /*
+     * Appends the tids of the section structures set in the bitset, map block by map block
+     */
+    void readTidItems(int section_idx, const BingoPgExternalBitset& structures, indigo::Array<ItemPointerData>& result);
 
     void readCmfItem(int section_idx, int mol_idx, indigo::Array<char>& cmf_buf);
     void readXyzItem(int section_idx, int mol_idx, indigo::Array<char>& xyz_buf);
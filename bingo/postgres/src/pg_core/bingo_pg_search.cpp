@@ -65,6 +65,18 @@ bool BingoPgSearch::next(PG_OBJECT scan_desc_ptr, PG_OBJECT result_ptr)
     return _fpEngine->searchNext(result_ptr);
 }
 
+bool BingoPgSearch::nextSection(PG_OBJECT scan_desc_ptr, Array<ItemPointerData>& result)
+{
+    _indexScanDesc = scan_desc_ptr;
+
+    if (_initSearch)
+    {
+        _initScanSearch();
+    }
+
+    return _fpEngine->searchNextSection(result);
+}
+
 void BingoPgSearch::prepareRescan(PG_OBJECT scan_desc_ptr, bool deferred_finish)
 {
     _indexScanDesc = scan_desc_ptr;
@@ -81,10 +93,33 @@ void BingoPgSearch::prepareRescan(PG_OBJECT scan_desc_ptr, bool deferred_finish)
     }
 }
 
+double BingoPgSearch::estimateScreening(PG_OBJECT scan_desc_ptr, int max_sections, double& query_bits, double& sections)
+{
+    _indexScanDesc = scan_desc_ptr;
+    _initSearch = false;
+
+    _initSearchEngine();
+    _fpEngine->prepareQuerySearch(_bufferIndex, _indexScanDesc);
+
+    return _fpEngine->estimateScreening(max_sections, query_bits, sections);
+}
+
 void BingoPgSearch::_initScanSearch(bool deferred_finish)
 {
     _initSearch = false;
 
+    _initSearchEngine();
+    _fpEngine->setDeferredFinish(deferred_finish);
+
+    /*
+     * Process query structure with parameters
+     */
+    _fpEngine->prepareQuerySearch(_bufferIndex, _indexScanDesc);
+    _fpEngine->loadDictionary(_bufferIndex);
+}
+
+void BingoPgSearch::_initSearchEngine()
+{
     Relation index = ((IndexScanDesc)_indexScanDesc)->indexRelation;
 
     BingoPgWrapper rel_wr;
@@ -103,7 +138,6 @@ void BingoPgSearch::_initScanSearch(bool deferred_finish)
     else
         throw Error("unknown index type %d", index_type);
 
-    _fpEngine->setDeferredFinish(deferred_finish);
     /*
      * Read configuration from index tuple
      */
@@ -117,10 +151,4 @@ void BingoPgSearch::_initScanSearch(bool deferred_finish)
     bingo_config.setUpBingoConfiguration();
     bingo_core.bingoTautomerRulesReady(0, 0, 0);
     bingo_core.bingoIndexBegin();
-
-    /*
-     * Process query structure with parameters
-     */
-    _fpEngine->prepareQuerySearch(_bufferIndex, _indexScanDesc);
-    _fpEngine->loadDictionary(_bufferIndex);
 }
@@ -29,6 +29,10 @@ public:
      * Sets up item pointer
      */
     bool next(PG_OBJECT scan_desc_ptr, PG_OBJECT result_item);
+    /*
+     * Appends the tids of the matches of the next section with a match, see BingoPgSearchEngine::searchNextSection
+     */
+    bool nextSection(PG_OBJECT scan_desc_ptr, indigo::Array<ItemPointerData>& result);
 
     void setItemPointer(PG_OBJECT result_ptr);
     void readCmfItem(indigo::Array<char>& cmf_buf);
@@ -45,12 +49,19 @@ public:
 
     void prepareRescan(PG_OBJECT scan_desc_ptr, bool deferred_finish);
 
+    /*
+     * Prepares the query of the scan and estimates its fingerprint screening
+     * on the sampled sections without loading the dictionary
+     */
+    double estimateScreening(PG_OBJECT scan_desc_ptr, int max_sections, double& query_bits, double& sections);
+
     DECL_ERROR;
 
 private:
     BingoPgSearch(const BingoPgSearch&); // no implicit copy
 
     void _initScanSearch(bool deferred_finish = false);
+    void _initSearchEngine();
     //   void _defineQueryOptions();
 
     bool _initSearch;
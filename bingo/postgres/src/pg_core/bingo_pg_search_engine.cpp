@@ -5,12 +5,18 @@ extern "C"
 #include "postgres.h"
 
 #include "access/itup.h"
+#include "access/relscan.h"
 #include "fmgr.h"
 #include "storage/bufmgr.h"
+#if PG_VERSION_NUM / 100 >= 1000
+#include "port/atomics.h"
+#endif
 }
 
 #include "bingo_pg_fix_post.h"
 
+#include <algorithm>
+
 #include "bingo_pg_search_engine.h"
 
 #include "base_c/bitarray.h"
@@ -28,6 +34,17 @@ extern "C"
 
 using namespace indigo;
 
+#if PG_VERSION_NUM / 100 >= 1000
+/*
+ * Shared memory state of a parallel index scan
+ */
+typedef struct
+{
+    pg_atomic_uint32 next_section;
+    pg_atomic_uint32 cursor_claimed;
+} BingoPgParallelScanData;
+#endif
+
 void BingoPgFpData::setTidItem(PG_OBJECT item_ptr)
 {
     ItemPointerData& item_p = *(ItemPointer)item_ptr;
@@ -58,7 +75,8 @@ void BingoPgFpData::setXyz(const char* xyz_buf, int xyz_len)
 }
 
 BingoPgSearchEngine::BingoPgSearchEngine()
-    : _fetchFound(false), _currentSection(-1), _currentIdx(-1), _blockBegin(0), _blockEnd(0), _bufferIndexPtr(0), _sectionBitset(BINGO_MOLS_PER_SECTION)
+    : _fetchFound(false), _currentSection(-1), _currentIdx(-1), _blockBegin(0), _blockEnd(0), _bufferIndexPtr(0), _sectionBitset(BINGO_MOLS_PER_SECTION),
+      _matchedBitset(BINGO_MOLS_PER_SECTION)
 {
     _bingoContext = std::make_unique<BingoContext>(0);
     _mangoContext = std::make_unique<MangoContext>(*_bingoContext.get());
@@ -78,6 +96,35 @@ void BingoPgSearchEngine::setItemPointer(PG_OBJECT result_ptr)
     _bufferIndexPtr->readTidItem(_currentSection, _currentIdx, result_ptr);
 }
 
+bool BingoPgSearchEngine::searchNextSection(Array<ItemPointerData>& result)
+{
+    ItemPointerData item_data;
+    if (!searchNext(&item_data))
+        return false;
+    /*
+     * Cursor searches do not screen sections
+     */
+    if (!_fetchFound)
+    {
+        result.push(item_data);
+        return true;
+    }
+    /*
+     * Verify the rest of the screened structures of the section
+     */
+    _matchedBitset.clear();
+    do
+    {
+        _matchedBitset.set(_currentIdx);
+    } while (_fetchForNext());
+
+    _bufferIndexPtr->readTidItems(_currentSection, _matchedBitset, result);
+
+    _fetchFound = false;
+    _currentSection = _nextSection();
+    return true;
+}
+
 void BingoPgSearchEngine::loadDictionary(BingoPgIndex& bingo_index)
 {
     QS_DEF(Array<char>, dict);
@@ -90,7 +137,7 @@ bool BingoPgSearchEngine::matchTarget(ItemPointerData& item_data)
     return matchTarget(ItemPointerGetBlockNumber(&item_data), ItemPointerGetOffsetNumber(&item_data));
 }
 
-void BingoPgSearchEngine::prepareQuerySearch(BingoPgIndex& bingo_idx, PG_OBJECT)
+void BingoPgSearchEngine::prepareQuerySearch(BingoPgIndex& bingo_idx, PG_OBJECT scan_desc_ptr)
 {
     _bufferIndexPtr = &bingo_idx;
     _currentSection = -1;
@@ -98,12 +145,127 @@ void BingoPgSearchEngine::prepareQuerySearch(BingoPgIndex& bingo_idx, PG_OBJECT)
     _fetchFound = false;
     _blockBegin = 0;
     _blockEnd = bingo_idx.getSectionNumber();
+
+    _parallelScan = 0;
+    _cursorClaimed = false;
+#if PG_VERSION_NUM / 100 >= 1000
+    IndexScanDesc scan_desc = (IndexScanDesc)scan_desc_ptr;
+    if (scan_desc != NULL && scan_desc->parallel_scan != NULL)
+        _parallelScan = OffsetToPointer((void*)scan_desc->parallel_scan, scan_desc->parallel_scan->ps_offset);
+#endif
+}
+
+size_t BingoPgSearchEngine::parallelScanSize()
+{
+#if PG_VERSION_NUM / 100 >= 1000
+    return sizeof(BingoPgParallelScanData);
+#else
+    return 0;
+#endif
+}
+
+void BingoPgSearchEngine::initParallelScan(PG_OBJECT target)
+{
+#if PG_VERSION_NUM / 100 >= 1000
+    BingoPgParallelScanData* scan_data = (BingoPgParallelScanData*)target;
+    pg_atomic_init_u32(&scan_data->next_section, 0);
+    pg_atomic_init_u32(&scan_data->cursor_claimed, 0);
+#endif
+}
+
+void BingoPgSearchEngine::resetParallelScan(PG_OBJECT target)
+{
+#if PG_VERSION_NUM / 100 >= 1000
+    BingoPgParallelScanData* scan_data = (BingoPgParallelScanData*)target;
+    pg_atomic_write_u32(&scan_data->next_section, 0);
+    pg_atomic_write_u32(&scan_data->cursor_claimed, 0);
+#endif
+}
+
+double BingoPgSearchEngine::estimateScreening(int max_sections, double& query_bits, double& sections)
+{
+    BingoPgFpData& query_data = *_queryFpData;
+    BingoPgIndex& bingo_index = *_bufferIndexPtr;
+
+    query_bits = 0;
+    for (int fp_idx = query_data.bitBegin(); fp_idx != query_data.bitEnd(); fp_idx = query_data.bitNext(fp_idx))
+        ++query_bits;
+
+    int section_count = _blockEnd - _blockBegin;
+    sections = section_count;
+    if (section_count <= 0)
+        return 0;
+    /*
+     * Sections are sampled evenly, the structures are screened the same way as on searching
+     */
+    int sample_count = std::min(section_count, max_sections);
+    double structures = 0, candidates = 0;
+
+    for (int sample_idx = 0; sample_idx < sample_count; ++sample_idx)
+    {
+        int section_idx = _blockBegin + (int)((long long)sample_idx * section_count / sample_count);
+
+        bingo_index.getSectionBitset(section_idx, _sectionBitset);
+        structures += _sectionBitset.bitsNumber();
+
+        for (int fp_idx = query_data.bitBegin(); fp_idx != query_data.bitEnd() && _sectionBitset.hasBits(); fp_idx = query_data.bitNext(fp_idx))
+            bingo_index.andWithBitset(section_idx, query_data.getBit(fp_idx), _sectionBitset);
+
+        candidates += _sectionBitset.bitsNumber();
+    }
+
+    if (structures == 0)
+        return 0;
+
+    return candidates / structures;
+}
+
+int BingoPgSearchEngine::_firstSection()
+{
+    if (_parallelScan != 0)
+        return _nextSection();
+
+    return _blockBegin;
+}
+
+int BingoPgSearchEngine::_nextSection()
+{
+#if PG_VERSION_NUM / 100 >= 1000
+    if (_parallelScan != 0)
+    {
+        /*
+         * A participant finishes when the sections are over
+         */
+        BingoPgParallelScanData* scan_data = (BingoPgParallelScanData*)_parallelScan;
+        uint32 claimed = pg_atomic_fetch_add_u32(&scan_data->next_section, 1);
+        return claimed < (uint32)(_blockEnd - _blockBegin) ? _blockBegin + (int)claimed : _blockEnd;
+    }
+#endif
+    return _currentSection + 1;
+}
+
+bool BingoPgSearchEngine::_claimCursor()
+{
+    if (_parallelScan == 0 || _cursorClaimed)
+        return true;
+
+#if PG_VERSION_NUM / 100 >= 1000
+    /*
+     * Cursor results can not be split, so the first participant reads them all
+     */
+    BingoPgParallelScanData* scan_data = (BingoPgParallelScanData*)_parallelScan;
+    _cursorClaimed = pg_atomic_exchange_u32(&scan_data->cursor_claimed, 1) == 0;
+#endif
+    return _cursorClaimed;
 }
 
 bool BingoPgSearchEngine::_searchNextCursor(PG_OBJECT result_ptr)
 {
     // profTimerStart(t0, "bingo_pg.search_cursor");
     ItemPointerData cmf_item;
+
+    if (!_claimCursor())
+        return false;
     /*
      * Iterate through the cursor
      */
@@ -150,17 +312,17 @@ bool BingoPgSearchEngine::_searchNextSub(PG_OBJECT result_ptr)
         else
         {
             _fetchFound = false;
-            ++_currentSection;
+            _currentSection = _nextSection();
         }
     }
     // profTimerStart(t1, "bingo_pg.search_fp");
 
     if (_currentSection < 0)
-        _currentSection = _blockBegin;
+        _currentSection = _firstSection();
     /*
      * Iterate through the sections bingo_index.readEnd()
      */
-    for (; _currentSection < _blockEnd; ++_currentSection)
+    for (; _currentSection < _blockEnd; _currentSection = _nextSection())
     {
         /*
          * Get section existing structures
@@ -145,10 +145,31 @@ public:
         return false;
     }
 
+    /*
+     * Appends the tids of all the matches of the next section with a match. Sections are screened
+     * and verified as a whole, searches made through a cursor append a single match per call
+     */
+    bool searchNextSection(indigo::Array<ItemPointerData>& result);
+
     void setItemPointer(PG_OBJECT result_ptr);
 
     void loadDictionary(BingoPgIndex&);
     indigo::bingo_core::BingoCore bingoCore;
+
+    /*
+     * Shared state of a parallel index scan. Participants claim the index sections
+     * one by one, and only one of them reads the searches made through a cursor
+     */
+    static size_t parallelScanSize();
+    static void initParallelScan(PG_OBJECT target);
+    static void resetParallelScan(PG_OBJECT target);
+
+    /*
+     * Screens the sampled sections by the prepared query fingerprint and returns
+     * the fraction of their structures passed the screening. Sets the number of the
+     * query fingerprint bits and the number of the sections to search
+     */
+    double estimateScreening(int max_sections, double& query_bits, double& sections);
     //   const char* getDictionary(int& size);
 
 private:
@@ -162,6 +183,14 @@ protected:
 
     void _getBlockParameters(indigo::Array<char>& params);
 
+    /*
+     * Sections to search: the block range in a single scan, claimed
+     * sections of the block range in a parallel one
+     */
+    int _firstSection();
+    int _nextSection();
+    bool _claimCursor();
+
     bool _fetchFound;
     int _currentSection;
     int _currentIdx;
@@ -171,9 +200,13 @@ protected:
 
     bool _deferred_finish = false;
 
+    PG_OBJECT _parallelScan = 0;
+    bool _cursorClaimed = false;
+
     BingoPgIndex* _bufferIndexPtr;
 
     BingoPgExternalBitset _sectionBitset;
+    BingoPgExternalBitset _matchedBitset;
     std::unique_ptr<BingoPgFpData> _queryFpData;
     std::unique_ptr<BingoPgCursor> _searchCursor;
     std::unique_ptr<indigo::BingoContext> _bingoContext;
@@ -702,7 +702,7 @@ bool MangoPgSearchEngine::_searchNextSim(PG_OBJECT result_ptr)
         else
         {
             _fetchFound = false;
-            ++_currentSection;
+            _currentSection = _nextSection();
         }
     }
 
@@ -717,11 +717,11 @@ bool MangoPgSearchEngine::_searchNextSim(PG_OBJECT result_ptr)
      * Read first section
      */
     if (_currentSection < 0)
-        _currentSection = _blockBegin;
+        _currentSection = _firstSection();
     /*
      * Iterate through the sections
      */
-    for (; _currentSection < _blockEnd; ++_currentSection)
+    for (; _currentSection < _blockEnd; _currentSection = _nextSection())
     {
         _currentIdx = -1;
         /*
@@ -0,0 +1,95 @@
+import json
+
+import pytest
+from sqlalchemy import text
+
+
+class TestSubstructure:
+    @pytest.fixture(scope="class", autouse=True)
+    def regression_table(self, db):
+        if db.dbms != "postgres":
+            yield None
+            return
+
+        table_name = "substructure_bitmap_regression_m_m_t"
+        db._execute_dml_query(
+            f"DROP TABLE IF EXISTS {db.test_schema}.{table_name} CASCADE"
+        )
+        db.create_data_tables([table_name])
+        # A half of the structures has a phenol, so the matches of a section
+        # span several map blocks
+        db._execute_dml_query(
+            f"""
+            INSERT INTO {db.test_schema}.{table_name}(id, data)
+            SELECT i, CASE WHEN i % 2 = 0
+                THEN 'Oc1ccccc1' || repeat('C', 1 + i % 10)
+                ELSE repeat('C', 1 + i % 20) || 'O' END
+            FROM generate_series(1, 2000) AS i
+            """
+        )
+        db.create_indices([table_name])
+        db._execute_dml_query(f"ANALYZE {db.test_schema}.{table_name}")
+
+        yield table_name
+
+        db._connect.execute(text("COMMIT"))
+        db._execute_dml_query(
+            f"DROP TABLE IF EXISTS {db.test_schema}.{table_name} CASCADE"
+        )
+
+    def _search(self, db, table_name, condition_sql, bitmap):
+        disabled = "enable_indexscan" if bitmap else "enable_bitmapscan"
+        db._connect.execute(text("SET enable_seqscan = off"))
+        db._connect.execute(text(f"SET {disabled} = off"))
+        query_sql = (
+            f"SELECT id FROM {db.test_schema}.{table_name} WHERE {condition_sql}"
+        )
+        result = db._connect.execute(
+            text(f"EXPLAIN (FORMAT JSON) {query_sql}")
+        )
+        plan = result.fetchone()[0]
+        result.close()
+        result = db._connect.execute(text(f"{query_sql} ORDER BY id"))
+        ids = [row[0] for row in result.fetchall()]
+        result.close()
+        db._connect.execute(text("COMMIT"))
+        db._connect.execute(text(f"RESET {disabled}"))
+        db._connect.execute(text("RESET enable_seqscan"))
+
+        if isinstance(plan, str):
+            plan = json.loads(plan)
+        node_types = []
+        node = plan[0]["Plan"]
+        while True:
+            node_types.append(node["Node Type"])
+            if "Plans" not in node:
+                break
+            node = node["Plans"][0]
+        return node_types, ids
+
+    @pytest.mark.parametrize(
+        "condition_sql",
+        [
+            "data @ ('c1ccccc1O', '')::bingo.sub",
+            "data @ ('[#8;H1]c1ccccc1', '')::bingo.smarts",
+            "data @ ('Oc1ccccc1CCC', '')::bingo.exact",
+        ],
+    )
+    def test_bitmap_scan_matches_index_scan(
+        self, db, db_backend, regression_table, condition_sql
+    ):
+        if db_backend != "postgres":
+            pytest.skip("Regression test only supported in PostgreSQL backend")
+
+        # The bitmap scan adds the matches of whole sections at once, the
+        # index scan returns them one by one
+        index_nodes, index_ids = self._search(
+            db, regression_table, condition_sql, bitmap=False
+        )
+        bitmap_nodes, bitmap_ids = self._search(
+            db, regression_table, condition_sql, bitmap=True
+        )
+        assert "Index Scan" in index_nodes
+        assert "Bitmap Index Scan" in bitmap_nodes
+        assert len(index_ids) > 0
+        assert bitmap_ids == index_ids
@@ -0,0 +1,84 @@
+import json
+
+import pytest
+from sqlalchemy import text
+
+
+class TestSubstructure:
+    @pytest.fixture(scope="class", autouse=True)
+    def regression_table(self, db):
+        if db.dbms != "postgres":
+            yield None
+            return
+
+        table_name = "substructure_cost_regression_m_m_t"
+        db._execute_dml_query(
+            f"DROP TABLE IF EXISTS {db.test_schema}.{table_name} CASCADE"
+        )
+        db.create_data_tables([table_name])
+        # Every structure has a chain of carbons, only a few have a sulfonamide
+        db._execute_dml_query(
+            f"""
+            INSERT INTO {db.test_schema}.{table_name}(id, data)
+            SELECT i, repeat('C', 1 + i % 20) || 'O'
+            FROM generate_series(1, 1000) AS i
+            """
+        )
+        db._execute_dml_query(
+            f"""
+            INSERT INTO {db.test_schema}.{table_name}(id, data) VALUES
+                (1001, 'NS(=O)(=O)c1ccc(C)cc1'),
+                (1002, 'CNS(=O)(=O)c1ccccc1'),
+                (1003, 'CCNS(=O)(=O)C')
+            """
+        )
+        db.create_indices([table_name])
+        db._execute_dml_query(f"ANALYZE {db.test_schema}.{table_name}")
+
+        yield table_name
+
+        db._connect.execute(text("COMMIT"))
+        db._execute_dml_query(
+            f"DROP TABLE IF EXISTS {db.test_schema}.{table_name} CASCADE"
+        )
+
+    def _index_scan_estimate(self, db, table_name, condition_sql):
+        db._connect.execute(text("SET enable_seqscan = off"))
+        result = db._connect.execute(
+            text(
+                f"""
+                EXPLAIN (FORMAT JSON) SELECT id FROM {db.test_schema}.{table_name}
+                WHERE {condition_sql}
+                """
+            )
+        )
+        plan = result.fetchone()[0]
+        result.close()
+        db._connect.execute(text("COMMIT"))
+        if isinstance(plan, str):
+            plan = json.loads(plan)
+        node = plan[0]["Plan"]
+        while "Index" not in node["Node Type"] and "Plans" in node:
+            node = node["Plans"][0]
+        assert "Index" in node["Node Type"]
+        return node["Plan Rows"], node["Total Cost"]
+
+    def test_substructure_cost_estimate(self, db, db_backend, regression_table):
+        if db_backend != "postgres":
+            pytest.skip("Regression test only supported in PostgreSQL backend")
+
+        # A row constructor query is screened the same way as a composite literal
+        row_query = self._index_scan_estimate(
+            db, regression_table, "data @ ('NS(=O)(=O)C', '')::bingo.sub"
+        )
+        literal_query = self._index_scan_estimate(
+            db, regression_table, "data @ '(\"NS(=O)(=O)C\",\"\")'::bingo.sub"
+        )
+        assert row_query == literal_query
+
+        # Screening makes the estimate depend on the query
+        common_query = self._index_scan_estimate(
+            db, regression_table, "data @ ('CO', '')::bingo.sub"
+        )
+        assert row_query[0] < common_query[0]
+        assert row_query[1] < common_query[1]
@@ -21,6 +21,18 @@
 
 #include "base_c/bitarray.h"
 
+// The vector kernels sum 64-bit lanes, so they are built for 64-bit targets only
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__EMSCRIPTEN__)
+#define BIT_POPCOUNT_X86
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define BIT_POPCOUNT_MSVC_X64
+#include <intrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define BIT_POPCOUNT_NEON
+#include <arm_neon.h>
+#endif
+
 int bitGetBit(const void* bitarray, int bitno)
 {
     return ((((char*)bitarray)[bitno / 8] & (char)(1 << (bitno % 8))) == 0) ? 0 : 1;
@@ -128,14 +140,344 @@ int bitGetOnesCountQword(qword value)
     return bitGetOnesCountDword((dword)value) + bitGetOnesCountDword((dword)(value >> 32));
 }
 
-int bitGetOnesCount(const byte* data, int size)
+//
+// Popcount kernels. The best one supported by the CPU is selected at the first call.
+// All of them return exactly the same counts, they differ only in speed.
+//
+
+enum
+{
+    BIT_OP_NONE,   // a
+    BIT_OP_AND,    // a & b
+    BIT_OP_ANDNOT, // a & ~b
+    BIT_OP_XOR,    // a ^ b
+    BIT_OP_OR,     // a | b
+    BIT_OP_COUNT
+};
+
+typedef int (*BitCountFunc)(const byte* a, const byte* b, int n_bytes);
+// Counts op(query, fingerprint) for every fingerprint from a contiguous array
+typedef void (*BitCountBatchFunc)(const byte* query, const byte* fingerprints, int n_bytes, int count, int* res);
+
+typedef struct
+{
+    const char* name;
+    BitCountFunc count[BIT_OP_COUNT];
+    BitCountBatchFunc count_batch[BIT_OP_COUNT];
+} BitPopcountKernel;
+
+static inline qword _bitLoadQword(const byte* p)
+{
+    qword value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline qword _bitCombineQword(qword a, qword b, int op)
+{
+    switch (op)
+    {
+    case BIT_OP_AND:
+        return a & b;
+    case BIT_OP_ANDNOT:
+        return a & ~b;
+    case BIT_OP_XOR:
+        return a ^ b;
+    case BIT_OP_OR:
+        return a | b;
+    default:
+        return a;
+    }
+}
+
+static inline int _bitCountTail(const byte* a, const byte* b, int from, int n_bytes, int op)
 {
     int count = 0;
-    while (size-- > 0)
-        count += bitGetOnesCountByte(*data++);
+    for (; from < n_bytes; from++)
+        count += bitGetOnesCountByte((byte)_bitCombineQword(a[from], b != 0 ? b[from] : 0, op));
     return count;
 }
 
+// Defines the functions for all the operations from the kernel body impl(a, b, n_bytes, op)
+#define BIT_DEFINE_KERNEL(isa, attr, impl)                                                                                                                     \
+    attr static int _bitCount_##isa##_none(const byte* a, const byte* b, int n)                                                                               \
+    {                                                                                                                                                          \
+        (void)b;                                                                                                                                               \
+        return impl(a, 0, n, BIT_OP_NONE);                                                                                                                     \
+    }                                                                                                                                                          \
+    attr static int _bitCount_##isa##_and(const byte* a, const byte* b, int n)                                                                                \
+    {                                                                                                                                                          \
+        return impl(a, b, n, BIT_OP_AND);                                                                                                                      \
+    }                                                                                                                                                          \
+    attr static int _bitCount_##isa##_andnot(const byte* a, const byte* b, int n)                                                                             \
+    {                                                                                                                                                          \
+        return impl(a, b, n, BIT_OP_ANDNOT);                                                                                                                   \
+    }                                                                                                                                                          \
+    attr static int _bitCount_##isa##_xor(const byte* a, const byte* b, int n)                                                                                \
+    {                                                                                                                                                          \
+        return impl(a, b, n, BIT_OP_XOR);                                                                                                                      \
+    }                                                                                                                                                          \
+    attr static int _bitCount_##isa##_or(const byte* a, const byte* b, int n)                                                                                 \
+    {                                                                                                                                                          \
+        return impl(a, b, n, BIT_OP_OR);                                                                                                                       \
+    }                                                                                                                                                          \
+    attr static void _bitCountBatch_##isa##_none(const byte* q, const byte* fps, int n, int count, int* res)                                                  \
+    {                                                                                                                                                          \
+        int i;                                                                                                                                                 \
+        (void)q;                                                                                                                                               \
+        for (i = 0; i < count; i++)                                                                                                                            \
+            res[i] = impl(fps + i * n, 0, n, BIT_OP_NONE);                                                                                                     \
+    }                                                                                                                                                          \
+    attr static void _bitCountBatch_##isa##_and(const byte* q, const byte* fps, int n, int count, int* res)                                                   \
+    {                                                                                                                                                          \
+        int i;                                                                                                                                                 \
+        for (i = 0; i < count; i++)                                                                                                                            \
+            res[i] = impl(q, fps + i * n, n, BIT_OP_AND);                                                                                                      \
+    }                                                                                                                                                          \
+    attr static void _bitCountBatch_##isa##_andnot(const byte* q, const byte* fps, int n, int count, int* res)                                                \
+    {                                                                                                                                                          \
+        int i;                                                                                                                                                 \
+        for (i = 0; i < count; i++)                                                                                                                            \
+            res[i] = impl(q, fps + i * n, n, BIT_OP_ANDNOT);                                                                                                   \
+    }                                                                                                                                                          \
+    attr static void _bitCountBatch_##isa##_xor(const byte* q, const byte* fps, int n, int count, int* res)                                                   \
+    {                                                                                                                                                          \
+        int i;                                                                                                                                                 \
+        for (i = 0; i < count; i++)                                                                                                                            \
+            res[i] = impl(q, fps + i * n, n, BIT_OP_XOR);                                                                                                      \
+    }                                                                                                                                                          \
+    attr static void _bitCountBatch_##isa##_or(const byte* q, const byte* fps, int n, int count, int* res)                                                    \
+    {                                                                                                                                                          \
+        int i;                                                                                                                                                 \
+        for (i = 0; i < count; i++)                                                                                                                            \
+            res[i] = impl(q, fps + i * n, n, BIT_OP_OR);                                                                                                       \
+    }                                                                                                                                                          \
+    static const BitPopcountKernel _bit_kernel_##isa = {#isa,                                                                                                  \
+                                                        {_bitCount_##isa##_none, _bitCount_##isa##_and, _bitCount_##isa##_andnot, _bitCount_##isa##_xor,       \
+                                                         _bitCount_##isa##_or},                                                                                \
+                                                        {_bitCountBatch_##isa##_none, _bitCountBatch_##isa##_and, _bitCountBatch_##isa##_andnot,               \
+                                                         _bitCountBatch_##isa##_xor, _bitCountBatch_##isa##_or}};
+
+#define BIT_NO_ATTR
+
+// Portable kernel
+static inline int _bitCountGeneric(const byte* a, const byte* b, int n_bytes, int op)
+{
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= n_bytes; i += 8)
+        count += bitGetOnesCountQword(_bitCombineQword(_bitLoadQword(a + i), b != 0 ? _bitLoadQword(b + i) : 0, op));
+    return count + _bitCountTail(a, b, i, n_bytes, op);
+}
+
+BIT_DEFINE_KERNEL(generic, BIT_NO_ATTR, _bitCountGeneric)
+
+#if defined(BIT_POPCOUNT_X86)
+
+#define BIT_TARGET_POPCNT __attribute__((target("popcnt")))
+#define BIT_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define BIT_TARGET_AVX512 __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+
+BIT_TARGET_POPCNT static inline int _bitCountPopcnt(const byte* a, const byte* b, int n_bytes, int op)
+{
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= n_bytes; i += 8)
+        count += __builtin_popcountll(_bitCombineQword(_bitLoadQword(a + i), b != 0 ? _bitLoadQword(b + i) : 0, op));
+    return count + _bitCountTail(a, b, i, n_bytes, op);
+}
+
+BIT_DEFINE_KERNEL(popcnt, BIT_TARGET_POPCNT, _bitCountPopcnt)
+
+BIT_TARGET_AVX2 static inline __m256i _bitCombine256(__m256i a, __m256i b, int op)
+{
+    switch (op)
+    {
+    case BIT_OP_AND:
+        return _mm256_and_si256(a, b);
+    case BIT_OP_ANDNOT:
+        return _mm256_andnot_si256(b, a);
+    case BIT_OP_XOR:
+        return _mm256_xor_si256(a, b);
+    case BIT_OP_OR:
+        return _mm256_or_si256(a, b);
+    default:
+        return a;
+    }
+}
+
+// Nibble lookup popcount (W. Mula), returns four 64-bit partial sums
+BIT_TARGET_AVX2 static inline __m256i _bitPopcount256(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+BIT_TARGET_AVX2 static inline int _bitCountAvx2(const byte* a, const byte* b, int n_bytes, int op)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= n_bytes; i += 32)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = b != 0 ? _mm256_loadu_si256((const __m256i*)(b + i)) : va;
+        acc = _mm256_add_epi64(acc, _bitPopcount256(_bitCombine256(va, vb, op)));
+    }
+    int count = (int)(_mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3));
+    for (; i + 8 <= n_bytes; i += 8)
+        count += __builtin_popcountll(_bitCombineQword(_bitLoadQword(a + i), b != 0 ? _bitLoadQword(b + i) : 0, op));
+    return count + _bitCountTail(a, b, i, n_bytes, op);
+}
+
+BIT_DEFINE_KERNEL(avx2, BIT_TARGET_AVX2, _bitCountAvx2)
+
+BIT_TARGET_AVX512 static inline __m512i _bitCombine512(__m512i a, __m512i b, int op)
+{
+    switch (op)
+    {
+    case BIT_OP_AND:
+        return _mm512_and_si512(a, b);
+    case BIT_OP_ANDNOT:
+        return _mm512_andnot_si512(b, a);
+    case BIT_OP_XOR:
+        return _mm512_xor_si512(a, b);
+    case BIT_OP_OR:
+        return _mm512_or_si512(a, b);
+    default:
+        return a;
+    }
+}
+
+BIT_TARGET_AVX512 static inline int _bitCountAvx512(const byte* a, const byte* b, int n_bytes, int op)
+{
+    __m512i acc = _mm512_setzero_si512();
+    int i = 0;
+    for (; i + 64 <= n_bytes; i += 64)
+    {
+        __m512i va = _mm512_loadu_si512((const void*)(a + i));
+        __m512i vb = b != 0 ? _mm512_loadu_si512((const void*)(b + i)) : va;
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_bitCombine512(va, vb, op)));
+    }
+    int count = (int)_mm512_reduce_add_epi64(acc);
+    for (; i + 8 <= n_bytes; i += 8)
+        count += __builtin_popcountll(_bitCombineQword(_bitLoadQword(a + i), b != 0 ? _bitLoadQword(b + i) : 0, op));
+    return count + _bitCountTail(a, b, i, n_bytes, op);
+}
+
+BIT_DEFINE_KERNEL(avx512, BIT_TARGET_AVX512, _bitCountAvx512)
+
+#elif defined(BIT_POPCOUNT_MSVC_X64)
+
+static inline int _bitCountPopcnt(const byte* a, const byte* b, int n_bytes, int op)
+{
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= n_bytes; i += 8)
+        count += (int)__popcnt64(_bitCombineQword(_bitLoadQword(a + i), b != 0 ? _bitLoadQword(b + i) : 0, op));
+    return count + _bitCountTail(a, b, i, n_bytes, op);
+}
+
+BIT_DEFINE_KERNEL(popcnt, BIT_NO_ATTR, _bitCountPopcnt)
+
+#elif defined(BIT_POPCOUNT_NEON)
+
+static inline uint8x16_t _bitCombine128(uint8x16_t a, uint8x16_t b, int op)
+{
+    switch (op)
+    {
+    case BIT_OP_AND:
+        return vandq_u8(a, b);
+    case BIT_OP_ANDNOT:
+        return vbicq_u8(a, b);
+    case BIT_OP_XOR:
+        return veorq_u8(a, b);
+    case BIT_OP_OR:
+        return vorrq_u8(a, b);
+    default:
+        return a;
+    }
+}
+
+static inline int _bitCountNeon(const byte* a, const byte* b, int n_bytes, int op)
+{
+    int count = 0;
+    int i = 0;
+    for (; i + 16 <= n_bytes; i += 16)
+    {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = b != 0 ? vld1q_u8(b + i) : va;
+        count += vaddlvq_u8(vcntq_u8(_bitCombine128(va, vb, op)));
+    }
+    return count + _bitCountTail(a, b, i, n_bytes, op);
+}
+
+BIT_DEFINE_KERNEL(neon, BIT_NO_ATTR, _bitCountNeon)
+
+#endif
+
+static const BitPopcountKernel* _bitFindKernel(const char* name)
+{
+    if (strcmp(name, "generic") == 0)
+        return &_bit_kernel_generic;
+#if defined(BIT_POPCOUNT_X86)
+    __builtin_cpu_init();
+    if (strcmp(name, "popcnt") == 0 && __builtin_cpu_supports("popcnt"))
+        return &_bit_kernel_popcnt;
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        return &_bit_kernel_avx2;
+    if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+        return &_bit_kernel_avx512;
+#elif defined(BIT_POPCOUNT_MSVC_X64)
+    if (strcmp(name, "popcnt") == 0)
+    {
+        int cpu_info[4];
+        __cpuid(cpu_info, 1);
+        if (cpu_info[2] & (1 << 23))
+            return &_bit_kernel_popcnt;
+    }
+#elif defined(BIT_POPCOUNT_NEON)
+    if (strcmp(name, "neon") == 0)
+        return &_bit_kernel_neon;
+#endif
+    return 0;
+}
+
+static const BitPopcountKernel* _bitSelectKernel(void)
+{
+    static const char* preferred[] = {"avx512", "avx2", "popcnt", "neon"};
+    int i;
+    for (i = 0; i < (int)(sizeof(preferred) / sizeof(preferred[0])); i++)
+    {
+        const BitPopcountKernel* kernel = _bitFindKernel(preferred[i]);
+        if (kernel != 0)
+            return kernel;
+    }
+    return &_bit_kernel_generic;
+}
+
+// Every thread selects the same kernel, so a concurrent first call is harmless
+static const BitPopcountKernel* volatile _bit_kernel = 0;
+
+static const BitPopcountKernel* _bitKernel(void)
+{
+    const BitPopcountKernel* kernel = _bit_kernel;
+    if (kernel == 0)
+    {
+        kernel = _bitSelectKernel();
+        _bit_kernel = kernel;
+    }
+    return kernel;
+}
+
+int bitGetOnesCount(const byte* data, int size)
+{
+    return _bitKernel()->count[BIT_OP_NONE](data, 0, size);
+}
+
 int bitGetOneHOIndex(byte value)
 {
     static const int oneHOIndex[] = {0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 6, 6, 6, 6, 6,
@@ -218,106 +560,48 @@ int bitIdecticalBits(const byte* bit1, const byte* bit2, int n_bytes)
 
 int bitCommonOnes(const byte* bit1, const byte* bit2, int n_bytes)
 {
-    int qwords_count = n_bytes / sizeof(qword);
-    int bytes_left = n_bytes - qwords_count * sizeof(qword);
-
-    int count = 0;
-    const qword* bit1_ptr = (const qword*)bit1;
-    const qword* bit2_ptr = (const qword*)bit2;
-    while (qwords_count-- > 0)
-    {
-        qword id = *bit1_ptr & *bit2_ptr;
-        count += bitGetOnesCountQword(id);
-
-        bit1_ptr++;
-        bit2_ptr++;
-    }
-
-    if (bytes_left != 0)
-    {
-        qword mask = ~(qword)0 >> (64 - 8 * bytes_left);
-        qword id = *bit1_ptr & *bit2_ptr & mask;
-        count += bitGetOnesCountQword(id);
-    }
-    return count;
+    return _bitKernel()->count[BIT_OP_AND](bit1, bit2, n_bytes);
 }
 
 int bitUniqueOnes(const byte* bit1, const byte* bit2, int n_bytes)
 {
-    int qwords_count = n_bytes / sizeof(qword);
-    int bytes_left = n_bytes - qwords_count * sizeof(qword);
-
-    int count = 0;
-    const qword* bit1_ptr = (const qword*)bit1;
-    const qword* bit2_ptr = (const qword*)bit2;
-    while (qwords_count-- > 0)
-    {
-        qword id = *bit1_ptr & ~*bit2_ptr;
-        count += bitGetOnesCountQword(id);
-
-        bit1_ptr++;
-        bit2_ptr++;
-    }
-
-    if (bytes_left != 0)
-    {
-        qword mask = ~(qword)0 >> (64 - 8 * bytes_left);
-        qword id = *bit1_ptr & ~*bit2_ptr & mask;
-        count += bitGetOnesCountQword(id);
-    }
-    return count;
+    return _bitKernel()->count[BIT_OP_ANDNOT](bit1, bit2, n_bytes);
 }
 
 int bitDifferentOnes(const byte* bit1, const byte* bit2, int n_bytes)
 {
-    int qwords_count = n_bytes / sizeof(qword);
-    int bytes_left = n_bytes - qwords_count * sizeof(qword);
-
-    int count = 0;
-    const qword* bit1_ptr = (const qword*)bit1;
-    const qword* bit2_ptr = (const qword*)bit2;
-    while (qwords_count-- > 0)
-    {
-        qword id = *bit1_ptr ^ *bit2_ptr;
-        count += bitGetOnesCount((byte*)&id, sizeof(qword));
-
-        bit1_ptr++;
-        bit2_ptr++;
-    }
-
-    if (bytes_left != 0)
-    {
-        qword mask = ~(qword)0 >> (64 - 8 * bytes_left);
-        qword id = (*bit1_ptr ^ *bit2_ptr) & mask;
-        count += bitGetOnesCountQword(id);
-    }
-    return count;
+    return _bitKernel()->count[BIT_OP_XOR](bit1, bit2, n_bytes);
 }
 
 int bitUnionOnes(const byte* bit1, const byte* bit2, int n_bytes)
 {
-    int qwords_count = n_bytes / sizeof(qword);
-    int bytes_left = n_bytes - qwords_count * sizeof(qword);
+    return _bitKernel()->count[BIT_OP_OR](bit1, bit2, n_bytes);
+}
 
-    int count = 0;
-    const qword* bit1_ptr = (const qword*)bit1;
-    const qword* bit2_ptr = (const qword*)bit2;
-    while (qwords_count-- > 0)
-    {
-        qword id = *bit1_ptr | *bit2_ptr;
-        count += bitGetOnesCountQword(id);
+void bitGetOnesCountBatch(const byte* fingerprints, int n_bytes, int count, int* ones)
+{
+    _bitKernel()->count_batch[BIT_OP_NONE](0, fingerprints, n_bytes, count, ones);
+}
 
-        bit1_ptr++;
-        bit2_ptr++;
-    }
+void bitCommonOnesBatch(const byte* query, const byte* fingerprints, int n_bytes, int count, int* common)
+{
+    _bitKernel()->count_batch[BIT_OP_AND](query, fingerprints, n_bytes, count, common);
+}
 
-    if (bytes_left != 0)
-    {
-        qword mask = ~(qword)0 >> (64 - 8 * bytes_left);
-        qword id = (*bit1_ptr | *bit2_ptr) & mask;
-        count += bitGetOnesCountQword(id);
-    }
-    return count;
+const char* bitGetPopcountKernel(void)
+{
+    return _bitKernel()->name;
+}
+
+// Not a part of the API, the unit tests declare it to run every kernel supported by the CPU.
+// Returns 0 if the kernel is unknown or not supported by the CPU
+int bitSetPopcountKernel(const char* name)
+{
+    const BitPopcountKernel* kernel = _bitFindKernel(name);
+    if (kernel == 0)
+        return 0;
+    _bit_kernel = kernel;
+    return 1;
 }
 
 // a &= b
@@ -55,6 +55,13 @@ extern "C"
     DLLEXPORT int bitDifferentOnes(const byte* bit1, const byte* bit2, int n_bytes);
     DLLEXPORT int bitUnionOnes(const byte* bit1, const byte* bit2, int n_bytes);
 
+    // Same as bitGetOnesCount/bitCommonOnes for count fingerprints of n_bytes stored one after another
+    DLLEXPORT void bitGetOnesCountBatch(const byte* fingerprints, int n_bytes, int count, int* ones);
+    DLLEXPORT void bitCommonOnesBatch(const byte* query, const byte* fingerprints, int n_bytes, int count, int* common);
+
+    // Popcount implementation in use: "generic", "popcnt", "avx2", "avx512" or "neon"
+    DLLEXPORT const char* bitGetPopcountKernel(void);
+
     DLLEXPORT void bitAnd(byte* a, const byte* b, int n_bytes);
     DLLEXPORT void bitOr(byte* a, const byte* b, int nbytes);
 
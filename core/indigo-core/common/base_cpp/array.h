@@ -30,6 +30,7 @@
 
 #include "base_c/defs.h"
 #include "base_cpp/exception.h"
+#include "base_cpp/scratch_arena.h"
 
 namespace indigo
 {
@@ -41,12 +42,22 @@ namespace indigo
     public:
         DECL_TPL_ERROR(ArrayError);
 
-        explicit Array() : _reserved(0), _length(0), _array(nullptr)
+        explicit Array() : _reserved(0), _length(0), _array(nullptr), _arena(nullptr)
         {
         }
 
-        Array(Array&& other) : _reserved(other._reserved), _length(other._length), _array(other._array)
+        Array(Array&& other) : _reserved(other._reserved), _length(other._length), _array(other._array), _arena(nullptr)
         {
+            if (other._arena != nullptr)
+            {
+                // Scratch storage must not outlive its scope, so it is copied to the heap
+                _reserved = 0;
+                _length = 0;
+                _array = nullptr;
+                copy(other);
+                other._length = 0;
+                return;
+            }
             other._array = nullptr;
             other._length = 0;
             other._reserved = 0;
@@ -56,13 +67,21 @@ namespace indigo
         {
             if (_array != nullptr)
             {
-                std::free(static_cast<void*>(_array));
+                _free();
                 _array = nullptr;
                 _length = 0;
                 _reserved = 0;
             }
         }
 
+        // Makes an empty array take its storage from the scratch arena of the
+        // calling thread when it is inside a ScratchScope. Used by QS_DEF.
+        void useScratchArena()
+        {
+            if (_array == nullptr)
+                _arena = ScratchArena::current();
+        }
+
         void clear()
         {
             _length = 0;
@@ -79,13 +98,27 @@ namespace indigo
                 {
                     if (_array != nullptr)
                     {
-                        std::free(static_cast<void*>(_array));
+                        _free();
                         _array = nullptr;
                         _length = 0;
                         _reserved = 0;
                     }
                 }
 
+                if (_arena != nullptr)
+                {
+                    size_t capacity;
+                    T* newptr = static_cast<T*>(_arena->allocate(sizeof(T) * to_reserve, capacity));
+                    if (_array != nullptr)
+                    {
+                        memcpy(static_cast<void*>(newptr), static_cast<void*>(_array), sizeof(T) * _reserved);
+                        _free();
+                    }
+                    _array = newptr;
+                    _reserved = static_cast<int>(capacity / sizeof(T));
+                    return;
+                }
+
                 T* oldptr = _array;
 
                 _array = static_cast<T*>(std::realloc(static_cast<void*>(_array), sizeof(T) * to_reserve));
@@ -373,6 +406,15 @@ namespace indigo
 
         void swap(Array<T>& other)
         {
+            if (_arena != other._arena)
+            {
+                // Storage can't move between the heap and the scratch arena
+                Array<T> tmp;
+                tmp.copy(*this);
+                copy(other);
+                other.copy(tmp);
+                return;
+            }
             std::swap(_array, other._array);
             std::swap(_reserved, other._reserved);
             std::swap(_length, other._length);
@@ -578,7 +620,17 @@ namespace indigo
         int _reserved;
         int _length;
 
+        ScratchArena* _arena; // nullptr if the storage is on the heap
+
     private:
+        void _free()
+        {
+            if (_arena != nullptr)
+                _arena->release(static_cast<void*>(_array), sizeof(T) * _reserved);
+            else
+                std::free(static_cast<void*>(_array));
+        }
+
         Array(const Array&);                            // no implicit copy
         Array<int>& operator=(const Array<int>& right); // no copy constructor
 
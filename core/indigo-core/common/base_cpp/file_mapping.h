@@ -0,0 +1,58 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __file_mapping_h__
+#define __file_mapping_h__
+
+#include <cstddef>
+
+#include "base_cpp/exception.h"
+#include "base_cpp/io_base.h"
+
+namespace indigo
+{
+    // Read-only mapping of a whole file into memory
+    class DLLEXPORT FileMapping
+    {
+    public:
+        FileMapping(Encoding filename_encoding, const char* filename);
+        ~FileMapping();
+
+        const char* data() const
+        {
+            return _data;
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+        DECL_ERROR;
+
+    private:
+        const char* _data;
+        size_t _size;
+#ifdef _WIN32
+        void* _map_object;
+#endif
+    };
+
+} // namespace indigo
+
+#endif
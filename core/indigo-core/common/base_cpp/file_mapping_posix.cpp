@@ -0,0 +1,74 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#if !defined(_WIN32)
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "base_cpp/file_mapping.h"
+
+using namespace indigo;
+
+IMPL_ERROR(FileMapping, "file mapping");
+
+FileMapping::FileMapping(Encoding filename_encoding, const char* filename) : _data(nullptr), _size(0)
+{
+    FILE* file = openFile(filename_encoding, filename, "rb");
+
+    if (file == NULL)
+        throw Error("can't open file %s: %s", filename, strerror(errno));
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        fclose(file);
+        throw Error("%s is not a regular file", filename);
+    }
+
+    _size = (size_t)st.st_size;
+
+    // Empty files can not be mapped, they have no data
+    if (_size > 0)
+    {
+        void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+
+        if (data == MAP_FAILED)
+        {
+            fclose(file);
+            throw Error("can't map file %s: %s", filename, strerror(errno));
+        }
+
+        // The records are read from the beginning to the end
+        madvise(data, _size, MADV_SEQUENTIAL);
+        _data = (const char*)data;
+    }
+
+    // The mapping stays valid after the file is closed
+    fclose(file);
+}
+
+FileMapping::~FileMapping()
+{
+    if (_data != nullptr)
+        munmap((void*)_data, _size);
+}
+
+#endif
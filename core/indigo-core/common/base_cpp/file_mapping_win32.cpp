@@ -0,0 +1,80 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#if defined(_WIN32)
+
+#include <errno.h>
+#include <io.h>
+#include <string.h>
+#include <windows.h>
+
+#include "base_cpp/file_mapping.h"
+
+using namespace indigo;
+
+IMPL_ERROR(FileMapping, "file mapping");
+
+FileMapping::FileMapping(Encoding filename_encoding, const char* filename) : _data(nullptr), _size(0), _map_object(NULL)
+{
+    FILE* file = openFile(filename_encoding, filename, "rb");
+
+    if (file == NULL)
+        throw Error("can't open file %s: %s", filename, strerror(errno));
+
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+    LARGE_INTEGER size;
+
+    if (GetFileType(handle) != FILE_TYPE_DISK || !GetFileSizeEx(handle, &size))
+    {
+        fclose(file);
+        throw Error("%s is not a regular file", filename);
+    }
+
+    _size = (size_t)size.QuadPart;
+
+    // Empty files can not be mapped, they have no data
+    if (_size > 0)
+    {
+        _map_object = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (_map_object != NULL)
+            _data = (const char*)MapViewOfFile(_map_object, FILE_MAP_READ, 0, 0, 0);
+
+        if (_data == nullptr)
+        {
+            DWORD error = GetLastError();
+            if (_map_object != NULL)
+                CloseHandle(_map_object);
+            fclose(file);
+            throw Error("can't map file %s: error %lu", filename, error);
+        }
+    }
+
+    // The mapping stays valid after the file is closed
+    fclose(file);
+}
+
+FileMapping::~FileMapping()
+{
+    if (_data != nullptr)
+        UnmapViewOfFile(_data);
+    if (_map_object != NULL)
+        CloseHandle(_map_object);
+}
+
+#endif
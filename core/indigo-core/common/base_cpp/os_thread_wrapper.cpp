@@ -31,8 +31,10 @@
 #include "base_cpp/os_thread_wrapper.h"
 #include "base_cpp/profiling.h"
 #include "base_cpp/tlscont.h"
+#include <exception>
 #include <memory>
 #include <thread>
+#include <vector>
 
 using namespace indigo;
 
@@ -98,14 +100,30 @@ void OsCommandDispatcher::_run(int nthreads)
 
     _parent_session_ID = TL_GET_SESSION_ID();
 
-    // Create handling threads
+    // Create handling threads. They are joined before returning because a thread
+    // still calls _cleanupThread() after it has reported that it is done, and the
+    // dispatcher may be destroyed as soon as run() returns
+    std::vector<std::thread> threads;
+    threads.reserve(_left_thread_count);
     for (int i = 0; i < _left_thread_count; i++)
+        threads.emplace_back([this]() { this->_threadFunc(); });
+
+    std::exception_ptr error;
+    try
+    {
+        _mainLoop();
+    }
+    catch (...)
     {
-        std::thread thread{[this]() { this->_threadFunc(); }};
-        thread.detach();
+        error = std::current_exception();
+        _stopThreads();
     }
 
-    _mainLoop();
+    for (auto& thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
 }
 
 void OsCommandDispatcher::_mainLoop()
@@ -135,6 +153,25 @@ void OsCommandDispatcher::_mainLoop()
     }
 }
 
+void OsCommandDispatcher::_stopThreads()
+{
+    // The main loop has failed while some threads still wait for replies. They get
+    // no more tasks and their results are dropped, so that they can be joined
+    _need_to_terminate = true;
+    _wakeSuspended();
+
+    while (_left_thread_count != 0)
+    {
+        try
+        {
+            _mainLoop();
+        }
+        catch (...)
+        {
+        }
+    }
+}
+
 void OsCommandDispatcher::markToTerminate()
 {
     _need_to_terminate = true;
@@ -187,7 +224,23 @@ void OsCommandDispatcher::_onMsgNeedTask()
     OsCommandResult* result = _getVacantResult();
     OsCommand* command = _getVacantCommand();
 
-    if (!_setupCommand(*command))
+    bool has_command;
+    try
+    {
+        has_command = _setupCommand(*command);
+    }
+    catch (...)
+    {
+        // The thread that asked for a task is released before the error is forwarded
+        _availableResults.add(std::unique_ptr<OsCommandResult>(result));
+        _availableCommands.add(std::unique_ptr<OsCommand>(command));
+
+        _privateMessageSystem.SendMsg(MSG_NO_TASK, NULL);
+        _left_thread_count--;
+        throw;
+    }
+
+    if (!has_command)
     {
         _availableResults.add(result);
         _availableCommands.add(command);
@@ -235,7 +288,8 @@ void OsCommandDispatcher::_onMsgHandleResult()
         throw Exception("cmdDispatcher::_OnMsgHandleResult: internal error");
     index = *(int*)param;
 
-    if (_handling_order == HANDLING_ORDER_SERIAL)
+    // After termination results are dropped, so nothing waits for the earlier ones
+    if (_handling_order == HANDLING_ORDER_SERIAL && !_need_to_terminate)
         if (!_storedResults.isInBound(index))
         {
             profIncCounter("dispatcher.syspend_count", 1);
@@ -255,7 +309,7 @@ void OsCommandDispatcher::_onMsgHandleResult()
     _recvCommandAndResult(result, command);
     _availableCommands.add(command);
 
-    if (_handling_order == HANDLING_ORDER_ANY)
+    if (_handling_order == HANDLING_ORDER_ANY || _need_to_terminate)
     {
         // Handle result in parallel mode
         _handleResultWithCheck(result);
@@ -120,6 +120,7 @@ namespace indigo
         void _recvCommandAndResult(OsCommandResult*& result, OsCommand*& command);
 
         void _mainLoop();
+        void _stopThreads();
 
         OsCommand* _getVacantCommand();
         OsCommandResult* _getVacantResult();
@@ -19,6 +19,7 @@
 #include "base_cpp/output.h"
 
 #include <cerrno>
+#include <charconv>
 #include <cmath>
 #include <cstdarg>
 #include <cstdio>
@@ -76,41 +77,101 @@ void Output::printf(const char* format, ...)
     va_end(args);
 }
 
-void Output::vprintf(const char* format, va_list args_orig)
+static int _vformat(char* buf, int size, const char* format, va_list args_orig)
 {
-    QS_DEF(Array<char>, str);
-    if (str.size() < 2048)
-        str.resize(2048);
-
-    int n;
-    while (true)
-    {
-        va_list args;
+    va_list args;
 
-        // vsnprintf may change va_list argument that leads to segfault
-        va_copy(args, args_orig);
+    // vsnprintf may change va_list argument that leads to segfault
+    va_copy(args, args_orig);
 
 #if defined(_WIN32) && !defined(__MINGW32__)
-        n = _vsnprintf_l(str.ptr(), str.size(), format, getCLocale(), args);
+    int n = _vsnprintf_l(buf, size, format, getCLocale(), args);
 #else
-        n = vsnprintf(str.ptr(), str.size(), format, args);
+    int n = vsnprintf(buf, size, format, args);
 #endif
+    va_end(args);
+    return n;
+}
+
+void Output::vprintf(const char* format, va_list args_orig)
+{
+    // Almost all the formatted lines fit the stack buffer
+    char buf[2048];
+    int n = _vformat(buf, sizeof(buf), format, args_orig);
+    if (n > -1 && n < (int)sizeof(buf))
+    {
+        write(buf, n);
+        return;
+    }
+
+    Array<char> str;
+    int new_size;
+    if (n > -1)                          /* glibc 2.1 */
+        new_size = n + 1;                /* precisely what is needed */
+    else                                 /* glibc 2.0 */
+        new_size = (int)sizeof(buf) * 2; /* twice the old size */
+
+    while (true)
+    {
+        str.resize(new_size);
+        n = _vformat(str.ptr(), str.size(), format, args_orig);
+
         /* If that worked, return the string. */
         if (n > -1 && n < str.size())
             break;
 
         /* Else try again with more space. */
-        int new_size;
-        if (n > -1)                    /* glibc 2.1 */
-            new_size = n + 1;          /* precisely what is needed */
-        else                           /* glibc 2.0 */
-            new_size = str.size() * 2; /* twice the old size */
-        str.resize(new_size);
+        if (n > -1)
+            new_size = n + 1;
+        else
+            new_size = str.size() * 2;
     }
 
     write(str.ptr(), n);
 }
 
+// Numbers are formatted after the room for the alignment spaces, so that
+// they are written at once with the spaces
+static const int NUMBER_PADDING = 32;
+
+static void _writeAligned(Output& output, char* buf, int n, int width)
+{
+    char* begin = buf + NUMBER_PADDING;
+    for (int i = n; i < width; i++)
+    {
+        if (begin == buf)
+        {
+            output.writeChar(' ');
+            continue;
+        }
+        *--begin = ' ';
+    }
+    output.write(begin, (int)(buf + NUMBER_PADDING - begin) + n);
+}
+
+void Output::writeInt(int value, int width)
+{
+    char buf[NUMBER_PADDING + 16];
+    char* end = std::to_chars(buf + NUMBER_PADDING, buf + sizeof(buf), value).ptr;
+    _writeAligned(*this, buf, (int)(end - buf - NUMBER_PADDING), width);
+}
+
+void Output::writeFixed(float value, int digits, int width)
+{
+#if defined(__cpp_lib_to_chars)
+    // Fixed notation of the largest float takes 39 digits before the point
+    char buf[NUMBER_PADDING + 128];
+    auto result = std::to_chars(buf + NUMBER_PADDING, buf + sizeof(buf), (double)value, std::chars_format::fixed, digits);
+    if (result.ec == std::errc())
+    {
+        _writeAligned(*this, buf, (int)(result.ptr - buf - NUMBER_PADDING), width);
+        return;
+    }
+#endif
+    // Floating point std::to_chars is not available with every standard library
+    printf("%*.*f", width, digits, value);
+}
+
 void Output::writeArray(const Array<char>& data)
 {
     write(data.ptr(), data.size());
@@ -62,6 +62,12 @@ namespace indigo
         void writeCR();
         void writeArray(const Array<char>& data);
 
+        // Locale independent number output without parsing a format string.
+        // Numbers are right-aligned in the field of the given width,
+        // like printf("%*d") and printf("%*.*f") do
+        void writeInt(int value, int width = 0);
+        void writeFixed(float value, int digits, int width = 0);
+
         void printf(const char* format, ...);
         void vprintf(const char* format, va_list args);
         void printfCR(const char* format, ...);
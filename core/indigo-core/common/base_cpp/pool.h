@@ -37,6 +37,13 @@ namespace indigo
         {
         }
 
+        // See Array::useScratchArena()
+        void useScratchArena()
+        {
+            _array.useScratchArena();
+            _next.useScratchArena();
+        }
+
         int add()
         {
             if (_first == -1)
@@ -20,6 +20,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <safe_ptr.h>
 
@@ -33,7 +36,7 @@ using namespace indigo;
 // ProfilingTimer
 //
 
-ProfilingTimer::ProfilingTimer(int name_index) : _name_index(name_index), _start_time(std::chrono::high_resolution_clock::now()), _dt(0)
+ProfilingTimer::ProfilingTimer(int name_index) : _name_index(name_index), _running(true), _start_time(std::chrono::high_resolution_clock::now()), _dt(0)
 {
 }
 
@@ -44,22 +47,22 @@ ProfilingTimer::~ProfilingTimer()
 
 qword ProfilingTimer::stop()
 {
-    if (_name_index == -1)
+    if (!_running)
     {
         return 0;
     }
     _dt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - _start_time).count();
+    if (_name_index != -1)
     {
-        auto inst = sf::xlock_safe_ptr(ProfilingSystem::getInstance());
-        inst->addTimer(_name_index, _dt);
+        ProfilingSystem::addTimer(_name_index, _dt);
     }
-    _name_index = -1;
+    _running = false;
     return _dt;
 }
 
 qword ProfilingTimer::getTime() const
 {
-    if (_name_index == -1)
+    if (!_running)
     {
         return _dt;
     }
@@ -77,8 +80,181 @@ float ProfilingTimer::getTimeSec() const
 
 IMPL_ERROR(ProfilingSystem, "Profiling system");
 
-namespace indigo
+//
+// Per-thread shards
+//
+
+namespace
 {
+    // Statistics of one label in one thread. Only the owner thread writes them,
+    // so plain load/store pairs are enough and readers never block the writer
+    struct ShardData
+    {
+        std::atomic<qword> count{0}, value{0}, max_value{0};
+        std::atomic<double> square_sum{0.0};
+
+        void add(qword adding_value)
+        {
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            value.store(value.load(std::memory_order_relaxed) + adding_value, std::memory_order_relaxed);
+            if (adding_value > max_value.load(std::memory_order_relaxed))
+                max_value.store(adding_value, std::memory_order_relaxed);
+            const auto adding_value_dbl = static_cast<double>(adding_value);
+            square_sum.store(square_sum.load(std::memory_order_relaxed) + adding_value_dbl * adding_value_dbl, std::memory_order_relaxed);
+        }
+
+        void reset()
+        {
+            count.store(0, std::memory_order_relaxed);
+            value.store(0, std::memory_order_relaxed);
+            max_value.store(0, std::memory_order_relaxed);
+            square_sum.store(0.0, std::memory_order_relaxed);
+        }
+    };
+
+    struct ShardRecord
+    {
+        enum
+        {
+            TYPE_NONE,
+            TYPE_TIMER,
+            TYPE_COUNTER
+        };
+
+        std::atomic<int> type{TYPE_NONE};
+        ShardData current, total;
+    };
+
+    // Records are allocated in chunks which are never moved, so a reader can walk them while the owner adds new ones
+    struct Shard
+    {
+        static constexpr int CHUNK_SIZE = 256;
+        static constexpr int MAX_CHUNKS = 256;
+
+        std::atomic<ShardRecord*> chunks[MAX_CHUNKS] = {};
+        std::atomic<unsigned> current_epoch{0}, total_epoch{0};
+        bool in_use = false; // guarded by the registry mutex
+
+        ~Shard()
+        {
+            for (auto& chunk : chunks)
+                delete[] chunk.load();
+        }
+
+        ShardRecord* find(int name_index) const
+        {
+            int chunk = name_index / CHUNK_SIZE;
+            if (name_index < 0 || chunk >= MAX_CHUNKS)
+                return nullptr;
+            ShardRecord* records = chunks[chunk].load(std::memory_order_acquire);
+            return records == nullptr ? nullptr : records + name_index % CHUNK_SIZE;
+        }
+
+        ShardRecord& get(int name_index)
+        {
+            int chunk = name_index / CHUNK_SIZE;
+            if (name_index < 0 || chunk >= MAX_CHUNKS)
+                throw ProfilingSystem::Error("too many profiling labels");
+            ShardRecord* records = chunks[chunk].load(std::memory_order_relaxed);
+            if (records == nullptr)
+            {
+                records = new ShardRecord[CHUNK_SIZE];
+                chunks[chunk].store(records, std::memory_order_release);
+            }
+            return records[name_index % CHUNK_SIZE];
+        }
+
+        template <typename Func>
+        void forEachRecord(Func func)
+        {
+            for (auto& chunk : chunks)
+            {
+                ShardRecord* records = chunk.load(std::memory_order_acquire);
+                if (records != nullptr)
+                    for (int i = 0; i < CHUNK_SIZE; i++)
+                        func(records[i]);
+            }
+        }
+    };
+
+    // Shards are never freed: a shard of a finished thread keeps its statistics and is reused by a new thread
+    struct ShardRegistry
+    {
+        std::mutex lock;
+        std::vector<std::unique_ptr<Shard>> shards;
+        // Incremented by ProfilingSystem::reset, owners clear their data lazily when they see a new value
+        std::atomic<unsigned> current_epoch{0}, total_epoch{0};
+
+        Shard* acquire()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (auto& shard : shards)
+                if (!shard->in_use)
+                {
+                    shard->in_use = true;
+                    return shard.get();
+                }
+            shards.push_back(std::make_unique<Shard>());
+            shards.back()->in_use = true;
+            return shards.back().get();
+        }
+
+        void release(Shard* shard)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            shard->in_use = false;
+        }
+    };
+
+    ShardRegistry& _shardRegistry()
+    {
+        static ShardRegistry registry;
+        return registry;
+    }
+
+    class LocalShard
+    {
+    public:
+        LocalShard() : _registry(_shardRegistry()), _shard(_registry.acquire())
+        {
+        }
+
+        ~LocalShard()
+        {
+            _registry.release(_shard);
+        }
+
+        // Returns the shard of the calling thread with the resets applied
+        Shard& get()
+        {
+            unsigned total_epoch = _registry.total_epoch.load(std::memory_order_acquire);
+            unsigned current_epoch = _registry.current_epoch.load(std::memory_order_acquire);
+            bool reset_total = _shard->total_epoch.load(std::memory_order_relaxed) != total_epoch;
+            bool reset_current = reset_total || _shard->current_epoch.load(std::memory_order_relaxed) != current_epoch;
+
+            if (reset_current)
+            {
+                _shard->forEachRecord([reset_total](ShardRecord& record) {
+                    record.current.reset();
+                    if (reset_total)
+                        record.total.reset();
+                });
+                _shard->total_epoch.store(total_epoch, std::memory_order_release);
+                _shard->current_epoch.store(current_epoch, std::memory_order_release);
+            }
+            return *_shard;
+        }
+
+    private:
+        ShardRegistry& _registry;
+        Shard* _shard;
+    };
+
+    Shard& _localShard()
+    {
+        static thread_local LocalShard local_shard;
+        return local_shard.get();
+    }
 }
 
 sf::safe_shared_hide_obj<ProfilingSystem>& ProfilingSystem::getInstance()
@@ -108,30 +284,86 @@ int ProfilingSystem::getNameIndex(const char* name, bool add_if_not_exists)
 
 void ProfilingSystem::addTimer(const int name_index, const qword dt)
 {
-    _ensureRecordExistanceLocked(name_index);
-    Record& rec = _records[name_index];
-    rec.type = Record::RecordType::TYPE_TIMER;
+    ShardRecord& rec = _localShard().get(name_index);
+    rec.type.store(ShardRecord::TYPE_TIMER, std::memory_order_relaxed);
     rec.current.add(dt);
     rec.total.add(dt);
 }
 
 void ProfilingSystem::addCounter(const int name_index, const int value)
 {
-    _ensureRecordExistanceLocked(name_index);
-    Record& rec = _records[name_index];
-    rec.type = Record::RecordType::TYPE_COUNTER;
+    ShardRecord& rec = _localShard().get(name_index);
+    rec.type.store(ShardRecord::TYPE_COUNTER, std::memory_order_relaxed);
     rec.current.add(value);
     rec.total.add(value);
 }
 
 void ProfilingSystem::reset(const bool all)
 {
+    ShardRegistry& registry = _shardRegistry();
+    registry.current_epoch.fetch_add(1, std::memory_order_acq_rel);
+    if (all)
+    {
+        registry.total_epoch.fetch_add(1, std::memory_order_acq_rel);
+    }
     for (int i = 0; i < _records.size(); i++)
     {
         _records[i].reset(all);
     }
 }
 
+void ProfilingSystem::_mergeShards()
+{
+    for (int i = 0; i < _records.size(); i++)
+    {
+        _records[i].reset(true);
+    }
+    _ensureRecordExistanceLocked(_names.size() - 1);
+
+    ShardRegistry& registry = _shardRegistry();
+    unsigned current_epoch = registry.current_epoch.load(std::memory_order_acquire);
+    unsigned total_epoch = registry.total_epoch.load(std::memory_order_acquire);
+
+    auto merge = [](Record::Data& data, const ShardData& shard_data) {
+        data.count += shard_data.count.load(std::memory_order_relaxed);
+        data.value += shard_data.value.load(std::memory_order_relaxed);
+        data.max_value = std::max(data.max_value, shard_data.max_value.load(std::memory_order_relaxed));
+        data.square_sum += shard_data.square_sum.load(std::memory_order_relaxed);
+    };
+
+    std::lock_guard<std::mutex> guard(registry.lock);
+    for (auto& shard : registry.shards)
+    {
+        // Data of a shard which has not seen the last reset yet is treated as cleared
+        bool has_total = shard->total_epoch.load(std::memory_order_acquire) == total_epoch;
+        bool has_current = has_total && shard->current_epoch.load(std::memory_order_acquire) == current_epoch;
+        if (!has_total)
+        {
+            continue;
+        }
+        for (int i = 0; i < _records.size(); i++)
+        {
+            const ShardRecord* shard_rec = shard->find(i);
+            if (shard_rec == nullptr)
+            {
+                continue;
+            }
+            int type = shard_rec->type.load(std::memory_order_relaxed);
+            if (type == ShardRecord::TYPE_NONE)
+            {
+                continue;
+            }
+            Record& rec = _records[i];
+            rec.type = (type == ShardRecord::TYPE_TIMER ? Record::RecordType::TYPE_TIMER : Record::RecordType::TYPE_COUNTER);
+            merge(rec.total, shard_rec->total);
+            if (has_current)
+            {
+                merge(rec.current, shard_rec->current);
+            }
+        }
+    }
+}
+
 int ProfilingSystem::_recordsCmp(const int idx1, const int idx2, void* context)
 {
     auto* this_ = static_cast<ProfilingSystem*>(context);
@@ -140,6 +372,8 @@ int ProfilingSystem::_recordsCmp(const int idx1, const int idx2, void* context)
 
 void ProfilingSystem::getStatistics(Output& output, const bool get_all)
 {
+    _mergeShards();
+
     // Print formatted statistics
     while (_sorted_records.size() < _records.size())
     {
@@ -254,6 +488,7 @@ bool ProfilingSystem::hasLabel(const char* name)
     {
         return false;
     }
+    _mergeShards();
     return _hasLabelIndex(name_index);
 }
 
@@ -268,7 +503,7 @@ void ProfilingSystem::_ensureRecordExistanceLocked(const int name_index)
 float ProfilingSystem::getLabelExecTime(const char* name, const bool total)
 {
     int idx = getNameIndex(name);
-    _ensureRecordExistanceLocked(idx);
+    _mergeShards();
 
     if (total)
     {
@@ -280,7 +515,7 @@ float ProfilingSystem::getLabelExecTime(const char* name, const bool total)
 qword ProfilingSystem::getLabelValue(const char* name, const bool total)
 {
     int idx = getNameIndex(name);
-    _ensureRecordExistanceLocked(idx);
+    _mergeShards();
     if (total)
     {
         return _records[idx].total.value;
@@ -291,7 +526,7 @@ qword ProfilingSystem::getLabelValue(const char* name, const bool total)
 qword ProfilingSystem::getLabelCallCount(const char* name, const bool total)
 {
     int idx = getNameIndex(name);
-    _ensureRecordExistanceLocked(idx);
+    _mergeShards();
     if (total)
     {
         return _records[idx].total.count;
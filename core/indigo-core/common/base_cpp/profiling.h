@@ -31,40 +31,63 @@
 #include "base_cpp/os_sync_wrapper.h"
 #include "base_cpp/ptr_array.h"
 
+#ifndef INDIGO_NO_PROFILING
+
+// Name index is resolved once per call site; the statistics are written to the
+// calling thread's shard without locking and merged only when they are read
 #define PROF_GET_NAME_INDEX(var_name, name)                                                                                                                    \
-    static std::atomic<int> var_name##_name_index;                                                                                                             \
-    if (var_name##_name_index == 0)                                                                                                                            \
+    static std::atomic<int> var_name##_name_index_plus_one;                                                                                                    \
+    if (var_name##_name_index_plus_one.load(std::memory_order_acquire) == 0)                                                                                   \
     {                                                                                                                                                          \
         auto inst = sf::xlock_safe_ptr(indigo::ProfilingSystem::getInstance());                                                                                \
-        var_name##_name_index = inst->getNameIndex(name);                                                                                                      \
-    }
+        var_name##_name_index_plus_one.store(inst->getNameIndex(name) + 1, std::memory_order_release);                                                         \
+    }                                                                                                                                                          \
+    const int var_name##_name_index = var_name##_name_index_plus_one.load(std::memory_order_relaxed) - 1
 
 #define profTimerStart(var_name, name)                                                                                                                         \
-    PROF_GET_NAME_INDEX(var_name, name)                                                                                                                        \
+    PROF_GET_NAME_INDEX(var_name, name);                                                                                                                       \
     indigo::ProfilingTimer var_name##_timer(var_name##_name_index)
 
-#define profTimerStop(var_name) var_name##_timer.stop()
+#define profIncTimer(name, dt)                                                                                                                                 \
+    do                                                                                                                                                         \
+    {                                                                                                                                                          \
+        PROF_GET_NAME_INDEX(var_name, name);                                                                                                                   \
+        indigo::ProfilingSystem::addTimer(var_name##_name_index, dt);                                                                                          \
+    } while (false)
 
-#define profTimerGetTime(var_name) var_name##_timer.getTime()
+#define profIncCounter(name, count)                                                                                                                            \
+    do                                                                                                                                                         \
+    {                                                                                                                                                          \
+        PROF_GET_NAME_INDEX(var_name, name);                                                                                                                   \
+        indigo::ProfilingSystem::addCounter(var_name##_name_index, count);                                                                                     \
+    } while (false)
 
-#define profTimerGetTimeSec(var_name) var_name##_timer.getTimeSec()
+#else
+
+// Instrumentation is compiled out. Timers still measure time because
+// profTimerGetTime/profTimerGetTimeSec are used for search estimations
+#define profTimerStart(var_name, name) indigo::ProfilingTimer var_name##_timer(-1)
 
 #define profIncTimer(name, dt)                                                                                                                                 \
     do                                                                                                                                                         \
     {                                                                                                                                                          \
-        PROF_GET_NAME_INDEX(var_name, name)                                                                                                                    \
-        auto inst = sf::xlock_safe_ptr(indigo::ProfilingSystem::getInstance());                                                                                \
-        inst->addTimer(var_name##_name_index, dt);                                                                                                             \
+        (void)sizeof(dt);                                                                                                                                      \
     } while (false)
 
 #define profIncCounter(name, count)                                                                                                                            \
     do                                                                                                                                                         \
     {                                                                                                                                                          \
-        PROF_GET_NAME_INDEX(var_name, name)                                                                                                                    \
-        auto inst = sf::xlock_safe_ptr(indigo::ProfilingSystem::getInstance());                                                                                \
-        inst->addCounter(var_name##_name_index, count);                                                                                                        \
+        (void)sizeof(count);                                                                                                                                   \
     } while (false)
 
+#endif
+
+#define profTimerStop(var_name) var_name##_timer.stop()
+
+#define profTimerGetTime(var_name) var_name##_timer.getTime()
+
+#define profTimerGetTimeSec(var_name) var_name##_timer.getTimeSec()
+
 #define profTimersReset() sf::xlock_safe_ptr(indigo::ProfilingSystem::getInstance())->reset(false)
 #define profTimersResetSession() sf::xlock_safe_ptr(indigo::ProfilingSystem::getInstance())->reset(true)
 
@@ -81,8 +104,10 @@ namespace indigo
 
         int getNameIndex(const char* name, bool add_if_not_exists = true);
 
-        void addTimer(int name_index, qword dt);
-        void addCounter(int name_index, int value);
+        // Thread-safe without the instance lock: the values go to the calling thread's shard
+        static void addTimer(int name_index, qword dt);
+        static void addCounter(int name_index, int value);
+
         void reset(bool all);
         void getStatistics(Output& output, bool get_all);
 
@@ -128,6 +153,8 @@ namespace indigo
 
         bool _hasLabelIndex(int name_index) const;
         void _ensureRecordExistanceLocked(int name_index);
+        // Sums the thread shards into _records
+        void _mergeShards();
 
         PtrArray<Array<char>> _names;
         PtrArray<Record> _records;
@@ -149,7 +176,8 @@ namespace indigo
         float getTimeSec() const;
 
     private:
-        int _name_index;
+        int _name_index; // -1 if the time is measured but not recorded
+        bool _running;
         std::chrono::time_point<std::chrono::high_resolution_clock> _start_time;
         qword _dt;
     };
@@ -0,0 +1,178 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include "base_cpp/scratch_arena.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace indigo;
+
+ScratchArena::ScratchArena() : _chunks(nullptr), _chunks_count(0), _chunks_reserved(0), _current(0), _depth(0), _enabled(true)
+{
+    memset(_free_lists, 0, sizeof(_free_lists));
+    _statistics.blocks = 0;
+    _statistics.chunks = 0;
+}
+
+ScratchArena::~ScratchArena()
+{
+    for (int i = 0; i < _chunks_count; i++)
+        std::free(_chunks[i].data);
+    std::free(_chunks);
+}
+
+ScratchArena& ScratchArena::_local()
+{
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+ScratchArena* ScratchArena::current()
+{
+    ScratchArena& arena = _local();
+    return arena._depth > 0 && arena._enabled ? &arena : nullptr;
+}
+
+void ScratchArena::setEnabled(bool enabled)
+{
+    _local()._enabled = enabled;
+}
+
+ScratchArena::Statistics ScratchArena::statistics()
+{
+    return _local()._statistics;
+}
+
+static int _sizeClass(size_t size, int min_class)
+{
+    int size_class = min_class;
+    while (((size_t)1 << size_class) < size)
+        size_class++;
+    return size_class;
+}
+
+void* ScratchArena::allocate(size_t size, size_t& capacity)
+{
+    _statistics.blocks++;
+
+    int size_class = _sizeClass(size, MIN_CLASS);
+
+    if (size_class > MAX_CLASS)
+    {
+        capacity = size;
+        return _allocateFromChunks(size);
+    }
+
+    capacity = (size_t)1 << size_class;
+
+    void* block = _free_lists[size_class];
+    if (block != nullptr)
+    {
+        _free_lists[size_class] = *(void**)block;
+        return block;
+    }
+    return _allocateFromChunks(capacity);
+}
+
+void ScratchArena::release(void* ptr, size_t capacity)
+{
+    int size_class = _sizeClass(capacity, 0);
+    if (size_class < MIN_CLASS || size_class > MAX_CLASS)
+        return; // large blocks are dropped with the whole scope
+
+    *(void**)ptr = _free_lists[size_class];
+    _free_lists[size_class] = ptr;
+}
+
+void* ScratchArena::_allocateFromChunks(size_t size)
+{
+    // Keep blocks aligned for any scalar type
+    size = (size + 15) & ~(size_t)15;
+
+    while (_current < _chunks_count)
+    {
+        Chunk& chunk = _chunks[_current];
+        if (chunk.size - chunk.used >= size)
+        {
+            void* block = chunk.data + chunk.used;
+            chunk.used += size;
+            return block;
+        }
+        _current++;
+    }
+
+    if (_chunks_count == _chunks_reserved)
+    {
+        int reserved = _chunks_reserved == 0 ? 8 : _chunks_reserved * 2;
+        Chunk* chunks = (Chunk*)std::realloc(_chunks, reserved * sizeof(Chunk));
+        if (chunks == nullptr)
+            throw std::bad_alloc();
+        _chunks = chunks;
+        _chunks_reserved = reserved;
+    }
+
+    size_t chunk_size = _chunks_count == 0 ? (size_t)FIRST_CHUNK_SIZE : _chunks[_chunks_count - 1].size * 2;
+    if (chunk_size < size)
+        chunk_size = size;
+
+    char* data = (char*)std::malloc(chunk_size);
+    if (data == nullptr)
+        throw std::bad_alloc();
+    _statistics.chunks++;
+
+    Chunk& chunk = _chunks[_chunks_count++];
+    chunk.data = data;
+    chunk.size = chunk_size;
+    chunk.used = size;
+    _current = _chunks_count - 1;
+    return data;
+}
+
+void ScratchArena::_reset()
+{
+    memset(_free_lists, 0, sizeof(_free_lists));
+
+    // Keep the chunks for the next scope unless a huge molecule made them grow too much
+    size_t retained = 0;
+    int count = 0;
+    for (; count < _chunks_count; count++)
+    {
+        retained += _chunks[count].size;
+        if (retained > RETAINED_SIZE && count > 0)
+            break;
+        _chunks[count].used = 0;
+    }
+    for (int i = count; i < _chunks_count; i++)
+        std::free(_chunks[i].data);
+
+    _chunks_count = count;
+    _current = 0;
+}
+
+ScratchScope::ScratchScope() : _arena(ScratchArena::_local())
+{
+    _arena._depth++;
+}
+
+ScratchScope::~ScratchScope()
+{
+    if (--_arena._depth == 0)
+        _arena._reset();
+}
@@ -0,0 +1,120 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __scratch_arena_h__
+#define __scratch_arena_h__
+
+#include <cstddef>
+
+#include "base_c/defs.h"
+
+namespace indigo
+{
+    // Per-thread allocator for the storage of short-lived scratch arrays.
+    //
+    // Blocks are carved from chunks that stay with the thread between scopes.
+    // Block sizes are rounded up to powers of two and released blocks go to
+    // per-size free lists, so temporary arrays that grow and die inside a scope
+    // do not reach the heap. When the outermost ScratchScope of the thread ends,
+    // all blocks are dropped at once by rewinding the chunks.
+    //
+    // Only the storage of objects that are constructed inside a scope and die
+    // before it ends can come from the arena. QS_DEF binds its arrays to the
+    // arena of the current thread, see tlscont.h.
+    class DLLEXPORT ScratchArena
+    {
+    public:
+        // Arena of the calling thread inside a ScratchScope, nullptr outside of it
+        static ScratchArena* current();
+
+        // Returns a block of at least size bytes, its actual size is returned in capacity
+        void* allocate(size_t size, size_t& capacity);
+        void release(void* ptr, size_t capacity);
+
+        struct Statistics
+        {
+            qword blocks; // blocks handed out, each of them would be a malloc or realloc call otherwise
+            qword chunks; // chunks allocated on the heap
+        };
+
+        // Counters of the calling thread
+        static Statistics statistics();
+
+        // Turns the arena of the calling thread off or back on, scopes leave the storage
+        // to the heap while it is off. Must be called outside of scopes
+        static void setEnabled(bool enabled);
+
+    private:
+        friend class ScratchScope;
+
+        ScratchArena();
+        ~ScratchArena();
+
+        ScratchArena(const ScratchArena&) = delete;
+        ScratchArena& operator=(const ScratchArena&) = delete;
+
+        static ScratchArena& _local();
+
+        void* _allocateFromChunks(size_t size);
+        void _reset();
+
+        enum
+        {
+            MIN_CLASS = 5,  // 32 bytes, enough for a free list link
+            MAX_CLASS = 24, // larger blocks are not reused inside the scope
+            FIRST_CHUNK_SIZE = 64 * 1024,
+            RETAINED_SIZE = 16 * 1024 * 1024
+        };
+
+        struct Chunk
+        {
+            char* data;
+            size_t size;
+            size_t used;
+        };
+
+        Chunk* _chunks;
+        int _chunks_count;
+        int _chunks_reserved;
+        int _current;
+
+        void* _free_lists[MAX_CLASS + 1];
+
+        int _depth;
+        bool _enabled;
+        Statistics _statistics;
+    };
+
+    // Enables the scratch arena of the calling thread until the end of the scope.
+    // Scopes can be nested, the arena is rewound when the outermost one ends.
+    class DLLEXPORT ScratchScope
+    {
+    public:
+        ScratchScope();
+        ~ScratchScope();
+
+        ScratchScope(const ScratchScope&) = delete;
+        ScratchScope& operator=(const ScratchScope&) = delete;
+
+    private:
+        ScratchArena& _arena;
+    };
+
+} // namespace indigo
+
+#endif // __scratch_arena_h__
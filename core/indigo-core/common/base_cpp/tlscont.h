@@ -34,6 +34,7 @@
 #include "base_cpp/pool.h"
 #include "base_cpp/ptr_array.h"
 #include "base_cpp/red_black.h"
+#include "base_cpp/scratch_arena.h"
 
 #ifdef _WIN32
 #pragma warning(push)
@@ -120,6 +121,25 @@ namespace indigo
 #define TL_GET(type, name) type& name = (TLSCONT_##name).createOrGetLocalCopy()
 #define TL_GET_BY_ID(type, name, id) type& name = (TLSCONT_##name).createOrGetLocalCopy(id)
 #define TL_DEF(className, type, name) _SessionLocalContainer<type> className::TLSCONT_##name
+
+    // Quasi-static arrays and pools take their storage from the scratch arena
+    // when they are defined inside a ScratchScope, other types use the heap
+    template <typename T>
+    inline void _qsUseScratchArena(T&)
+    {
+    }
+
+    template <typename T>
+    inline void _qsUseScratchArena(Array<T>& arr)
+    {
+        arr.useScratchArena();
+    }
+
+    template <typename T>
+    inline void _qsUseScratchArena(Pool<T>& pool)
+    {
+        pool.useScratchArena();
+    }
 }
 
 // "Quasi-static" variable definition. Calls clear() at the end
@@ -131,7 +151,11 @@ namespace indigo
 //    _POOL_##name##_auto_release.init(_POOL_##name##_idx, &_POOL_##name);                                                                                  \
 //    name.clear();
 // Use this for debug purposes if you suspect QS_DEF in something bad
-#define QS_DEF(TYPE, name) TYPE name;
+// Inside a ScratchScope arrays and pools defined this way take their storage
+// from the scratch arena of the thread, see base_cpp/scratch_arena.h
+#define QS_DEF(TYPE, name)                                                                                                                                     \
+    TYPE name;                                                                                                                                                 \
+    ::indigo::_qsUseScratchArena(name);
 
 // "Quasi-static" variable definition. Calls clear_resize() at the end
 // #define QS_DEF_RES(TYPE, name, len) \
@@ -144,6 +168,7 @@ namespace indigo
 // Use this for debug purposes if you suspect QS_DEF in something bad
 #define QS_DEF_RES(TYPE, name, len)                                                                                                                            \
     TYPE name;                                                                                                                                                 \
+    ::indigo::_qsUseScratchArena(name);                                                                                                                        \
     name.clear_resize(len);
 
 // Reusable class members definition
@@ -0,0 +1,103 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __csr_graph_h__
+#define __csr_graph_h__
+
+#include "base_cpp/array.h"
+#include "graph/graph.h"
+
+namespace indigo
+{
+
+    // Read-only snapshot of the graph adjacency in compressed sparse row form.
+    // Neighbours of vertex v are stored contiguously in [neiBegin(v), neiEnd(v))
+    // of the neiVertices()/neiEdges() arrays in the order of Graph::getVertex(v),
+    // so algorithms that walk the same graph many times do not chase list nodes.
+    // Indices are the ones of the source graph, removed vertices have no
+    // neighbours. The snapshot is not updated when the graph is edited: call
+    // build() again after that.
+    class DLLEXPORT CsrGraph
+    {
+    public:
+        CsrGraph();
+        explicit CsrGraph(const Graph& graph);
+
+        void build(const Graph& graph);
+        void clear();
+
+        int vertexEnd() const
+        {
+            return _offsets.size() > 0 ? _offsets.size() - 1 : 0;
+        }
+
+        int edgeEnd() const
+        {
+            return _edges.size();
+        }
+
+        // Indices of the existing vertices in ascending order
+        const Array<int>& vertices() const
+        {
+            return _vertices;
+        }
+
+        int neiBegin(int v) const
+        {
+            return _offsets[v];
+        }
+
+        int neiEnd(int v) const
+        {
+            return _offsets[v + 1];
+        }
+
+        int degree(int v) const
+        {
+            return _offsets[v + 1] - _offsets[v];
+        }
+
+        const int* neiVertices() const
+        {
+            return _nei_vertices.ptr();
+        }
+
+        const int* neiEdges() const
+        {
+            return _nei_edges.ptr();
+        }
+
+        // Removed edges have both ends set to -1
+        const Edge& getEdge(int e) const
+        {
+            return _edges[e];
+        }
+
+        int findEdgeIndex(int v1, int v2) const;
+
+    private:
+        Array<int> _vertices;
+        Array<int> _offsets;
+        Array<int> _nei_vertices;
+        Array<int> _nei_edges;
+        Array<Edge> _edges;
+    };
+
+} // namespace indigo
+
+#endif // __csr_graph_h__
@@ -22,6 +22,7 @@
 #include "base_cpp/array.h"
 #include "base_cpp/list.h"
 #include "base_cpp/tlscont.h"
+#include "graph/csr_graph.h"
 #include "graph/graph.h"
 
 namespace indigo
@@ -79,6 +80,8 @@ namespace indigo
 
         TL_CP_DECL(Array<int>, _v_processed); // from _graph to _subtree
 
+        TL_CP_DECL(CsrGraph, _csr); // adjacency of _graph, walked on every step
+
         void _reverseSearch(int front_idx, int cur_maximal_criteria_value);
 
         VertexEdge _m1, _m2;
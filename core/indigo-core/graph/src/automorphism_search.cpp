@@ -17,6 +17,7 @@
  ***************************************************************************/
 
 #include "graph/automorphism_search.h"
+#include "base_cpp/scratch_arena.h"
 
 using namespace indigo;
 
@@ -244,6 +245,8 @@ void AutomorphismSearch::getCanonicallyOrderedOrbits(Array<int>& orbits) const
 
 void AutomorphismSearch::process(Graph& graph)
 {
+    ScratchScope scratch;
+
     _prepareGraph(graph);
 
     _active.clear_resize(_n);
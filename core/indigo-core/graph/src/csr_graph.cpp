@@ -0,0 +1,85 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include "graph/csr_graph.h"
+
+using namespace indigo;
+
+CsrGraph::CsrGraph()
+{
+}
+
+CsrGraph::CsrGraph(const Graph& graph)
+{
+    build(graph);
+}
+
+void CsrGraph::clear()
+{
+    _vertices.clear();
+    _offsets.clear();
+    _nei_vertices.clear();
+    _nei_edges.clear();
+    _edges.clear();
+}
+
+void CsrGraph::build(const Graph& graph)
+{
+    int vertex_end = graph.vertexEnd();
+
+    _vertices.clear();
+    _offsets.clear_resize(vertex_end + 1);
+    _offsets.zerofill();
+
+    // Each edge adds one neighbour to both of its ends
+    _nei_vertices.clear_resize(graph.edgeCount() * 2);
+    _nei_edges.clear_resize(graph.edgeCount() * 2);
+
+    int pos = 0;
+    for (int v = 0; v < vertex_end; v++)
+    {
+        _offsets[v] = pos;
+        if (!graph.hasVertex(v))
+            continue;
+
+        _vertices.push(v);
+
+        const Vertex& vertex = graph.getVertex(v);
+        for (int i = vertex.neiBegin(); i != vertex.neiEnd(); i = vertex.neiNext(i))
+        {
+            _nei_vertices[pos] = vertex.neiVertex(i);
+            _nei_edges[pos] = vertex.neiEdge(i);
+            pos++;
+        }
+    }
+    _offsets[vertex_end] = pos;
+
+    _edges.clear_resize(graph.edgeEnd());
+    for (int e = 0; e < graph.edgeEnd(); e++)
+        _edges[e].beg = _edges[e].end = -1;
+    for (int e = graph.edgeBegin(); e != graph.edgeEnd(); e = graph.edgeNext(e))
+        _edges[e] = graph.getEdge(e);
+}
+
+int CsrGraph::findEdgeIndex(int v1, int v2) const
+{
+    for (int i = _offsets[v1]; i < _offsets[v1 + 1]; i++)
+        if (_nei_vertices[i] == v2)
+            return _nei_edges[i];
+    return -1;
+}
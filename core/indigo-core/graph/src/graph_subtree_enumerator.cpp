@@ -25,7 +25,7 @@ using namespace indigo;
 CP_DEF(GraphSubtreeEnumerator);
 
 GraphSubtreeEnumerator::GraphSubtreeEnumerator(Graph& graph)
-    : _graph(graph), CP_INIT, TL_CP_GET(_front), TL_CP_GET(_vertices), TL_CP_GET(_edges), TL_CP_GET(_v_processed)
+    : _graph(graph), CP_INIT, TL_CP_GET(_front), TL_CP_GET(_vertices), TL_CP_GET(_edges), TL_CP_GET(_v_processed), TL_CP_GET(_csr)
 {
     min_vertices = 1;
     max_vertices = graph.vertexCount();
@@ -50,6 +50,8 @@ void GraphSubtreeEnumerator::process()
 
     _front.clear_resize(1);
 
+    _csr.build(_graph);
+
     _m1.e = _m2.e = -1;
     _m1.v = _m2.v = -1;
 
@@ -97,16 +99,17 @@ void GraphSubtreeEnumerator::_reverseSearch(int front_idx, int cur_maximal_crite
 
         // Update front
         int v = front_prev_value.v;
-        const Vertex& vertex = _graph.getVertex(v);
-        for (int i = vertex.neiBegin(); i != vertex.neiEnd(); i = vertex.neiNext(i))
+        const int* nei_vertices = _csr.neiVertices();
+        const int* nei_edges = _csr.neiEdges();
+        for (int i = _csr.neiBegin(v); i != _csr.neiEnd(v); i++)
         {
-            int nei_v = vertex.neiVertex(i);
+            int nei_v = nei_vertices[i];
             if (_v_processed[nei_v] == 1)
                 continue;
 
             VertexEdgeParent& added = _front.push();
             added.v = nei_v;
-            added.e = vertex.neiEdge(i);
+            added.e = nei_edges[i];
             added.parent = v;
         }
         // Check if we can reuse front_idx front index
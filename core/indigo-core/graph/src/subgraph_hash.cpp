@@ -16,6 +16,8 @@
  * limitations under the License.
  ***************************************************************************/
 
+#include <cstring>
+
 #include "graph/subgraph_hash.h"
 #include "graph/graph.h"
 
@@ -24,7 +26,8 @@ using namespace indigo;
 CP_DEF(SubgraphHash);
 
 SubgraphHash::SubgraphHash(Graph& g)
-    : _g(g), CP_INIT, TL_CP_GET(_codes), TL_CP_GET(_oldcodes), TL_CP_GET(_gf), TL_CP_GET(_default_vertex_codes), TL_CP_GET(_default_edge_codes)
+    : _g(g), CP_INIT, TL_CP_GET(_codes), TL_CP_GET(_oldcodes), TL_CP_GET(_set_codes), TL_CP_GET(_set_oldcodes), TL_CP_GET(_set_edge_ends),
+      TL_CP_GET(_set_edge_ranks), TL_CP_GET(_local_index), TL_CP_GET(_gf), TL_CP_GET(_default_vertex_codes), TL_CP_GET(_default_edge_codes)
 {
     max_iterations = _g.vertexEnd();
     _different_codes_count = 0;
@@ -32,6 +35,7 @@ SubgraphHash::SubgraphHash(Graph& g)
 
     _codes.clear_resize(_g.vertexEnd());
     _oldcodes.clear_resize(_g.vertexEnd());
+    _local_index.clear_resize(_g.vertexEnd());
 
     _default_vertex_codes.clear_resize(_g.vertexEnd());
     _default_edge_codes.clear_resize(_g.edgeEnd());
@@ -139,3 +143,95 @@ int SubgraphHash::getDifferentCodesCount()
 {
     return _different_codes_count;
 }
+
+void SubgraphHash::getHashes(const Array<int>& vertices, const Array<int>& edges, int count, const Array<int>* const* vertex_codes_sets,
+                             const Array<int>* const* edge_codes_sets, dword* hashes, int* different_codes_counts)
+{
+    int i, k, iter;
+    int n_vertices = vertices.size();
+    int n_edges = edges.size();
+
+    // Subgraph vertices are numbered from 0 and the codes of the sets are interleaved,
+    // so the codes are kept together and an edge updates all of them at once
+    _set_codes.resize(n_vertices * count);
+    _set_oldcodes.resize(n_vertices * count);
+    _set_edge_ends.resize(n_edges * 2);
+    _set_edge_ranks.resize(n_edges * count);
+
+    dword* codes_ptr = _set_codes.ptr();
+    dword* oldcodes_ptr = _set_oldcodes.ptr();
+    int* edge_ends = _set_edge_ends.ptr();
+    dword* edge_ranks = _set_edge_ranks.ptr();
+    int* local_index = _local_index.ptr();
+
+    const int* v = vertices.ptr();
+    const int* e = edges.ptr();
+    for (i = 0; i < n_vertices; i++)
+    {
+        local_index[v[i]] = i;
+        for (k = 0; k < count; k++)
+            codes_ptr[i * count + k] = vertex_codes_sets[k]->ptr()[v[i]];
+    }
+
+    const Edge* graph_edges = _gf.getEdges();
+
+    for (i = 0; i < n_edges; i++)
+    {
+        const Edge& edge = graph_edges[e[i]];
+        edge_ends[i * 2] = local_index[edge.beg] * count;
+        edge_ends[i * 2 + 1] = local_index[edge.end] * count;
+        for (k = 0; k < count; k++)
+            edge_ranks[i * count + k] = edge_codes_sets[k]->ptr()[e[i]] + 1721;
+    }
+
+    for (iter = 0; iter < max_iterations; iter++)
+    {
+        memcpy(oldcodes_ptr, codes_ptr, n_vertices * count * sizeof(dword));
+
+        for (i = 0; i < n_edges; i++)
+        {
+            int beg = edge_ends[i * 2];
+            int end = edge_ends[i * 2 + 1];
+            const dword* ranks = edge_ranks + i * count;
+
+            for (k = 0; k < count; k++)
+            {
+                dword v1_code = oldcodes_ptr[beg + k];
+                dword v2_code = oldcodes_ptr[end + k];
+
+                codes_ptr[beg + k] += v2_code * v2_code + (v2_code + 23) * ranks[k];
+                codes_ptr[end + k] += v1_code * v1_code + (v1_code + 23) * ranks[k];
+            }
+        }
+    }
+
+    for (k = 0; k < count; k++)
+    {
+        dword result = 0;
+
+        for (i = 0; i < n_vertices; i++)
+        {
+            dword code = codes_ptr[i * count + k];
+
+            result += code * (code + 6849) + 29;
+        }
+        hashes[k] = result;
+
+        if (different_codes_counts != 0)
+        {
+            // Codes equal to an earlier one are not counted
+            int different = 0;
+            for (i = 0; i < n_vertices; i++)
+            {
+                dword cur_code = codes_ptr[i * count + k];
+                int j;
+                for (j = 0; j < i; j++)
+                    if (codes_ptr[j * count + k] == cur_code)
+                        break;
+                if (j == i)
+                    different++;
+            }
+            different_codes_counts[k] = different;
+        }
+    }
+}
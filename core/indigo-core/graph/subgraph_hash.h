@@ -46,6 +46,12 @@ namespace indigo
 
         int getDifferentCodesCount();
 
+        // Hashes of the same subgraph for several sets of vertex and edge codes computed
+        // in one pass over the subgraph edges. Each hash and different codes count is
+        // equal to the one getHash() returns for the corresponding codes
+        void getHashes(const Array<int>& vertices, const Array<int>& edges, int count, const Array<int>* const* vertex_codes_sets,
+                       const Array<int>* const* edge_codes_sets, dword* hashes, int* different_codes_counts);
+
         const Array<int>*vertex_codes, *edge_codes;
 
     private:
@@ -55,6 +61,11 @@ namespace indigo
         CP_DECL;
         TL_CP_DECL(Array<dword>, _codes);
         TL_CP_DECL(Array<dword>, _oldcodes);
+        TL_CP_DECL(Array<dword>, _set_codes);
+        TL_CP_DECL(Array<dword>, _set_oldcodes);
+        TL_CP_DECL(Array<int>, _set_edge_ends);
+        TL_CP_DECL(Array<dword>, _set_edge_ranks);
+        TL_CP_DECL(Array<int>, _local_index);
         TL_CP_DECL(GraphFastAccess, _gf);
 
         TL_CP_DECL(Array<int>, _default_vertex_codes);
@@ -157,11 +157,10 @@ namespace indigo
 
         void _handleSubgraph(Graph& graph, const Array<int>& vertices, const Array<int>& edges);
 
-        dword _canonicalizeFragment(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds,
-                                    int* different_vertex_count);
+        int _fragmentBitTypes(const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds, int subgraph_type);
 
-        void _canonicalizeFragmentAndSetBits(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds,
-                                             int subgraph_type, dword& bits_to_set);
+        void _setFragmentBits(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds, int bit_types,
+                              dword hash, int different_vertex_count, dword& bits_to_set);
 
         void _makeFingerprint(BaseMolecule& mol);
         void _makeFingerprint_calcOrdSim(BaseMolecule& mol);
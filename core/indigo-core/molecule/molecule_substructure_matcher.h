@@ -42,6 +42,96 @@ namespace indigo
     class MoleculeAtomNeighbourhoodCounters;
     class MoleculePiSystemsMatcher;
 
+    // Target-independent part of MoleculeSubstructureMatcher::setQuery(): query
+    // hydrogens that can be skipped, the decision to unfold target hydrogens,
+    // 3D-constrained atoms and the applicability of the equivalence heuristic
+    // and the aromaticity matcher. A query is compiled once and then bound to
+    // every target with MoleculeSubstructureMatcher::setQuery(compiled).
+    // The source query must outlive the compiled query and stay unchanged.
+    class DLLEXPORT CompiledSubstructureQuery
+    {
+    public:
+        CompiledSubstructureQuery();
+        ~CompiledSubstructureQuery();
+
+        // Same as the matcher properties, must be set before compile() and must
+        // be equal to the ones of every matcher the query is bound to
+        bool not_ignore_first_atom;
+        bool disable_folding_query_h;
+
+        void compile(QueryMolecule& query);
+
+        // Compiles a copy of the query with the atoms ordered by makeTransposition(),
+        // so the embedding enumeration starts from rare and highly connected atoms.
+        // Atom indices of the matcher mappings then refer to the copy, use
+        // sourceAtom() to get the index in the source query
+        void compileReordered(QueryMolecule& query);
+
+        bool isCompiled() const;
+
+        QueryMolecule& getQuery() const;
+
+        int sourceAtom(int idx) const;
+
+        // Same as MoleculeSubstructureMatcher::matchQueryAtom() for the atom of the
+        // compiled query, but runs the flattened program of its expression
+        bool matchAtom(int idx, BaseMolecule& target, int super_idx, PtrArray<RedBlackStringMap<int>>* fmcache, dword flags) const;
+
+        DECL_ERROR;
+
+    private:
+        friend class MoleculeSubstructureMatcher;
+
+        // Atom expressions are flattened into one array in prefix order. Every
+        // instruction stores the index of the one that follows its subtree, so the
+        // operands of AND/OR are walked without touching the node tree. Nested
+        // operations of the same kind are merged, OR lists of elements become
+        // bit masks, and the most common leaves are compared inline. Other leaves
+        // are evaluated with MoleculeSubstructureMatcher::matchQueryAtom().
+        enum
+        {
+            ATOM_CODE_TRUE,
+            ATOM_CODE_AND,
+            ATOM_CODE_OR,
+            ATOM_CODE_NOT,
+            ATOM_CODE_ELEMENTS,
+            ATOM_CODE_NUMBER,
+            ATOM_CODE_ISOTOPE,
+            ATOM_CODE_CHARGE,
+            ATOM_CODE_NODE
+        };
+
+        struct AtomInstruction
+        {
+            int code;
+            int next;
+            int value_min;
+            int value_max;
+            qword elements[2];
+            QueryMolecule::Atom* node;
+        };
+
+        void _compile(QueryMolecule& query);
+        void _compileAtom(QueryMolecule::Atom* node);
+        static void _collectOperands(QueryMolecule::Atom* node, int type, Array<QueryMolecule::Atom*>& operands);
+        bool _matchAtomCode(int pc, BaseMolecule& target, int super_idx, PtrArray<RedBlackStringMap<int>>* fmcache, dword flags) const;
+
+        QueryMolecule* _query;
+        std::unique_ptr<QueryMolecule> _reordered;
+        Array<int> _source_atoms;
+
+        bool _markush;
+        bool _should_unfold_h;
+        bool _can_use_equivalence_heuristic;
+        bool _aromaticity_matcher_necessary;
+        Array<int> _ignored_atoms;
+        Array<int> _3d_constrained_atoms;
+
+        Array<AtomInstruction> _atom_code;
+        Array<int> _atom_code_start;
+        Array<int> _atom_min_h;
+    };
+
     class DLLEXPORT MoleculeSubstructureMatcher
     {
     public:
@@ -57,6 +147,8 @@ namespace indigo
         ~MoleculeSubstructureMatcher();
 
         void setQuery(QueryMolecule& query);
+        // Binds a compiled query to the target, skipping the query analysis of setQuery()
+        void setQuery(const CompiledSubstructureQuery& compiled);
         QueryMolecule& getQuery();
 
         // Set vertex neibourhood counters for effective matching
@@ -83,6 +175,12 @@ namespace indigo
         int match_3d;        // 0 or AFFINE or CONFORMATION
         float rms_threshold; // for AFFINE and CONFORMATION
 
+        // Evaluate the target-independent part of the atom matching for all pairs
+        // of query and target atoms before the search. Applies to compiled queries
+        // only and pays off when most pairs are tried, e.g. for small targets.
+        // false by default
+        bool precompute_atom_pairs;
+
         void ignoreQueryAtom(int idx);
         void ignoreTargetAtom(int idx);
         bool fix(int query_atom_idx, int target_atom_idx);
@@ -156,6 +254,8 @@ namespace indigo
         static bool shouldUnfoldTargetHydrogens(QueryMolecule& query, bool find_all_embeddings);
 
     protected:
+        friend class CompiledSubstructureQuery;
+
         struct MarkushContext
         {
             explicit MarkushContext(QueryMolecule& query_, BaseMolecule& target_);
@@ -168,6 +268,9 @@ namespace indigo
         };
 
         static bool _matchAtoms(Graph& subgraph, Graph& supergraph, const int* core_sub, int sub_idx, int super_idx, void* userdata);
+        // Checks of _matchAtoms() that do not depend on the embedding state
+        bool _matchAtomFeatures(QueryMolecule& query, int sub_idx, int super_idx);
+        void _buildAtomPairs();
 
         static bool _matchBonds(Graph& subgraph, Graph& supergraph, int sub_idx, int super_idx, void* userdata);
 
@@ -181,6 +284,9 @@ namespace indigo
         int _embedding_markush(int* core_sub, int* core_super);
 
         static bool _canUseEquivalenceHeuristic(QueryMolecule& query);
+        static void _markIgnoredAtoms(QueryMolecule& query, QueryMolecule& source, bool disable_folding_query_h, bool not_ignore_first_atom,
+                                      Array<int>& constrained_3d, Array<int>& ignored);
+        void _initEnumerator(const Array<int>& ignored);
         static bool _isSingleBond(Graph& graph, int edge_idx);
 
         static bool _shouldUnfoldTargetHydrogens(QueryMolecule& query, bool is_fragment, bool disable_folding_query_h);
@@ -214,6 +320,14 @@ namespace indigo
 
         bool _h_unfold; // implicit target hydrogens unfolded
 
+        // Set when the query is bound with setQuery(compiled)
+        const CompiledSubstructureQuery* _compiled;
+
+        // Results of _matchAtomFeatures() for the compiled query, filled during find()
+        // when precompute_atom_pairs is set: query atom * _atom_pairs_stride + target atom
+        Array<byte> _atom_pairs;
+        int _atom_pairs_stride;
+
         CP_DECL;
         TL_CP_DECL(Array<int>, _3d_constrained_atoms);
         TL_CP_DECL(Array<int>, _unfolded_target_h);
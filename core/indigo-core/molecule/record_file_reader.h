@@ -0,0 +1,142 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __record_file_reader__
+#define __record_file_reader__
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base_cpp/exception.h"
+#include "base_cpp/io_base.h"
+
+struct z_stream_s;
+
+namespace indigo
+{
+    class FileMapping;
+    class PropertiesMap;
+
+    // Bulk reader of SDF files and of files with a record per line (SMILES).
+    // Plain files are memory-mapped, gzip-compressed ones are unpacked by blocks
+    // of BLOCK_SIZE bytes. Records are found by scanning the data for the "$$$$"
+    // lines or line ends with memchr and are handed out as views into the mapping
+    // or the block without copying. forEach() splits the data at record boundaries
+    // into ranges read by several threads at once.
+    class DLLEXPORT RecordFileReader
+    {
+    public:
+        enum class Format
+        {
+            SDF,
+            LINES
+        };
+
+        enum
+        {
+            BLOCK_SIZE = 16 * 1024 * 1024,
+            RANGE_SIZE = 1024 * 1024,
+            MAX_RECORD_SIZE = 10485760 // the same as SdfLoader::MAX_DATA_SIZE
+        };
+
+        struct Record
+        {
+            // Record text without the "$$$$" line or the line end.
+            // Valid until the next block is read
+            const char* data;
+            size_t size;
+
+            // Offset in the unpacked file and the number of the record
+            long long offset;
+            long long index;
+
+            // Offset of the record following this one
+            long long next_offset;
+        };
+
+        RecordFileReader(Encoding filename_encoding, const char* filename, Format format);
+        ~RecordFileReader();
+
+        // Reads the next record on the calling thread
+        bool next(Record& record);
+
+        // Passes all the remaining records to the handler. The ranges of about range_size
+        // bytes are taken by thread_count threads in the file order, so the handler is
+        // called from that many threads at once; records of one range go one after another.
+        // The threads work in the session of the caller.
+        // The first exception of the handler stops the reading and is rethrown
+        void forEach(int thread_count, const std::function<void(const Record& record)>& handler, size_t range_size = RANGE_SIZE);
+
+        // Offset of the next record
+        long long tell() const;
+
+        // Number of all the records of the file
+        long long count();
+
+        bool isMapped() const;
+
+        // Data items of an SDF record, read the same way SdfLoader reads them
+        static void readSdfProperties(const Record& record, PropertiesMap& properties);
+
+        DECL_ERROR;
+
+    private:
+        struct _Range
+        {
+            const char* begin;
+            const char* end;
+            long long offset;
+            long long index;
+        };
+
+        // Finds the record starting at pos. Returns false if the data ends before the
+        // record does and more data may follow, or if only the trailing spaces are left
+        bool _findRecord(const char* pos, const char* end, bool last, Record& record, const char*& next) const;
+
+        // Moves the unread data to the beginning of the buffer and appends the next block.
+        // Returns false at the end of the file
+        bool _readBlock();
+        size_t _readData(char* buf, size_t size);
+
+        // Splits the unread data into the ranges of about range_size bytes
+        void _splitRanges(std::vector<_Range>& ranges, size_t range_size);
+
+        Format _format;
+        Encoding _filename_encoding;
+        std::string _filename;
+
+        std::unique_ptr<FileMapping> _mapping;
+
+        FILE* _file;
+        std::unique_ptr<z_stream_s> _zstream;
+        std::vector<char> _inbuf;
+        std::vector<char> _buffer;
+        bool _file_eof;
+
+        // Unread data and the position of its beginning in the file
+        const char* _pos;
+        const char* _end;
+        long long _offset;
+        long long _index;
+    };
+
+} // namespace indigo
+
+#endif
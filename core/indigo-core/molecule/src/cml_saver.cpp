@@ -169,7 +169,8 @@ void CmlSaver::_addMoleculeElement(XMLElement* elem, BaseMolecule& mol, bool que
 
             QS_DEF(Array<char>, buf);
             ArrayOutput out(buf);
-            out.printf("a%d", i);
+            out.writeChar('a');
+            out.writeInt(i);
             buf.push(0);
             atom->SetAttribute("id", buf.ptr());
             atom->SetAttribute("elementType", atom_str);
@@ -489,7 +490,10 @@ void CmlSaver::_addMoleculeElement(XMLElement* elem, BaseMolecule& mol, bool que
 
             QS_DEF(Array<char>, buf);
             ArrayOutput out(buf);
-            out.printf("a%d a%d", edge.beg, edge.end);
+            out.writeChar('a');
+            out.writeInt(edge.beg);
+            out.writeString(" a");
+            out.writeInt(edge.end);
             buf.push(0);
             bond->SetAttribute("atomRefs2", buf.ptr());
 
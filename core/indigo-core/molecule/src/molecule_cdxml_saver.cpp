@@ -45,7 +45,9 @@ tinyxml2::XMLElement* MoleculeCdxmlSaver::create_text(tinyxml2::XMLElement* pare
     parent->LinkEndChild(t);
     Array<char> buf;
     ArrayOutput out(buf);
-    out.printf("%f %f", x, y);
+    out.writeFixed(x, 6);
+    out.writeChar(' ');
+    out.writeFixed(y, 6);
     buf.push(0);
     t->SetAttribute("p", buf.ptr());
     if (label_justification)
@@ -744,14 +746,20 @@ void MoleculeCdxmlSaver::addNodeToFragment(BaseMolecule& mol, XMLElement* fragme
     {
         QS_DEF(Array<char>, buf);
         ArrayOutput out(buf);
-        out.printf("%f %f", pos.x, -pos.y);
+        out.writeFixed(pos.x, 6);
+        out.writeChar(' ');
+        out.writeFixed(-pos.y, 6);
         buf.push(0);
         node->SetAttribute("p", buf.ptr());
         if (have_z)
         {
             QS_DEF(Array<char>, buf);
             ArrayOutput out(buf);
-            out.printf("%f %f %f", pos3.x, -pos3.y, -pos3.z);
+            out.writeFixed(pos3.x, 6);
+            out.writeChar(' ');
+            out.writeFixed(-pos3.y, 6);
+            out.writeChar(' ');
+            out.writeFixed(-pos3.z, 6);
             buf.push(0);
             node->SetAttribute("xyz", buf.ptr());
         }
@@ -771,8 +779,8 @@ void MoleculeCdxmlSaver::addNodeToFragment(BaseMolecule& mol, XMLElement* fragme
         for (int i = 0; i < 4; ++i)
         {
             if (i)
-                out.printf(" ");
-            out.printf("%d", _atoms_ids[pyramid[i] < 0 ? 0 : pyramid[i]]);
+                out.writeChar(' ');
+            out.writeInt(_atoms_ids[pyramid[i] < 0 ? 0 : pyramid[i]]);
         }
 
         buf.push(0);
@@ -836,7 +844,7 @@ void MoleculeCdxmlSaver::addNodeToFragment(BaseMolecule& mol, XMLElement* fragme
         if (hcount > 1)
         {
             out.clear();
-            out.printf("%d", hcount);
+            out.writeInt(hcount);
             buf.push(0);
             add_style_str(t, 3, 10, 32, buf.ptr());
         }
@@ -20,6 +20,7 @@
 
 #include "base_c/bitarray.h"
 #include "base_cpp/output.h"
+#include "base_cpp/scratch_arena.h"
 #include "graph/cycle_enumerator.h"
 #include "graph/graph_subtree_enumerator.h"
 #include "graph/subgraph_hash.h"
@@ -160,6 +161,8 @@ MoleculeFingerprintBuilder::~MoleculeFingerprintBuilder()
 
 void MoleculeFingerprintBuilder::process()
 {
+    ScratchScope scratch;
+
     _total_fingerprint.zerofill();
     _makeFingerprint(_mol);
 }
@@ -357,38 +360,9 @@ int MoleculeFingerprintBuilder::_maximalSubgraphCriteriaValue(Graph& graph, cons
     return ret;
 }
 
-dword MoleculeFingerprintBuilder::_canonicalizeFragment(BaseMolecule& /* mol */, const Array<int>& vertices, const Array<int>& edges, bool use_atoms,
-                                                        bool use_bonds, int* different_vertex_count)
-{
-    if (use_bonds)
-        subgraph_hash->edge_codes = &_bond_codes;
-    else
-        subgraph_hash->edge_codes = &_bond_codes_empty;
-
-    if (use_atoms)
-        subgraph_hash->vertex_codes = &_atom_codes;
-    else
-        subgraph_hash->vertex_codes = &_atom_codes_empty;
-
-    subgraph_hash->max_iterations = (edges.size() + 1) / 2;
-    subgraph_hash->calc_different_codes_count = true;
-
-    dword ret = subgraph_hash->getHash(vertices, edges);
-    if (different_vertex_count != 0)
-        *different_vertex_count = subgraph_hash->getDifferentCodesCount();
-
-    return ret;
-}
-
 void MoleculeFingerprintBuilder::_addOrdHashBits(dword hash, int bits_per_fragment)
 {
-    HashBits hash_bits(hash, bits_per_fragment);
-
-    auto it = _ord_hashes.find(hash_bits);
-    if (it == _ord_hashes.end())
-        _ord_hashes.emplace(hash_bits, 1);
-    else
-        _ord_hashes.at(hash_bits)++;
+    _ord_hashes[HashBits(hash, bits_per_fragment)]++;
 }
 
 void MoleculeFingerprintBuilder::_calculateFragmentVertexDegree(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges)
@@ -421,8 +395,7 @@ int MoleculeFingerprintBuilder::_calculateFragmentExternalConn(BaseMolecule& mol
     return sum;
 }
 
-void MoleculeFingerprintBuilder::_canonicalizeFragmentAndSetBits(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms,
-                                                                 bool use_bonds, int subgraph_type, dword& bits_set)
+int MoleculeFingerprintBuilder::_fragmentBitTypes(const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds, int subgraph_type)
 {
     bool set_sim = false, set_ord = false, set_any = false, set_tau = false;
 
@@ -465,14 +438,18 @@ void MoleculeFingerprintBuilder::_canonicalizeFragmentAndSetBits(BaseMolecule& m
     if (!use_bonds && !skip_tau && _parameters.tau_qwords > 0)
         set_tau = true;
 
-    if (!set_any && !set_ord && !set_sim && !set_tau)
-        return;
+    // Same masks as the ones of bits_set
+    return (set_sim ? 0x01 : 0) | (set_ord ? 0x02 : 0) | (set_any ? 0x04 : 0) | (set_tau ? 0x08 : 0);
+}
+
+void MoleculeFingerprintBuilder::_setFragmentBits(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds,
+                                                  int bit_types, dword hash, int different_vertex_count, dword& bits_set)
+{
+    bool set_sim = (bit_types & 0x01) != 0, set_ord = (bit_types & 0x02) != 0;
+    bool set_any = (bit_types & 0x04) != 0, set_tau = (bit_types & 0x08) != 0;
 
     // different_vertex_count is equal to the number of orbits
     // if codes have no collisions
-    int different_vertex_count;
-    dword hash = _canonicalizeFragment(mol, vertices, edges, use_atoms, use_bonds, &different_vertex_count);
-
     // Calculate bits count factor based on different_vertex_count
     int bits_per_fragment;
     if (2 * vertices.size() > 3 * different_vertex_count)
@@ -582,20 +559,51 @@ void MoleculeFingerprintBuilder::_handleSubgraph(Graph& graph, const Array<int>&
 
     bool has_query_bonds = (i != edges.size());
 
+    // Fragment variants: with atom and bond codes, atoms only, bonds only, and neither
+    const bool use_atoms[] = {true, true, false, false};
+    const bool use_bonds[] = {true, false, true, false};
+    const bool handled[] = {!has_query_atoms && !has_query_bonds, !query || !has_query_atoms, !query || !has_query_bonds, true};
+
+    // Hashes of all the used variants are calculated in one pass over the fragment
+    const Array<int>* vertex_codes[4];
+    const Array<int>* edge_codes[4];
+    int bit_types[4], variant_index[4];
+    dword hashes[4];
+    int different_vertex_counts[4];
+    int count = 0;
+
+    for (i = 0; i < 4; i++)
+    {
+        bit_types[i] = handled[i] ? _fragmentBitTypes(vertices, edges, use_atoms[i], use_bonds[i], subgraph_type) : 0;
+        if (bit_types[i] == 0)
+            continue;
+
+        vertex_codes[count] = use_atoms[i] ? &_atom_codes : &_atom_codes_empty;
+        edge_codes[count] = use_bonds[i] ? &_bond_codes : &_bond_codes_empty;
+        variant_index[i] = count++;
+    }
+
+    if (count == 0)
+        return;
+
+    subgraph_hash->max_iterations = (edges.size() + 1) / 2;
+    subgraph_hash->getHashes(vertices, edges, count, vertex_codes, edge_codes, hashes, different_vertex_counts);
+
     dword bits_set = 0;
-    if (!has_query_atoms && !has_query_bonds)
-        _canonicalizeFragmentAndSetBits(mol, vertices, edges, true, true, subgraph_type, bits_set);
+    if (bit_types[0] != 0)
+        _setFragmentBits(mol, vertices, edges, true, true, bit_types[0], hashes[variant_index[0]], different_vertex_counts[variant_index[0]], bits_set);
 
     dword bits_set_a = bits_set;
-    if (!query || !has_query_atoms)
-        _canonicalizeFragmentAndSetBits(mol, vertices, edges, true, false, subgraph_type, bits_set_a);
+    if (bit_types[1] != 0)
+        _setFragmentBits(mol, vertices, edges, true, false, bit_types[1], hashes[variant_index[1]], different_vertex_counts[variant_index[1]], bits_set_a);
 
     dword bits_set_b = bits_set;
-    if (!query || !has_query_bonds)
-        _canonicalizeFragmentAndSetBits(mol, vertices, edges, false, true, subgraph_type, bits_set_b);
+    if (bit_types[2] != 0)
+        _setFragmentBits(mol, vertices, edges, false, true, bit_types[2], hashes[variant_index[2]], different_vertex_counts[variant_index[2]], bits_set_b);
 
     dword bits_set_ab = (bits_set_a | bits_set_b);
-    _canonicalizeFragmentAndSetBits(mol, vertices, edges, false, false, subgraph_type, bits_set_ab);
+    if (bit_types[3] != 0)
+        _setFragmentBits(mol, vertices, edges, false, false, bit_types[3], hashes[variant_index[3]], different_vertex_counts[variant_index[3]], bits_set_ab);
 }
 
 void MoleculeFingerprintBuilder::_makeFingerprint(BaseMolecule& mol)
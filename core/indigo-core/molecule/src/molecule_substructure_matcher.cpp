@@ -18,6 +18,7 @@
 
 #include "molecule/molecule_substructure_matcher.h"
 #include "base_cpp/array.h"
+#include "base_cpp/scratch_arena.h"
 #include "graph/edge_rotation_matcher.h"
 #include "graph/filter.h"
 #include "graph/graph.h"
@@ -56,6 +57,265 @@ MoleculeSubstructureMatcher::MarkushContext::MarkushContext(QueryMolecule& query
         query_marking[i] = -1;
 }
 
+IMPL_ERROR(CompiledSubstructureQuery, "compiled substructure query");
+
+CompiledSubstructureQuery::CompiledSubstructureQuery()
+    : not_ignore_first_atom(false), disable_folding_query_h(false), _query(nullptr), _markush(false), _should_unfold_h(false),
+      _can_use_equivalence_heuristic(false), _aromaticity_matcher_necessary(false)
+{
+}
+
+CompiledSubstructureQuery::~CompiledSubstructureQuery()
+{
+}
+
+void CompiledSubstructureQuery::compile(QueryMolecule& query)
+{
+    _reordered.reset(nullptr);
+    _source_atoms.clear();
+    _compile(query);
+}
+
+void CompiledSubstructureQuery::compileReordered(QueryMolecule& query)
+{
+    // Markush and 3D constraints refer to the atom indices of the source query
+    if (query.rgroups.getRGroupCount() > 0 || query.spatial_constraints.haveConstraints())
+    {
+        compile(query);
+        return;
+    }
+
+    QS_DEF(Array<int>, transposition);
+
+    MoleculeSubstructureMatcher::makeTransposition(query, transposition);
+
+    _reordered = std::make_unique<QueryMolecule>();
+    _reordered->makeSubmolecule(query, transposition, 0);
+    _source_atoms.copy(transposition);
+    _compile(*_reordered);
+}
+
+void CompiledSubstructureQuery::_compile(QueryMolecule& query)
+{
+    _query = &query;
+    _markush = query.rgroups.getRGroupCount() > 0;
+    _ignored_atoms.clear();
+    _3d_constrained_atoms.clear();
+
+    // Markush queries are analyzed by every matcher on its own copy
+    if (_markush)
+        return;
+
+    MoleculeSubstructureMatcher::_markIgnoredAtoms(query, query, disable_folding_query_h, not_ignore_first_atom, _3d_constrained_atoms, _ignored_atoms);
+    _should_unfold_h = MoleculeSubstructureMatcher::shouldUnfoldTargetHydrogens(query, disable_folding_query_h);
+    _can_use_equivalence_heuristic = MoleculeSubstructureMatcher::_canUseEquivalenceHeuristic(query);
+    _aromaticity_matcher_necessary = AromaticityMatcher::isNecessary(query);
+
+    _atom_code.clear();
+    _atom_code_start.clear_resize(query.vertexEnd());
+    _atom_code_start.fill(-1);
+    _atom_min_h.clear_resize(query.vertexEnd());
+    _atom_min_h.zerofill();
+
+    for (int i = query.vertexBegin(); i != query.vertexEnd(); i = query.vertexNext(i))
+    {
+        _atom_code_start[i] = _atom_code.size();
+        _compileAtom(&query.getAtom(i));
+
+        try
+        {
+            _atom_min_h[i] = query.getAtomMinH(i);
+        }
+        catch (Exception&)
+        {
+            _atom_min_h[i] = 0;
+        }
+    }
+}
+
+void CompiledSubstructureQuery::_collectOperands(QueryMolecule::Atom* node, int type, Array<QueryMolecule::Atom*>& operands)
+{
+    for (int i = 0; i < node->children.size(); i++)
+    {
+        QueryMolecule::Atom* child = node->child(i);
+
+        if (child->type == type)
+            _collectOperands(child, type, operands);
+        else
+            operands.push(child);
+    }
+}
+
+static bool _isSingleElement(QueryMolecule::Atom* node)
+{
+    return node->type == QueryMolecule::ATOM_NUMBER && node->value_min == node->value_max && node->value_min >= 0 && node->value_min < 128;
+}
+
+void CompiledSubstructureQuery::_compileAtom(QueryMolecule::Atom* node)
+{
+    int pc = _atom_code.size();
+    AtomInstruction& instr = _atom_code.push();
+
+    instr.code = ATOM_CODE_NODE;
+    instr.next = pc + 1;
+    instr.value_min = node->value_min;
+    instr.value_max = node->value_max;
+    instr.elements[0] = instr.elements[1] = 0;
+    instr.node = node;
+
+    switch (node->type)
+    {
+    case QueryMolecule::ATOM_STAR:
+    case QueryMolecule::OP_NONE:
+    case QueryMolecule::ATOM_RSITE:
+        instr.code = ATOM_CODE_TRUE;
+        return;
+    case QueryMolecule::ATOM_NUMBER:
+        instr.code = ATOM_CODE_NUMBER;
+        return;
+    case QueryMolecule::ATOM_ISOTOPE:
+        instr.code = ATOM_CODE_ISOTOPE;
+        return;
+    case QueryMolecule::ATOM_CHARGE:
+        instr.code = ATOM_CODE_CHARGE;
+        return;
+    case QueryMolecule::OP_NOT:
+        instr.code = ATOM_CODE_NOT;
+        _compileAtom(node->child(0));
+        _atom_code[pc].next = _atom_code.size();
+        return;
+    case QueryMolecule::OP_AND:
+    case QueryMolecule::OP_OR:
+        break;
+    default:
+        return;
+    }
+
+    // Nested operations of the same kind are merged into one list of operands
+    Array<QueryMolecule::Atom*> operands;
+    _collectOperands(node, node->type, operands);
+
+    if (operands.size() == 1)
+    {
+        _atom_code.pop();
+        _compileAtom(operands[0]);
+        return;
+    }
+
+    instr.code = node->type == QueryMolecule::OP_AND ? ATOM_CODE_AND : ATOM_CODE_OR;
+
+    if (node->type == QueryMolecule::OP_OR)
+    {
+        int elements_count = 0;
+        for (int i = 0; i < operands.size(); i++)
+            if (_isSingleElement(operands[i]))
+                elements_count++;
+
+        // Element lists like [C,N,O] are tested with one bit mask lookup
+        if (elements_count > 1)
+        {
+            AtomInstruction& mask = _atom_code.push();
+            mask = _atom_code[pc];
+            mask.code = ATOM_CODE_ELEMENTS;
+            mask.next = pc + 2;
+            mask.node = nullptr;
+
+            for (int i = 0; i < operands.size(); i++)
+            {
+                if (!_isSingleElement(operands[i]))
+                    continue;
+                int number = operands[i]->value_min;
+                mask.elements[number >> 6] |= (qword)1 << (number & 63);
+                operands.remove(i--);
+            }
+        }
+    }
+
+    for (int i = 0; i < operands.size(); i++)
+        _compileAtom(operands[i]);
+
+    _atom_code[pc].next = _atom_code.size();
+}
+
+bool CompiledSubstructureQuery::matchAtom(int idx, BaseMolecule& target, int super_idx, PtrArray<RedBlackStringMap<int>>* fmcache, dword flags) const
+{
+    if (_query == nullptr)
+        throw Error("query is not compiled");
+
+    if (_markush)
+        return MoleculeSubstructureMatcher::matchQueryAtom(&_query->getAtom(idx), target, super_idx, fmcache, flags);
+
+    return _matchAtomCode(_atom_code_start[idx], target, super_idx, fmcache, flags);
+}
+
+bool CompiledSubstructureQuery::_matchAtomCode(int pc, BaseMolecule& target, int super_idx, PtrArray<RedBlackStringMap<int>>* fmcache, dword flags) const
+{
+    const AtomInstruction& instr = _atom_code[pc];
+
+    switch (instr.code)
+    {
+    case ATOM_CODE_TRUE:
+        return true;
+    case ATOM_CODE_AND:
+        for (int i = pc + 1; i < instr.next; i = _atom_code[i].next)
+            if (!_matchAtomCode(i, target, super_idx, fmcache, flags))
+                return false;
+        return true;
+    case ATOM_CODE_OR:
+        for (int i = pc + 1; i < instr.next; i = _atom_code[i].next)
+            if (_matchAtomCode(i, target, super_idx, fmcache, flags))
+                return true;
+        return false;
+    case ATOM_CODE_NOT:
+        return !_matchAtomCode(pc + 1, target, super_idx, fmcache, flags ^ MoleculeSubstructureMatcher::MATCH_DISABLED_AS_TRUE);
+    case ATOM_CODE_ELEMENTS: {
+        int number = target.getAtomNumber(super_idx);
+        if (number < 0 || number >= 128)
+            return false;
+        return ((instr.elements[number >> 6] >> (number & 63)) & 1) != 0;
+    }
+    case ATOM_CODE_NUMBER: {
+        int number = target.getAtomNumber(super_idx);
+        return number >= instr.value_min && number <= instr.value_max;
+    }
+    case ATOM_CODE_ISOTOPE: {
+        int isotope = target.getAtomIsotope(super_idx);
+        return isotope >= instr.value_min && isotope <= instr.value_max;
+    }
+    case ATOM_CODE_CHARGE: {
+        if (flags & MoleculeSubstructureMatcher::MATCH_ATOM_CHARGE)
+        {
+            int charge = target.getAtomCharge(super_idx);
+            return charge >= instr.value_min && charge <= instr.value_max;
+        }
+        return (flags & MoleculeSubstructureMatcher::MATCH_DISABLED_AS_TRUE) != 0;
+    }
+    default:
+        return MoleculeSubstructureMatcher::matchQueryAtom(instr.node, target, super_idx, fmcache, flags);
+    }
+}
+
+bool CompiledSubstructureQuery::isCompiled() const
+{
+    return _query != nullptr;
+}
+
+QueryMolecule& CompiledSubstructureQuery::getQuery() const
+{
+    if (_query == nullptr)
+        throw Error("query is not compiled");
+
+    return *_query;
+}
+
+int CompiledSubstructureQuery::sourceAtom(int idx) const
+{
+    if (_source_atoms.size() == 0)
+        return idx;
+
+    return _source_atoms[idx];
+}
+
 IMPL_ERROR(MoleculeSubstructureMatcher, "molecule substructure matcher");
 
 CP_DEF(MoleculeSubstructureMatcher);
@@ -69,6 +329,7 @@ MoleculeSubstructureMatcher::MoleculeSubstructureMatcher(BaseMolecule& target)
     _query = 0;
     match_3d = 0;
     rms_threshold = 0;
+    precompute_atom_pairs = false;
 
     highlight = false;
     find_all_embeddings = false;
@@ -91,6 +352,9 @@ MoleculeSubstructureMatcher::MoleculeSubstructureMatcher(BaseMolecule& target)
     _query_nei_counters = 0;
     _target_nei_counters = 0;
 
+    _compiled = nullptr;
+    _atom_pairs_stride = 0;
+
     _used_target_h.clear_resize(target.vertexEnd());
 
     // won't ignore target hydrogens because query can contain
@@ -210,8 +474,6 @@ bool MoleculeSubstructureMatcher::_shouldUnfoldTargetHydrogens(QueryMolecule& qu
 
 void MoleculeSubstructureMatcher::setQuery(QueryMolecule& query)
 {
-    int i;
-
     if (query.rgroups.getRGroupCount() > 0)
     {
         _markush = std::make_unique<MarkushContext>(query, _target);
@@ -222,36 +484,82 @@ void MoleculeSubstructureMatcher::setQuery(QueryMolecule& query)
         _markush.reset(nullptr);
         _query = &query;
     }
+    _compiled = nullptr;
 
     QS_DEF(Array<int>, ignored);
 
-    ignored.clear_resize(_query->vertexEnd());
+    _markIgnoredAtoms(*_query, query, disable_folding_query_h, not_ignore_first_atom, _3d_constrained_atoms, ignored);
+
+    if (!disable_unfolding_implicit_h && shouldUnfoldTargetHydrogens(*_query, disable_folding_query_h) && !_target.isQueryMolecule())
+    {
+        _h_unfold = true;
+    }
+    else
+        _h_unfold = false;
+
+    _initEnumerator(ignored);
+}
+
+void MoleculeSubstructureMatcher::setQuery(const CompiledSubstructureQuery& compiled)
+{
+    if (!compiled.isCompiled())
+        throw Error("query is not compiled");
+
+    if (compiled.not_ignore_first_atom != not_ignore_first_atom || compiled.disable_folding_query_h != disable_folding_query_h)
+        throw Error("query is compiled with different options");
+
+    if (compiled._markush)
+    {
+        // Markush matching modifies its own copy of the query
+        setQuery(*compiled._query);
+        return;
+    }
+
+    _markush.reset(nullptr);
+    _query = compiled._query;
+    _compiled = &compiled;
+
+    _3d_constrained_atoms.copy(compiled._3d_constrained_atoms);
+    _h_unfold = !disable_unfolding_implicit_h && compiled._should_unfold_h && !_target.isQueryMolecule();
+
+    _initEnumerator(compiled._ignored_atoms);
+}
+
+void MoleculeSubstructureMatcher::_markIgnoredAtoms(QueryMolecule& query, QueryMolecule& source, bool disable_folding_query_h, bool not_ignore_first_atom,
+                                                    Array<int>& constrained_3d, Array<int>& ignored)
+{
+    QS_DEF(Array<int>, ignored_h);
+
+    ignored_h.clear_resize(query.vertexEnd());
 
     if (!disable_folding_query_h)
         // If hydrogens are folded then the number of the all matchers is different
-        markIgnoredQueryHydrogens(*_query, ignored.ptr(), 0, 1);
+        markIgnoredQueryHydrogens(query, ignored_h.ptr(), 0, 1);
     else
-        ignored.zerofill();
+        ignored_h.zerofill();
 
     if (not_ignore_first_atom)
-        ignored[_query->vertexBegin()] = 0;
+        ignored_h[query.vertexBegin()] = 0;
 
-    _3d_constrained_atoms.clear_resize(_query->vertexEnd());
-    _3d_constrained_atoms.zerofill();
+    constrained_3d.clear_resize(query.vertexEnd());
+    constrained_3d.zerofill();
 
     {
-        Molecule3dConstraintsChecker checker(query.spatial_constraints);
+        Molecule3dConstraintsChecker checker(source.spatial_constraints);
 
-        checker.markUsedAtoms(_3d_constrained_atoms.ptr(), 1);
+        checker.markUsedAtoms(constrained_3d.ptr(), 1);
     }
 
-    if (!disable_unfolding_implicit_h && shouldUnfoldTargetHydrogens(*_query, disable_folding_query_h) && !_target.isQueryMolecule())
+    ignored.clear();
+    for (int i = query.vertexBegin(); i != query.vertexEnd(); i = query.vertexNext(i))
     {
-        _h_unfold = true;
+        if ((ignored_h[i] && !constrained_3d[i]) || query.isRSite(i))
+            ignored.push(i);
     }
-    else
-        _h_unfold = false;
+}
 
+void MoleculeSubstructureMatcher::_initEnumerator(const Array<int>& ignored)
+{
     if (_ee.get() != nullptr)
         _ee.reset(nullptr);
 
@@ -264,11 +572,8 @@ void MoleculeSubstructureMatcher::setQuery(QueryMolecule& query)
     _ee->userdata = this;
 
     _ee->setSubgraph(*_query);
-    for (i = _query->vertexBegin(); i != _query->vertexEnd(); i = _query->vertexNext(i))
-    {
-        if ((ignored[i] && !_3d_constrained_atoms[i]) || _query->isRSite(i))
-            _ee->ignoreSubgraphVertex(i);
-    }
+    for (int i = 0; i < ignored.size(); i++)
+        _ee->ignoreSubgraphVertex(ignored[i]);
 
     _embeddings_storage.reset(nullptr);
 }
@@ -299,20 +604,23 @@ bool MoleculeSubstructureMatcher::find()
     if (match_3d != 0 && !_target.have_xyz)
         return false;
 
+    ScratchScope scratch;
+
     if (_h_unfold)
     {
         _target.asMolecule().unfoldHydrogens(&_unfolded_target_h, -1, true);
         _ee->validate();
     }
 
-    if (_canUseEquivalenceHeuristic(*_query))
+    bool can_use_equivalence_heuristic = _compiled != nullptr ? _compiled->_can_use_equivalence_heuristic : _canUseEquivalenceHeuristic(*_query);
+    if (can_use_equivalence_heuristic)
         _ee->setEquivalenceHandler(vertex_equivalence_handler);
     else
         _ee->setEquivalenceHandler(NULL);
 
     _used_target_h.zerofill();
 
-    if (use_aromaticity_matcher && AromaticityMatcher::isNecessary(*_query))
+    if (use_aromaticity_matcher && (_compiled != nullptr ? _compiled->_aromaticity_matcher_necessary : AromaticityMatcher::isNecessary(*_query)))
         _am = std::make_unique<AromaticityMatcher>(*_query, _target, arom_options);
     else
         _am.reset(nullptr);
@@ -325,8 +633,13 @@ bool MoleculeSubstructureMatcher::find()
     _3d_constraints_checker = std::make_unique<Molecule3dConstraintsChecker>(_query->spatial_constraints);
     _createEmbeddingsStorage();
 
+    _buildAtomPairs();
+
     int result = _ee->process();
 
+    // findNext() and fix() may see another set of unfolded hydrogens
+    _atom_pairs.clear();
+
     if (_h_unfold && restore_unfolded_h)
         _removeUnfoldedHydrogens();
 
@@ -580,50 +893,16 @@ bool MoleculeSubstructureMatcher::_matchAtoms(Graph& subgraph, Graph& supergraph
 {
     MoleculeSubstructureMatcher* self = (MoleculeSubstructureMatcher*)userdata;
 
-    if (self->_h_unfold && (&subgraph == (Graph*)self->_query))
-    {
-        if (sub_idx < self->_3d_constrained_atoms.size() && self->_3d_constrained_atoms[sub_idx])
-            // we can't check 3D constraint on unfolded atom, because it has no actual position
-            if (self->_unfolded_target_h[super_idx])
-                return false;
-    }
-
-    dword match_atoms_flags = 0xFFFFFFFF;
-    // If target atom belongs to a pi-system then its charge
-    // should be checked after embedding
-    if (self->_pi_systems_matcher.get())
-    {
-        if (self->_pi_systems_matcher->isAtomInPiSystem(super_idx))
-            match_atoms_flags &= ~(MATCH_ATOM_CHARGE | MATCH_ATOM_VALENCE);
-    }
-
     QueryMolecule& query = (QueryMolecule&)subgraph;
     BaseMolecule& target = (BaseMolecule&)supergraph;
 
-    if (!target.isPseudoAtom(super_idx) && !target.isRSite(super_idx) && !target.isTemplateAtom(super_idx))
+    if (self->_atom_pairs.size() > 0 && &subgraph == (Graph*)self->_query)
     {
-        int q_min_h;
-        int t_max_h;
-        try
-        {
-            q_min_h = query.getAtomMinH(sub_idx);
-        }
-        catch (Exception e)
-        {
-            q_min_h = 0;
-        }
-        try
-        {
-            t_max_h = target.getAtomMaxH(super_idx);
-        }
-        catch (Exception e)
-        {
-            t_max_h = 0;
-        }
-        if (q_min_h > 0 && t_max_h >= 0)
-            if (q_min_h > t_max_h)
-                return false;
+        if (!self->_atom_pairs[sub_idx * self->_atom_pairs_stride + super_idx])
+            return false;
     }
+    else if (!self->_matchAtomFeatures(query, sub_idx, super_idx))
+        return false;
 
     if (query.components.size() > sub_idx && query.components[sub_idx] > 0)
     {
@@ -647,22 +926,6 @@ bool MoleculeSubstructureMatcher::_matchAtoms(Graph& subgraph, Graph& supergraph
         }
     }
 
-    QueryMolecule::Atom& sub_atom = query.getAtom(sub_idx);
-
-    if (!matchQueryAtom(&sub_atom, target, super_idx, self->fmcache, match_atoms_flags))
-        return false;
-
-    if (query.stereocenters.getType(sub_idx) > target.stereocenters.getType(super_idx))
-        return false;
-
-    if (self->_query_nei_counters != 0 && self->_target_nei_counters != 0)
-    {
-        bool use_bond_types = (self->_pi_systems_matcher.get() == 0);
-        bool ret = self->_query_nei_counters->testSubstructure(*self->_target_nei_counters, sub_idx, super_idx, use_bond_types);
-        if (!ret)
-            return false;
-    }
-
     if (self->match_3d == AFFINE)
     {
         QS_DEF(Array<int>, core_sub_full);
@@ -689,6 +952,110 @@ bool MoleculeSubstructureMatcher::_matchAtoms(Graph& subgraph, Graph& supergraph
     return true;
 }
 
+bool MoleculeSubstructureMatcher::_matchAtomFeatures(QueryMolecule& query, int sub_idx, int super_idx)
+{
+    bool compiled = _compiled != nullptr && &query == _compiled->_query;
+
+    if (_h_unfold && &query == _query)
+    {
+        if (sub_idx < _3d_constrained_atoms.size() && _3d_constrained_atoms[sub_idx])
+            // we can't check 3D constraint on unfolded atom, because it has no actual position
+            if (_unfolded_target_h[super_idx])
+                return false;
+    }
+
+    dword match_atoms_flags = 0xFFFFFFFF;
+    // If target atom belongs to a pi-system then its charge
+    // should be checked after embedding
+    if (_pi_systems_matcher.get())
+    {
+        if (_pi_systems_matcher->isAtomInPiSystem(super_idx))
+            match_atoms_flags &= ~(MATCH_ATOM_CHARGE | MATCH_ATOM_VALENCE);
+    }
+
+    if (!_target.isPseudoAtom(super_idx) && !_target.isRSite(super_idx) && !_target.isTemplateAtom(super_idx))
+    {
+        int q_min_h;
+        int t_max_h;
+        if (compiled)
+            q_min_h = _compiled->_atom_min_h[sub_idx];
+        else
+        {
+            try
+            {
+                q_min_h = query.getAtomMinH(sub_idx);
+            }
+            catch (Exception e)
+            {
+                q_min_h = 0;
+            }
+        }
+        if (q_min_h > 0)
+        {
+            try
+            {
+                t_max_h = _target.getAtomMaxH(super_idx);
+            }
+            catch (Exception e)
+            {
+                t_max_h = 0;
+            }
+            if (t_max_h >= 0 && q_min_h > t_max_h)
+                return false;
+        }
+    }
+
+    if (compiled)
+    {
+        if (!_compiled->_matchAtomCode(_compiled->_atom_code_start[sub_idx], _target, super_idx, fmcache, match_atoms_flags))
+            return false;
+    }
+    else if (!matchQueryAtom(&query.getAtom(sub_idx), _target, super_idx, fmcache, match_atoms_flags))
+        return false;
+
+    if (query.stereocenters.getType(sub_idx) > _target.stereocenters.getType(super_idx))
+        return false;
+
+    if (_query_nei_counters != 0 && _target_nei_counters != 0)
+    {
+        bool use_bond_types = (_pi_systems_matcher.get() == 0);
+        if (!_query_nei_counters->testSubstructure(*_target_nei_counters, sub_idx, super_idx, use_bond_types))
+            return false;
+    }
+
+    return true;
+}
+
+void MoleculeSubstructureMatcher::_buildAtomPairs()
+{
+    _atom_pairs.clear();
+
+    if (!precompute_atom_pairs || _compiled == nullptr || _query != _compiled->_query)
+        return;
+
+    const Array<int>& ignored = _compiled->_ignored_atoms;
+    QS_DEF(Array<int>, is_ignored);
+
+    is_ignored.clear_resize(_query->vertexEnd());
+    is_ignored.zerofill();
+    for (int i = 0; i < ignored.size(); i++)
+        is_ignored[ignored[i]] = 1;
+
+    _atom_pairs_stride = _target.vertexEnd();
+    _atom_pairs.clear_resize(_query->vertexEnd() * _atom_pairs_stride);
+    _atom_pairs.zerofill();
+
+    for (int i = _query->vertexBegin(); i != _query->vertexEnd(); i = _query->vertexNext(i))
+    {
+        if (is_ignored[i])
+            continue;
+
+        byte* row = _atom_pairs.ptr() + i * _atom_pairs_stride;
+        for (int j = _target.vertexBegin(); j != _target.vertexEnd(); j = _target.vertexNext(j))
+            row[j] = _matchAtomFeatures(*_query, i, j) ? 1 : 0;
+    }
+}
+
 bool MoleculeSubstructureMatcher::_matchBonds(Graph& subgraph, Graph& supergraph, int sub_idx, int super_idx, void* userdata)
 {
     MoleculeSubstructureMatcher* self = (MoleculeSubstructureMatcher*)userdata;
@@ -595,10 +595,16 @@ void MolfileSaver::_writeCtab(Output& output, BaseMolecule& mol, bool query)
          */
         convert_xyz_to_string(xyz, coords);
 
-        out.printf(" %s %d", coords.str().c_str(), aam);
+        out.writeChar(' ');
+        out.writeString(coords.str().c_str());
+        out.writeChar(' ');
+        out.writeInt(aam);
 
         if ((mol.isQueryMolecule() && charge != CHARGE_UNKNOWN) || (!mol.isQueryMolecule() && charge != 0))
-            out.printf(" CHG=%d", charge);
+        {
+            out.writeString(" CHG=");
+            out.writeInt(charge);
+        }
 
         if (qmol != 0)
         {
@@ -753,7 +759,13 @@ void MolfileSaver::_writeCtab(Output& output, BaseMolecule& mol, bool query)
                 bond_order = _BOND_HYDROGEN;
         }
 
-        out.printf("%d %d %d %d", iw, bond_order, _atom_mapping[edge.beg], _atom_mapping[edge.end]);
+        out.writeInt(iw);
+        out.writeChar(' ');
+        out.writeInt(bond_order);
+        out.writeChar(' ');
+        out.writeInt(_atom_mapping[edge.beg]);
+        out.writeChar(' ');
+        out.writeInt(_atom_mapping[edge.end]);
 
         int direction = mol.getBondDirection(i);
 
@@ -1464,11 +1476,16 @@ void MolfileSaver::_writeCtab2000(Output& output, BaseMolecule& mol, bool query)
         if (fabs(pos.z) < 1e-5f)
             pos.z = 0;
 
-        output.printfCR("%10.4f%10.4f%10.4f %c%c%c%2d"
-                        "%3d%3d%3d%3d%3d"
-                        "%3d%3d%3d%3d%3d%3d",
-                        pos.x, pos.y, pos.z, label[0], label[1], label[2], 0, 0, stereo_parity, hydrogens_count, stereo_care, valence, 0, 0, 0, aam, irflag,
-                        ecflag);
+        // "%10.4f%10.4f%10.4f %c%c%c%2d%3d%3d%3d%3d%3d%3d%3d%3d%3d%3d%3d"
+        output.writeFixed(pos.x, 4, 10);
+        output.writeFixed(pos.y, 4, 10);
+        output.writeFixed(pos.z, 4, 10);
+        output.writeChar(' ');
+        output.write(label, 3);
+        output.writeInt(0, 2);
+        for (int value : {0, stereo_parity, hydrogens_count, stereo_care, valence, 0, 0, 0, aam, irflag, ecflag})
+            output.writeInt(value, 3);
+        output.writeCR();
     }
 
     iw = 1;
@@ -1535,7 +1552,9 @@ void MolfileSaver::_writeCtab2000(Output& output, BaseMolecule& mol, bool query)
 
         reacting_center = mol.reaction_bond_reacting_center[i];
 
-        output.printfCR("%3d%3d%3d%3d%3d%3d%3d", _atom_mapping[edge.beg], _atom_mapping[edge.end], bond_order, stereo, 0, topology, reacting_center);
+        for (int value : {_atom_mapping[edge.beg], _atom_mapping[edge.end], bond_order, stereo, 0, topology, reacting_center})
+            output.writeInt(value, 3);
+        output.writeCR();
         _bond_mapping[i] = iw++;
     }
 
@@ -1546,7 +1565,12 @@ void MolfileSaver::_writeCtab2000(Output& output, BaseMolecule& mol, bool query)
         {
             output.printf("M  CHG%3d", std::min(charges.size(), j + 8) - j);
             for (i = j; i < std::min(charges.size(), j + 8); i++)
-                output.printf(" %3d %3d", _atom_mapping[charges[i]], mol.getAtomCharge(charges[i]));
+            {
+                output.writeChar(' ');
+                output.writeInt(_atom_mapping[charges[i]], 3);
+                output.writeChar(' ');
+                output.writeInt(mol.getAtomCharge(charges[i]), 3);
+            }
             output.writeCR();
             j += 8;
         }
@@ -1559,7 +1583,12 @@ void MolfileSaver::_writeCtab2000(Output& output, BaseMolecule& mol, bool query)
         {
             output.printf("M  RAD%3d", std::min(radicals.size(), j + 8) - j);
             for (i = j; i < std::min(radicals.size(), j + 8); i++)
-                output.printf(" %3d %3d", _atom_mapping[radicals[i][0]], radicals[i][1]);
+            {
+                output.writeChar(' ');
+                output.writeInt(_atom_mapping[radicals[i][0]], 3);
+                output.writeChar(' ');
+                output.writeInt(radicals[i][1], 3);
+            }
             output.writeCR();
             j += 8;
         }
@@ -1572,7 +1601,12 @@ void MolfileSaver::_writeCtab2000(Output& output, BaseMolecule& mol, bool query)
         {
             output.printf("M  ISO%3d", std::min(isotopes.size(), j + 8) - j);
             for (i = j; i < std::min(isotopes.size(), j + 8); i++)
-                output.printf(" %3d %3d", _atom_mapping[isotopes[i]], mol.getAtomIsotope(isotopes[i]));
+            {
+                output.writeChar(' ');
+                output.writeInt(_atom_mapping[isotopes[i]], 3);
+                output.writeChar(' ');
+                output.writeInt(mol.getAtomIsotope(isotopes[i]), 3);
+            }
             output.writeCR();
             j += 8;
         }
@@ -0,0 +1,448 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include "molecule/record_file_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <zlib.h>
+
+#include "base_cpp/file_mapping.h"
+#include "base_cpp/profiling.h"
+#include "base_cpp/properties_map.h"
+#include "base_cpp/tlscont.h"
+
+using namespace indigo;
+
+IMPL_ERROR(RecordFileReader, "record file reader");
+
+// Compressed data read from the file at a time
+static const size_t INPUT_BLOCK_SIZE = 1024 * 1024;
+
+RecordFileReader::RecordFileReader(Encoding filename_encoding, const char* filename, Format format)
+    : _format(format), _filename_encoding(filename_encoding), _filename(filename), _file(nullptr), _file_eof(false), _pos(nullptr), _end(nullptr),
+      _offset(0), _index(0)
+{
+    _file = openFile(filename_encoding, filename, "rb");
+
+    if (_file == nullptr)
+        throw Error("can't open file %s. Error: %s", filename, strerror(errno));
+
+    unsigned char id[2] = {0, 0};
+    size_t id_size = fread(id, 1, 2, _file);
+    bool compressed = id_size == 2 && id[0] == 0x1f && id[1] == 0x8b;
+
+    if (!compressed)
+    {
+        try
+        {
+            _mapping = std::make_unique<FileMapping>(filename_encoding, filename);
+        }
+        catch (Exception&)
+        {
+            // Pipes and other special files are read by blocks
+        }
+    }
+
+    if (_mapping != nullptr)
+    {
+        fclose(_file);
+        _file = nullptr;
+        _pos = _mapping->data();
+        _end = _pos + _mapping->size();
+        return;
+    }
+
+    rewind(_file);
+
+    if (compressed)
+    {
+        _zstream = std::make_unique<z_stream_s>();
+        memset(_zstream.get(), 0, sizeof(z_stream_s));
+
+        if (inflateInit2(_zstream.get(), 16 + MAX_WBITS) != Z_OK)
+        {
+            fclose(_file);
+            throw Error("can't initialize zlib");
+        }
+        _inbuf.resize(INPUT_BLOCK_SIZE);
+    }
+}
+
+RecordFileReader::~RecordFileReader()
+{
+    if (_zstream != nullptr)
+        inflateEnd(_zstream.get());
+    if (_file != nullptr)
+        fclose(_file);
+}
+
+bool RecordFileReader::isMapped() const
+{
+    return _mapping != nullptr;
+}
+
+long long RecordFileReader::tell() const
+{
+    return _offset;
+}
+
+bool RecordFileReader::next(Record& record)
+{
+    while (true)
+    {
+        const bool last = _mapping != nullptr || _file_eof;
+        const char* next_pos;
+
+        if (_findRecord(_pos, _end, last, record, next_pos))
+        {
+            record.offset = _offset;
+            record.index = _index++;
+            _offset += next_pos - _pos;
+            _pos = next_pos;
+            record.next_offset = _offset;
+            return true;
+        }
+
+        if (last)
+            return false;
+
+        _readBlock();
+    }
+}
+
+void RecordFileReader::forEach(int thread_count, const std::function<void(const Record& record)>& handler, size_t range_size)
+{
+    profTimerStart(t, "record_file_reader.for_each");
+
+    if (thread_count <= 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    const qword session_id = TL_GET_SESSION_ID();
+    std::vector<_Range> ranges;
+
+    while (true)
+    {
+        ranges.clear();
+        _splitRanges(ranges, range_size);
+
+        if (ranges.empty())
+        {
+            if (_mapping != nullptr || _file_eof)
+                break;
+            _readBlock();
+            continue;
+        }
+
+        std::atomic<size_t> next_range(0);
+        std::atomic_bool failed(false);
+        std::exception_ptr error;
+        std::mutex error_lock;
+
+        auto read_ranges = [&]() {
+            try
+            {
+                size_t r;
+                while (!failed && (r = next_range++) < ranges.size())
+                {
+                    const _Range& range = ranges[r];
+                    const char* pos = range.begin;
+                    const char* next_pos;
+                    long long index = range.index;
+                    Record record;
+
+                    while (!failed && _findRecord(pos, range.end, true, record, next_pos))
+                    {
+                        record.offset = range.offset + (pos - range.begin);
+                        record.index = index++;
+                        record.next_offset = range.offset + (next_pos - range.begin);
+                        handler(record);
+                        pos = next_pos;
+                    }
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(error_lock);
+                if (!error)
+                    error = std::current_exception();
+                failed = true;
+            }
+        };
+
+        int range_threads = std::min(thread_count, (int)ranges.size());
+        if (range_threads <= 1)
+            read_ranges();
+        else
+        {
+            std::vector<std::thread> threads;
+            for (int i = 0; i < range_threads; i++)
+                threads.emplace_back([&]() {
+                    TL_SET_SESSION_ID(session_id);
+                    read_ranges();
+                });
+            for (auto& thread : threads)
+                thread.join();
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+long long RecordFileReader::count()
+{
+    // The records already read stay available, so the file is counted by another reader
+    RecordFileReader reader(_filename_encoding, _filename.c_str(), _format);
+    Record record;
+    long long count = 0;
+
+    while (reader.next(record))
+        count++;
+
+    return count;
+}
+
+bool RecordFileReader::_findRecord(const char* pos, const char* end, bool last, Record& record, const char*& next) const
+{
+    if (pos >= end)
+        return false;
+
+    const char* record_end = nullptr;
+
+    if (_format == Format::LINES)
+    {
+        const char* eol = (const char*)memchr(pos, '\n', end - pos);
+        if (eol != nullptr)
+        {
+            record_end = eol;
+            next = eol + 1;
+        }
+    }
+    else
+    {
+        // Dollar signs are rare in SDF, so the terminators are found by
+        // memchr jumps rather than by looking at the start of every line
+        const char* p = pos;
+        while (p < end)
+        {
+            p = (const char*)memchr(p, '$', end - p);
+            if (p == nullptr)
+                break;
+
+            if (p == pos || p[-1] == '\n')
+            {
+                if (end - p < 4)
+                    break;
+
+                if (memcmp(p, "$$$$", 4) == 0)
+                {
+                    const char* eol = (const char*)memchr(p, '\n', end - p);
+                    if (eol == nullptr && !last)
+                        break;
+                    record_end = p;
+                    next = eol != nullptr ? eol + 1 : end;
+                    break;
+                }
+            }
+            p++;
+        }
+    }
+
+    if (record_end == nullptr)
+    {
+        if (!last)
+        {
+            if (end - pos > MAX_RECORD_SIZE)
+                throw Error("record size exceeded the acceptable size %d bytes, please check for correct file format", MAX_RECORD_SIZE);
+            return false;
+        }
+
+        record_end = end;
+        next = end;
+
+        // Spaces after the last SDF record are not a record
+        if (_format == Format::SDF)
+        {
+            const char* p = pos;
+            while (p < end && isspace((unsigned char)*p))
+                p++;
+            if (p == end)
+                return false;
+        }
+    }
+
+    if (_format == Format::LINES && record_end > pos && record_end[-1] == '\r')
+        record_end--;
+
+    if (record_end - pos > MAX_RECORD_SIZE)
+        throw Error("record size exceeded the acceptable size %d bytes, please check for correct file format", MAX_RECORD_SIZE);
+
+    record.data = pos;
+    record.size = record_end - pos;
+    return true;
+}
+
+bool RecordFileReader::_readBlock()
+{
+    profTimerStart(t, "record_file_reader.read_block");
+
+    size_t unread = _end - _pos;
+    if (unread > 0 && _pos != _buffer.data())
+        memmove(_buffer.data(), _pos, unread);
+
+    _buffer.resize(unread + BLOCK_SIZE);
+    size_t size = _readData(_buffer.data() + unread, BLOCK_SIZE);
+    _buffer.resize(unread + size);
+
+    _pos = _buffer.data();
+    _end = _pos + _buffer.size();
+    return size > 0;
+}
+
+size_t RecordFileReader::_readData(char* buf, size_t size)
+{
+    if (_file_eof)
+        return 0;
+
+    if (_zstream == nullptr)
+    {
+        size_t read = fread(buf, 1, size, _file);
+        if (read < size)
+            _file_eof = true;
+        return read;
+    }
+
+    z_stream_s& zstream = *_zstream;
+    zstream.next_out = (Bytef*)buf;
+    zstream.avail_out = (uInt)size;
+
+    while (zstream.avail_out > 0)
+    {
+        if (zstream.avail_in == 0)
+        {
+            zstream.avail_in = (uInt)fread(_inbuf.data(), 1, _inbuf.size(), _file);
+            zstream.next_in = (Bytef*)_inbuf.data();
+            if (zstream.avail_in == 0)
+            {
+                _file_eof = true;
+                break;
+            }
+        }
+
+        int rc = inflate(&zstream, Z_NO_FLUSH);
+
+        if (rc == Z_STREAM_END)
+        {
+            // Concatenated gzip members make one file
+            inflateReset(&zstream);
+            continue;
+        }
+        if (rc != Z_OK && rc != Z_BUF_ERROR)
+            throw Error("corrupted compressed data, zlib error code: %d", rc);
+    }
+
+    return size - zstream.avail_out;
+}
+
+void RecordFileReader::_splitRanges(std::vector<_Range>& ranges, size_t range_size)
+{
+    profTimerStart(t, "record_file_reader.split");
+
+    const bool last = _mapping != nullptr || _file_eof;
+    const char* pos = _pos;
+    const char* next_pos;
+    Record record;
+
+    _Range range = {pos, pos, _offset, _index};
+    while (_findRecord(pos, _end, last, record, next_pos))
+    {
+        pos = next_pos;
+        _index++;
+        range.end = pos;
+
+        if ((size_t)(range.end - range.begin) >= range_size)
+        {
+            ranges.push_back(range);
+            range = {pos, pos, _offset + (pos - _pos), _index};
+        }
+    }
+    if (range.end > range.begin)
+        ranges.push_back(range);
+
+    _offset += pos - _pos;
+    _pos = pos;
+}
+
+void RecordFileReader::readSdfProperties(const Record& record, PropertiesMap& properties)
+{
+    properties.clear();
+
+    const char* pos = record.data;
+    const char* end = record.data + record.size;
+
+    auto read_line = [&](std::string& line) {
+        if (pos >= end)
+            return false;
+        const char* eol = (const char*)memchr(pos, '\n', end - pos);
+        const char* line_end = eol != nullptr ? eol : end;
+        line.assign(pos, line_end);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        pos = eol != nullptr ? eol + 1 : end;
+        return true;
+    };
+
+    // The data items start with the first line beginning with '>'
+    std::string line;
+    bool found = false;
+    while (!found && read_line(line))
+        found = !line.empty() && line[0] == '>';
+
+    while (found)
+    {
+        size_t name_begin = line.find('<');
+        size_t name_end = name_begin != std::string::npos ? line.find('>', name_begin + 1) : std::string::npos;
+
+        if (name_end != std::string::npos && name_end > name_begin + 1)
+        {
+            std::string value, value_line;
+            read_line(value);
+
+            // Value lines go up to an empty line
+            if (!value.empty())
+            {
+                while (read_line(value_line) && !value_line.empty())
+                {
+                    value += '\n';
+                    value += value_line;
+                }
+            }
+            properties.insert(line.substr(name_begin + 1, name_end - name_begin - 1).c_str(), value);
+        }
+
+        found = read_line(line);
+    }
+}
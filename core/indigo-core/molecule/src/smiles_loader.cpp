@@ -22,6 +22,7 @@
 #include <unordered_set>
 
 #include "base_cpp/scanner.h"
+#include "base_cpp/scratch_arena.h"
 #include "graph/cycle_basis.h"
 #include "molecule/elements.h"
 #include "molecule/molecule.h"
@@ -412,6 +413,8 @@ void SmilesLoader::_setRadicalsAndHCounts()
 
 void SmilesLoader::_loadMolecule()
 {
+    ScratchScope scratch;
+
     _atoms.clear();
     _bonds.clear();
     _polymer_repetitions.clear();
@@ -754,9 +754,12 @@ bool SmilesSaver::_shouldWriteAromaticBond(int e_idx)
 void SmilesSaver::_writeCycleNumber(int n) const
 {
     if (n > 0 && n < 10)
-        _output.printf("%d", n);
+        _output.writeInt(n);
     else if (n >= 10 && n < 100)
-        _output.printf("%%%2d", n);
+    {
+        _output.writeChar('%');
+        _output.writeInt(n);
+    }
     else
         throw Error("bad cycle number: %d", n);
 }
@@ -924,17 +927,17 @@ void SmilesSaver::_writeAtom(int idx, bool /*aromatic*/, bool lowercase, int chi
     }
 
     if (isotope > 0)
-        _output.printf("%d", isotope);
+        _output.writeInt(isotope);
 
     const char* elem = Element::toString(atom_number);
 
     if (lowercase)
     {
         for (i = 0; i < (int)strlen(elem); i++)
-            _output.printf("%c", tolower(elem[i]));
+            _output.writeChar(tolower(elem[i]));
     }
     else
-        _output.printf("%s", elem);
+        _output.writeString(elem);
 
     if (!need_brackets)
         return;
@@ -943,14 +946,20 @@ void SmilesSaver::_writeAtom(int idx, bool /*aromatic*/, bool lowercase, int chi
         _writeChirality(chirality);
 
     if (hydro > 1)
-        _output.printf("H%d", hydro);
+    {
+        _output.writeChar('H');
+        _output.writeInt(hydro);
+    }
     else if (hydro == 1)
-        _output.printf("H");
+        _output.writeChar('H');
 
     _writeCharge(charge);
 
     if (aam > 0)
-        _output.printf(":%d", aam);
+    {
+        _output.writeChar(':');
+        _output.writeInt(aam);
+    }
 
     if (need_brackets)
         _output.writeChar(']');
@@ -961,22 +970,28 @@ void SmilesSaver::_writeChirality(int chirality) const
     if (chirality > 0)
     {
         if (chirality == 1)
-            _output.printf("@");
+            _output.writeChar('@');
         else // chirality == 2
-            _output.printf("@@");
+            _output.writeString("@@");
     }
 }
 
 void SmilesSaver::_writeCharge(int charge) const
 {
     if (charge > 1)
-        _output.printf("+%d", charge);
+    {
+        _output.writeChar('+');
+        _output.writeInt(charge);
+    }
     else if (charge < -1)
-        _output.printf("-%d", -charge);
+    {
+        _output.writeChar('-');
+        _output.writeInt(-charge);
+    }
     else if (charge == 1)
-        _output.printf("+");
+        _output.writeChar('+');
     else if (charge == -1)
-        _output.printf("-");
+        _output.writeChar('-');
 }
 
 void SmilesSaver::_banSlashes()
@@ -1806,7 +1821,10 @@ void SmilesSaver::_writeWedges()
                     _output.writeString(";");
                 auto atom_idx = _written_atoms[i];
                 const auto& pos = _mol->getAtomXyz(atom_idx);
-                _output.printf("%.2f,%.2f,", pos.x, pos.y);
+                _output.writeFixed(pos.x, 2);
+                _output.writeChar(',');
+                _output.writeFixed(pos.y, 2);
+                _output.writeChar(',');
             }
             _output.writeString(")");
         }
@@ -0,0 +1,112 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <base_c/bitarray.h>
+
+#include "common.h"
+
+using namespace indigo;
+
+// Switches the popcount kernel, defined in bitarray.c for the tests only
+extern "C" int bitSetPopcountKernel(const char* name);
+
+class IndigoCoreBitArrayTest : public IndigoCoreTest
+{
+};
+
+namespace
+{
+    int naiveCount(const std::vector<byte>& a, const std::vector<byte>& b, int offset, int n_bytes, int op)
+    {
+        int count = 0;
+        for (int i = 0; i < n_bytes * 8; i++)
+        {
+            int x = bitGetBit(a.data(), i);
+            int y = bitGetBit(b.data() + offset, i);
+            switch (op)
+            {
+            case 0:
+                count += x;
+                break;
+            case 1:
+                count += x & y;
+                break;
+            case 2:
+                count += x & !y;
+                break;
+            case 3:
+                count += x ^ y;
+                break;
+            default:
+                count += x | y;
+            }
+        }
+        return count;
+    }
+}
+
+TEST_F(IndigoCoreBitArrayTest, popcount_kernels)
+{
+    const std::string default_kernel = bitGetPopcountKernel();
+    const int fp_count = 7;
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    for (const char* kernel : {"generic", "popcnt", "avx2", "avx512", "neon"})
+    {
+        if (!bitSetPopcountKernel(kernel))
+            continue;
+        ASSERT_EQ(std::string(kernel), bitGetPopcountKernel());
+
+        for (int n_bytes : {0, 1, 7, 8, 9, 31, 33, 63, 64, 65, 100, 333})
+        {
+            std::vector<byte> query(n_bytes), fps(n_bytes * fp_count);
+            for (auto& b : query)
+                b = (byte)dist(rng);
+            for (auto& b : fps)
+                b = (byte)dist(rng);
+
+            std::vector<int> ones(fp_count), common(fp_count);
+            bitGetOnesCountBatch(fps.data(), n_bytes, fp_count, ones.data());
+            bitCommonOnesBatch(query.data(), fps.data(), n_bytes, fp_count, common.data());
+
+            for (int i = 0; i < fp_count; i++)
+            {
+                const byte* fp = fps.data() + i * n_bytes;
+                std::vector<byte> fp_copy(fp, fp + n_bytes);
+                EXPECT_EQ(naiveCount(fp_copy, fp_copy, 0, n_bytes, 0), bitGetOnesCount(fp, n_bytes)) << kernel << " " << n_bytes;
+                EXPECT_EQ(naiveCount(query, fps, i * n_bytes, n_bytes, 1), bitCommonOnes(query.data(), fp, n_bytes)) << kernel << " " << n_bytes;
+                EXPECT_EQ(naiveCount(query, fps, i * n_bytes, n_bytes, 2), bitUniqueOnes(query.data(), fp, n_bytes)) << kernel << " " << n_bytes;
+                EXPECT_EQ(naiveCount(query, fps, i * n_bytes, n_bytes, 3), bitDifferentOnes(query.data(), fp, n_bytes)) << kernel << " " << n_bytes;
+                EXPECT_EQ(naiveCount(query, fps, i * n_bytes, n_bytes, 4), bitUnionOnes(query.data(), fp, n_bytes)) << kernel << " " << n_bytes;
+                EXPECT_EQ(bitGetOnesCount(fp, n_bytes), ones[i]) << kernel << " " << n_bytes;
+                EXPECT_EQ(bitCommonOnes(query.data(), fp, n_bytes), common[i]) << kernel << " " << n_bytes;
+            }
+        }
+    }
+
+    EXPECT_FALSE(bitSetPopcountKernel("unknown"));
+    bitSetPopcountKernel(default_kernel.c_str());
+}
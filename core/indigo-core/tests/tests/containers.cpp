@@ -16,14 +16,19 @@
  * limitations under the License.
  ***************************************************************************/
 
+#include <iostream>
+#include <string>
+
 #include <gtest/gtest.h>
 
 #include <base_cpp/output.h>
 #include <base_cpp/scanner.h>
+#include <base_cpp/scratch_arena.h>
 #include <molecule/cmf_loader.h>
 #include <molecule/cmf_saver.h>
 #include <molecule/cml_saver.h>
 #include <molecule/molecule_cdxml_saver.h>
+#include <molecule/molecule_fingerprint.h>
 #include <molecule/molecule_mass.h>
 #include <molecule/molecule_substructure_matcher.h>
 #include <molecule/molfile_loader.h>
@@ -33,8 +38,36 @@
 
 #include "common.h"
 
+#if defined(__SANITIZE_ADDRESS__)
+#define INDIGO_TEST_ALLOCATION_HOOKS
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define INDIGO_TEST_ALLOCATION_HOOKS
+#endif
+#endif
+
+#ifdef INDIGO_TEST_ALLOCATION_HOOKS
+#include <atomic>
+
+// From <sanitizer/allocator_interface.h>, which not every toolchain ships
+extern "C" int __sanitizer_install_malloc_and_free_hooks(void (*malloc_hook)(const volatile void*, size_t), void (*free_hook)(const volatile void*));
+#endif
+
 using namespace indigo;
 
+#ifdef INDIGO_TEST_ALLOCATION_HOOKS
+static std::atomic<qword> _allocations_count{0};
+
+static void _countAllocation(const volatile void* /* ptr */, size_t /* size */)
+{
+    _allocations_count++;
+}
+
+static void _ignoreRelease(const volatile void* /* ptr */)
+{
+}
+#endif
+
 class IndigoCoreContainersTest : public IndigoCoreTest
 {
 };
@@ -85,6 +118,145 @@ TEST_F(IndigoCoreContainersTest, test_array)
     ASSERT_EQ(array.size(), 0);
 }
 
+TEST_F(IndigoCoreContainersTest, test_qsdef_scratch_arena)
+{
+    Array<int> heap;
+    heap.push(-1);
+
+    {
+        QS_DEF(Array<int>, outside);
+        outside.push(1);
+        ASSERT_EQ(ScratchArena::current(), nullptr);
+    }
+
+    ScratchArena::Statistics before = ScratchArena::statistics();
+    {
+        ScratchScope scratch;
+        ASSERT_NE(ScratchArena::current(), nullptr);
+
+        QS_DEF(Array<int>, xs);
+        QS_DEF(Array<int>, ys);
+        for (int i = 0; i < 10000; i++)
+        {
+            xs.push(i);
+            ys.push(-i);
+        }
+        for (int i = 0; i < 10000; i++)
+            ASSERT_EQ(xs[i] + ys[i], 0);
+
+        {
+            ScratchScope nested;
+            QS_DEF(Array<int>, zs);
+            zs.copy(xs);
+            ASSERT_EQ(zs[9999], 9999);
+        }
+        // Rewinding happens only at the end of the outermost scope
+        ASSERT_NE(ScratchArena::current(), nullptr);
+        ASSERT_EQ(xs[9999], 9999);
+
+        // Storage is copied when it would move between the heap and the arena
+        heap.swap(xs);
+        ASSERT_EQ(heap.size(), 10000);
+        ASSERT_EQ(xs.size(), 1);
+        ASSERT_EQ(xs[0], -1);
+
+        Array<int> moved(std::move(ys));
+        ASSERT_EQ(moved.size(), 10000);
+        ASSERT_EQ(moved[9999], -9999);
+    }
+    ASSERT_EQ(ScratchArena::current(), nullptr);
+    ASSERT_GT(ScratchArena::statistics().blocks, before.blocks);
+    ASSERT_EQ(heap[9999], 9999);
+}
+
+namespace
+{
+    const char* _arena_test_smiles[] = {"CC(=O)Oc1ccccc1C(=O)O", "CN1C=NC2=C1C(=O)N(C(=O)N2C)C", "CC(C)Cc1ccc(cc1)C(C)C(=O)O",
+                                        "OC[C@H]1OC(O)[C@H](O)[C@@H](O)[C@@H]1O", "c1ccc2c(c1)ccc1ccccc12", "CN1CCC[C@H]1c1cccnc1",
+                                        "CC(C)NCC(O)COc1cccc2ccccc12", "O=C(O)c1ccccc1O"};
+    const int _arena_test_molecules = sizeof(_arena_test_smiles) / sizeof(_arena_test_smiles[0]);
+
+    // Loads, aromatizes and fingerprints every molecule of the set with the bingo-nosql parameters
+    void _fingerprintArenaTestMolecules()
+    {
+        MoleculeFingerprintParameters parameters;
+        parameters.ext = true;
+        parameters.similarity_type = SimilarityType::SIM;
+        parameters.ord_qwords = 25;
+        parameters.any_qwords = 15;
+        parameters.tau_qwords = 10;
+        parameters.sim_qwords = 8;
+
+        for (auto smiles_str : _arena_test_smiles)
+        {
+            Molecule mol;
+            BufferScanner scanner(smiles_str);
+            SmilesLoader loader(scanner);
+            loader.loadMolecule(mol);
+            mol.aromatize(AromaticityOptions());
+
+            MoleculeFingerprintBuilder builder(mol, parameters);
+            builder.process();
+        }
+    }
+}
+
+// Every arena block is a malloc or realloc call that the heap does not see, so
+// the counters of the arena give the saving in any build. A molecule of the set
+// takes about 490 blocks, see the allocation counts below
+TEST_F(IndigoCoreContainersTest, test_scratch_arena_blocks_per_molecule)
+{
+    // The first pass grows the arena chunks and the thread-local pools
+    _fingerprintArenaTestMolecules();
+
+    ScratchArena::Statistics before = ScratchArena::statistics();
+    _fingerprintArenaTestMolecules();
+    ScratchArena::Statistics after = ScratchArena::statistics();
+
+    qword blocks_per_molecule = (after.blocks - before.blocks) / _arena_test_molecules;
+    RecordProperty("arena_blocks_per_molecule", std::to_string(blocks_per_molecule));
+    std::cout << "Scratch arena blocks per molecule: " << blocks_per_molecule << std::endl;
+
+    // Warm chunks serve the whole pass without going to the heap
+    ASSERT_EQ(after.chunks, before.chunks);
+    ASSERT_GT(blocks_per_molecule, 100);
+}
+
+// Counts the heap allocations of loading and fingerprinting with the scratch
+// arena off and on. The allocator hooks come with the address sanitizer. At the
+// time of writing a molecule took 2768 allocations without the arena and 2268
+// with it
+TEST_F(IndigoCoreContainersTest, test_scratch_arena_allocations)
+{
+#ifdef INDIGO_TEST_ALLOCATION_HOOKS
+    static const bool hooks_installed = __sanitizer_install_malloc_and_free_hooks(_countAllocation, _ignoreRelease) != 0;
+    ASSERT_TRUE(hooks_installed);
+
+    auto count_allocations = [&]() {
+        qword before = _allocations_count;
+        _fingerprintArenaTestMolecules();
+        return _allocations_count - before;
+    };
+
+    // The first pass grows the arena chunks and the thread-local pools
+    count_allocations();
+
+    ScratchArena::setEnabled(false);
+    qword without_arena = count_allocations() / _arena_test_molecules;
+    ScratchArena::setEnabled(true);
+    qword with_arena = count_allocations() / _arena_test_molecules;
+
+    RecordProperty("allocations_per_molecule_without_arena", std::to_string(without_arena));
+    RecordProperty("allocations_per_molecule_with_arena", std::to_string(with_arena));
+    std::cout << "Heap allocations per molecule: " << without_arena << " without the scratch arena, " << with_arena << " with it" << std::endl;
+
+    ASSERT_GT(without_arena, 0);
+    ASSERT_LT(with_arena, without_arena);
+#else
+    GTEST_SKIP() << "allocator hooks are not available";
+#endif
+}
+
 TEST_F(IndigoCoreContainersTest, test_red_black_map)
 {
     RedBlackMap<int, int> map;
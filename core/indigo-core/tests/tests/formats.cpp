@@ -20,6 +20,8 @@
 #pragma warning(push)
 #endif
 
+#include <climits>
+
 #include <gtest/gtest.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
@@ -31,6 +33,7 @@
 #include "molecule/sequence_loader.h"
 #include "molecule/sequence_saver.h"
 #include <base_cpp/output.h>
+#include <base_cpp/properties_map.h>
 #include <base_cpp/scanner.h>
 #include <molecule/cmf_loader.h>
 #include <molecule/cmf_saver.h>
@@ -44,6 +47,7 @@
 #include <molecule/molfile_saver.h>
 #include <molecule/monomer_commons.h>
 #include <molecule/query_molecule.h>
+#include <molecule/record_file_reader.h>
 #include <molecule/sdf_loader.h>
 #include <molecule/smiles_loader.h>
 #include <molecule/smiles_saver.h>
@@ -52,6 +56,7 @@
 #include "common.h"
 
 #include <algorithm>
+#include <mutex>
 
 using namespace indigo;
 
@@ -101,6 +106,120 @@ TEST_F(IndigoCoreFormatsTest, load_targets_cmf)
     }
 }
 
+TEST_F(IndigoCoreFormatsTest, record_file_reader)
+{
+    // Mapped and compressed files give the same records and data items as SdfLoader does
+    for (const char* name : {"molecules/basic/thiazolidines.sdf", "molecules/basic/Compound_0000001_0000250.sdf.gz"})
+    {
+        const std::string path = dataPath(name);
+        FileScanner sc(path.c_str());
+        SdfLoader sdf(sc);
+        RecordFileReader reader(ENCODING_ASCII, path.c_str(), RecordFileReader::Format::SDF);
+        EXPECT_EQ(strstr(name, ".gz") == nullptr, reader.isMapped());
+
+        RecordFileReader::Record record;
+        PropertiesMap properties;
+        std::vector<std::string> names;
+        while (!sdf.isEOF())
+        {
+            sdf.readNext();
+            ASSERT_TRUE(reader.next(record));
+            EXPECT_EQ(sdf.currentNumber() - 1, record.index);
+
+            RecordFileReader::readSdfProperties(record, properties);
+            int count = 0;
+            for (auto i : sdf.properties.elements())
+            {
+                ASSERT_TRUE(properties.contains(sdf.properties.key(i)));
+                EXPECT_STREQ(sdf.properties.value(i), properties.at(sdf.properties.key(i)));
+                count++;
+            }
+            for (auto i : properties.elements())
+                count--;
+            EXPECT_EQ(0, count);
+
+            Molecule expected, mol;
+            BufferScanner expected_scanner(sdf.data);
+            MolfileLoader(expected_scanner).loadMolecule(expected);
+            BufferScanner scanner(record.data, (int)record.size);
+            MolfileLoader(scanner).loadMolecule(mol);
+            EXPECT_STREQ(expected.name.ptr(), mol.name.ptr());
+            EXPECT_EQ(expected.vertexCount(), mol.vertexCount());
+            EXPECT_EQ(expected.edgeCount(), mol.edgeCount());
+            names.push_back(mol.name.ptr());
+        }
+        EXPECT_FALSE(reader.next(record));
+        EXPECT_EQ((long long)names.size(), reader.count());
+
+        // Ranges read by several threads give every record once, with its index
+        RecordFileReader parallel(ENCODING_ASCII, path.c_str(), RecordFileReader::Format::SDF);
+        std::vector<std::string> parallel_names(names.size());
+        std::mutex lock;
+        parallel.forEach(4, [&](const RecordFileReader::Record& record) {
+            Molecule mol;
+            BufferScanner scanner(record.data, (int)record.size);
+            MolfileLoader(scanner).loadMolecule(mol);
+            std::lock_guard<std::mutex> guard(lock);
+            ASSERT_LT(record.index, (long long)names.size());
+            parallel_names[record.index] = mol.name.ptr();
+        });
+        EXPECT_EQ(names, parallel_names);
+    }
+
+    // Every line is a record
+    const std::string path = dataPath("molecules/basic/pubchem_slice_5000.smi");
+    FileScanner sc(path.c_str());
+    RecordFileReader reader(ENCODING_ASCII, path.c_str(), RecordFileReader::Format::LINES);
+    RecordFileReader::Record record;
+    Array<char> line;
+    long long index = 0;
+    while (!sc.isEOF())
+    {
+        long long offset = sc.tell();
+        sc.readLine(line, false);
+        ASSERT_TRUE(reader.next(record));
+        EXPECT_EQ(index++, record.index);
+        EXPECT_EQ(offset, record.offset);
+        EXPECT_EQ(std::string(line.ptr(), line.size()), std::string(record.data, record.size));
+    }
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_EQ(index, reader.count());
+}
+
+TEST_F(IndigoCoreFormatsTest, output_numbers)
+{
+    std::string typed, formatted;
+    StringOutput typed_out(typed);
+    StringOutput formatted_out(formatted);
+
+    for (int value : {0, 1, -1, 9, 10, -99, 100, 999, 1000, -12345, INT_MAX, INT_MIN})
+    {
+        for (int width : {0, 2, 3, 10})
+        {
+            typed_out.writeInt(value, width);
+            typed_out.writeChar('|');
+            formatted_out.printf("%*d|", width, value);
+        }
+    }
+    EXPECT_EQ(formatted, typed);
+
+    typed.clear();
+    formatted.clear();
+    for (float value : {0.f, -0.f, 1.f, -1.5f, 0.00005f, 0.00015f, 1.23455f, -2.99995f, 123.456789f, 1e-7f, -1e-7f, 65535.9999f, 1e20f, -3.4e38f})
+    {
+        for (int digits : {0, 2, 4, 6})
+        {
+            for (int width : {0, 9, 10})
+            {
+                typed_out.writeFixed(value, digits, width);
+                typed_out.writeChar('|');
+                formatted_out.printf("%*.*f|", width, digits, value);
+            }
+        }
+    }
+    EXPECT_EQ(formatted, typed);
+}
+
 TEST_F(IndigoCoreFormatsTest, save_cdxml)
 {
     Molecule t_mol;
@@ -30,7 +30,9 @@
 
 #include <base_cpp/array.h>
 #include <base_cpp/exception.h>
+#include <graph/csr_graph.h>
 #include <graph/graph.h>
+#include <graph/subgraph_hash.h>
 
 using namespace indigo;
 
@@ -133,3 +135,103 @@ TEST(GraphContract, CloneGraphPreservesAllLiveVertices)
         EXPECT_TRUE(dst.hasVertex(mapping[i]));
     }
 }
+
+// CsrGraph must list the same neighbours in the same order as the source
+// graph, keep the source indices and leave removed vertices and edges empty.
+TEST(GraphContract, CsrGraphMatchesAdjacency)
+{
+    Graph g;
+    for (int k = 0; k < 5; k++)
+        g.addVertex(); // 0..4
+    g.addEdge(0, 1);
+    g.addEdge(1, 2);
+    g.addEdge(2, 3);
+    g.addEdge(3, 4);
+    g.addEdge(4, 0);
+    g.addEdge(1, 3);
+    g.removeVertex(2); // hole at 2, edges 1 and 2 removed
+
+    CsrGraph csr(g);
+    ASSERT_EQ(g.vertexEnd(), csr.vertexEnd());
+    ASSERT_EQ(g.edgeEnd(), csr.edgeEnd());
+    ASSERT_EQ(g.vertexCount(), csr.vertices().size());
+    EXPECT_EQ(0, csr.degree(2));
+    EXPECT_EQ(-1, csr.getEdge(1).beg);
+
+    for (int v = g.vertexBegin(); v != g.vertexEnd(); v = g.vertexNext(v))
+    {
+        const Vertex& vertex = g.getVertex(v);
+        ASSERT_EQ(vertex.degree(), csr.degree(v));
+
+        int pos = csr.neiBegin(v);
+        for (int i = vertex.neiBegin(); i != vertex.neiEnd(); i = vertex.neiNext(i), pos++)
+        {
+            EXPECT_EQ(vertex.neiVertex(i), csr.neiVertices()[pos]);
+            EXPECT_EQ(vertex.neiEdge(i), csr.neiEdges()[pos]);
+        }
+    }
+
+    for (int e = g.edgeBegin(); e != g.edgeEnd(); e = g.edgeNext(e))
+    {
+        const Edge& edge = g.getEdge(e);
+        EXPECT_EQ(e, csr.findEdgeIndex(edge.beg, edge.end));
+        EXPECT_EQ(e, csr.findEdgeIndex(edge.end, edge.beg));
+    }
+    EXPECT_EQ(-1, csr.findEdgeIndex(0, 3));
+}
+
+TEST(GraphContract, SubgraphHashesMatchSeparateHashes)
+{
+    Graph g;
+    for (int i = 0; i < 8; i++)
+        g.addVertex();
+    for (int i = 0; i < 7; i++)
+        g.addEdge(i, i + 1);
+    g.addEdge(7, 2);
+    g.addEdge(1, 5);
+    g.removeVertex(0); // hole at 0, edge 0 removed
+
+    Array<int> vertex_codes, edge_codes, zero_vertex_codes, zero_edge_codes;
+    vertex_codes.clear_resize(g.vertexEnd());
+    edge_codes.clear_resize(g.edgeEnd());
+    zero_vertex_codes.clear_resize(g.vertexEnd());
+    zero_edge_codes.clear_resize(g.edgeEnd());
+    for (int i = 0; i < g.vertexEnd(); i++)
+    {
+        vertex_codes[i] = 6 + i % 3;
+        zero_vertex_codes[i] = 0;
+    }
+    for (int i = 0; i < g.edgeEnd(); i++)
+    {
+        edge_codes[i] = 1 + i % 2;
+        zero_edge_codes[i] = 0;
+    }
+
+    const Array<int>* vertex_sets[] = {&vertex_codes, &vertex_codes, &zero_vertex_codes};
+    const Array<int>* edge_sets[] = {&edge_codes, &zero_edge_codes, &zero_edge_codes};
+
+    SubgraphHash hash(g);
+    Array<int> vertices, edges;
+    for (int v = g.vertexBegin(); v != g.vertexEnd(); v = g.vertexNext(v))
+        vertices.push(v);
+
+    // Grow the subgraph edge by edge and compare the hashes on every step
+    for (int e = g.edgeBegin(); e != g.edgeEnd(); e = g.edgeNext(e))
+    {
+        edges.push(e);
+        hash.max_iterations = (edges.size() + 1) / 2;
+
+        dword hashes[3];
+        int counts[3];
+        hash.getHashes(vertices, edges, 3, vertex_sets, edge_sets, hashes, counts);
+
+        for (int k = 0; k < 3; k++)
+        {
+            hash.vertex_codes = vertex_sets[k];
+            hash.edge_codes = edge_sets[k];
+            hash.calc_different_codes_count = true;
+            EXPECT_EQ(hash.getHash(vertices, edges), hashes[k]);
+            EXPECT_EQ(hash.getDifferentCodesCount(), counts[k]);
+        }
+    }
+}
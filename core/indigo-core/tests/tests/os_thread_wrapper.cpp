@@ -0,0 +1,91 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include <base_cpp/exception.h>
+#include <base_cpp/os_thread_wrapper.h>
+
+using namespace indigo;
+
+namespace
+{
+    class CountingCommand : public OsCommand
+    {
+    public:
+        void execute(OsCommandResult& /* result */) override
+        {
+            (*executed)++;
+        }
+
+        std::atomic<int>* executed = nullptr;
+    };
+
+    // Hands out commands and fails when the command with the given number is set up
+    class FailingDispatcher : public OsCommandDispatcher
+    {
+    public:
+        FailingDispatcher(int handling_order, int fail_at) : OsCommandDispatcher(handling_order, true), _fail_at(fail_at)
+        {
+        }
+
+        std::atomic<int> executed{0};
+        int handled = 0;
+
+    protected:
+        OsCommand* _allocateCommand() override
+        {
+            CountingCommand* command = new CountingCommand();
+            command->executed = &executed;
+            return command;
+        }
+
+        bool _setupCommand(OsCommand& /* command */) override
+        {
+            if (_set_up == _fail_at)
+                throw Exception("setup failed");
+            _set_up++;
+            return true;
+        }
+
+        void _handleResult(OsCommandResult& /* result */) override
+        {
+            handled++;
+        }
+
+    private:
+        int _fail_at;
+        int _set_up = 0;
+    };
+}
+
+TEST(OsCommandDispatcherTest, SetupErrorReleasesThreads)
+{
+    for (int order : {OsCommandDispatcher::HANDLING_ORDER_ANY, OsCommandDispatcher::HANDLING_ORDER_SERIAL})
+    {
+        for (int fail_at : {0, 1, 50})
+        {
+            FailingDispatcher dispatcher(order, fail_at);
+            EXPECT_THROW(dispatcher.run(4), Exception);
+            EXPECT_LE(dispatcher.executed.load(), fail_at);
+            EXPECT_LE(dispatcher.handled, fail_at);
+        }
+    }
+}
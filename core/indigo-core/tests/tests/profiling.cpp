@@ -0,0 +1,80 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <base_cpp/output.h>
+#include <base_cpp/profiling.h>
+
+#include "common.h"
+
+using namespace indigo;
+
+class IndigoCoreProfilingTest : public IndigoCoreTest
+{
+};
+
+#ifndef INDIGO_NO_PROFILING
+
+TEST_F(IndigoCoreProfilingTest, counters_from_threads)
+{
+    constexpr int THREADS_COUNT = 4;
+    constexpr int ITERATIONS = 10000;
+
+    auto work = []() {
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            profIncCounter("test_profiling_counter", 2);
+            profTimerStart(t, "test_profiling_timer");
+        }
+    };
+
+    profTimersResetSession();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS_COUNT; i++)
+        threads.emplace_back(work);
+    for (auto& thread : threads)
+        thread.join();
+    work();
+
+    {
+        auto inst = sf::xlock_safe_ptr(ProfilingSystem::getInstance());
+        EXPECT_EQ((THREADS_COUNT + 1) * ITERATIONS, inst->getLabelCallCount("test_profiling_counter"));
+        EXPECT_EQ(2 * (THREADS_COUNT + 1) * ITERATIONS, inst->getLabelValue("test_profiling_counter"));
+        EXPECT_EQ((THREADS_COUNT + 1) * ITERATIONS, inst->getLabelCallCount("test_profiling_timer", true));
+
+        Array<char> statistics;
+        ArrayOutput output(statistics);
+        inst->getStatistics(output, false);
+        output.writeByte(0);
+        EXPECT_NE(nullptr, strstr(statistics.ptr(), "test_profiling_counter"));
+    }
+
+    // Reset of the current statistics applies to the shards of the finished threads too, totals are kept
+    profTimersReset();
+    work();
+    auto inst = sf::xlock_safe_ptr(ProfilingSystem::getInstance());
+    EXPECT_EQ(ITERATIONS, inst->getLabelCallCount("test_profiling_counter"));
+    EXPECT_EQ((THREADS_COUNT + 2) * ITERATIONS, inst->getLabelCallCount("test_profiling_counter", true));
+}
+
+#endif
@@ -144,3 +144,95 @@ TEST_F(IndigoCoreSmartsTest, smiles)
 {
     EXPECT_STREQ(smilesLoadSaveLoad("C |$Carbon$|", false).c_str(), "C");
 }
+
+TEST_F(IndigoCoreSmartsTest, compiled_query)
+{
+    const char* queries[] = {"c1ccccc1", "[#7;H2]C", "[H]N(C)C", "C/C=C/C", "[OH]C=O", "[#6;R2]~[#6;R2]"};
+    const char* targets[] = {"c1ccccc1N", "CNC", "CCN", "C/C=C/CC", "C/C=C\\C", "OC(=O)c1ccccc1", "c1ccc2ccccc2c1", "[H]N([H])C"};
+
+    for (auto query_str : queries)
+    {
+        QueryMolecule query;
+        loadQueryMolecule(query_str, query);
+
+        CompiledSubstructureQuery compiled, reordered;
+        compiled.compile(query);
+        reordered.compileReordered(query);
+
+        for (auto target_str : targets)
+        {
+            Molecule target;
+            loadMolecule(target_str, target);
+
+            MoleculeSubstructureMatcher matcher(target);
+            matcher.setQuery(query);
+            bool expected = matcher.find();
+
+            MoleculeSubstructureMatcher compiled_matcher(target);
+            compiled_matcher.setQuery(compiled);
+            EXPECT_EQ(expected, compiled_matcher.find()) << query_str << " in " << target_str;
+
+            MoleculeSubstructureMatcher reordered_matcher(target);
+            reordered_matcher.setQuery(reordered);
+            bool found = reordered_matcher.find();
+            EXPECT_EQ(expected, found) << query_str << " in " << target_str;
+            if (!found)
+                continue;
+
+            // Mapping of the reordered query leads back to the atoms of the source query
+            const int* mapping = reordered_matcher.getQueryMapping();
+            QueryMolecule& compiled_query = reordered.getQuery();
+            for (int i = compiled_query.vertexBegin(); i != compiled_query.vertexEnd(); i = compiled_query.vertexNext(i))
+            {
+                if (mapping[i] < 0)
+                    continue;
+                EXPECT_TRUE(query.possibleAtomNumber(reordered.sourceAtom(i), target.getAtomNumber(mapping[i])));
+            }
+        }
+    }
+}
+
+TEST_F(IndigoCoreSmartsTest, compiled_atom_expressions)
+{
+    const char* queries[] = {"[C,N,O;!H0]", "[!#6;!#1]", "[N,O,S;+,-]", "[#6,#7;R;!a]", "[13C,N]", "[$(C=O),$(N#C)]", "[C;X4;!$(C(F)(F)F)]",
+                             "[!C;!c]~[#8]", "[Cl,Br,I]C", "[O-,N+]", "[#7,#8,#16;H1,H2]", "[C,c;D3;+0]"};
+    const char* targets[] = {"CC(=O)O", "C[N+](C)(C)C", "OC(F)(F)F", "C1=CC=NC=C1", "c1ccccc1O", "[13CH4]",
+                             "N#CCBr", "O=S(=O)(O)O", "ClCCI", "C[O-].[Na+]", "CC(C)(C)O"};
+
+    for (auto query_str : queries)
+    {
+        QueryMolecule query;
+        loadQueryMolecule(query_str, query);
+
+        CompiledSubstructureQuery compiled;
+        compiled.compile(query);
+
+        for (auto target_str : targets)
+        {
+            Molecule target;
+            loadMolecule(target_str, target);
+
+            MoleculeSubstructureMatcher::FragmentMatchCache fmcache;
+            for (int i = query.vertexBegin(); i != query.vertexEnd(); i = query.vertexNext(i))
+                for (int j = target.vertexBegin(); j != target.vertexEnd(); j = target.vertexNext(j))
+                    for (dword flags : {0xFFFFFFFFU, 0xFFFFFFFFU & ~(dword)MoleculeSubstructureMatcher::MATCH_ATOM_CHARGE})
+                        EXPECT_EQ(MoleculeSubstructureMatcher::matchQueryAtom(&query.getAtom(i), target, j, &fmcache, flags),
+                                  compiled.matchAtom(i, target, j, &fmcache, flags))
+                            << query_str << " atom " << i << " in " << target_str << " atom " << j;
+
+            MoleculeSubstructureMatcher matcher(target);
+            matcher.fmcache = &fmcache;
+            matcher.setQuery(query);
+            bool expected = matcher.find();
+
+            for (bool precompute : {false, true})
+            {
+                MoleculeSubstructureMatcher compiled_matcher(target);
+                compiled_matcher.fmcache = &fmcache;
+                compiled_matcher.precompute_atom_pairs = precompute;
+                compiled_matcher.setQuery(compiled);
+                EXPECT_EQ(expected, compiled_matcher.find()) << query_str << " in " << target_str;
+            }
+        }
+    }
+}